@@ -59,18 +59,27 @@ int
 main(int argc, char **argv) {
    unsigned short int port = 3000;
    snl_socket_t *server = NULL;
+   char *group = NULL;
+   int batch = 1;
+   int mtu = 0;
 
    for (int i=1; i<argc; i++) {
       if (!strcmp(argv[i], "-p") && (argc>i+1)) port = atoi(argv[i+1]);
       if (!strcmp(argv[i], "-k")) key  = argv[i+1];
+      if (!strcmp(argv[i], "-m") && (argc>i+1)) group = argv[i+1];
+      if (!strcmp(argv[i], "-b") && (argc>i+1)) batch = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-F") && (argc>i+1)) mtu   = atoi(argv[i+1]);
       if (!strcmp(argv[i], "--help")) {
          puts("");
          puts("udplistener " VERSION " <clemens@1541.org>");
          puts("");
-         puts("USAGE: udplistener [-p port] [-k key]");
+         puts("USAGE: udplistener [-p port] [-k key] [-m group] [-b num] [-F mtu]");
          puts("");
          puts("\t-p ... listen on port <port> (default 3000)");
          puts("\t-k ... set cipher key to <key> (default none)");
+         puts("\t-m ... join multicast group <group> (default none)");
+         puts("\t-b ... receive up to <num> datagrams at once (default 1)");
+         puts("\t-F ... reassemble fragments of <mtu> bytes (default off)");
          exit(0);
       }
    }
@@ -86,6 +95,14 @@ main(int argc, char **argv) {
    server = snl_socket_new(SNL_PROTO_UDP, event_callback, NULL);
 
    snl_passphrase(server, key);
+   snl_receive_batch(server, batch);
+   snl_fragment(server, mtu);
+
+   if (group && snl_multicast_join(server, group, NULL)) {
+      printf("could not join multicast group %s, exiting.\n", group);
+
+      return (1);
+   }
 
    if (snl_listen(server, port)) {
       printf("could not start listener, exiting.\n");
@@ -30,12 +30,14 @@ main(int argc, char **argv) {
    int flush = 0;
    int fast = 0;
    int size = 0;
+   int mtu = 0;
 
    for (int i=1; i<argc; i++) {
       if (!strcmp(argv[i], "-h") && (argc>i+1)) host = argv[i+1];
       if (!strcmp(argv[i], "-k") && (argc>i+1)) key  = argv[i+1];
       if (!strcmp(argv[i], "-p") && (argc>i+1)) port = atoi(argv[i+1]);
       if (!strcmp(argv[i], "-s") && (argc>i+1)) size = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-F") && (argc>i+1)) mtu  = atoi(argv[i+1]);
       if (!strcmp(argv[i], "-b")) host = NULL;
       if (!strcmp(argv[i], "-t")) fast = 1;
       if (!strcmp(argv[i], "-f")) flush = 1;
@@ -44,15 +46,16 @@ main(int argc, char **argv) {
          puts("udpsender " VERSION " <clemens@1541.org>");
          puts("");
          puts("USAGE: udpsender [-h host] [-p port] [-s size]");
-         puts("                 [-k key] [-b] [-t] [-f]");
+         puts("                 [-k key] [-F mtu] [-b] [-t] [-f]");
          puts("");
-         puts("\t-h ... host name (default localhost)");
+         puts("\t-h ... host name or multicast group (default localhost)");
          puts("\t-k ... set passphrase to <key> (default none)");
          puts("\t-p ... port number (default 3000)");
          puts("\t-b ... use broadcast address (default off)");
          puts("\t-t ... send a packet each timeslice (default off)");
          puts("\t-f ... send as fast as possible (default off)");
          puts("\t-s ... payload size");
+         puts("\t-F ... split payload into fragments of <mtu> bytes");
          puts("");
          exit(0);
       }
@@ -67,6 +70,7 @@ main(int argc, char **argv) {
    skt = snl_socket_new(SNL_PROTO_UDP, NULL, NULL);
 
    snl_passphrase(skt, key);
+   snl_fragment(skt, mtu);
 
    if (!(snl_connect(skt, host, port)) > 0) {
       if (size) {
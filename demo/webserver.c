@@ -12,16 +12,6 @@
 
 static int shutdown = 0;
 
-static const char *
-ipaddr(unsigned int host, unsigned short port) {
-	unsigned char *ip = (unsigned char *)&host;
-	static char buf[32];
-
-	sprintf(buf, "%i.%i.%i.%i:%i", ip[3], ip[2], ip[1], ip[0], port);
-
-	return (buf);
-}
-
 static void
 quit(int sig) {
 	if (!shutdown) {
@@ -30,34 +20,17 @@ quit(int sig) {
 }
 
 static void
-event_callback(snl_socket_t *skt) {
-	const char *info, *msg = "<html>hello, world!</html>";
-
-	switch (skt->event_code) {
-		case SNL_EVENT_ERROR:
-			if (skt->error_code == SNL_ERROR_CLOSED) {
-				printf("client closed connection\n");
-				snl_disconnect(skt);
-			} else {
-				printf("client error: %i (%s)\n",
-					skt->error_code,
-					snl_error_string(skt->error_code));
-			}
-		break;
-
-		case SNL_EVENT_ACCEPT:
-			info = ipaddr(skt->client_ip, skt->client_port);
-			printf("client connected from: %s\n", info);
-
-			snl_write(skt->client_fd, msg, strlen(msg));
-			close(skt->client_fd);
-		break;
-	}
+request_handler(snl_socket_t *skt, const snl_http_request_t *req, void *data) {
+	// everything but the static page ends up here
+	printf("%.*s %.*s\n",
+		req->method_length, req->method,
+		req->target_length, req->target);
 }
 
 int main(int argc, char **argv) {
+	const char *msg = "<html>hello, world!</html>";
 	unsigned short int port = 8080;
-	snl_socket_t *server;
+	snl_http_t *server;
 
 	for (int i=1; i<argc; i++) {
 		if (!strcmp(argv[i], "-p")) port = atoi(argv[i+1]);
@@ -80,9 +53,13 @@ int main(int argc, char **argv) {
 
 	printf("starting webserver on port %i.\n", port);
 
-	server = snl_socket_new(SNL_PROTO_TCP, event_callback, NULL);
+	server = snl_http_new(request_handler, NULL);
+
+	// formatted once, served over persistent connections
+	snl_http_static(server, "/", "text/html", msg, strlen(msg));
+	snl_http_static(server, "/index.html", "text/html", msg, strlen(msg));
 
-	if (snl_listen(server, port)) {
+	if (snl_http_listen(server, port)) {
 		printf("could not start server, exiting.\n");
 
 		return (1);
@@ -92,10 +69,7 @@ int main(int argc, char **argv) {
 		usleep(1000);
 	}
 
-	sleep(1);
-
-	snl_disconnect(server);
-	snl_socket_delete(server);
+	snl_http_delete(server);
 	
 	return (0);
 }
@@ -0,0 +1,138 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <stdlib.h>      // calloc(), malloc(), free()
+#include <pthread.h>     // pthread_mutex_*()
+
+#include "admission.h"
+
+static pthread_mutex_t registry = PTHREAD_MUTEX_INITIALIZER;
+
+static snl_admission_claim_t *unclaimed = NULL;
+
+// any listener's claim for fd, unless adm names one
+static snl_admission_t *
+take_claim(int fd, snl_admission_t *adm) {
+   snl_admission_claim_t **cp, *claim;
+   snl_admission_t *found = NULL;
+
+   pthread_mutex_lock(&registry);
+
+   for (cp=&unclaimed; (claim = *cp); cp=&claim->next) {
+      if ((claim->fd == fd) && (!adm || (claim->admission == adm))) {
+         *cp = claim->next;
+         found = claim->admission;
+         free(claim);
+         break;
+      }
+   }
+
+   pthread_mutex_unlock(&registry);
+
+   return (found);
+}
+
+static void
+connection_ended(snl_admission_t *adm) {
+   __sync_fetch_and_sub(&adm->live, 1);
+   snl_admission_unref(adm);
+}
+
+snl_admission_t *
+snl_admission_new(int backlog, unsigned int limit, snl_bucket_t *bkt) {
+   snl_admission_t *adm;
+
+   if (!(adm = calloc(1, sizeof (snl_admission_t)))) {
+      return (NULL);
+   }
+
+   adm->refcount = 1;
+   adm->backlog  = backlog;
+   adm->limit    = limit;
+   adm->bucket   = bkt ? snl_bucket_ref(bkt) : NULL;
+
+   return (adm);
+}
+
+void
+snl_admission_unref(snl_admission_t *adm) {
+   if (!adm || __sync_sub_and_fetch(&adm->refcount, 1)) return;
+
+   snl_bucket_delete(adm->bucket);
+   free(adm);
+}
+
+long long
+snl_admission_wait(snl_admission_t *adm) {
+   return (adm->bucket ? snl_bucket_debt(adm->bucket) : 0);
+}
+
+int
+snl_admission_admit(snl_admission_t *adm, int fd) {
+   snl_admission_claim_t *claim;
+
+   // a clear answer beats a connect timeout for the client
+   if (adm->limit && (adm->live >= adm->limit)) {
+      __sync_fetch_and_add(&adm->refused, 1);
+      return (SNL_ERROR_ACCEPT);
+   }
+
+   if (!(claim = malloc(sizeof (snl_admission_claim_t)))) {
+      return (SNL_ERROR_BUFFER);
+   }
+
+   if (adm->bucket) snl_bucket_take(adm->bucket, 1);
+
+   __sync_fetch_and_add(&adm->live, 1);
+   __sync_fetch_and_add(&adm->refcount, 1);
+
+   claim->fd = fd;
+   claim->admission = adm;
+
+   pthread_mutex_lock(&registry);
+   claim->next = unclaimed;
+   unclaimed = claim;
+   pthread_mutex_unlock(&registry);
+
+   return (SNL_ERROR_OK);
+}
+
+void
+snl_admission_settle(snl_admission_t *adm, int fd) {
+   // the callback closed it or kept it for itself
+   if (take_claim(fd, adm)) connection_ended(adm);
+}
+
+void
+snl_admission_claim(snl_socket_t *skt) {
+   snl_admission_t *adm;
+
+   if ((adm = take_claim(skt->file_descriptor, NULL))) {
+      snl_admission_release(skt);
+      skt->admitted = adm;
+   }
+}
+
+void
+snl_admission_release(snl_socket_t *skt) {
+   if (!skt->admitted) return;
+
+   connection_ended(skt->admitted);
+   skt->admitted = NULL;
+}
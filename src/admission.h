@@ -0,0 +1,52 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef _SNL_ADMISSION_H_
+#define _SNL_ADMISSION_H_
+
+#include "shaper.h"
+#include "snl.h"
+
+// limits of a listener, shared with the connections it accepted
+typedef struct snl_admission_t {
+   int refcount;                  // listener and every live connection
+   int backlog;                   // for listen()
+   unsigned int limit;            // most live connections, 0 for any
+   volatile unsigned int live;    // accepted and not yet ended
+   volatile unsigned int refused; // closed right away over the limit
+   snl_bucket_t *bucket;          // accept rate, NULL for any
+} snl_admission_t;
+
+// accepted, snl_accept() not yet called for it
+typedef struct snl_admission_claim_t {
+   int fd;
+   snl_admission_t *admission;
+   struct snl_admission_claim_t *next;
+} snl_admission_claim_t;
+
+snl_admission_t *snl_admission_new(int backlog, unsigned int limit, snl_bucket_t *bkt);
+void snl_admission_unref(snl_admission_t *adm);
+
+long long snl_admission_wait(snl_admission_t *adm);
+int snl_admission_admit(snl_admission_t *adm, int fd);
+void snl_admission_settle(snl_admission_t *adm, int fd);
+void snl_admission_claim(snl_socket_t *skt);
+void snl_admission_release(snl_socket_t *skt);
+
+#endif // _SNL_ADMISSION_H_
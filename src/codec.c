@@ -0,0 +1,220 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <string.h>      // memcpy(), memmove(), memset(), strlen()
+#include <stdlib.h>      // calloc(), malloc(), free()
+
+#include "blowfish.h"
+#include "codec.h"
+
+// the cipher of snl_passphrase() as a stage, pads to full blocks
+static int
+blowfish_encode(void *state, const void *buf, unsigned int len, void *out, unsigned int *size) {
+   unsigned char *ptr = out;
+   int pad = 8 - (len % 8);
+
+   if (out != buf) memcpy(out, buf, len);
+   memset(ptr + len, pad, pad);
+
+   if (bf_encrypt(state, out, len + pad)) {
+      return (SNL_ERROR_CIPHER);
+   }
+
+   *size = len + pad;
+
+   return (SNL_ERROR_OK);
+}
+
+static int
+blowfish_decode(void *state, void *buf, unsigned int len, void **out, unsigned int *size) {
+   unsigned char *ptr = buf;
+   int pad;
+
+   if (!len || bf_decrypt(state, buf, len)) {
+      return (SNL_ERROR_CIPHER);
+   }
+
+   pad = ptr[len - 1];
+
+   if ((pad < 1) || (pad > 8)) {
+      return (SNL_ERROR_CIPHER);
+   }
+
+   *out = buf;
+   *size = len - pad;
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_codec_blowfish(snl_codec_t *codec, const char *key) {
+   blowfish_t *bf;
+
+   if (!key) return (SNL_ERROR_OPTION);
+
+   if (!(bf = malloc(sizeof (blowfish_t)))) {
+      return (SNL_ERROR_BUFFER);
+   }
+
+   bf_init(bf, (void *)key, strlen(key));
+
+   memset(codec, 0, sizeof (snl_codec_t));
+
+   codec->overhead = 8;
+   codec->inplace  = 1;
+   codec->encode   = blowfish_encode;
+   codec->decode   = blowfish_decode;
+   codec->release  = free;
+   codec->state    = bf;
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_codecs_insert(snl_codecs_t **codecs, unsigned int index, const snl_codec_t *codec) {
+   snl_codecs_t *c = *codecs;
+
+   if (!codec->encode || !codec->decode) {
+      return (SNL_ERROR_OPTION);
+   }
+
+   if (!c && !(c = calloc(1, sizeof (snl_codecs_t)))) {
+      return (SNL_ERROR_BUFFER);
+   }
+
+   *codecs = c;
+
+   if (c->count == CODEC_STAGES_MAX) {
+      return (SNL_ERROR_OPTION);
+   }
+
+   if (index > c->count) index = c->count;
+
+   memmove(&c->stage[index + 1], &c->stage[index], (c->count - index) * sizeof (snl_codec_t));
+   c->stage[index] = *codec;
+   c->count++;
+
+   c->overhead += codec->overhead;
+
+   return (SNL_ERROR_OK);
+}
+
+void
+snl_codecs_remove(snl_codecs_t **codecs, const void *state) {
+   snl_codecs_t *c = *codecs;
+   unsigned int i = 0;
+
+   if (!c) return;
+
+   while (i < c->count) {
+      if (c->stage[i].state != state) {
+         i++;
+         continue;
+      }
+
+      c->overhead -= c->stage[i].overhead;
+      if (c->stage[i].release) c->stage[i].release(c->stage[i].state);
+
+      c->count--;
+      memmove(&c->stage[i], &c->stage[i + 1], (c->count - i) * sizeof (snl_codec_t));
+   }
+
+   // an empty pipeline is no pipeline at all
+   if (!c->count) {
+      snl_codecs_delete(c);
+      *codecs = NULL;
+   }
+}
+
+void
+snl_codecs_delete(snl_codecs_t *codecs) {
+   unsigned int i;
+
+   if (!codecs) return;
+
+   for (i=0; i<codecs->count; i++) {
+      if (codecs->stage[i].release) codecs->stage[i].release(codecs->stage[i].state);
+   }
+
+   free(codecs);
+}
+
+int
+snl_codecs_encode(snl_codecs_t *codecs, const void *buf, unsigned int *len, void **out) {
+   unsigned int i, size = *len, room = *len + codecs->overhead, flips = 0, half;
+   unsigned char *mem, *dst;
+   const void *src = buf;
+   int error;
+
+   if (room < size) {
+      return (SNL_ERROR_SEND);
+   }
+
+   // the first stage reads the buffer of the caller, every stage that
+   // does not work in place flips to the other half, the last one has to
+   // end up in the first
+   for (i=1; i<codecs->count; i++) {
+      if (!codecs->stage[i].inplace) flips++;
+   }
+
+   if (!(mem = malloc(flips ? 2 * (size_t)room : room))) {
+      return (SNL_ERROR_BUFFER);
+   }
+
+   half = flips & 1;
+
+   for (i=0; i<codecs->count; i++) {
+      if (i && codecs->stage[i].inplace) {
+         dst = (unsigned char *)src;
+      } else {
+         if (i) half ^= 1;
+         dst = mem + (half ? room : 0);
+      }
+
+      if ((error = codecs->stage[i].encode(codecs->stage[i].state, src, size, dst, &size))) {
+         free(mem);
+         return (error);
+      }
+
+      src = dst;
+   }
+
+   *out = mem;
+   *len = size;
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_codecs_decode(snl_codecs_t *codecs, void *buf, unsigned int len, void **out, unsigned int *size) {
+   unsigned int i;
+   int error;
+
+   // backwards, each stage sees what its encoder produced
+   for (i=codecs->count; i--; ) {
+      if ((error = codecs->stage[i].decode(codecs->stage[i].state, buf, len, &buf, &len))) {
+         return (error);
+      }
+   }
+
+   *out = buf;
+   *size = len;
+
+   return (SNL_ERROR_OK);
+}
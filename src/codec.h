@@ -0,0 +1,43 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef _SNL_CODEC_H_
+#define _SNL_CODEC_H_
+
+#include "snl.h"
+
+#define CODEC_STAGES_MAX 8
+
+// ordered transforms of every message, stage 0 runs first when sending
+typedef struct snl_codecs_t {
+   unsigned int count;
+   unsigned int overhead;         // sum of all stages, sizes buffers once
+   snl_codec_t stage[CODEC_STAGES_MAX];
+   int lent;                      // data buffer points to a decoded message
+   void *spare;                   // receive buffer while delivering
+} snl_codecs_t;
+
+int snl_codecs_insert(snl_codecs_t **codecs, unsigned int index, const snl_codec_t *codec);
+void snl_codecs_remove(snl_codecs_t **codecs, const void *state);
+void snl_codecs_delete(snl_codecs_t *codecs);
+
+int snl_codecs_encode(snl_codecs_t *codecs, const void *buf, unsigned int *len, void **out);
+int snl_codecs_decode(snl_codecs_t *codecs, void *buf, unsigned int len, void **out, unsigned int *size);
+
+#endif // _SNL_CODEC_H_
@@ -0,0 +1,383 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <string.h>      // memcpy(), memset()
+#include <stdlib.h>      // calloc(), malloc(), realloc(), free()
+
+#include "compress.h"
+#include "framing.h"
+
+// LZ77 in the spirit of LZ4: every sequence is a token with the number of
+// literals in the high and the match length in the low nibble, followed by
+// the literals, a 16 bit little endian offset and the match. The last
+// sequence ends after its literals. A dictionary is a virtual prefix of
+// every message, matches may reach back into it.
+
+static inline unsigned int
+read32(const unsigned char *p) {
+   unsigned int v;
+
+   memcpy(&v, p, sizeof (v));
+
+   return (v);
+}
+
+static inline unsigned int
+hash(unsigned int v) {
+   return ((v * 2654435761U) >> (32 - COMPRESS_HASH_BITS));
+}
+
+static unsigned int
+match_length(const unsigned char *a, const unsigned char *b, const unsigned char *end) {
+   const unsigned char *start = a;
+   unsigned long long x, y;
+
+   while (a + sizeof (x) <= end) {
+      memcpy(&x, a, sizeof (x));
+      memcpy(&y, b, sizeof (y));
+
+      if (x != y) return (a - start + (__builtin_ctzll(x ^ y) >> 3));
+
+      a += sizeof (x);
+      b += sizeof (y);
+   }
+
+   while ((a < end) && (*a == *b)) {
+      a++;
+      b++;
+   }
+
+   return (a - start);
+}
+
+static unsigned char *
+put_length(unsigned char *op, unsigned int len) {
+   while (len >= 255) {
+      *op++ = 255;
+      len -= 255;
+   }
+
+   *op++ = len;
+
+   return (op);
+}
+
+static int
+get_length(const unsigned char **ip, const unsigned char *end, unsigned int *len) {
+   unsigned int byte;
+
+   do {
+      if (*ip >= end) return (-1);
+
+      byte = *(*ip)++;
+      *len += byte;
+
+      // no message is that long, stops overflows
+      if (*len > FRAME_LENGTH_MAX) return (-1);
+   } while (byte == 255);
+
+   return (0);
+}
+
+// 0 if the result would not be shorter than cap
+static unsigned int
+lz_encode(const snl_compress_t *cmp, const unsigned char *src, unsigned int len, unsigned char *dst, unsigned int cap) {
+   const unsigned char *ip = src, *anchor = src, *end = src + len, *ref;
+   unsigned char *op = dst, *limit = dst + cap, *token;
+   int table[1 << COMPRESS_HASH_BITS], cand, pos;
+   unsigned int h, lit, mlen, miss = 0;
+   int dict = cmp->dict_len;
+
+   // a very negative position is out of reach
+   if (dict) {
+      memcpy(table, cmp->table, sizeof (table));
+   } else {
+      memset(table, 0x80, sizeof (table));
+   }
+
+   while (ip + COMPRESS_MIN_MATCH <= end) {
+      pos = ip - src;
+      h = hash(read32(ip));
+      cand = table[h];
+      table[h] = pos;
+
+      if ((cand < -dict) || (pos - cand > COMPRESS_WINDOW)) {
+         ref = NULL;
+      } else {
+         ref = (cand < 0) ? cmp->dict + dict + cand : src + cand;
+      }
+
+      if (!ref || (read32(ref) != read32(ip))) {
+         // incompressible data is skipped faster and faster
+         ip += 1 + (miss++ >> 5);
+         continue;
+      }
+
+      miss = 0;
+
+      if (cand < 0) {
+         // up to the end of the dictionary, then on in the message
+         mlen = match_length(ip, ref, (end - ip < -cand) ? end : ip - cand);
+         if (mlen == (unsigned int)-cand) mlen += match_length(ip + mlen, src, end);
+      } else {
+         mlen = match_length(ip, ref, end);
+      }
+
+      lit = ip - anchor;
+
+      // token, literals, offset and both lengths
+      if (op + 1 + lit + lit / 255 + 2 + mlen / 255 + 2 > limit) {
+         return (0);
+      }
+
+      token = op++;
+      *token = ((lit < 15) ? lit : 15) << 4;
+      if (lit >= 15) op = put_length(op, lit - 15);
+
+      memcpy(op, anchor, lit);
+      op += lit;
+
+      *op++ = (pos - cand) & 0xff;
+      *op++ = (pos - cand) >> 8;
+
+      mlen -= COMPRESS_MIN_MATCH;
+      *token |= (mlen < 15) ? mlen : 15;
+      if (mlen >= 15) op = put_length(op, mlen - 15);
+
+      ip += mlen + COMPRESS_MIN_MATCH;
+      anchor = ip;
+
+      // remember a position inside the match, helps repetitive data
+      if (ip + COMPRESS_MIN_MATCH <= end) {
+         table[hash(read32(ip - 2))] = ip - 2 - src;
+      }
+   }
+
+   lit = end - anchor;
+
+   if (op + 1 + lit + lit / 255 + 1 > limit) {
+      return (0);
+   }
+
+   token = op++;
+   *token = ((lit < 15) ? lit : 15) << 4;
+   if (lit >= 15) op = put_length(op, lit - 15);
+
+   memcpy(op, anchor, lit);
+   op += lit;
+
+   return (op - dst);
+}
+
+static int
+lz_decode(const snl_compress_t *cmp, const unsigned char *ip, unsigned int len, unsigned char *dst, unsigned int size) {
+   const unsigned char *end = ip + len, *ref;
+   unsigned char *op = dst, *oend = dst + size;
+   unsigned int token, lit, mlen, off, n;
+
+   while (ip < end) {
+      token = *ip++;
+
+      lit = token >> 4;
+      if ((lit == 15) && get_length(&ip, end, &lit)) return (-1);
+
+      if ((lit > (unsigned int)(end - ip)) || (lit > (unsigned int)(oend - op))) {
+         return (-1);
+      }
+
+      memcpy(op, ip, lit);
+      op += lit;
+      ip += lit;
+
+      // the last sequence has no match
+      if (ip == end) break;
+
+      if (end - ip < 2) return (-1);
+
+      off = ip[0] | (ip[1] << 8);
+      ip += 2;
+
+      mlen = token & 15;
+      if ((mlen == 15) && get_length(&ip, end, &mlen)) return (-1);
+      mlen += COMPRESS_MIN_MATCH;
+
+      if ((mlen > (unsigned int)(oend - op)) || !off || (off > (op - dst) + cmp->dict_len)) {
+         return (-1);
+      }
+
+      // reaching back into the dictionary
+      if (off > (unsigned int)(op - dst)) {
+         n = off - (op - dst);
+         if (n > mlen) n = mlen;
+
+         memcpy(op, cmp->dict + cmp->dict_len - (off - (op - dst)), n);
+         op += n;
+         mlen -= n;
+      }
+
+      ref = op - off;
+
+      if (off >= mlen) {
+         memcpy(op, ref, mlen);
+         op += mlen;
+      } else {
+         // overlapping, repeats the last off bytes
+         while (mlen--) *op++ = *ref++;
+      }
+   }
+
+   return ((op == oend) ? 0 : -1);
+}
+
+snl_compress_t *
+snl_compress_new(unsigned int threshold) {
+   snl_compress_t *cmp;
+
+   if (!(cmp = calloc(1, sizeof (snl_compress_t)))) {
+      return (NULL);
+   }
+
+   cmp->threshold = threshold;
+
+   return (cmp);
+}
+
+void
+snl_compress_delete(snl_compress_t *cmp) {
+   if (!cmp) return;
+
+   free(cmp->dict);
+   free(cmp->table);
+   free(cmp->scratch);
+   free(cmp);
+}
+
+int
+snl_compress_load(snl_compress_t *cmp, const void *dict, unsigned int len) {
+   unsigned int i;
+
+   free(cmp->dict);
+   free(cmp->table);
+
+   cmp->dict = NULL;
+   cmp->table = NULL;
+   cmp->dict_len = 0;
+
+   if (!len) return (SNL_ERROR_OK);
+
+   // only the last window can be reached
+   if (len > COMPRESS_WINDOW) {
+      dict = (const unsigned char *)dict + len - COMPRESS_WINDOW;
+      len = COMPRESS_WINDOW;
+   }
+
+   if (!(cmp->dict = malloc(len)) || !(cmp->table = malloc(sizeof (int) << COMPRESS_HASH_BITS))) {
+      free(cmp->dict);
+      cmp->dict = NULL;
+      return (SNL_ERROR_BUFFER);
+   }
+
+   memcpy(cmp->dict, dict, len);
+   memset(cmp->table, 0x80, sizeof (int) << COMPRESS_HASH_BITS);
+
+   // hashed once, every message starts from a copy
+   for (i=0; i+COMPRESS_MIN_MATCH<=len; i++) {
+      cmp->table[hash(read32(cmp->dict + i))] = (int)i - (int)len;
+   }
+
+   cmp->dict_len = len;
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_compress_encode(void *state, const void *buf, unsigned int len, void *out, unsigned int *size) {
+   const snl_compress_t *cmp = state;
+   unsigned int header, packed = 0;
+   unsigned char *ptr = out;
+
+   if (len >= cmp->threshold) {
+      ptr[0] = COMPRESS_LZ;
+      header = 1 + snl_varint_put(ptr + 1, len);
+
+      // only worth it if shorter than the raw message
+      if (len > header) {
+         packed = lz_encode(cmp, buf, len, ptr + header, len - header);
+      }
+   }
+
+   if (packed) {
+      *size = header + packed;
+   } else {
+      ptr[0] = COMPRESS_RAW;
+      memcpy(ptr + 1, buf, len);
+      *size = len + 1;
+   }
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_compress_decode(void *state, void *buf, unsigned int len, void **out, unsigned int *size) {
+   snl_compress_t *cmp = state;
+   unsigned char *ptr = buf;
+   unsigned long long length;
+   unsigned int used;
+   void *scratch;
+
+   if (!len) {
+      return (SNL_ERROR_COMPRESS);
+   }
+
+   if (ptr[0] == COMPRESS_RAW) {
+      *out = ptr + 1;
+      *size = len - 1;
+
+      return (SNL_ERROR_OK);
+   }
+
+   if (ptr[0] != COMPRESS_LZ) {
+      return (SNL_ERROR_COMPRESS);
+   }
+
+   used = snl_varint_get(ptr + 1, len - 1, &length);
+
+   // a match expands to at most 255 bytes per input byte
+   if (!used || (length > FRAME_LENGTH_MAX) || (length > 255ULL * len)) {
+      return (SNL_ERROR_COMPRESS);
+   }
+
+   if (length > cmp->scratch_len) {
+      if (!(scratch = realloc(cmp->scratch, length * 2))) {
+         return (SNL_ERROR_BUFFER);
+      }
+
+      cmp->scratch = scratch;
+      cmp->scratch_len = length * 2;
+   }
+
+   if (lz_decode(cmp, ptr + 1 + used, len - 1 - used, cmp->scratch, length)) {
+      return (SNL_ERROR_COMPRESS);
+   }
+
+   *out = cmp->scratch;
+   *size = length;
+
+   return (SNL_ERROR_OK);
+}
@@ -0,0 +1,51 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef _SNL_COMPRESS_H_
+#define _SNL_COMPRESS_H_
+
+#include "snl.h"
+
+#define COMPRESS_WINDOW    65535  // max match distance, also kept of a dictionary
+#define COMPRESS_HASH_BITS 12     // 4096 entries, 16KB on the stack of a sender
+#define COMPRESS_MIN_MATCH 4
+#define COMPRESS_RAW       0x00   // marker byte, payload follows unchanged
+#define COMPRESS_LZ        0x01   // marker byte, varint length and sequences follow
+#define COMPRESS_OVERHEAD  1      // raw marker, compressed messages are shorter
+
+typedef struct snl_compress_t {
+   unsigned int threshold;        // smaller messages are sent raw
+   unsigned char *dict;           // tail of the shared dictionary
+   unsigned int dict_len;
+   int *table;                    // hashed dictionary positions, negative
+   void *scratch;                 // decompressed message, worker only
+   unsigned int scratch_len;
+   int lent;                      // data buffer points to scratch
+   void *spare;                   // receive buffer while delivering
+} snl_compress_t;
+
+snl_compress_t *snl_compress_new(unsigned int threshold);
+void snl_compress_delete(snl_compress_t *cmp);
+int snl_compress_load(snl_compress_t *cmp, const void *dict, unsigned int len);
+
+// stage of the codec pipeline, the state is a snl_compress_t
+int snl_compress_encode(void *state, const void *buf, unsigned int len, void *out, unsigned int *size);
+int snl_compress_decode(void *state, void *buf, unsigned int len, void **out, unsigned int *size);
+
+#endif // _SNL_COMPRESS_H_
@@ -0,0 +1,218 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <string.h>      // memcpy(), memset()
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>       // __get_cpuid()
+#define CRC_SSE42
+#elif defined(__aarch64__)
+#include <sys/auxv.h>    // getauxval()
+#include <asm/hwcap.h>   // HWCAP_CRC32
+#define CRC_ARMV8
+#endif
+
+#include "crc.h"
+
+#define CRC_POLY 0x82f63b78 // Castagnoli, reflected
+
+typedef unsigned int (*crc_copy_t)(unsigned int crc, unsigned char *dst, const unsigned char *src, unsigned int len);
+
+static unsigned int table[8][256];
+
+static unsigned int crc_copy_table(unsigned int crc, unsigned char *dst, const unsigned char *src, unsigned int len);
+
+// chosen once by snl_init(), the table works everywhere
+static crc_copy_t crc_copy = crc_copy_table;
+
+static unsigned int
+crc_copy_table(unsigned int crc, unsigned char *dst, const unsigned char *src, unsigned int len) {
+   unsigned int lo, hi;
+
+   // slice by 8, the copy is done with the very same loads
+   while (len >= 8) {
+      memcpy(&lo, src, 4);
+      memcpy(&hi, src + 4, 4);
+      if (dst) {
+         memcpy(dst, src, 8);
+         dst += 8;
+      }
+
+      lo ^= crc;
+      crc = table[7][lo & 0xff] ^ table[6][(lo >> 8) & 0xff] ^
+            table[5][(lo >> 16) & 0xff] ^ table[4][lo >> 24] ^
+            table[3][hi & 0xff] ^ table[2][(hi >> 8) & 0xff] ^
+            table[1][(hi >> 16) & 0xff] ^ table[0][hi >> 24];
+
+      src += 8;
+      len -= 8;
+   }
+
+   while (len--) {
+      if (dst) *dst++ = *src;
+      crc = table[0][(crc ^ *src++) & 0xff] ^ (crc >> 8);
+   }
+
+   return (crc);
+}
+
+#ifdef CRC_SSE42
+__attribute__((target("sse4.2")))
+static unsigned int
+crc_copy_sse42(unsigned int crc, unsigned char *dst, const unsigned char *src, unsigned int len) {
+#ifdef __x86_64__
+   unsigned long long c = crc, v;
+
+   while (len >= 8) {
+      memcpy(&v, src, 8);
+      if (dst) {
+         memcpy(dst, &v, 8);
+         dst += 8;
+      }
+
+      c = __builtin_ia32_crc32di(c, v);
+
+      src += 8;
+      len -= 8;
+   }
+
+   crc = c;
+#endif
+
+   while (len--) {
+      if (dst) *dst++ = *src;
+      crc = __builtin_ia32_crc32qi(crc, *src++);
+   }
+
+   return (crc);
+}
+#endif
+
+#ifdef CRC_ARMV8
+__attribute__((target("+crc")))
+static unsigned int
+crc_copy_armv8(unsigned int crc, unsigned char *dst, const unsigned char *src, unsigned int len) {
+   unsigned long long v;
+
+   while (len >= 8) {
+      memcpy(&v, src, 8);
+      if (dst) {
+         memcpy(dst, &v, 8);
+         dst += 8;
+      }
+
+      crc = __builtin_aarch64_crc32cx(crc, v);
+
+      src += 8;
+      len -= 8;
+   }
+
+   while (len--) {
+      if (dst) *dst++ = *src;
+      crc = __builtin_aarch64_crc32cb(crc, *src++);
+   }
+
+   return (crc);
+}
+#endif
+
+void
+snl_crc_init(void) {
+   unsigned int i, j, crc;
+#ifdef CRC_SSE42
+   unsigned int a, b, c, d;
+#endif
+
+   for (i=0; i<256; i++) {
+      crc = i;
+      for (j=0; j<8; j++) crc = (crc >> 1) ^ ((crc & 1) ? CRC_POLY : 0);
+      table[0][i] = crc;
+   }
+
+   for (i=0; i<256; i++) {
+      for (j=1; j<8; j++) table[j][i] = table[0][table[j - 1][i] & 0xff] ^ (table[j - 1][i] >> 8);
+   }
+
+#ifdef CRC_SSE42
+   if (__get_cpuid(1, &a, &b, &c, &d) && (c & bit_SSE4_2)) crc_copy = crc_copy_sse42;
+#endif
+
+#ifdef CRC_ARMV8
+   if (getauxval(AT_HWCAP) & HWCAP_CRC32) crc_copy = crc_copy_armv8;
+#endif
+}
+
+unsigned int
+snl_crc32c(unsigned int crc, const void *buf, unsigned int len) {
+   return (~crc_copy(~crc, NULL, buf, len));
+}
+
+static int
+crc_encode(void *state, const void *buf, unsigned int len, void *out, unsigned int *size) {
+   unsigned char *ptr = out;
+   unsigned int crc;
+
+   // copies while it checksums, if not in place
+   crc = ~crc_copy(~0U, (out != buf) ? ptr : NULL, buf, len);
+
+   ptr[len + 0] = crc;
+   ptr[len + 1] = crc >> 8;
+   ptr[len + 2] = crc >> 16;
+   ptr[len + 3] = crc >> 24;
+
+   *size = len + CRC_SIZE;
+
+   return (SNL_ERROR_OK);
+}
+
+static int
+crc_decode(void *state, void *buf, unsigned int len, void **out, unsigned int *size) {
+   unsigned char *ptr = buf;
+   unsigned int crc;
+
+   if (len < CRC_SIZE) {
+      return (SNL_ERROR_CHECKSUM);
+   }
+
+   len -= CRC_SIZE;
+
+   crc = ptr[len] | (ptr[len + 1] << 8) | (ptr[len + 2] << 16) | ((unsigned int)ptr[len + 3] << 24);
+
+   if (crc != ~crc_copy(~0U, NULL, buf, len)) {
+      return (SNL_ERROR_CHECKSUM);
+   }
+
+   *out = buf;
+   *size = len;
+
+   return (SNL_ERROR_OK);
+}
+
+void
+snl_crc_codec(snl_codec_t *codec) {
+   memset(codec, 0, sizeof (snl_codec_t));
+
+   codec->overhead = CRC_SIZE;
+   codec->inplace  = 1;
+   codec->encode   = crc_encode;
+   codec->decode   = crc_decode;
+
+   // tells the stage apart from all others
+   codec->state    = table;
+}
@@ -0,0 +1,33 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef _SNL_CRC_H_
+#define _SNL_CRC_H_
+
+#include "snl.h"
+
+#define CRC_SIZE 4 // little endian CRC32C trailer
+
+void snl_crc_init(void);
+unsigned int snl_crc32c(unsigned int crc, const void *buf, unsigned int len);
+
+// stage of the codec pipeline, filled in by snl_crc_codec()
+void snl_crc_codec(snl_codec_t *codec);
+
+#endif // _SNL_CRC_H_
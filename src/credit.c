@@ -0,0 +1,297 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <errno.h>       // ETIMEDOUT
+#include <string.h>      // memcpy()
+#include <stdlib.h>      // calloc(), malloc(), free()
+#include <pthread.h>     // pthread_mutex_*(), pthread_cond_*(), pthread_self()
+#include <time.h>        // clock_gettime()
+#include <arpa/inet.h>   // htonl(), ntohl()
+
+#include "credit.h"
+
+// must be called with the mutex held
+static int
+available(snl_credit_t *credit) {
+   // the last credit takes a message of any size
+   return ((credit->send_messages > 0) && (credit->send_bytes > 0));
+}
+
+static int
+grant(snl_socket_t *skt, unsigned int messages, unsigned int bytes, snl_credit_write_t write) {
+   unsigned char msg[CREDIT_UPDATE];
+
+   msg[0] = CREDIT_GRANT;
+   msg[1] = msg[2] = msg[3] = 0;
+
+   messages = htonl(messages);
+   bytes    = htonl(bytes);
+   memcpy(msg + 4, &messages, sizeof (messages));
+   memcpy(msg + 8, &bytes, sizeof (bytes));
+
+   return (write(skt, msg, sizeof (msg)));
+}
+
+// sends what our own callback queued, as far as the credit goes
+static void
+flush_backlog(snl_socket_t *skt, snl_credit_write_t write) {
+   snl_credit_t *credit = skt->credit;
+   snl_frame_t *frame;
+
+   for (;;) {
+      pthread_mutex_lock(&credit->mutex);
+
+      if (credit->error || !available(credit) || !(frame = snl_queue_pop(credit->backlog))) {
+         pthread_mutex_unlock(&credit->mutex);
+         break;
+      }
+
+      credit->send_messages--;
+      credit->send_bytes -= frame->length - CREDIT_HEADER;
+      credit->queued -= frame->length;
+
+      pthread_mutex_unlock(&credit->mutex);
+
+      // a broken connection also stops the worker
+      write(skt, frame->data, frame->length);
+      snl_frame_unref(frame);
+   }
+}
+
+snl_credit_t *
+snl_credit_new(unsigned int messages, unsigned int bytes) {
+   pthread_condattr_t attr;
+   snl_credit_t *credit;
+
+   if (!(credit = calloc(1, sizeof (snl_credit_t)))) {
+      return (NULL);
+   }
+
+   if (!(credit->backlog = snl_queue_new())) {
+      free(credit);
+      return (NULL);
+   }
+
+   credit->messages = messages ? messages : CREDIT_NONE;
+   credit->bytes    = bytes    ? bytes    : CREDIT_NONE;
+
+   pthread_condattr_init(&attr);
+   pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+   pthread_cond_init(&credit->cond, &attr);
+   pthread_condattr_destroy(&attr);
+
+   pthread_mutex_init(&credit->mutex, NULL);
+
+   return (credit);
+}
+
+void
+snl_credit_delete(snl_credit_t *credit) {
+   if (!credit) return;
+
+   snl_queue_delete(credit->backlog, (void (*)(void *))snl_frame_unref);
+
+   pthread_mutex_destroy(&credit->mutex);
+   pthread_cond_destroy(&credit->cond);
+
+   free(credit);
+}
+
+int
+snl_credit_open(snl_socket_t *skt, snl_credit_write_t write) {
+   snl_credit_t *credit = skt->credit;
+   snl_frame_t *frame;
+
+   pthread_mutex_lock(&credit->mutex);
+
+   // left over from an earlier connection
+   while ((frame = snl_queue_pop(credit->backlog))) {
+      snl_frame_unref(frame);
+   }
+
+   credit->queued = 0;
+   credit->send_messages = 0;
+   credit->send_bytes    = 0;
+   credit->used_messages = 0;
+   credit->used_bytes    = 0;
+   credit->error = SNL_ERROR_OK;
+
+   pthread_mutex_unlock(&credit->mutex);
+
+   // the peer may send a full window before it hears from us again
+   return (grant(skt, credit->messages, credit->bytes, write));
+}
+
+int
+snl_credit_send(snl_socket_t *skt, const void *buf, unsigned int len, int timeout, snl_credit_write_t write) {
+   unsigned char stack[CREDIT_STACK], *msg = stack;
+   snl_credit_t *credit = skt->credit;
+   int error = SNL_ERROR_OK, worker;
+   snl_frame_t *frame = NULL;
+   struct timespec ts;
+
+   // the callback must not wait, only its worker reads the next grant
+   worker = pthread_equal(pthread_self(), skt->worker_tid);
+
+   // header and payload go out as one message
+   if ((len > sizeof (stack) - CREDIT_HEADER) && !(msg = malloc(len + CREDIT_HEADER))) {
+      return (SNL_ERROR_BUFFER);
+   }
+
+   msg[0] = CREDIT_DATA;
+   msg[1] = msg[2] = msg[3] = 0;
+   memcpy(msg + CREDIT_HEADER, buf, len);
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   ts.tv_sec += timeout;
+
+   pthread_mutex_lock(&credit->mutex);
+
+   // behind the backlog, so the callback keeps its order
+   while (!credit->error && (!available(credit) || snl_queue_length(credit->backlog))) {
+      if (worker) {
+         // a peer that stopped reading must not make us buffer forever,
+         // but one message always fits
+         if (credit->queued && (credit->queued + len + CREDIT_HEADER > CREDIT_BACKLOG)) {
+            error = SNL_ERROR_BUFFER;
+            break;
+         }
+
+         if (!(frame = snl_frame_new(len + CREDIT_HEADER))) {
+            error = SNL_ERROR_BUFFER;
+            break;
+         }
+
+         memcpy(frame->data, msg, len + CREDIT_HEADER);
+
+         if (snl_queue_push(credit->backlog, frame)) {
+            snl_frame_unref(frame);
+            error = SNL_ERROR_BUFFER;
+         } else {
+            credit->queued += frame->length;
+         }
+
+         break;
+      }
+
+      if (pthread_cond_timedwait(&credit->cond, &credit->mutex, &ts) == ETIMEDOUT) {
+         error = SNL_ERROR_TIMEOUT;
+         break;
+      }
+   }
+
+   if (!error && !frame) error = credit->error;
+
+   if (!error && !frame) {
+      credit->send_messages--;
+      credit->send_bytes -= len;
+   }
+
+   pthread_mutex_unlock(&credit->mutex);
+
+   // queued for later, or sent right away
+   if (!error && !frame) error = write(skt, msg, len + CREDIT_HEADER);
+
+   if (msg != stack) free(msg);
+
+   return (error);
+}
+
+void
+snl_credit_receive(snl_socket_t *skt, snl_credit_write_t write) {
+   unsigned char *hdr = skt->data_buffer;
+   snl_credit_t *credit = skt->credit;
+   unsigned int messages, bytes;
+
+   if ((skt->data_length < CREDIT_HEADER) || (hdr[0] > CREDIT_GRANT) ||
+       ((hdr[0] == CREDIT_GRANT) && (skt->data_length < CREDIT_UPDATE))) {
+      skt->error_code = SNL_ERROR_PROTOCOL;
+      skt->event_code = SNL_EVENT_ERROR;
+      return;
+   }
+
+   if (hdr[0] == CREDIT_GRANT) {
+      memcpy(&messages, hdr + 4, sizeof (messages));
+      memcpy(&bytes, hdr + 8, sizeof (bytes));
+
+      pthread_mutex_lock(&credit->mutex);
+      credit->send_messages += ntohl(messages);
+      credit->send_bytes    += ntohl(bytes);
+      pthread_mutex_unlock(&credit->mutex);
+
+      // what our callback sent goes first
+      flush_backlog(skt, write);
+
+      pthread_mutex_lock(&credit->mutex);
+      pthread_cond_broadcast(&credit->cond);
+      pthread_mutex_unlock(&credit->mutex);
+
+      // consumed, no event for the socket callback
+      skt->event_code = SNL_EVENT_UNKNOWN;
+      return;
+   }
+
+   // lend the payload behind the header to the callback
+   credit->spare = skt->data_buffer;
+   credit->lent = 1;
+   skt->data_buffer = hdr + CREDIT_HEADER;
+   skt->data_length -= CREDIT_HEADER;
+   credit->length = skt->data_length;
+}
+
+void
+snl_credit_restore(snl_socket_t *skt, snl_credit_write_t write) {
+   snl_credit_t *credit = skt->credit;
+
+   if (!credit->lent) return;
+
+   skt->data_buffer = credit->spare;
+   credit->spare = NULL;
+   credit->lent = 0;
+
+   // the callback is done with it, room for the next one
+   credit->used_messages++;
+   credit->used_bytes += credit->length;
+
+   if ((credit->used_messages >= credit->messages / 2) || (credit->used_bytes >= credit->bytes / 2)) {
+      grant(skt, credit->used_messages, credit->used_bytes, write);
+
+      credit->used_messages = 0;
+      credit->used_bytes = 0;
+   }
+}
+
+void
+snl_credit_cancel(snl_socket_t *skt, int error) {
+   snl_credit_t *credit = skt->credit;
+   snl_frame_t *frame;
+
+   pthread_mutex_lock(&credit->mutex);
+
+   credit->error = error;
+   pthread_cond_broadcast(&credit->cond);
+
+   while ((frame = snl_queue_pop(credit->backlog))) {
+      snl_frame_unref(frame);
+   }
+
+   credit->queued = 0;
+
+   pthread_mutex_unlock(&credit->mutex);
+}
@@ -0,0 +1,65 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef _SNL_CREDIT_H_
+#define _SNL_CREDIT_H_
+
+#include <pthread.h>
+
+#include "queue.h"
+#include "snl.h"
+
+#define CREDIT_HEADER  4         // type, 3 reserved bytes
+#define CREDIT_UPDATE  12        // header, messages and bytes granted
+#define CREDIT_STACK   512       // messages copied on the stack up to this
+#define CREDIT_NONE    1<<30     // window of a dimension without limit
+#define CREDIT_BACKLOG 1<<20     // 1MB queued by the callback, then sends fail
+
+#define CREDIT_DATA    0
+#define CREDIT_GRANT   1
+
+typedef struct snl_credit_t {
+   pthread_mutex_t mutex;
+   pthread_cond_t cond;           // credit granted or connection lost
+   unsigned int messages;         // window the peer may send ahead
+   unsigned int bytes;
+   long long send_messages;       // credit left for sending to the peer
+   long long send_bytes;
+   unsigned int used_messages;    // delivered since the last grant
+   unsigned int used_bytes;
+   snl_queue_t *backlog;          // sent from our own callback without credit
+   unsigned int queued;           // bytes in the backlog
+   int error;                     // connection lost, waiting senders give up
+   unsigned int length;           // payload length of the lent message
+   int lent;                      // data buffer points behind the header
+   void *spare;                   // receive buffer while delivering
+} snl_credit_t;
+
+typedef int (*snl_credit_write_t)(snl_socket_t *skt, const void *buf, unsigned int len);
+
+snl_credit_t *snl_credit_new(unsigned int messages, unsigned int bytes);
+void snl_credit_delete(snl_credit_t *credit);
+
+int snl_credit_open(snl_socket_t *skt, snl_credit_write_t write);
+int snl_credit_send(snl_socket_t *skt, const void *buf, unsigned int len, int timeout, snl_credit_write_t write);
+void snl_credit_receive(snl_socket_t *skt, snl_credit_write_t write);
+void snl_credit_restore(snl_socket_t *skt, snl_credit_write_t write);
+void snl_credit_cancel(snl_socket_t *skt, int error);
+
+#endif // _SNL_CREDIT_H_
@@ -0,0 +1,206 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#define _GNU_SOURCE      // memmem()
+
+#include <string.h>      // memchr(), memcmp(), memcpy(), memmove(), memmem()
+#include <stdlib.h>      // calloc(), realloc(), free()
+#include <unistd.h>      // read()
+#include <errno.h>       // errno, EINTR
+
+#ifdef __SSE2__
+#include <emmintrin.h>   // _mm_cmpeq_epi8(), _mm_movemask_epi8()
+#endif
+
+#include "delimit.h"
+
+static const unsigned char *
+find_byte(const unsigned char *ptr, const unsigned char *end, unsigned char byte) {
+#ifdef __SSE2__
+   __m128i needle = _mm_set1_epi8(byte);
+   unsigned int mask;
+
+   // 16 bytes per compare, part of every x86_64
+   while (ptr + 16 <= end) {
+      mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)ptr), needle));
+      if (mask) return (ptr + __builtin_ctz(mask));
+
+      ptr += 16;
+   }
+#endif
+
+   return ((ptr < end) ? memchr(ptr, byte, end - ptr) : NULL);
+}
+
+snl_delimit_t *
+snl_delimit_new(void) {
+   return (calloc(1, sizeof (snl_delimit_t)));
+}
+
+void
+snl_delimit_delete(snl_delimit_t *dl) {
+   if (!dl) return;
+
+   free(dl->buf);
+   free(dl);
+}
+
+int
+snl_delimit_set(snl_delimit_t *dl, const void *delim, unsigned int len, unsigned int max) {
+   if (len > DELIMIT_MAX) {
+      return (SNL_ERROR_OPTION);
+   }
+
+   memcpy(dl->delim, delim, len);
+   dl->len = len;
+   dl->max = max ? max : DELIMIT_RECORD;
+
+   // the new delimiter may come earlier than the old one
+   dl->scan = dl->head;
+
+   return (SNL_ERROR_OK);
+}
+
+void
+snl_delimit_fixed(snl_delimit_t *dl, unsigned int len) {
+   // e.g. a body of known length behind a header
+   dl->fixed = len;
+}
+
+int
+snl_delimit_ready(snl_delimit_t *dl) {
+   unsigned int length = dl->tail - dl->head;
+
+   if (dl->fixed) return (length >= dl->fixed);
+
+   if (!dl->len || (length < dl->len)) return (0);
+
+   return (memmem(dl->buf + dl->head, length, dl->delim, dl->len) != NULL);
+}
+
+int
+snl_delimit_fill(snl_delimit_t *dl, int fd) {
+   unsigned int size;
+   ssize_t received;
+   void *buf;
+
+   // delivered records make room at the front
+   if (dl->head) {
+      memmove(dl->buf, dl->buf + dl->head, dl->tail - dl->head);
+      dl->tail -= dl->head;
+      dl->scan -= dl->head;
+      dl->head = 0;
+   }
+
+   // a record of max bytes plus its delimiter fits in any case
+   if (dl->size - dl->tail < DELIMIT_READ) {
+      size = dl->size ? dl->size * 2 : DELIMIT_READ;
+      if (size < dl->tail + DELIMIT_READ) size = dl->tail + DELIMIT_READ;
+
+      if (!(buf = realloc(dl->buf, size))) {
+         return (SNL_ERROR_BUFFER);
+      }
+
+      dl->buf = buf;
+      dl->size = size;
+   }
+
+   while ((received = read(fd, dl->buf + dl->tail, dl->size - dl->tail)) < 0) {
+      if (errno != EINTR) return (SNL_ERROR_RECEIVE);
+   }
+
+   if (!received) {
+      return (SNL_ERROR_CLOSED);
+   }
+
+   dl->tail += received;
+
+   return (SNL_ERROR_OK);
+}
+
+unsigned char *
+snl_delimit_next(snl_delimit_t *dl, unsigned int *len, int *error) {
+   const unsigned char *end = dl->buf + dl->tail, *pos;
+   unsigned char *record;
+
+   *error = SNL_ERROR_OK;
+
+   if (dl->fixed) {
+      if (dl->tail - dl->head < dl->fixed) return (NULL);
+
+      // not terminated, the next record may start right behind it
+      record = dl->buf + dl->head;
+      *len = dl->fixed;
+
+      dl->head += dl->fixed;
+      dl->scan = dl->head;
+      dl->fixed = 0;
+
+      return (record);
+   }
+
+   while (dl->len) {
+      pos = dl->buf + ((dl->scan > dl->head) ? dl->scan : dl->head);
+
+      // candidates start with the first byte of the delimiter
+      while ((pos = find_byte(pos, end, dl->delim[0]))) {
+         if (pos + dl->len > end) break;
+         if (!memcmp(pos, dl->delim, dl->len)) break;
+         pos++;
+      }
+
+      if (!pos || (pos + dl->len > end)) {
+         // the rest may still turn into a delimiter
+         dl->scan = pos ? pos - dl->buf : dl->tail;
+
+         if (!dl->discard && (dl->scan - dl->head > dl->max)) {
+            dl->discard = 1;
+            *error = SNL_ERROR_LENGTH;
+         }
+
+         // an overlong record is dropped up to its delimiter
+         if (dl->discard) dl->head = dl->scan;
+
+         return (NULL);
+      }
+
+      record = dl->buf + dl->head;
+      *len = pos - record;
+
+      dl->head = pos + dl->len - dl->buf;
+      dl->scan = dl->head;
+
+      if (dl->discard) {
+         dl->discard = 0;
+         continue;
+      }
+
+      if (*len > dl->max) {
+         *error = SNL_ERROR_LENGTH;
+         return (NULL);
+      }
+
+      // text protocols get a C string
+      record[*len] = '\0';
+
+      return (record);
+   }
+
+   return (NULL);
+}
@@ -0,0 +1,54 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef _SNL_DELIMIT_H_
+#define _SNL_DELIMIT_H_
+
+#include "snl.h"
+
+#define DELIMIT_MAX    16       // max length of a delimiter
+#define DELIMIT_RECORD 1<<16    // default max length of a record
+#define DELIMIT_READ   4096     // min free space for each read()
+
+// records of a byte stream, separated by a delimiter
+typedef struct snl_delimit_t {
+   unsigned char delim[DELIMIT_MAX];
+   unsigned int len;              // 0 after switching back to raw mode
+   unsigned int max;              // max record length without delimiter
+   unsigned char *buf;
+   unsigned int size;
+   unsigned int head;             // first byte of the next record
+   unsigned int tail;             // end of the received bytes
+   unsigned int scan;             // no delimiter starts before this
+   unsigned int fixed;            // length of the next record, if not 0
+   int discard;                   // dropping an overlong record
+   int lent;                      // data buffer points into buf
+   void *spare;                   // receive buffer while delivering
+} snl_delimit_t;
+
+snl_delimit_t *snl_delimit_new(void);
+void snl_delimit_delete(snl_delimit_t *dl);
+int snl_delimit_set(snl_delimit_t *dl, const void *delim, unsigned int len, unsigned int max);
+void snl_delimit_fixed(snl_delimit_t *dl, unsigned int len);
+int snl_delimit_ready(snl_delimit_t *dl);
+
+int snl_delimit_fill(snl_delimit_t *dl, int fd);
+unsigned char *snl_delimit_next(snl_delimit_t *dl, unsigned int *len, int *error);
+
+#endif // _SNL_DELIMIT_H_
@@ -0,0 +1,399 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#define _GNU_SOURCE      // sendmmsg()
+
+#include <errno.h>       // errno, EINTR, EIO
+#include <string.h>      // memset(), memcpy()
+#include <stdlib.h>      // malloc(), calloc(), free()
+#include <time.h>        // clock_gettime()
+#include <sys/socket.h>  // sendmsg(), sendmmsg(), CMSG_*
+#include <netinet/in.h>  // IPPROTO_UDP
+#include <netinet/udp.h> // UDP_SEGMENT
+#include <arpa/inet.h>   // htons(), htonl(), ntohs(), ntohl()
+
+#include "fragment.h"
+#include "sender.h"
+
+#define FRAGMENT_MAGIC  0x534E // "SN"
+#define GSO_SEGMENTS    64     // kernel limit of segments per send
+#define GSO_PAYLOAD     65507  // max udp payload of one gso send
+#define MMSG_BATCH      64     // datagrams per sendmmsg() call
+
+// every datagram starts with this header (network byte order):
+//
+//  0: magic  (16 bit)     8: message id     (32 bit)
+//  2: index  (16 bit)    12: message length (32 bit)
+//  4: count  (16 bit)
+//  6: unused (16 bit)
+//
+// all fragments but the last carry exactly ceil(length / count) bytes,
+// so the receiver can place them without an explicit offset.
+
+static long long
+now_ms(void) {
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   return ((long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+static void
+put_header(unsigned char *hdr, unsigned int id, unsigned int index, unsigned int count, unsigned int total) {
+   unsigned short s;
+   unsigned int l;
+
+   s = htons(FRAGMENT_MAGIC); memcpy(hdr +  0, &s, 2);
+   s = htons(index);          memcpy(hdr +  2, &s, 2);
+   s = htons(count);          memcpy(hdr +  4, &s, 2);
+   s = 0;                     memcpy(hdr +  6, &s, 2);
+   l = htonl(id);             memcpy(hdr +  8, &l, 4);
+   l = htonl(total);          memcpy(hdr + 12, &l, 4);
+}
+
+static void
+release_slot(snl_fragment_t *frg, snl_reassembly_t *slot, int keep_data) {
+   if (!keep_data) free(slot->data);
+   free(slot->map);
+
+   frg->memory -= slot->total;
+
+   memset(slot, 0, sizeof (snl_reassembly_t));
+}
+
+snl_fragment_t *
+snl_fragment_new(unsigned int mtu) {
+   snl_fragment_t *frg;
+
+   if (!(frg = malloc(sizeof (snl_fragment_t)))) {
+      return (NULL);
+   }
+
+   memset(frg, 0, sizeof (snl_fragment_t));
+   frg->mtu     = mtu;
+   frg->limit   = FRAGMENT_MEMORY;
+   frg->timeout = FRAGMENT_TIMEOUT;
+   frg->gso     = 1; // until the kernel tells us otherwise
+
+   return (frg);
+}
+
+void
+snl_fragment_delete(snl_fragment_t *frg) {
+   int i;
+
+   if (!frg) return;
+
+   for (i=0; i<FRAGMENT_SLOTS; i++) {
+      if (frg->slot[i].data) release_slot(frg, &frg->slot[i], 0);
+   }
+
+   free(frg->spare);
+   free(frg);
+}
+
+// let the kernel cut one contiguous buffer into equally sized datagrams,
+// returns -1 if segmentation offload is not available on this socket
+static int
+send_gso(int fd, unsigned char *data, unsigned int total, unsigned int chunk, unsigned int count, unsigned int id) {
+   char control[CMSG_SPACE(sizeof (unsigned short))];
+   unsigned int segsize = FRAGMENT_HEADER_SIZE + chunk;
+   unsigned int per_call, index, n, i, len;
+   unsigned char *scratch, *ptr;
+   struct cmsghdr *cm;
+   struct msghdr msg;
+   struct iovec iov;
+   int error = 0;
+
+   per_call = GSO_PAYLOAD / segsize;
+   if (per_call > GSO_SEGMENTS) per_call = GSO_SEGMENTS;
+   if (per_call < 2) return (-1);
+
+   if (!(scratch = malloc(per_call * segsize))) {
+      return (SNL_ERROR_BUFFER);
+   }
+
+   for (index=0; index<count; index+=n) {
+      n = ((count - index) < per_call) ? (count - index) : per_call;
+
+      // interleave headers and payload slices
+      for (ptr=scratch, i=index; i<index+n; i++) {
+         len = ((i + 1) * chunk > total) ? total - i * chunk : chunk;
+
+         put_header(ptr, id, i, count, total);
+         memcpy(ptr + FRAGMENT_HEADER_SIZE, data + i * chunk, len);
+         ptr += FRAGMENT_HEADER_SIZE + len;
+      }
+
+      iov.iov_base = scratch;
+      iov.iov_len  = ptr - scratch;
+
+      memset(&msg, 0, sizeof (msg));
+      msg.msg_iov        = &iov;
+      msg.msg_iovlen     = 1;
+      msg.msg_control    = control;
+      msg.msg_controllen = sizeof (control);
+
+      cm = CMSG_FIRSTHDR(&msg);
+      cm->cmsg_level = SOL_UDP;
+      cm->cmsg_type  = UDP_SEGMENT;
+      cm->cmsg_len   = CMSG_LEN(sizeof (unsigned short));
+      *(unsigned short *)CMSG_DATA(cm) = segsize;
+
+      while (sendmsg(fd, &msg, 0) < 0) {
+         if (errno == EINTR) continue;
+
+         // no offload on this path, only fatal before the first batch
+         if (!index && ((errno == EIO) || (errno == EINVAL) || (errno == ENOPROTOOPT))) {
+            error = -1;
+         } else {
+            error = SNL_ERROR_SEND;
+         }
+
+         goto cleanup;
+      }
+   }
+
+cleanup:
+
+   free(scratch);
+
+   return (error);
+}
+
+static int
+send_mmsg(int fd, unsigned char *data, unsigned int total, unsigned int chunk, unsigned int count, unsigned int id) {
+   unsigned char header[MMSG_BATCH][FRAGMENT_HEADER_SIZE];
+   struct mmsghdr msgs[MMSG_BATCH];
+   struct iovec iov[MMSG_BATCH][2];
+   unsigned int index, n, i, len;
+   int sent;
+
+   for (index=0; index<count; index+=sent) {
+      n = ((count - index) < MMSG_BATCH) ? (count - index) : MMSG_BATCH;
+
+      memset(msgs, 0, n * sizeof (struct mmsghdr));
+
+      for (i=0; i<n; i++) {
+         len = ((index + i + 1) * chunk > total) ? total - (index + i) * chunk : chunk;
+
+         put_header(header[i], id, index + i, count, total);
+
+         iov[i][0].iov_base = header[i];
+         iov[i][0].iov_len  = FRAGMENT_HEADER_SIZE;
+         iov[i][1].iov_base = data + (index + i) * chunk;
+         iov[i][1].iov_len  = len;
+
+         msgs[i].msg_hdr.msg_iov    = iov[i];
+         msgs[i].msg_hdr.msg_iovlen = 2;
+      }
+
+      if ((sent = sendmmsg(fd, msgs, n, 0)) < 0) {
+         if (errno == EINTR) {
+            sent = 0;
+            continue;
+         }
+
+         return (SNL_ERROR_SEND);
+      }
+   }
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_fragment_send(snl_socket_t *skt, const void *buf, unsigned int len) {
+   snl_fragment_t *frg = skt->fragment;
+   unsigned int chunk, count, total, id;
+   snl_frame_t *frame;
+   int error = -1;
+
+   // encrypt the whole message once, fragments are just slices of it
+   if (!(frame = snl_sender_frame(SNL_PROTO_UDP, skt->cipher, buf, len))) {
+      return (skt->cipher ? SNL_ERROR_CIPHER : SNL_ERROR_BUFFER);
+   }
+
+   total = frame->length;
+   chunk = frg->mtu - FRAGMENT_HEADER_SIZE;
+   count = total ? (total + chunk - 1) / chunk : 1;
+
+   if (count > 0xffff) {
+      snl_frame_unref(frame);
+      return (SNL_ERROR_SEND);
+   }
+
+   // spread the payload evenly, the receiver derives the same size
+   chunk = total ? (total + count - 1) / count : 0;
+
+   id = __sync_add_and_fetch(&frg->sequence, 1);
+
+   if (frg->gso && (count > 1)) {
+      if ((error = send_gso(skt->file_descriptor, frame->data, total, chunk, count, id)) < 0) {
+         frg->gso = 0;
+      }
+   }
+
+   if (error < 0) {
+      error = send_mmsg(skt->file_descriptor, frame->data, total, chunk, count, id);
+   }
+
+   if (!error) {
+      __sync_fetch_and_add(&skt->xfer_sent, total);
+   }
+
+   snl_frame_unref(frame);
+
+   return (error);
+}
+
+static void
+expire(snl_fragment_t *frg, long long now) {
+   int i;
+
+   for (i=0; i<FRAGMENT_SLOTS; i++) {
+      if (!frg->slot[i].data) continue;
+
+      if (now - frg->slot[i].started > frg->timeout) {
+         release_slot(frg, &frg->slot[i], 0);
+      }
+   }
+}
+
+static snl_reassembly_t *
+oldest_slot(snl_fragment_t *frg) {
+   snl_reassembly_t *oldest = NULL;
+   int i;
+
+   for (i=0; i<FRAGMENT_SLOTS; i++) {
+      if (!frg->slot[i].data) continue;
+
+      if (!oldest || (frg->slot[i].started < oldest->started)) {
+         oldest = &frg->slot[i];
+      }
+   }
+
+   return (oldest);
+}
+
+static snl_reassembly_t *
+new_slot(snl_fragment_t *frg, unsigned int total, unsigned int count, long long now) {
+   snl_reassembly_t *slot = NULL;
+   int i;
+
+   if (total > frg->limit) return (NULL);
+
+   // make room by giving up on the oldest incomplete messages
+   while (frg->memory + total > frg->limit) {
+      if (!(slot = oldest_slot(frg))) break;
+      release_slot(frg, slot, 0);
+      slot = NULL;
+   }
+
+   for (i=0; i<FRAGMENT_SLOTS; i++) {
+      if (!frg->slot[i].data) {
+         slot = &frg->slot[i];
+         break;
+      }
+   }
+
+   if (!slot) {
+      slot = oldest_slot(frg);
+      release_slot(frg, slot, 0);
+   }
+
+   if (!(slot->data = malloc(total ? total : 1))) {
+      return (NULL);
+   }
+
+   if (!(slot->map = calloc((count + 7) / 8, 1))) {
+      free(slot->data);
+      slot->data = NULL;
+      return (NULL);
+   }
+
+   slot->total   = total;
+   slot->count   = count;
+   slot->started = now;
+
+   frg->memory += total;
+
+   return (slot);
+}
+
+void *
+snl_fragment_input(snl_fragment_t *frg, const unsigned char *buf, unsigned int len, unsigned int ip, unsigned short port, unsigned int *length) {
+   unsigned int index, count, id, total, chunk, expected, i;
+   snl_reassembly_t *slot = NULL;
+   unsigned short s;
+   long long now;
+   void *data;
+
+   if (len < FRAGMENT_HEADER_SIZE) return (NULL);
+
+   memcpy(&s, buf + 0, 2);  if (ntohs(s) != FRAGMENT_MAGIC) return (NULL);
+   memcpy(&s, buf + 2, 2);  index = ntohs(s);
+   memcpy(&s, buf + 4, 2);  count = ntohs(s);
+   memcpy(&id, buf + 8, 4); id = ntohl(id);
+   memcpy(&total, buf + 12, 4); total = ntohl(total);
+
+   if (!count || (index >= count)) return (NULL);
+
+   chunk = (total + count - 1) / count;
+   expected = ((index + 1) * chunk > total) ? total - index * chunk : chunk;
+
+   // reject anything that doesn't fit the layout of the message
+   if (len - FRAGMENT_HEADER_SIZE != expected) return (NULL);
+
+   now = now_ms();
+   expire(frg, now);
+
+   for (i=0; i<FRAGMENT_SLOTS; i++) {
+      if (frg->slot[i].data && (frg->slot[i].id == id) &&
+         (frg->slot[i].ip == ip) && (frg->slot[i].port == port)) {
+         slot = &frg->slot[i];
+         break;
+      }
+   }
+
+   if (!slot) {
+      if (!(slot = new_slot(frg, total, count, now))) return (NULL);
+
+      slot->id   = id;
+      slot->ip   = ip;
+      slot->port = port;
+   }
+
+   if ((slot->total != total) || (slot->count != count)) return (NULL);
+
+   // duplicate
+   if (slot->map[index / 8] & (1 << (index % 8))) return (NULL);
+
+   slot->map[index / 8] |= 1 << (index % 8);
+   memcpy(slot->data + index * chunk, buf + FRAGMENT_HEADER_SIZE, expected);
+
+   if (++slot->done < slot->count) return (NULL);
+
+   // complete, the caller owns the message buffer from now on
+   data = slot->data;
+   *length = total;
+   release_slot(frg, slot, 1);
+
+   return (data);
+}
@@ -0,0 +1,59 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef _SNL_FRAGMENT_H_
+#define _SNL_FRAGMENT_H_
+
+#include "snl.h"
+
+#define FRAGMENT_HEADER_SIZE 16
+#define FRAGMENT_SLOTS       32         // messages reassembled at once
+#define FRAGMENT_MEMORY      1<<24      // 16MB reassembly memory
+#define FRAGMENT_TIMEOUT     1000       // ms until incomplete messages expire
+
+typedef struct snl_reassembly_t {
+   unsigned char *data;
+   unsigned char *map;            // bitmap of received fragments
+   unsigned int total;            // message length
+   unsigned int count;            // number of fragments
+   unsigned int done;             // fragments received so far
+   unsigned int id;
+   unsigned int ip;
+   unsigned short port;
+   long long started;             // ms, monotonic
+} snl_reassembly_t;
+
+typedef struct snl_fragment_t {
+   unsigned int mtu;              // max datagram size incl. header
+   unsigned int memory;           // bytes in use for reassembly
+   unsigned int limit;            // max bytes for reassembly
+   unsigned int timeout;          // ms
+   volatile unsigned int sequence;
+   int gso;                       // kernel segmentation offload usable
+   void *spare;                   // receive buffer while delivering
+   snl_reassembly_t slot[FRAGMENT_SLOTS];
+} snl_fragment_t;
+
+snl_fragment_t *snl_fragment_new(unsigned int mtu);
+void snl_fragment_delete(snl_fragment_t *frg);
+
+int snl_fragment_send(snl_socket_t *skt, const void *buf, unsigned int len);
+void *snl_fragment_input(snl_fragment_t *frg, const unsigned char *buf, unsigned int len, unsigned int ip, unsigned short port, unsigned int *length);
+
+#endif // _SNL_FRAGMENT_H_
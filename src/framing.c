@@ -0,0 +1,229 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <string.h>      // memcpy(), memset()
+#include <unistd.h>      // read()
+#include <errno.h>       // errno, EINTR
+#include <poll.h>        // poll()
+
+#include "framing.h"
+
+unsigned int
+snl_varint_put(unsigned char *buf, unsigned long long val) {
+   unsigned int len = 0;
+
+   // 7 bits per byte, least significant first, high bit means more
+   while (val >= 0x80) {
+      buf[len++] = (val & 0x7f) | 0x80;
+      val >>= 7;
+   }
+
+   buf[len++] = val;
+
+   return (len);
+}
+
+unsigned int
+snl_varint_get(const unsigned char *buf, unsigned int len, unsigned long long *val) {
+   unsigned int i;
+
+   *val = 0;
+
+   for (i=0; (i<len) && (i<10); i++) {
+      // the 10th byte holds the 64th bit, nothing more
+      if ((i == 9) && (buf[i] > 1)) break;
+
+      *val |= (unsigned long long)(buf[i] & 0x7f) << (7 * i);
+
+      if (!(buf[i] & 0x80)) return (i + 1);
+   }
+
+   // truncated or longer than 64 bit
+   return (0);
+}
+
+unsigned int
+snl_framing_header(unsigned char *buf, unsigned int flags, unsigned long long len) {
+   buf[0] = flags;
+
+   return (1 + snl_varint_put(buf + 1, len));
+}
+
+static int
+read_all(int fd, unsigned char *buf, unsigned int len) {
+   ssize_t received;
+
+   while (len) {
+      received = read(fd, buf, len);
+
+      if (received == 0) {
+         return (SNL_ERROR_CLOSED);
+      } else if (received < 0) {
+         if (errno == EINTR) continue;
+         return (SNL_ERROR_RECEIVE);
+      }
+
+      buf += received;
+      len -= received;
+   }
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_framing_read(int fd, unsigned int *flags, unsigned long long *len) {
+   unsigned char header[FRAME_HEADER_MAX];
+   unsigned int size = 2;
+   int error;
+
+   // flags and the first length byte, enough for messages below 128 bytes
+   if ((error = read_all(fd, header, size))) {
+      return (error);
+   }
+
+   while (header[size - 1] & 0x80) {
+      if (size == FRAME_HEADER_MAX) {
+         return (SNL_ERROR_RECEIVE);
+      }
+
+      if ((error = read_all(fd, header + size, 1))) {
+         return (error);
+      }
+
+      size++;
+   }
+
+   if (header[0] & ~FRAME_FLAGS) {
+      return (SNL_ERROR_PROTOCOL);
+   }
+
+   // more than 64 bit
+   if (!snl_varint_get(header + 1, size - 1, len)) {
+      return (SNL_ERROR_RECEIVE);
+   }
+
+   *flags = header[0];
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_framing_hello(snl_framing_t *frm, int fd, int timeout, int accepting) {
+   unsigned char mine[4] = { 'S', 'N', 'L', frm->wanted }, theirs[4];
+   struct pollfd pfd;
+   int error;
+
+   frm->version = 1;
+
+   // the connecting side speaks first
+   if (!accepting && snl_write(fd, mine, sizeof (mine))) {
+      return (SNL_ERROR_SEND);
+   }
+
+   pfd.fd = fd;
+   pfd.events = POLLIN;
+
+   while (poll(&pfd, 1, timeout * 1000) < 0) {
+      if (errno != EINTR) return (SNL_ERROR_RECEIVE);
+   }
+
+   if (!(pfd.revents & (POLLIN | POLLHUP))) {
+      return (SNL_ERROR_TIMEOUT);
+   }
+
+   if ((error = read_all(fd, theirs, sizeof (theirs)))) {
+      return (error);
+   }
+
+   if (memcmp(theirs, mine, 3) || !theirs[3]) {
+      return (SNL_ERROR_PROTOCOL);
+   }
+
+   // both use the highest version they have in common
+   frm->version = (theirs[3] < frm->wanted) ? theirs[3] : frm->wanted;
+
+   if (accepting) {
+      mine[3] = frm->version;
+
+      if (snl_write(fd, mine, sizeof (mine))) {
+         return (SNL_ERROR_SEND);
+      }
+   }
+
+   return (SNL_ERROR_OK);
+}
+
+snl_frame_t *
+snl_framing_pack(blowfish_t *bf, const void **bufs, const unsigned int *lens, unsigned int count) {
+   unsigned long long length = 0;
+   unsigned int i, header, pad = 0;
+   unsigned char tmp[FRAME_HEADER_MAX];
+   snl_frame_t *frame;
+   unsigned char *ptr;
+   int flags = 0;
+
+   // a single message goes without length prefix
+   if (count == 1) {
+      length = lens[0];
+   } else {
+      flags = FRAME_PACKED;
+
+      for (i=0; i<count; i++) {
+         length += snl_varint_put(tmp, lens[i]) + lens[i];
+      }
+   }
+
+   // the whole container is padded and encrypted once
+   if (bf) pad = 8 - (length % 8);
+
+   length += pad;
+
+   if (length > FRAME_LENGTH_MAX) {
+      return (NULL);
+   }
+
+   header = snl_framing_header(tmp, flags, length);
+
+   if (!(frame = snl_frame_new(header + length))) {
+      return (NULL);
+   }
+
+   frame->header = header;
+   memcpy(frame->data, tmp, header);
+
+   ptr = frame->data + header;
+
+   for (i=0; i<count; i++) {
+      if (flags & FRAME_PACKED) ptr += snl_varint_put(ptr, lens[i]);
+
+      memcpy(ptr, bufs[i], lens[i]);
+      ptr += lens[i];
+   }
+
+   if (bf) {
+      memset(ptr, pad, pad);
+
+      if (bf_encrypt(bf, frame->data + header, length)) {
+         snl_frame_unref(frame);
+         return (NULL);
+      }
+   }
+
+   return (frame);
+}
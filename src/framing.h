@@ -0,0 +1,53 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef _SNL_FRAMING_H_
+#define _SNL_FRAMING_H_
+
+#include "blowfish.h"
+#include "queue.h"
+#include "snl.h"
+
+#define FRAMING_VERSION  2     // highest version we speak
+#define FRAME_HEADER_MAX 11    // flags byte and up to 10 varint bytes
+#define FRAME_PACKED     0x01  // payload holds length prefixed messages
+#define FRAME_HEARTBEAT  0x02  // sign of life without payload
+#define FRAME_FLAGS      0x03  // all flags known to this version
+#define FRAME_LENGTH_MAX 0x7fffffff // data_length and buffer_length are 32 bit
+
+// version 2 framing is in effect on this connection
+#define SNL_FRAMING_V2(skt) ((skt)->framing && ((skt)->framing->version > 1) && !(skt)->local)
+
+typedef struct snl_framing_t {
+   unsigned int wanted;           // version asked for with snl_framing()
+   unsigned int version;          // version agreed on with the peer
+   int lent;                      // data buffer points into a container
+   void *spare;                   // receive buffer while delivering
+} snl_framing_t;
+
+unsigned int snl_varint_put(unsigned char *buf, unsigned long long val);
+unsigned int snl_varint_get(const unsigned char *buf, unsigned int len, unsigned long long *val);
+
+unsigned int snl_framing_header(unsigned char *buf, unsigned int flags, unsigned long long len);
+int snl_framing_read(int fd, unsigned int *flags, unsigned long long *len);
+int snl_framing_hello(snl_framing_t *frm, int fd, int timeout, int accepting);
+
+snl_frame_t *snl_framing_pack(blowfish_t *bf, const void **bufs, const unsigned int *lens, unsigned int count);
+
+#endif // _SNL_FRAMING_H_
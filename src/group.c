@@ -0,0 +1,261 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <string.h>      // memset(), memcmp(), strlen()
+#include <stdlib.h>      // malloc(), realloc(), free()
+#include <pthread.h>     // pthread_mutex_*()
+#include <sys/socket.h>  // shutdown()
+
+#include "sender.h"
+#include "snl.h"
+
+#define GROUP_PENDING_LIMIT 1<<20 // 1MB
+
+typedef struct snl_group_member_t {
+   snl_socket_t *socket;
+   int policy;
+} snl_group_member_t;
+
+struct snl_group_t {
+   int protocol;
+   unsigned int limit;
+   blowfish_t *cipher;
+   pthread_mutex_t mutex;
+   snl_group_member_t *member;
+   unsigned int members;
+   unsigned int size;
+};
+
+static void
+remove_member(snl_group_t *grp, unsigned int i) {
+   grp->member[i] = grp->member[--grp->members];
+}
+
+snl_group_t *
+snl_group_new(int proto) {
+   snl_group_t *grp;
+
+   if (!(grp = malloc(sizeof (snl_group_t)))) {
+      return (NULL);
+   }
+
+   memset(grp, 0, sizeof (snl_group_t));
+   grp->protocol = proto;
+   grp->limit    = GROUP_PENDING_LIMIT;
+
+   pthread_mutex_init(&grp->mutex, NULL);
+
+   return (grp);
+}
+
+int
+snl_group_delete(snl_group_t *grp) {
+   pthread_mutex_destroy(&grp->mutex);
+
+   free(grp->cipher);
+   free(grp->member);
+   free(grp);
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_group_add(snl_group_t *grp, snl_socket_t *skt, int policy) {
+   snl_group_member_t *member;
+   int error = SNL_ERROR_OK;
+   unsigned int i;
+
+   // reliable UDP, shared memory and in-process sockets have their own
+   // send paths, local message sockets do without the length header and
+   // the shared frames carry the classic one, without codec stages or
+   // correlation header, nor are they fragmented or shaped
+   if ((skt->protocol != grp->protocol) || (skt->local && (skt->protocol == SNL_PROTO_MSG)) ||
+       (skt->protocol == SNL_PROTO_RUDP) || (skt->protocol == SNL_PROTO_SHM) ||
+       (skt->protocol == SNL_PROTO_LOOP) || skt->framing || skt->codecs || skt->credit ||
+       skt->rpc || skt->mux || skt->fragment || skt->shaper) {
+      return (SNL_ERROR_PROTOCOL);
+   }
+
+   if ((policy != SNL_POLICY_DROP) && (policy != SNL_POLICY_QUEUE) && (policy != SNL_POLICY_DISCONNECT)) {
+      return (SNL_ERROR_OPTION);
+   }
+
+   pthread_mutex_lock(&grp->mutex);
+
+   // the peer decrypts with the passphrase of the member socket
+   if ((!grp->cipher != !skt->cipher) ||
+       (grp->cipher && memcmp(grp->cipher, skt->cipher, sizeof (blowfish_t)))) {
+      error = SNL_ERROR_OPTION;
+      goto cleanup;
+   }
+
+   for (i=0; i<grp->members; i++) {
+      if (grp->member[i].socket == skt) {
+         error = SNL_ERROR_OPTION;
+         goto cleanup;
+      }
+   }
+
+   // members get written to from whoever calls snl_group_send()
+   if ((error = snl_threadsafe(skt, 1))) {
+      goto cleanup;
+   }
+
+   if (grp->members == grp->size) {
+      grp->size = grp->size ? grp->size * 2 : 16;
+
+      if (!(member = realloc(grp->member, grp->size * sizeof (snl_group_member_t)))) {
+         grp->size = grp->members;
+         error = SNL_ERROR_BUFFER;
+         goto cleanup;
+      }
+
+      grp->member = member;
+   }
+
+   grp->member[grp->members].socket = skt;
+   grp->member[grp->members].policy = policy;
+   grp->members++;
+
+cleanup:
+
+   pthread_mutex_unlock(&grp->mutex);
+
+   return (error);
+}
+
+int
+snl_group_remove(snl_group_t *grp, snl_socket_t *skt) {
+   unsigned int i;
+
+   pthread_mutex_lock(&grp->mutex);
+
+   for (i=0; i<grp->members; i++) {
+      if (grp->member[i].socket == skt) {
+         remove_member(grp, i);
+         break;
+      }
+   }
+
+   pthread_mutex_unlock(&grp->mutex);
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_group_send(snl_group_t *grp, const void *buf, unsigned int len) {
+   snl_group_member_t *member;
+   snl_frame_t *frame;
+   snl_sender_t *snd;
+   unsigned int i;
+
+   if ((grp->protocol == SNL_PROTO_UDP) && (len > UDP_PAYLOAD_SIZE)) {
+      return (SNL_ERROR_SEND);
+   }
+
+   // frame and encrypt exactly once for all members
+   if (!(frame = snl_sender_frame(grp->protocol, grp->cipher, buf, len))) {
+      return (grp->cipher ? SNL_ERROR_CIPHER : SNL_ERROR_BUFFER);
+   }
+
+   pthread_mutex_lock(&grp->mutex);
+
+   for (i=0; i<grp->members; i++) {
+      member = &grp->member[i];
+      snd = member->socket->sender;
+
+      // broken connection, the owner gets an error event anyway
+      if (snd->error) continue;
+
+      if (snd->pending + frame->length > grp->limit) {
+         // give the member a chance to catch up first
+         snl_sender_drain(member->socket, 1);
+      }
+
+      if (snd->pending + frame->length > grp->limit) {
+         if (member->policy == SNL_POLICY_DROP) continue;
+
+         if (member->policy == SNL_POLICY_DISCONNECT) {
+            // the worker of that socket reports SNL_ERROR_CLOSED
+            shutdown(member->socket->file_descriptor, SHUT_RDWR);
+            remove_member(grp, i--);
+            continue;
+         }
+      }
+
+      snl_sender_send(member->socket, snl_frame_ref(frame), SNL_PRIORITY_NORMAL, 1);
+   }
+
+   pthread_mutex_unlock(&grp->mutex);
+
+   snl_frame_unref(frame);
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_group_flush(snl_group_t *grp) {
+   unsigned int i;
+
+   pthread_mutex_lock(&grp->mutex);
+
+   for (i=0; i<grp->members; i++) {
+      snl_sender_drain(grp->member[i].socket, 1);
+   }
+
+   pthread_mutex_unlock(&grp->mutex);
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_group_limit(snl_group_t *grp, unsigned int bytes) {
+   grp->limit = bytes;
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_group_passphrase(snl_group_t *grp, char *key) {
+   int error = SNL_ERROR_OK;
+
+   pthread_mutex_lock(&grp->mutex);
+
+   // the members were admitted with the old key
+   if (grp->members) {
+      error = SNL_ERROR_BUSY;
+      goto cleanup;
+   }
+
+   // destroy old blowfish context
+   free(grp->cipher);
+   grp->cipher = NULL;
+
+   if (key) {
+      // create new blowfish context
+      grp->cipher = malloc(sizeof (blowfish_t));
+      bf_init(grp->cipher, key, strlen(key));
+   }
+
+cleanup:
+
+   pthread_mutex_unlock(&grp->mutex);
+
+   return (error);
+}
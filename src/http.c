@@ -0,0 +1,584 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <string.h>      // memchr(), memcmp(), memcpy(), strlen(), strdup()
+#include <strings.h>     // strncasecmp()
+#include <stdlib.h>      // calloc(), malloc(), realloc(), free()
+#include <unistd.h>      // close()
+#include <stdio.h>       // snprintf()
+#include <pthread.h>     // pthread_mutex_*(), pthread_cond_*()
+#include <sys/socket.h>  // shutdown()
+
+#include "delimit.h"
+#include "snl.h"
+
+#define HTTP_HEADER_MAX 8192      // max size of the header block
+#define HTTP_BODY_MAX   1<<20     // max Content-Length, 1MB
+#define HTTP_FLUSH      1<<16     // write collected responses beyond this
+#define HTTP_ROUTES_MAX 64
+#define HTTP_STATUS_MAX 256       // room for status line and headers
+#define HTTP_KEEP       0         // response variants, keeping the connection
+#define HTTP_CLOSE      1         // closing it
+#define HTTP_KEEP_10    2         // keeping it for a HTTP/1.0 client that asked
+#define HTTP_VARIANTS   3
+
+// a HTTP/1.0 client closes unless told that the connection stays open
+static const char *connection[HTTP_VARIANTS] = {
+   "", "Connection: close\r\n", "Connection: keep-alive\r\n"
+};
+
+typedef struct snl_http_route_t {
+   char *path;
+   unsigned int path_length;
+   char *response[HTTP_VARIANTS]; // one per HTTP_KEEP, HTTP_CLOSE, HTTP_KEEP_10
+   unsigned int length[HTTP_VARIANTS];
+   unsigned int header[HTTP_VARIANTS]; // length without the body, for HEAD
+} snl_http_route_t;
+
+typedef struct snl_http_conn_t {
+   snl_http_t *http;
+   snl_socket_t *socket;
+   snl_http_request_t request;
+   char *head;                    // header block, kept while the body arrives
+   unsigned int body;             // Content-Length still to come
+   char *out;                     // responses not written yet
+   unsigned int out_length;
+   unsigned int out_size;
+   int responded;
+   int closing;
+   struct snl_http_conn_t *next;
+} snl_http_conn_t;
+
+struct snl_http_t {
+   snl_socket_t *listener;
+   snl_http_handler_t handler;
+   void *data;
+   snl_http_route_t route[HTTP_ROUTES_MAX];
+   unsigned int routes;
+   pthread_mutex_t mutex;
+   pthread_cond_t gone;           // the last connection freed itself
+   snl_http_conn_t *conns;
+   int connections;
+   int closing;
+};
+
+static const char *
+status_text(int status) {
+   switch (status) {
+      case 200: return ("OK");
+      case 201: return ("Created");
+      case 202: return ("Accepted");
+      case 204: return ("No Content");
+      case 301: return ("Moved Permanently");
+      case 302: return ("Found");
+      case 304: return ("Not Modified");
+      case 400: return ("Bad Request");
+      case 401: return ("Unauthorized");
+      case 403: return ("Forbidden");
+      case 404: return ("Not Found");
+      case 405: return ("Method Not Allowed");
+      case 413: return ("Payload Too Large");
+      case 431: return ("Request Header Fields Too Large");
+      case 500: return ("Internal Server Error");
+      case 501: return ("Not Implemented");
+      case 503: return ("Service Unavailable");
+   }
+
+   return ("Unknown");
+}
+
+static int
+token_is(const char *str, unsigned int len, const char *token) {
+   return ((strlen(token) == len) && !strncasecmp(str, token, len));
+}
+
+static int
+parse_request(snl_http_request_t *req, const char *buf, unsigned int len) {
+   const char *end = buf + len, *line, *eol, *colon, *ptr;
+   snl_http_header_t *hdr;
+   unsigned long size;
+
+   req->headers = 0;
+   req->body = NULL;
+   req->body_length = 0;
+
+   // empty lines before a request are to be ignored
+   while ((buf + 1 < end) && (buf[0] == '\r') && (buf[1] == '\n')) buf += 2;
+
+   if (!(eol = memchr(buf, '\r', end - buf))) eol = end;
+
+   // METHOD SP target SP HTTP/1.x
+   if (!(ptr = memchr(buf, ' ', eol - buf)) || (ptr == buf)) return (400);
+
+   req->method = buf;
+   req->method_length = ptr - buf;
+
+   req->target = ++ptr;
+   if (!(ptr = memchr(ptr, ' ', eol - ptr)) || (ptr == req->target)) return (400);
+   req->target_length = ptr - req->target;
+
+   ptr++;
+   if ((eol - ptr != 8) || memcmp(ptr, "HTTP/1.", 7)) return (400);
+   if ((ptr[7] != '0') && (ptr[7] != '1')) return (400);
+
+   req->version = (ptr[7] == '1') ? 11 : 10;
+   req->keep_alive = (req->version == 11);
+
+   for (line = eol + 2; line < end; line = eol + 2) {
+      if (!(eol = memchr(line, '\r', end - line))) eol = end;
+      if ((eol < end) && (eol[1] != '\n')) return (400);
+
+      // no obsolete line folding, no space before the colon
+      if (!(colon = memchr(line, ':', eol - line)) || (colon == line)) return (400);
+      if ((line[0] == ' ') || (line[0] == '\t') || (colon[-1] == ' ')) return (400);
+
+      if (req->headers == SNL_HTTP_HEADERS) return (431);
+
+      hdr = &req->header[req->headers++];
+      hdr->name = line;
+      hdr->name_length = colon - line;
+
+      for (ptr=colon+1; (ptr < eol) && ((*ptr == ' ') || (*ptr == '\t')); ptr++);
+      hdr->value = ptr;
+      for (ptr=eol; (ptr > hdr->value) && ((ptr[-1] == ' ') || (ptr[-1] == '\t')); ptr--);
+      hdr->value_length = ptr - hdr->value;
+
+      if (token_is(hdr->name, hdr->name_length, "connection")) {
+         if (token_is(hdr->value, hdr->value_length, "close")) req->keep_alive = 0;
+         if (token_is(hdr->value, hdr->value_length, "keep-alive")) req->keep_alive = 1;
+      } else if (token_is(hdr->name, hdr->name_length, "content-length")) {
+         if (!hdr->value_length || req->body_length) return (400);
+
+         for (size=0, ptr=hdr->value; ptr < hdr->value + hdr->value_length; ptr++) {
+            if ((*ptr < '0') || (*ptr > '9')) return (400);
+            if ((size = size * 10 + (*ptr - '0')) > HTTP_BODY_MAX) return (413);
+         }
+
+         req->body_length = size;
+      } else if (token_is(hdr->name, hdr->name_length, "transfer-encoding")) {
+         // chunked bodies are not supported
+         return (501);
+      }
+   }
+
+   return (0);
+}
+
+static int
+append(snl_http_conn_t *conn, const void *buf, unsigned int len) {
+   unsigned int size;
+   char *out;
+
+   if (conn->out_length + len > conn->out_size) {
+      size = (conn->out_length + len) * 2;
+
+      if (!(out = realloc(conn->out, size))) {
+         return (SNL_ERROR_BUFFER);
+      }
+
+      conn->out = out;
+      conn->out_size = size;
+   }
+
+   memcpy(conn->out + conn->out_length, buf, len);
+   conn->out_length += len;
+
+   return (SNL_ERROR_OK);
+}
+
+static int
+flush(snl_http_conn_t *conn) {
+   int error;
+
+   if (!conn->out_length) return (SNL_ERROR_OK);
+
+   error = snl_write(conn->socket->file_descriptor, conn->out, conn->out_length);
+   conn->out_length = 0;
+
+   return (error);
+}
+
+// the response variant the request asked for
+static int
+variant(const snl_http_request_t *req) {
+   if (!req->keep_alive) return (HTTP_CLOSE);
+
+   return ((req->version == 10) ? HTTP_KEEP_10 : HTTP_KEEP);
+}
+
+static int
+is_head(const snl_http_request_t *req) {
+   return ((req->method_length == 4) && !memcmp(req->method, "HEAD", 4));
+}
+
+static int
+respond(snl_http_conn_t *conn, int status, const char *type, const void *body, unsigned int len) {
+   char header[HTTP_STATUS_MAX];
+   int length, error;
+
+   length = snprintf(header, sizeof (header),
+      "HTTP/1.1 %i %s\r\n%s%s%sContent-Length: %u\r\n%s\r\n",
+      status, status_text(status),
+      type ? "Content-Type: " : "", type ? type : "", type ? "\r\n" : "",
+      len, connection[variant(&conn->request)]);
+
+   if ((length < 0) || (length >= sizeof (header))) {
+      return (SNL_ERROR_OPTION);
+   }
+
+   conn->responded = 1;
+
+   if ((error = append(conn, header, length))) return (error);
+   if (is_head(&conn->request)) return (SNL_ERROR_OK);
+
+   return (append(conn, body, len));
+}
+
+static snl_http_route_t *
+find_route(snl_http_t *http, const snl_http_request_t *req) {
+   const char *query;
+   unsigned int length, i;
+
+   if (!is_head(req) && ((req->method_length != 3) || memcmp(req->method, "GET", 3))) {
+      return (NULL);
+   }
+
+   length = req->target_length;
+   if ((query = memchr(req->target, '?', length))) length = query - req->target;
+
+   for (i=0; i<http->routes; i++) {
+      if ((http->route[i].path_length == length) && !memcmp(http->route[i].path, req->target, length)) {
+         return (&http->route[i]);
+      }
+   }
+
+   return (NULL);
+}
+
+static void
+finish(snl_http_conn_t *conn) {
+   snl_delimit_t *dl = conn->socket->delimit;
+
+   // the connection is done after this response
+   if (!conn->request.keep_alive) conn->closing = 1;
+
+   // answers to pipelined requests go out together
+   if (!conn->closing && (conn->out_length < HTTP_FLUSH) && dl && snl_delimit_ready(dl)) {
+      return;
+   }
+
+   if (flush(conn) || conn->closing) {
+      // the client reads the rest and closes, then we do
+      conn->closing = 1;
+      shutdown(conn->socket->file_descriptor, SHUT_WR);
+   }
+}
+
+static void
+dispatch(snl_http_conn_t *conn) {
+   snl_http_request_t *req = &conn->request;
+   snl_http_t *http = conn->http;
+   snl_http_route_t *route;
+   int v;
+
+   if ((route = find_route(http, req))) {
+      v = variant(req);
+      append(conn, route->response[v], is_head(req) ? route->header[v] : route->length[v]);
+   } else {
+      conn->responded = 0;
+      if (http->handler) http->handler(conn->socket, req, http->data);
+      if (!conn->responded) respond(conn, 404, NULL, NULL, 0);
+   }
+
+   finish(conn);
+}
+
+static void
+reject(snl_http_conn_t *conn, int status) {
+   conn->request.keep_alive = 0;
+   conn->request.method_length = 0;
+
+   respond(conn, status, NULL, NULL, 0);
+   finish(conn);
+}
+
+static void
+receive_request(snl_http_conn_t *conn, snl_socket_t *skt) {
+   snl_http_request_t *req = &conn->request;
+   int status;
+
+   if (conn->body) {
+      // the body has arrived, the header waited in the copy
+      req->body = skt->data_buffer;
+      req->body_length = skt->data_length;
+      conn->body = 0;
+
+      dispatch(conn);
+      return;
+   }
+
+   if ((status = parse_request(req, skt->data_buffer, skt->data_length))) {
+      reject(conn, status);
+      return;
+   }
+
+   if (!req->body_length) {
+      dispatch(conn);
+      return;
+   }
+
+   // the receive buffer may move while the body is read
+   if (!conn->head && !(conn->head = malloc(HTTP_HEADER_MAX))) {
+      reject(conn, 500);
+      return;
+   }
+
+   memcpy(conn->head, skt->data_buffer, skt->data_length);
+   parse_request(req, conn->head, skt->data_length);
+
+   conn->body = req->body_length;
+   snl_delimit_fixed(skt->delimit, conn->body);
+}
+
+static void
+conn_free(snl_http_conn_t *conn) {
+   snl_http_t *http = conn->http;
+   snl_http_conn_t **cp;
+
+   pthread_mutex_lock(&http->mutex);
+
+   for (cp=&http->conns; *cp; cp=&(*cp)->next) {
+      if (*cp == conn) {
+         *cp = conn->next;
+         break;
+      }
+   }
+
+   // snl_http_delete() may be waiting for the last one
+   if (!--http->connections) pthread_cond_broadcast(&http->gone);
+
+   pthread_mutex_unlock(&http->mutex);
+
+   free(conn->head);
+   free(conn->out);
+   free(conn);
+}
+
+static void
+conn_callback(snl_socket_t *skt) {
+   snl_http_conn_t *conn = skt->user_data;
+
+   switch (skt->event_code) {
+      case SNL_EVENT_RECEIVE:
+         // requests pipelined behind a closing one are dropped
+         if (!conn->closing) receive_request(conn, skt);
+      break;
+
+      case SNL_EVENT_ERROR:
+         if ((skt->error_code == SNL_ERROR_LENGTH) && !conn->closing) {
+            reject(conn, 431);
+            break;
+         }
+
+         conn_free(conn);
+         snl_socket_delete(skt); // WILL NOT RETURN
+      break;
+   }
+}
+
+static void
+listen_callback(snl_socket_t *skt) {
+   snl_http_t *http = skt->user_data;
+   snl_http_conn_t *conn;
+   snl_socket_t *peer;
+
+   if (skt->event_code != SNL_EVENT_ACCEPT) return;
+
+   if (!(conn = calloc(1, sizeof (snl_http_conn_t)))) {
+      close(skt->client_fd);
+      return;
+   }
+
+   if (!(peer = snl_socket_new(SNL_PROTO_TCP, conn_callback, conn))) {
+      close(skt->client_fd);
+      free(conn);
+      return;
+   }
+
+   conn->http = http;
+   conn->socket = peer;
+   peer->file_descriptor = skt->client_fd;
+
+   pthread_mutex_lock(&http->mutex);
+   conn->next = http->conns;
+   http->conns = conn;
+   http->connections++;
+   pthread_mutex_unlock(&http->mutex);
+
+   // the worker raises one event per complete header block
+   if (snl_delimiter(peer, "\r\n\r\n", 4, HTTP_HEADER_MAX) || snl_accept(peer)) {
+      conn_free(conn);
+      snl_socket_delete(peer);
+   }
+}
+
+snl_http_t *
+snl_http_new(snl_http_handler_t handler, void *data) {
+   snl_http_t *http;
+
+   if (!(http = calloc(1, sizeof (snl_http_t)))) {
+      return (NULL);
+   }
+
+   http->handler = handler;
+   http->data    = data;
+
+   pthread_mutex_init(&http->mutex, NULL);
+   pthread_cond_init(&http->gone, NULL);
+
+   return (http);
+}
+
+int
+snl_http_delete(snl_http_t *http) {
+   snl_http_conn_t *conn;
+   unsigned int i, j;
+
+   if (!http) return (SNL_ERROR_OK);
+
+   // no more connections from here on
+   if (http->listener) snl_socket_delete(http->listener);
+
+   pthread_mutex_lock(&http->mutex);
+
+   for (conn=http->conns; conn; conn=conn->next) {
+      shutdown(conn->socket->file_descriptor, SHUT_RDWR);
+   }
+
+   // every connection frees itself as it sees the shutdown
+   while (http->connections) {
+      pthread_cond_wait(&http->gone, &http->mutex);
+   }
+
+   pthread_mutex_unlock(&http->mutex);
+
+   for (i=0; i<http->routes; i++) {
+      free(http->route[i].path);
+      for (j=0; j<HTTP_VARIANTS; j++) free(http->route[i].response[j]);
+   }
+
+   pthread_cond_destroy(&http->gone);
+   pthread_mutex_destroy(&http->mutex);
+   free(http);
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_http_listen(snl_http_t *http, unsigned short port) {
+   int error;
+
+   if (http->listener) {
+      return (SNL_ERROR_BUSY);
+   }
+
+   if (!(http->listener = snl_socket_new(SNL_PROTO_TCP, listen_callback, http))) {
+      return (SNL_ERROR_BUFFER);
+   }
+
+   if ((error = snl_listen(http->listener, port))) {
+      snl_socket_delete(http->listener);
+      http->listener = NULL;
+   }
+
+   return (error);
+}
+
+int
+snl_http_static(snl_http_t *http, const char *path, const char *type, const void *body, unsigned int len) {
+   snl_http_route_t *route;
+   char header[HTTP_STATUS_MAX];
+   int length, i, j;
+
+   // the workers look routes up without locking
+   if (http->listener) {
+      return (SNL_ERROR_BUSY);
+   }
+
+   if (http->routes == HTTP_ROUTES_MAX) {
+      return (SNL_ERROR_BUFFER);
+   }
+
+   route = &http->route[http->routes];
+
+   if (!(route->path = strdup(path))) {
+      return (SNL_ERROR_BUFFER);
+   }
+
+   route->path_length = strlen(path);
+
+   for (i=0; i<HTTP_VARIANTS; i++) {
+      length = snprintf(header, sizeof (header),
+         "HTTP/1.1 200 OK\r\nContent-Type: %s\r\nContent-Length: %u\r\n%s\r\n",
+         type, len, connection[i]);
+
+      if ((length < 0) || (length >= sizeof (header)) || !(route->response[i] = malloc(length + len))) {
+         for (j=0; j<i; j++) free(route->response[j]);
+         free(route->path);
+         memset(route, 0, sizeof (snl_http_route_t));
+         return (SNL_ERROR_BUFFER);
+      }
+
+      memcpy(route->response[i], header, length);
+      memcpy(route->response[i] + length, body, len);
+
+      route->header[i] = length;
+      route->length[i] = length + len;
+   }
+
+   http->routes++;
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_http_respond(snl_socket_t *skt, int status, const char *type, const void *body, unsigned int len) {
+   snl_http_conn_t *conn = skt->user_data;
+
+   // only valid for the request in hand
+   if (!conn || (conn->socket != skt) || conn->responded) {
+      return (SNL_ERROR_OPTION);
+   }
+
+   return (respond(conn, status, type, body, len));
+}
+
+const char *
+snl_http_header(const snl_http_request_t *req, const char *name, unsigned int *len) {
+   unsigned int i;
+
+   for (i=0; i<req->headers; i++) {
+      if (token_is(req->header[i].name, req->header[i].name_length, name)) {
+         *len = req->header[i].value_length;
+         return (req->header[i].value);
+      }
+   }
+
+   return (NULL);
+}
@@ -0,0 +1,502 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <string.h>      // memcpy(), strcmp(), strlen()
+#include <stdlib.h>      // calloc(), free()
+#include <unistd.h>      // close(), dup(), read(), write()
+#include <pthread.h>     // pthread_mutex_*(), pthread_cond_*()
+#include <time.h>        // clock_gettime()
+#include <poll.h>        // poll()
+#include <sys/eventfd.h> // eventfd()
+
+#include "loop.h"
+
+static pthread_mutex_t registry = PTHREAD_MUTEX_INITIALIZER;
+
+static snl_loop_t *listeners = NULL;  // by port
+static snl_link_t *unclaimed = NULL;  // accept event raised, snl_accept() pending
+
+static void
+wake(int event) {
+   unsigned long long one = 1;
+
+   if (write(event, &one, sizeof (one))) {}
+}
+
+static void
+wake_sleeper(snl_link_t *link, int side) {
+   __sync_synchronize();
+
+   if (link->sleeping[side]) {
+      link->sleeping[side] = 0;
+      wake(link->event[side]);
+   }
+}
+
+static void
+link_unref(snl_link_t *link) {
+   int i;
+
+   if (!link || __sync_sub_and_fetch(&link->refcount, 1)) return;
+
+   for (i=0; i<2; i++) {
+      snl_queue_delete(link->queue[i], (void (*)(void *))snl_frame_unref);
+      if (link->event[i] >= 0) close(link->event[i]);
+      pthread_cond_destroy(&link->room[i]);
+   }
+
+   pthread_mutex_destroy(&link->mutex);
+   free(link);
+}
+
+static snl_link_t *
+link_new(void) {
+   pthread_condattr_t attr;
+   snl_link_t *link;
+   int i;
+
+   if (!(link = calloc(1, sizeof (snl_link_t)))) {
+      return (NULL);
+   }
+
+   // one reference for each side
+   link->refcount = 2;
+   link->handle = -1;
+
+   // send timeouts must not jump with the wall clock
+   pthread_condattr_init(&attr);
+   pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+   pthread_mutex_init(&link->mutex, NULL);
+
+   for (i=0; i<2; i++) {
+      link->event[i] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+      link->queue[i] = snl_queue_new();
+      pthread_cond_init(&link->room[i], &attr);
+   }
+
+   pthread_condattr_destroy(&attr);
+
+   for (i=0; i<2; i++) {
+      if ((link->event[i] < 0) || !link->queue[i]) {
+         link->refcount = 1;
+         link_unref(link);
+         return (NULL);
+      }
+   }
+
+   return (link);
+}
+
+// a listener serves either a name or, without one, a port
+static int
+address_of(const snl_loop_t *listener, unsigned short port, const char *name) {
+   if (name[0]) return (!strcmp(listener->name, name));
+
+   return (!listener->name[0] && (listener->port == port));
+}
+
+// the name given to snl_name() before listen or connect
+static const char *
+name_of(const snl_socket_t *skt) {
+   return (skt->loop ? skt->loop->name : "");
+}
+
+static snl_loop_t *
+endpoint_new(snl_link_t *link, int side) {
+   snl_loop_t *loop;
+
+   if (!(loop = calloc(1, sizeof (snl_loop_t)))) {
+      return (NULL);
+   }
+
+   loop->link  = link;
+   loop->side  = side;
+   loop->event = -1;
+
+   return (loop);
+}
+
+int
+snl_loop_name(snl_socket_t *skt, const char *name) {
+   if (!name || (strlen(name) >= LOOP_NAME_MAX)) {
+      return (SNL_ERROR_OPTION);
+   }
+
+   // holds the name until snl_listen() or snl_connect()
+   if (!skt->loop && !(skt->loop = endpoint_new(NULL, 0))) {
+      return (SNL_ERROR_BUFFER);
+   }
+
+   strcpy(skt->loop->name, name);
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_loop_listen(snl_socket_t *skt, unsigned short port) {
+   snl_loop_t *loop;
+   int fd;
+
+   if (!(loop = endpoint_new(NULL, 0))) {
+      return (SNL_ERROR_BUFFER);
+   }
+
+   loop->port = port;
+   strcpy(loop->name, name_of(skt));
+
+   if (!(loop->pending = snl_queue_new()) ||
+       ((loop->event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) ||
+       ((fd = dup(loop->event)) < 0)) {
+      snl_loop_delete(loop);
+      return (SNL_ERROR_OPEN);
+   }
+
+   pthread_mutex_lock(&registry);
+
+   for (snl_loop_t *l=listeners; l; l=l->next) {
+      if (address_of(l, port, loop->name)) {
+         pthread_mutex_unlock(&registry);
+         snl_loop_delete(loop);
+         close(fd);
+         return (SNL_ERROR_BIND);
+      }
+   }
+
+   loop->next = listeners;
+   listeners = loop;
+
+   pthread_mutex_unlock(&registry);
+
+   snl_loop_delete(skt->loop);
+   skt->loop = loop;
+
+   // the listening worker waits for this to get readable
+   skt->file_descriptor = fd;
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_loop_connect(snl_socket_t *skt, unsigned short port) {
+   snl_loop_t *listener, *loop;
+   snl_link_t *link;
+   int fd;
+
+   if (!(link = link_new())) {
+      return (SNL_ERROR_BUFFER);
+   }
+
+   if (!(loop = endpoint_new(link, 0)) || ((fd = dup(link->event[0])) < 0)) {
+      free(loop);
+      link->refcount = 1;
+      link_unref(link);
+      return (SNL_ERROR_OPEN);
+   }
+
+   pthread_mutex_lock(&registry);
+
+   for (listener=listeners; listener; listener=listener->next) {
+      if (address_of(listener, port, name_of(skt))) break;
+   }
+
+   // handed out as client_fd, owned by the accepting socket later
+   if (listener) link->handle = dup(link->event[1]);
+
+   if (!listener || (link->handle < 0) || snl_queue_push(listener->pending, link)) {
+      pthread_mutex_unlock(&registry);
+
+      if (link->handle >= 0) close(link->handle);
+      close(fd);
+      free(loop);
+      link->refcount = 1;
+      link_unref(link);
+
+      return (SNL_ERROR_CONNECT);
+   }
+
+   wake(listener->event);
+
+   pthread_mutex_unlock(&registry);
+
+   snl_loop_delete(skt->loop);
+   skt->loop = loop;
+
+   skt->file_descriptor = fd;
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_loop_accept(snl_socket_t *skt) {
+   snl_loop_t *loop = skt->loop;
+   unsigned long long count;
+   snl_link_t *link;
+
+   if (!(link = snl_queue_pop(loop->pending))) {
+      // nothing left, the next connect makes the event readable again
+      if (read(loop->event, &count, sizeof (count))) {}
+
+      if (!(link = snl_queue_pop(loop->pending))) return (-1);
+   }
+
+   pthread_mutex_lock(&registry);
+   link->next = unclaimed;
+   unclaimed = link;
+   pthread_mutex_unlock(&registry);
+
+   return (link->handle);
+}
+
+int
+snl_loop_attach(snl_socket_t *skt) {
+   snl_link_t *link, **lp;
+   snl_loop_t *loop;
+
+   pthread_mutex_lock(&registry);
+
+   for (lp=&unclaimed; (link = *lp); lp=&link->next) {
+      if (link->handle == skt->file_descriptor) {
+         *lp = link->next;
+         break;
+      }
+   }
+
+   pthread_mutex_unlock(&registry);
+
+   if (!link) {
+      return (SNL_ERROR_ACCEPT);
+   }
+
+   if (!(loop = endpoint_new(link, 1))) {
+      link->closed[1] = 1;
+      wake(link->event[0]);
+      link_unref(link);
+      return (SNL_ERROR_BUFFER);
+   }
+
+   // the socket owns the handle from now on
+   link->handle = -1;
+
+   snl_loop_delete(skt->loop);
+   skt->loop = loop;
+
+   return (SNL_ERROR_OK);
+}
+
+void
+snl_loop_close(snl_loop_t *loop) {
+   snl_loop_t **lp;
+   snl_link_t *link;
+
+   // not connected nor listening, maybe just named
+   if (!loop || (!loop->link && !loop->pending)) return;
+
+   if ((link = loop->link)) {
+      link->closed[loop->side] = 1;
+      wake(link->event[!loop->side]);
+
+      // senders waiting for room on either side give up
+      pthread_mutex_lock(&link->mutex);
+      pthread_cond_broadcast(&link->room[0]);
+      pthread_cond_broadcast(&link->room[1]);
+      pthread_mutex_unlock(&link->mutex);
+
+      return;
+   }
+
+   pthread_mutex_lock(&registry);
+
+   for (lp=&listeners; *lp; lp=&(*lp)->next) {
+      if (*lp == loop) {
+         *lp = loop->next;
+         break;
+      }
+   }
+
+   pthread_mutex_unlock(&registry);
+
+   // refuse everybody still waiting
+   while ((link = snl_queue_pop(loop->pending))) {
+      link->closed[1] = 1;
+      wake(link->event[0]);
+      close(link->handle);
+      link_unref(link);
+   }
+}
+
+void
+snl_loop_delete(snl_loop_t *loop) {
+   if (!loop) return;
+
+   if (loop->link || loop->pending) snl_loop_close(loop);
+
+   snl_frame_unref(loop->lent);
+   link_unref(loop->link);
+
+   snl_queue_delete(loop->pending, NULL);
+   if (loop->event >= 0) close(loop->event);
+
+   free(loop);
+}
+
+// waits until the receiver took some, like a full socket buffer
+static int
+wait_for_room(snl_link_t *link, int peer, int timeout) {
+   int error = SNL_ERROR_OK;
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   ts.tv_sec += timeout;
+
+   pthread_mutex_lock(&link->mutex);
+   link->blocked[peer]++;
+   __sync_synchronize();
+
+   while (snl_queue_length(link->queue[peer]) >= LOOP_QUEUE_LIMIT) {
+      if (link->closed[0] || link->closed[1]) break;
+
+      if (pthread_cond_timedwait(&link->room[peer], &link->mutex, &ts)) {
+         if (snl_queue_length(link->queue[peer]) >= LOOP_QUEUE_LIMIT) error = SNL_ERROR_TIMEOUT;
+         break;
+      }
+   }
+
+   link->blocked[peer]--;
+   pthread_mutex_unlock(&link->mutex);
+
+   return (error);
+}
+
+int
+snl_loop_hand_over(snl_socket_t *skt, snl_frame_t *frame, int timeout) {
+   snl_link_t *link = skt->loop ? skt->loop->link : NULL;
+   unsigned int len = frame->length;
+   int peer, error;
+
+   if (!link) {
+      snl_frame_unref(frame);
+      return (SNL_ERROR_SEND);
+   }
+
+   peer = !skt->loop->side;
+
+   if (snl_queue_length(link->queue[peer]) >= LOOP_QUEUE_LIMIT) {
+      if ((error = wait_for_room(link, peer, timeout))) {
+         snl_frame_unref(frame);
+         return (error);
+      }
+   }
+
+   if (link->closed[0] || link->closed[1]) {
+      snl_frame_unref(frame);
+      return (SNL_ERROR_CLOSED);
+   }
+
+   // the receiver gets the pointer
+   if (snl_queue_push(link->queue[peer], frame)) {
+      snl_frame_unref(frame);
+      return (SNL_ERROR_BUFFER);
+   }
+
+   wake_sleeper(link, peer);
+
+   __sync_fetch_and_add(&skt->xfer_sent, len);
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_loop_send(snl_socket_t *skt, const void *buf, unsigned int len, int timeout) {
+   snl_frame_t *frame;
+
+   // the only copy
+   if (!(frame = snl_frame_new(len))) {
+      return (SNL_ERROR_BUFFER);
+   }
+
+   memcpy(frame->data, buf, len);
+
+   return (snl_loop_hand_over(skt, frame, timeout));
+}
+
+int
+snl_loop_receive(snl_socket_t *skt, snl_loop_deliver_t deliver) {
+   snl_link_t *link = skt->loop->link;
+   int side = skt->loop->side;
+   snl_frame_t *frame;
+
+   while (!skt->worker_stop && (frame = snl_queue_pop(link->queue[side]))) {
+      __sync_synchronize();
+
+      // there is room again for a sender waiting for it
+      if (link->blocked[side]) {
+         pthread_mutex_lock(&link->mutex);
+         pthread_cond_broadcast(&link->room[side]);
+         pthread_mutex_unlock(&link->mutex);
+      }
+
+      deliver(skt, frame);
+   }
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_loop_wait(snl_socket_t *skt, int timeout) {
+   snl_link_t *link = skt->loop->link;
+   int side = skt->loop->side;
+   unsigned long long count;
+   struct pollfd pfd;
+
+   link->sleeping[side] = 1;
+   __sync_synchronize();
+
+   // a message arrived while we were about to sleep
+   if (snl_queue_length(link->queue[side]) > 0) {
+      link->sleeping[side] = 0;
+      return (SNL_ERROR_OK);
+   }
+
+   if (link->closed[!side]) {
+      link->sleeping[side] = 0;
+      return (SNL_ERROR_CLOSED);
+   }
+
+   pfd.fd = skt->file_descriptor;
+   pfd.events = POLLIN;
+
+   poll(&pfd, 1, timeout);
+
+   link->sleeping[side] = 0;
+
+   // disconnected locally
+   if (pfd.revents & POLLNVAL) {
+      return (SNL_ERROR_RECEIVE);
+   }
+
+   if (pfd.revents & POLLIN) {
+      if (read(pfd.fd, &count, sizeof (count))) {}
+   }
+
+   if (link->closed[!side] && !snl_queue_length(link->queue[side])) {
+      return (SNL_ERROR_CLOSED);
+   }
+
+   return (SNL_ERROR_OK);
+}
@@ -0,0 +1,72 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef _SNL_LOOP_H_
+#define _SNL_LOOP_H_
+
+#include <pthread.h>
+
+#include "queue.h"
+#include "snl.h"
+
+#define LOOP_QUEUE_LIMIT 1<<16 // max messages waiting for one receiver
+#define LOOP_NAME_MAX    64    // including the terminating \0
+
+// connection between two sockets of the same process
+typedef struct snl_link_t {
+   int refcount;
+   snl_queue_t *queue[2];         // queue[i] is read by side i
+   int event[2];                  // eventfd waking side i
+   volatile int sleeping[2];
+   volatile int closed[2];
+   volatile int blocked[2];       // senders waiting for room in queue[i]
+   pthread_mutex_t mutex;         // guards the waits for room
+   pthread_cond_t room[2];
+   int handle;                    // client_fd until snl_accept()
+   struct snl_link_t *next;       // not yet accepted
+} snl_link_t;
+
+typedef struct snl_loop_t {
+   snl_link_t *link;              // NULL for listeners
+   int side;                      // 0 connecting, 1 accepting side
+   unsigned short port;           // listeners only
+   char name[LOOP_NAME_MAX];      // addressed by name instead of port
+   snl_queue_t *pending;          // listeners only, connecting links
+   int event;                     // listeners only
+   snl_frame_t *lent;             // message lent to the callback
+   void *spare;                   // receive buffer while delivering
+   struct snl_loop_t *next;       // listener registry
+} snl_loop_t;
+
+typedef void (*snl_loop_deliver_t)(snl_socket_t *skt, snl_frame_t *frame);
+
+int snl_loop_name(snl_socket_t *skt, const char *name);
+int snl_loop_listen(snl_socket_t *skt, unsigned short port);
+int snl_loop_connect(snl_socket_t *skt, unsigned short port);
+int snl_loop_accept(snl_socket_t *skt);
+int snl_loop_attach(snl_socket_t *skt);
+void snl_loop_close(snl_loop_t *loop);
+void snl_loop_delete(snl_loop_t *loop);
+
+int snl_loop_send(snl_socket_t *skt, const void *buf, unsigned int len, int timeout);
+int snl_loop_hand_over(snl_socket_t *skt, snl_frame_t *frame, int timeout);
+int snl_loop_receive(snl_socket_t *skt, snl_loop_deliver_t deliver);
+int snl_loop_wait(snl_socket_t *skt, int timeout);
+
+#endif // _SNL_LOOP_H_
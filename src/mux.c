@@ -0,0 +1,314 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <string.h>      // memcpy()
+#include <stdlib.h>      // calloc(), realloc(), free()
+#include <pthread.h>     // pthread_mutex_*(), pthread_cond_*()
+
+#include "mux.h"
+
+// channel with the earliest virtual start time, weighted fair queueing
+static snl_mux_channel_t *
+pick_channel(snl_mux_t *mux) {
+   snl_mux_channel_t *ch, *best = NULL;
+   unsigned int i;
+
+   for (i=0; i<MUX_CHANNELS; i++) {
+      ch = &mux->channel[i];
+
+      if (ch->head && (!best || (ch->vtime < best->vtime))) best = ch;
+   }
+
+   return (best);
+}
+
+// fails everything still queued, must be called with the mutex held
+static void
+fail_all(snl_mux_t *mux, int error) {
+   snl_mux_entry_t *entry;
+   unsigned int i;
+
+   for (i=0; i<MUX_CHANNELS; i++) {
+      while ((entry = mux->channel[i].head)) {
+         mux->channel[i].head = entry->next;
+         entry->error = error;
+         entry->done = 1;
+      }
+
+      mux->channel[i].tail = NULL;
+   }
+}
+
+// writes chunks until our own message is out, with the mutex held
+static void
+drain(snl_socket_t *skt, snl_mux_entry_t *own, snl_mux_write_t write) {
+   snl_mux_t *mux = skt->mux;
+   snl_mux_channel_t *ch;
+   snl_mux_entry_t *entry;
+   unsigned int size;
+   int error;
+
+   mux->draining = 1;
+
+   while (!own->done && (ch = pick_channel(mux))) {
+      entry = ch->head;
+
+      size = entry->len - entry->offset;
+      if (size > MUX_CHUNK) size = MUX_CHUNK;
+
+      mux->chunk[0] = ch - mux->channel;
+      mux->chunk[1] = (entry->offset + size < entry->len) ? MUX_MORE : 0;
+      mux->chunk[2] = mux->chunk[3] = 0;
+
+      memcpy(mux->chunk + MUX_HEADER, entry->buf + entry->offset, size);
+
+      // the next chunk of a heavier channel comes sooner
+      mux->vtime = ch->vtime;
+      ch->vtime += ((unsigned long long)(size + MUX_HEADER) << 16) / ch->weight;
+
+      // other senders queue up meanwhile
+      pthread_mutex_unlock(&mux->mutex);
+      error = write(skt, mux->chunk, size + MUX_HEADER);
+      pthread_mutex_lock(&mux->mutex);
+
+      if (error) {
+         fail_all(mux, error);
+         break;
+      }
+
+      entry->offset += size;
+
+      // its sender returns as soon as it gets the mutex
+      if (entry->offset == entry->len) {
+         if (!(ch->head = entry->next)) ch->tail = NULL;
+         entry->done = 1;
+         pthread_cond_broadcast(&mux->cond);
+      }
+   }
+
+   // whoever still waits takes over
+   mux->draining = 0;
+   pthread_cond_broadcast(&mux->cond);
+}
+
+snl_mux_t *
+snl_mux_new(void) {
+   snl_mux_t *mux;
+   unsigned int i;
+
+   if (!(mux = calloc(1, sizeof (snl_mux_t)))) {
+      return (NULL);
+   }
+
+   for (i=0; i<MUX_CHANNELS; i++) {
+      mux->channel[i].weight = 1;
+   }
+
+   mux->limit = MUX_LIMIT;
+
+   pthread_mutex_init(&mux->mutex, NULL);
+   pthread_cond_init(&mux->cond, NULL);
+
+   return (mux);
+}
+
+void
+snl_mux_delete(snl_mux_t *mux) {
+   unsigned int i;
+
+   if (!mux) return;
+
+   for (i=0; i<MUX_CHANNELS; i++) {
+      free(mux->channel[i].buf);
+   }
+
+   pthread_cond_destroy(&mux->cond);
+   pthread_mutex_destroy(&mux->mutex);
+   free(mux);
+}
+
+int
+snl_mux_weight(snl_mux_t *mux, unsigned int channel, unsigned int weight) {
+   if ((channel >= MUX_CHANNELS) || !weight) {
+      return (SNL_ERROR_OPTION);
+   }
+
+   pthread_mutex_lock(&mux->mutex);
+   mux->channel[channel].weight = weight;
+   pthread_mutex_unlock(&mux->mutex);
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_mux_limit(snl_mux_t *mux, unsigned int max) {
+   // no message of several chunks would fit
+   if (max && (max < MUX_CHUNK)) {
+      return (SNL_ERROR_OPTION);
+   }
+
+   mux->limit = max ? max : MUX_LIMIT;
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_mux_send(snl_socket_t *skt, unsigned int channel, const void *buf, unsigned int len, snl_mux_write_t write) {
+   snl_mux_t *mux = skt->mux;
+   snl_mux_entry_t entry;
+   snl_mux_channel_t *ch;
+
+   if (channel >= MUX_CHANNELS) {
+      return (SNL_ERROR_OPTION);
+   }
+
+   memset(&entry, 0, sizeof (entry));
+   entry.buf = buf;
+   entry.len = len;
+
+   ch = &mux->channel[channel];
+
+   pthread_mutex_lock(&mux->mutex);
+
+   // an idle channel starts at the current virtual time, no credit
+   if (!ch->head && (ch->vtime < mux->vtime)) ch->vtime = mux->vtime;
+
+   if (ch->tail) {
+      ch->tail->next = &entry;
+   } else {
+      ch->head = &entry;
+   }
+
+   ch->tail = &entry;
+
+   // an empty message still takes one chunk
+   while (!entry.done) {
+      if (!mux->draining) {
+         drain(skt, &entry, write);
+      } else {
+         pthread_cond_wait(&mux->cond, &mux->mutex);
+      }
+   }
+
+   pthread_mutex_unlock(&mux->mutex);
+
+   return (entry.error);
+}
+
+void
+snl_mux_receive(snl_socket_t *skt) {
+   unsigned char *hdr = skt->data_buffer;
+   unsigned int length = skt->data_length - MUX_HEADER;
+   snl_mux_t *mux = skt->mux;
+   snl_mux_channel_t *ch;
+   unsigned int size;
+   void *buf;
+
+   if ((skt->data_length < MUX_HEADER) || (hdr[0] >= MUX_CHANNELS)) {
+      skt->error_code = SNL_ERROR_PROTOCOL;
+      skt->event_code = SNL_EVENT_ERROR;
+      return;
+   }
+
+   ch = &mux->channel[hdr[0]];
+   mux->current = hdr[0];
+
+   // the rest of an oversized message goes where its start went
+   if (ch->discard) {
+      if (!(hdr[1] & MUX_MORE)) ch->discard = 0;
+      skt->event_code = SNL_EVENT_UNKNOWN;
+      return;
+   }
+
+   if (length > mux->limit - ch->length) {
+      if (ch->size > MUX_KEEP) {
+         free(ch->buf);
+         ch->buf = NULL;
+         ch->size = 0;
+      }
+
+      ch->length = 0;
+      ch->discard = (hdr[1] & MUX_MORE);
+      skt->error_code = SNL_ERROR_LENGTH;
+      skt->event_code = SNL_EVENT_ERROR;
+      return;
+   }
+
+   // a message of one chunk is lent in place
+   if (!(hdr[1] & MUX_MORE) && !ch->length) {
+      mux->spare = skt->data_buffer;
+      mux->lent = 1;
+      skt->data_buffer = hdr + MUX_HEADER;
+      skt->data_length = length;
+      return;
+   }
+
+   if (ch->length + length > ch->size) {
+      size = (ch->length + length) * 2;
+
+      // wrapped around or beyond what we take anyway
+      if ((size < ch->length + length) || (size > mux->limit)) size = mux->limit;
+
+      if (!(buf = realloc(ch->buf, size))) {
+         ch->length = 0;
+         ch->discard = (hdr[1] & MUX_MORE);
+         skt->error_code = SNL_ERROR_BUFFER;
+         skt->event_code = SNL_EVENT_ERROR;
+         return;
+      }
+
+      ch->buf = buf;
+      ch->size = size;
+   }
+
+   memcpy(ch->buf + ch->length, hdr + MUX_HEADER, length);
+   ch->length += length;
+
+   // chunks of other channels may come in between
+   if (hdr[1] & MUX_MORE) {
+      skt->event_code = SNL_EVENT_UNKNOWN;
+      return;
+   }
+
+   mux->spare = skt->data_buffer;
+   mux->lent = 1;
+   skt->data_buffer = ch->buf;
+   skt->data_length = ch->length;
+
+   ch->length = 0;
+}
+
+void
+snl_mux_restore(snl_socket_t *skt) {
+   snl_mux_t *mux = skt->mux;
+   snl_mux_channel_t *ch = &mux->channel[mux->current];
+
+   if (!mux->lent) return;
+
+   skt->data_buffer = mux->spare;
+   mux->spare = NULL;
+   mux->lent = 0;
+
+   // one bulk message should not pin its buffer forever
+   if (ch->size > MUX_KEEP) {
+      free(ch->buf);
+      ch->buf = NULL;
+      ch->size = 0;
+   }
+}
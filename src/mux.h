@@ -0,0 +1,79 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef _SNL_MUX_H_
+#define _SNL_MUX_H_
+
+#include <pthread.h>
+
+#include "snl.h"
+
+#define MUX_CHANNELS 16          // logical channels per connection
+#define MUX_HEADER   4           // channel, flags, 2 reserved bytes
+#define MUX_CHUNK    1<<14       // 16KB, max payload of one chunk
+#define MUX_KEEP     1<<20       // reassembly buffers kept up to 1MB
+#define MUX_LIMIT    1<<26       // 64MB, default max reassembled message
+#define MUX_LOWAT    1<<16       // max unsent bytes in the kernel, 64KB
+#define MUX_MORE     0x01        // further chunks of the message follow
+
+// message of a sender blocked in snl_channel_send(), lives on its stack
+typedef struct snl_mux_entry_t {
+   const unsigned char *buf;
+   unsigned int len;
+   unsigned int offset;           // bytes already sent
+   int done;
+   int error;
+   struct snl_mux_entry_t *next;
+} snl_mux_entry_t;
+
+typedef struct snl_mux_channel_t {
+   snl_mux_entry_t *head, *tail;  // messages waiting to be sent
+   unsigned int weight;
+   unsigned long long vtime;      // virtual start time of the next chunk
+   unsigned char *buf;            // chunks received so far
+   unsigned int length;
+   unsigned int size;
+   int discard;                   // chunks of an oversized message follow
+} snl_mux_channel_t;
+
+typedef struct snl_mux_t {
+   pthread_mutex_t mutex;
+   pthread_cond_t cond;           // a message is done or the wire is free
+   int draining;                  // a sender is writing chunks
+   unsigned long long vtime;      // virtual time of the last chunk sent
+   snl_mux_channel_t channel[MUX_CHANNELS];
+   unsigned char chunk[MUX_HEADER + (MUX_CHUNK)];
+   unsigned int limit;            // max length of a reassembled message
+   unsigned int current;          // channel of the message in the callback
+   int lent;                      // data buffer is a chunk or reassembled
+   void *spare;                   // receive buffer while delivering
+} snl_mux_t;
+
+typedef int (*snl_mux_write_t)(snl_socket_t *skt, const void *buf, unsigned int len);
+
+snl_mux_t *snl_mux_new(void);
+void snl_mux_delete(snl_mux_t *mux);
+int snl_mux_weight(snl_mux_t *mux, unsigned int channel, unsigned int weight);
+int snl_mux_limit(snl_mux_t *mux, unsigned int max);
+
+int snl_mux_send(snl_socket_t *skt, unsigned int channel, const void *buf, unsigned int len, snl_mux_write_t write);
+void snl_mux_receive(snl_socket_t *skt);
+void snl_mux_restore(snl_socket_t *skt);
+
+#endif // _SNL_MUX_H_
@@ -0,0 +1,152 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "queue.h"
+
+snl_frame_t *
+snl_frame_new(unsigned int len) {
+   snl_frame_t *frame;
+
+   if (!(frame = malloc(sizeof (snl_frame_t) + len))) {
+      return (NULL);
+   }
+
+   frame->refcount = 1;
+   frame->header = 0;
+   frame->length = len;
+   frame->lane = 0;
+   frame->deadline = 0;
+
+   return (frame);
+}
+
+snl_frame_t *
+snl_frame_ref(snl_frame_t *frame) {
+   __sync_fetch_and_add(&frame->refcount, 1);
+
+   return (frame);
+}
+
+void
+snl_frame_unref(snl_frame_t *frame) {
+   if (!frame) return;
+
+   if (__sync_sub_and_fetch(&frame->refcount, 1) == 0) {
+      free(frame);
+   }
+}
+
+static void
+link_node(snl_queue_t *queue, snl_queue_node_t *node) {
+   snl_queue_node_t *prev;
+
+   node->next = NULL;
+
+   // producers only serialize on this single exchange
+   prev = __atomic_exchange_n(&queue->head, node, __ATOMIC_ACQ_REL);
+   __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+}
+
+snl_queue_t *
+snl_queue_new(void) {
+   snl_queue_t *queue;
+
+   if (!(queue = malloc(sizeof (snl_queue_t)))) {
+      return (NULL);
+   }
+
+   memset(queue, 0, sizeof (snl_queue_t));
+   queue->head = &queue->stub;
+   queue->tail = &queue->stub;
+
+   return (queue);
+}
+
+void
+snl_queue_delete(snl_queue_t *queue, void (*release)(void *)) {
+   void *data;
+
+   if (!queue) return;
+
+   while (queue->length > 0) {
+      if ((data = snl_queue_pop(queue)) && release) release(data);
+   }
+
+   free(queue);
+}
+
+int
+snl_queue_push(snl_queue_t *queue, void *data) {
+   snl_queue_node_t *node;
+
+   if (!(node = malloc(sizeof (snl_queue_node_t)))) {
+      return (-1);
+   }
+
+   node->data = data;
+
+   // count first, so a consumer never misses a node in flight
+   __sync_fetch_and_add(&queue->length, 1);
+   link_node(queue, node);
+
+   return (0);
+}
+
+void *
+snl_queue_pop(snl_queue_t *queue) {
+   snl_queue_node_t *tail = queue->tail;
+   snl_queue_node_t *next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+   void *data;
+
+   if (tail == &queue->stub) {
+      if (!next) return (NULL);
+
+      queue->tail = next;
+      tail = next;
+      next = __atomic_load_n(&next->next, __ATOMIC_ACQUIRE);
+   }
+
+   if (!next) {
+      // a producer is between exchange and link, try again later
+      if (tail != __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE)) {
+         return (NULL);
+      }
+
+      link_node(queue, &queue->stub);
+      next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+
+      if (!next) return (NULL);
+   }
+
+   queue->tail = next;
+   data = tail->data;
+   free(tail);
+
+   __sync_fetch_and_sub(&queue->length, 1);
+
+   return (data);
+}
+
+int
+snl_queue_length(snl_queue_t *queue) {
+   return (queue ? __atomic_load_n(&queue->length, __ATOMIC_ACQUIRE) : 0);
+}
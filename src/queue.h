@@ -0,0 +1,56 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef _SNL_QUEUE_H_
+#define _SNL_QUEUE_H_
+
+// refcounted, ready to send wire data (header + payload)
+typedef struct snl_frame_t {
+   int refcount;
+   unsigned int header;  // framing bytes in front of the payload
+   unsigned int length;  // total number of bytes in data
+   int lane;             // sender queue it waits in
+   long long deadline;   // us, monotonic, dropped unsent after it, 0 never
+   unsigned char data[];
+} snl_frame_t;
+
+typedef struct snl_queue_node_t {
+   struct snl_queue_node_t *volatile next;
+   void *data;
+} snl_queue_node_t;
+
+// lock free multi producer, single consumer queue (vyukov style)
+typedef struct snl_queue_t {
+   snl_queue_node_t *volatile head;
+   snl_queue_node_t *tail;
+   snl_queue_node_t stub;
+   volatile int length;
+} snl_queue_t;
+
+snl_frame_t *snl_frame_new(unsigned int len);
+snl_frame_t *snl_frame_ref(snl_frame_t *frame);
+void snl_frame_unref(snl_frame_t *frame);
+
+snl_queue_t *snl_queue_new(void);
+void snl_queue_delete(snl_queue_t *queue, void (*release)(void *));
+int snl_queue_push(snl_queue_t *queue, void *data);
+void *snl_queue_pop(snl_queue_t *queue);
+int snl_queue_length(snl_queue_t *queue);
+
+#endif // _SNL_QUEUE_H_
@@ -0,0 +1,210 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#define _GNU_SOURCE      // splice()
+
+#include <stdlib.h>      // calloc(), free()
+#include <unistd.h>      // close(), read(), pipe2()
+#include <fcntl.h>       // splice(), fcntl()
+#include <errno.h>       // errno
+#include <arpa/inet.h>   // htonl()
+#include <sys/socket.h>  // send()
+
+#include "framing.h"
+#include "relay.h"
+
+snl_relay_t *
+snl_relay_new(void) {
+   snl_relay_t *relay;
+
+   if (!(relay = calloc(1, sizeof (snl_relay_t)))) {
+      return (NULL);
+   }
+
+   if (pipe2(relay->pipe, O_CLOEXEC)) {
+      free(relay);
+      return (NULL);
+   }
+
+   // fewer round trips for large frames, the default 64KB will do too
+   fcntl(relay->pipe[1], F_SETPIPE_SZ, RELAY_PIPE_SIZE);
+
+   pthread_mutex_init(&relay->mutex, NULL);
+
+   return (relay);
+}
+
+void
+snl_relay_delete(snl_relay_t *relay) {
+   if (!relay) return;
+
+   close(relay->pipe[0]);
+   close(relay->pipe[1]);
+
+   pthread_mutex_destroy(&relay->mutex);
+
+   free(relay);
+}
+
+int
+snl_relay_direct(snl_socket_t *skt) {
+   snl_socket_t *peer = skt->relay->peer;
+
+   // plain TCP streams on both ends, the bytes pass unchanged
+   if (!peer || skt->local || skt->cipher || (skt->protocol != SNL_PROTO_MSG)) {
+      return (0);
+   }
+
+   if ((peer->protocol != SNL_PROTO_MSG) && (peer->protocol != SNL_PROTO_TCP)) {
+      return (0);
+   }
+
+   // the peer expects a compact header or another payload
+   if (SNL_FRAMING_V2(peer) || skt->codecs || peer->codecs || skt->shaper || peer->shaper ||
+       skt->credit || peer->credit || skt->rpc || peer->rpc || skt->mux || peer->mux) {
+      return (0);
+   }
+
+   // queued senders would interleave with the frame
+   return (!peer->local && !peer->cipher && !peer->sender && (peer->file_descriptor >= 0));
+}
+
+static int
+send_header(int fd, unsigned int length) {
+   unsigned int header = htonl(length);
+   unsigned char *ptr = (unsigned char *)&header;
+   int remaining = sizeof (header), sent;
+
+   while (remaining) {
+      // goes out together with the start of the body
+      sent = send(fd, ptr, remaining, MSG_NOSIGNAL | (length ? MSG_MORE : 0));
+
+      if (sent < 0) {
+         if (errno == EINTR) continue;
+         return (SNL_ERROR_SEND);
+      }
+
+      ptr += sent;
+      remaining -= sent;
+   }
+
+   return (SNL_ERROR_OK);
+}
+
+static int
+splice_body(int in, int *pipe, int out, unsigned int length) {
+   int error = SNL_ERROR_OK;
+   unsigned char scratch[4096];
+   unsigned int flags;
+   ssize_t moved, sent;
+
+   while (length) {
+      moved = splice(in, NULL, pipe[1], NULL, (length < RELAY_PIPE_SIZE) ? length : RELAY_PIPE_SIZE, SPLICE_F_MOVE);
+
+      if (moved == 0) {
+         return (SNL_ERROR_CLOSED);
+      } else if (moved < 0) {
+         if (errno == EINTR) continue;
+         return (SNL_ERROR_RECEIVE);
+      }
+
+      length -= moved;
+      flags = SPLICE_F_MOVE | (length ? SPLICE_F_MORE : 0);
+
+      // drain the pipe to the peer, or discard the rest of the frame
+      // after a write error, so the incoming stream stays in sync
+      while (moved) {
+         if (out >= 0) {
+            sent = splice(pipe[0], NULL, out, NULL, moved, flags);
+
+            if ((sent < 0) && (errno == EINTR)) continue;
+
+            if (sent <= 0) {
+               error = SNL_ERROR_SEND;
+               out = -1;
+               continue;
+            }
+         } else {
+            sent = read(pipe[0], scratch, (moved < (ssize_t)sizeof (scratch)) ? moved : (ssize_t)sizeof (scratch));
+
+            if (sent < 0) {
+               if (errno == EINTR) continue;
+               return (SNL_ERROR_RECEIVE);
+            }
+         }
+
+         moved -= sent;
+      }
+   }
+
+   return (error);
+}
+
+int
+snl_relay_forward(snl_socket_t *skt, unsigned int length) {
+   snl_relay_t *relay = skt->relay;
+   snl_socket_t *peer;
+   int error, out;
+
+   pthread_mutex_lock(&relay->mutex);
+
+   if (!snl_relay_direct(skt)) {
+      pthread_mutex_unlock(&relay->mutex);
+      return (SNL_ERROR_PROTOCOL);
+   }
+
+   peer = relay->peer;
+   out = peer->file_descriptor;
+
+   // raw streams go without the header, the frame is consumed anyway
+   if ((peer->protocol == SNL_PROTO_MSG) && send_header(out, length)) {
+      out = -1;
+   }
+
+   error = splice_body(skt->file_descriptor, relay->pipe, out, length);
+
+   if ((out < 0) && !error) error = SNL_ERROR_SEND;
+
+   if ((error != SNL_ERROR_CLOSED) && (error != SNL_ERROR_RECEIVE)) {
+      skt->xfer_rcvd += length;
+   }
+
+   if (!error) {
+      __sync_fetch_and_add(&peer->xfer_sent, length);
+   }
+
+   pthread_mutex_unlock(&relay->mutex);
+
+   return (error);
+}
+
+int
+snl_relay_send(snl_socket_t *skt, const void *buf, unsigned int len) {
+   snl_relay_t *relay = skt->relay;
+   int error = SNL_ERROR_PROTOCOL;
+
+   pthread_mutex_lock(&relay->mutex);
+
+   // decrypted or unframed, sent the usual way
+   if (relay->peer) error = snl_send(relay->peer, buf, len);
+
+   pthread_mutex_unlock(&relay->mutex);
+
+   return (error);
+}
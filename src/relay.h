@@ -0,0 +1,42 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef _SNL_RELAY_H_
+#define _SNL_RELAY_H_
+
+#include <pthread.h>
+
+#include "snl.h"
+
+#define RELAY_PIPE_SIZE 1<<20 // 1MB in flight between the sockets
+
+typedef struct snl_relay_t {
+   snl_socket_t *peer;            // frames are forwarded to this socket
+   pthread_mutex_t mutex;         // peer does not change during a frame
+   int pipe[2];                   // kernel buffer for splice()
+} snl_relay_t;
+
+snl_relay_t *snl_relay_new(void);
+void snl_relay_delete(snl_relay_t *relay);
+
+int snl_relay_direct(snl_socket_t *skt);
+int snl_relay_forward(snl_socket_t *skt, unsigned int length);
+int snl_relay_send(snl_socket_t *skt, const void *buf, unsigned int len);
+
+#endif // _SNL_RELAY_H_
@@ -0,0 +1,397 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <sys/eventfd.h> // eventfd()
+#include <string.h>      // memcpy()
+#include <stdlib.h>      // calloc(), malloc(), free()
+#include <unistd.h>      // write(), close()
+#include <pthread.h>     // pthread_mutex_*(), pthread_cond_*()
+#include <time.h>        // clock_gettime()
+#include <arpa/inet.h>   // htonl(), ntohl()
+
+#include "rpc.h"
+
+struct snl_rpc_future_t {
+   pthread_mutex_t mutex;
+   pthread_cond_t cond;
+   int done;
+   int abandoned;                 // released before completion
+   int error;
+   void *buf;                     // copy of the reply
+   unsigned int len;
+};
+
+static long long
+now(void) {
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   return ((long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+// must be called with the mutex held
+static void
+find_earliest(snl_rpc_t *rpc) {
+   snl_rpc_call_t *call;
+   unsigned int i;
+
+   rpc->earliest = 0;
+
+   for (i=0; rpc->pending && (i<RPC_BUCKETS); i++) {
+      for (call=rpc->bucket[i]; call; call=call->next) {
+         if (call->deadline && (!rpc->earliest || (call->deadline < rpc->earliest))) {
+            rpc->earliest = call->deadline;
+         }
+      }
+   }
+}
+
+// must be called with the mutex held
+static snl_rpc_call_t *
+take_call(snl_rpc_t *rpc, unsigned int id) {
+   snl_rpc_call_t **cp, *call;
+
+   for (cp=&rpc->bucket[id & (RPC_BUCKETS - 1)]; (call = *cp); cp=&call->next) {
+      if (call->id == id) {
+         *cp = call->next;
+         rpc->pending--;
+
+         // the worker would wake up for a call that is gone
+         if (call->deadline && (call->deadline == rpc->earliest)) {
+            find_earliest(rpc);
+         }
+
+         return (call);
+      }
+   }
+
+   return (NULL);
+}
+
+snl_rpc_t *
+snl_rpc_new(void) {
+   snl_rpc_t *rpc;
+
+   if (!(rpc = calloc(1, sizeof (snl_rpc_t)))) {
+      return (NULL);
+   }
+
+   if ((rpc->event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+      free(rpc);
+      return (NULL);
+   }
+
+   pthread_mutex_init(&rpc->mutex, NULL);
+
+   return (rpc);
+}
+
+void
+snl_rpc_delete(snl_rpc_t *rpc) {
+   snl_rpc_call_t *call;
+   unsigned int i;
+
+   if (!rpc) return;
+
+   for (i=0; i<RPC_BUCKETS; i++) {
+      while ((call = rpc->bucket[i])) {
+         rpc->bucket[i] = call->next;
+         free(call);
+      }
+   }
+
+   close(rpc->event);
+
+   pthread_mutex_destroy(&rpc->mutex);
+   free(rpc);
+}
+
+void
+snl_rpc_header(void *buf, int type, unsigned int id) {
+   unsigned char *hdr = buf;
+
+   hdr[0] = type;
+   hdr[1] = hdr[2] = hdr[3] = 0;
+
+   id = htonl(id);
+   memcpy(hdr + 4, &id, sizeof (id));
+}
+
+unsigned int
+snl_rpc_register(snl_rpc_t *rpc, unsigned int timeout, snl_rpc_callback_t cb, void *data) {
+   snl_rpc_call_t *call, **bucket;
+   unsigned long long one = 1;
+   int wake = 0;
+
+   if (!(call = malloc(sizeof (snl_rpc_call_t)))) {
+      return (0);
+   }
+
+   call->deadline = timeout ? now() + timeout * 1000LL : 0;
+   call->callback = cb;
+   call->data     = data;
+
+   pthread_mutex_lock(&rpc->mutex);
+
+   // 0 marks plain messages
+   if (!++rpc->next_id) ++rpc->next_id;
+   call->id = rpc->next_id;
+
+   bucket = &rpc->bucket[call->id & (RPC_BUCKETS - 1)];
+   call->next = *bucket;
+   *bucket = call;
+   rpc->pending++;
+
+   if (call->deadline && (!rpc->earliest || (call->deadline < rpc->earliest))) {
+      rpc->earliest = call->deadline;
+      wake = 1;
+   }
+
+   pthread_mutex_unlock(&rpc->mutex);
+
+   // the worker may sleep toward a later deadline
+   if (wake && write(rpc->event, &one, sizeof (one))) {}
+
+   return (call->id);
+}
+
+int
+snl_rpc_forget(snl_rpc_t *rpc, unsigned int id) {
+   snl_rpc_call_t *call;
+
+   pthread_mutex_lock(&rpc->mutex);
+   call = take_call(rpc, id);
+   pthread_mutex_unlock(&rpc->mutex);
+
+   free(call);
+
+   return (call != NULL);
+}
+
+void
+snl_rpc_receive(snl_socket_t *skt) {
+   unsigned char *hdr = skt->data_buffer;
+   snl_rpc_t *rpc = skt->rpc;
+   snl_rpc_call_t *call;
+   unsigned int id;
+
+   if ((skt->data_length < RPC_HEADER) || (hdr[0] > RPC_REPLY)) {
+      skt->error_code = SNL_ERROR_PROTOCOL;
+      skt->event_code = SNL_EVENT_ERROR;
+      return;
+   }
+
+   memcpy(&id, hdr + 4, sizeof (id));
+   id = ntohl(id);
+
+   if (hdr[0] == RPC_REPLY) {
+      pthread_mutex_lock(&rpc->mutex);
+      call = take_call(rpc, id);
+      pthread_mutex_unlock(&rpc->mutex);
+
+      // late replies of expired calls are dropped
+      if (call) {
+         call->callback(skt, SNL_ERROR_OK, hdr + RPC_HEADER, skt->data_length - RPC_HEADER, call->data);
+         free(call);
+      }
+
+      // consumed, no event for the socket callback
+      skt->event_code = SNL_EVENT_UNKNOWN;
+      return;
+   }
+
+   rpc->current = id;
+
+   // lend the payload behind the header to the callback
+   rpc->spare = skt->data_buffer;
+   rpc->lent = 1;
+   skt->data_buffer = hdr + RPC_HEADER;
+   skt->data_length -= RPC_HEADER;
+}
+
+void
+snl_rpc_restore(snl_socket_t *skt) {
+   snl_rpc_t *rpc = skt->rpc;
+
+   rpc->current = 0;
+
+   if (!rpc->lent) return;
+
+   skt->data_buffer = rpc->spare;
+   rpc->spare = NULL;
+   rpc->lent = 0;
+}
+
+long long
+snl_rpc_expire(snl_socket_t *skt, long long now) {
+   snl_rpc_call_t **cp, *call, *expired = NULL;
+   snl_rpc_t *rpc = skt->rpc;
+   long long earliest;
+   unsigned int i;
+
+   if (!rpc->earliest || (rpc->earliest > now)) return (rpc->earliest);
+
+   pthread_mutex_lock(&rpc->mutex);
+
+   for (i=0; i<RPC_BUCKETS; i++) {
+      for (cp=&rpc->bucket[i]; (call = *cp); ) {
+         if (!call->deadline || (call->deadline > now)) {
+            cp = &call->next;
+            continue;
+         }
+
+         *cp = call->next;
+         rpc->pending--;
+
+         call->next = expired;
+         expired = call;
+      }
+   }
+
+   find_earliest(rpc);
+   earliest = rpc->earliest;
+
+   pthread_mutex_unlock(&rpc->mutex);
+
+   // outside the lock, callbacks may issue new calls
+   while ((call = expired)) {
+      expired = call->next;
+      call->callback(skt, SNL_ERROR_TIMEOUT, NULL, 0, call->data);
+      free(call);
+   }
+
+   return (earliest);
+}
+
+void
+snl_rpc_cancel(snl_socket_t *skt, int error) {
+   snl_rpc_t *rpc = skt->rpc;
+   snl_rpc_call_t *call;
+   unsigned int i;
+
+   for (i=0; i<RPC_BUCKETS; i++) {
+      pthread_mutex_lock(&rpc->mutex);
+
+      while ((call = rpc->bucket[i])) {
+         rpc->bucket[i] = call->next;
+         rpc->pending--;
+
+         pthread_mutex_unlock(&rpc->mutex);
+         call->callback(skt, error, NULL, 0, call->data);
+         free(call);
+         pthread_mutex_lock(&rpc->mutex);
+      }
+
+      pthread_mutex_unlock(&rpc->mutex);
+   }
+
+   rpc->earliest = 0;
+}
+
+static void
+future_free(snl_rpc_future_t *future) {
+   pthread_cond_destroy(&future->cond);
+   pthread_mutex_destroy(&future->mutex);
+   free(future->buf);
+   free(future);
+}
+
+static void
+complete_future(snl_socket_t *skt, int error, const void *buf, unsigned int len, void *data) {
+   snl_rpc_future_t *future = data;
+
+   pthread_mutex_lock(&future->mutex);
+
+   if (future->abandoned) {
+      pthread_mutex_unlock(&future->mutex);
+      future_free(future);
+      return;
+   }
+
+   // the reply is only lent to us
+   if (!error && len && (future->buf = malloc(len))) {
+      memcpy(future->buf, buf, len);
+      future->len = len;
+   } else if (!error && len) {
+      error = SNL_ERROR_BUFFER;
+   }
+
+   future->error = error;
+   future->done = 1;
+
+   pthread_cond_signal(&future->cond);
+   pthread_mutex_unlock(&future->mutex);
+}
+
+int
+snl_rpc_submit(snl_socket_t *skt, const void *buf, unsigned int len, unsigned int timeout, snl_rpc_future_t **future) {
+   snl_rpc_future_t *f;
+   int error;
+
+   if (!(f = calloc(1, sizeof (snl_rpc_future_t)))) {
+      return (SNL_ERROR_BUFFER);
+   }
+
+   pthread_mutex_init(&f->mutex, NULL);
+   pthread_cond_init(&f->cond, NULL);
+
+   if ((error = snl_rpc_call(skt, buf, len, timeout, complete_future, f))) {
+      future_free(f);
+      return (error);
+   }
+
+   *future = f;
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_rpc_wait(snl_rpc_future_t *future, const void **buf, unsigned int *len) {
+   pthread_mutex_lock(&future->mutex);
+
+   while (!future->done) {
+      pthread_cond_wait(&future->cond, &future->mutex);
+   }
+
+   pthread_mutex_unlock(&future->mutex);
+
+   if (buf) *buf = future->buf;
+   if (len) *len = future->len;
+
+   return (future->error);
+}
+
+void
+snl_rpc_release(snl_rpc_future_t *future) {
+   if (!future) return;
+
+   // still in flight, the completion frees it
+   pthread_mutex_lock(&future->mutex);
+
+   if (!future->done) {
+      future->abandoned = 1;
+      pthread_mutex_unlock(&future->mutex);
+      return;
+   }
+
+   pthread_mutex_unlock(&future->mutex);
+
+   future_free(future);
+}
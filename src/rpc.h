@@ -0,0 +1,67 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef _SNL_RPC_H_
+#define _SNL_RPC_H_
+
+#include <pthread.h>
+
+#include "snl.h"
+
+#define RPC_HEADER   8           // type, 3 reserved bytes, call id
+#define RPC_BUCKETS  256         // pending calls hashed by id, power of 2
+#define RPC_STACK    512         // messages copied on the stack up to this
+
+#define RPC_MESSAGE  0           // plain snl_send()
+#define RPC_REQUEST  1
+#define RPC_REPLY    2
+
+typedef struct snl_rpc_call_t {
+   unsigned int id;
+   long long deadline;            // us, monotonic, 0 for none
+   snl_rpc_callback_t callback;
+   void *data;
+   struct snl_rpc_call_t *next;
+} snl_rpc_call_t;
+
+typedef struct snl_rpc_t {
+   pthread_mutex_t mutex;         // callers register, the worker completes
+   unsigned int next_id;
+   snl_rpc_call_t *bucket[RPC_BUCKETS];
+   unsigned int pending;
+   long long earliest;            // no deadline expires before this
+   int event;                     // eventfd, wakes the worker for an earlier deadline
+   unsigned int current;          // id of the request in the callback
+   int lent;                      // data buffer points behind the header
+   void *spare;                   // receive buffer while delivering
+} snl_rpc_t;
+
+snl_rpc_t *snl_rpc_new(void);
+void snl_rpc_delete(snl_rpc_t *rpc);
+
+void snl_rpc_header(void *buf, int type, unsigned int id);
+unsigned int snl_rpc_register(snl_rpc_t *rpc, unsigned int timeout, snl_rpc_callback_t cb, void *data);
+int snl_rpc_forget(snl_rpc_t *rpc, unsigned int id);
+
+void snl_rpc_receive(snl_socket_t *skt);
+void snl_rpc_restore(snl_socket_t *skt);
+long long snl_rpc_expire(snl_socket_t *skt, long long now);
+void snl_rpc_cancel(snl_socket_t *skt, int error);
+
+#endif // _SNL_RPC_H_
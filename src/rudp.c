@@ -0,0 +1,553 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <errno.h>       // errno, EINTR, ETIMEDOUT
+#include <string.h>      // memset(), memcpy()
+#include <stdlib.h>      // malloc(), free()
+#include <unistd.h>      // close()
+#include <time.h>        // clock_gettime()
+#include <poll.h>        // poll()
+#include <sys/socket.h>  // socket(), bind(), connect(), send(), recv()
+#include <arpa/inet.h>   // htons(), htonl(), ntohs(), ntohl()
+
+#include "rudp.h"
+#include "sender.h"
+
+#define RUDP_MASK        (RUDP_WINDOW - 1)
+#define RUDP_RTO_INIT    50000   // us
+#define RUDP_RTO_MIN     2000    // us, we are on a LAN
+#define RUDP_RTO_MAX     1000000 // us
+#define RUDP_RETRIES     20      // retransmits until the peer is given up
+#define RUDP_DUPTHRESH   3       // later packets acked before fast retransmit
+#define RUDP_POLL        5000    // us, max idle time of the worker
+#define RUDP_DATAGRAM    65507   // max udp payload over ipv4
+
+#define SA struct sockaddr
+
+// every datagram starts with this header (network byte order):
+//
+//  0: type   (8 bit)      4: sequence (32 bit)
+//  1: unused (8 bit)      8: stream sequence for data,
+//  2: stream (16 bit)        selective ack bitmap for acks (32 bit)
+//
+// an ack carries the next expected sequence and a bitmap of the 32
+// sequences following it, that have already been received.
+
+static long long
+now_us(void) {
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   return ((long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+static void
+put_header(unsigned char *hdr, int type, unsigned int stream, unsigned int seq, unsigned int aux) {
+   unsigned short s = htons(stream);
+
+   hdr[0] = type;
+   hdr[1] = 0;
+   memcpy(hdr + 2, &s, 2);
+   seq = htonl(seq); memcpy(hdr + 4, &seq, 4);
+   aux = htonl(aux); memcpy(hdr + 8, &aux, 4);
+}
+
+static int
+get_header(const unsigned char *hdr, unsigned int len, unsigned int *stream, unsigned int *seq, unsigned int *aux) {
+   unsigned short s;
+
+   if (len < RUDP_HEADER_SIZE) return (0);
+
+   memcpy(&s, hdr + 2, 2); *stream = ntohs(s);
+   memcpy(seq, hdr + 4, 4); *seq = ntohl(*seq);
+   memcpy(aux, hdr + 8, 4); *aux = ntohl(*aux);
+
+   return (hdr[0]);
+}
+
+static void
+send_control(int fd, int type, unsigned int seq, unsigned int aux) {
+   unsigned char hdr[RUDP_HEADER_SIZE];
+
+   put_header(hdr, type, 0, seq, aux);
+   send(fd, hdr, sizeof (hdr), MSG_DONTWAIT);
+}
+
+static void
+release(snl_rudp_packet_t *pkt) {
+   snl_frame_unref(pkt->frame);
+   pkt->frame = NULL;
+}
+
+snl_rudp_t *
+snl_rudp_new(void) {
+   pthread_condattr_t attr;
+   snl_rudp_t *rudp;
+
+   if (!(rudp = malloc(sizeof (snl_rudp_t)))) {
+      return (NULL);
+   }
+
+   memset(rudp, 0, sizeof (snl_rudp_t));
+   rudp->rto = RUDP_RTO_INIT;
+
+   pthread_condattr_init(&attr);
+   pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+   pthread_cond_init(&rudp->cond, &attr);
+   pthread_condattr_destroy(&attr);
+
+   pthread_mutex_init(&rudp->mutex, NULL);
+
+   return (rudp);
+}
+
+void
+snl_rudp_delete(snl_rudp_t *rudp) {
+   snl_rudp_pending_t *pending;
+   int i;
+
+   if (!rudp) return;
+
+   for (i=0; i<RUDP_WINDOW; i++) {
+      release(&rudp->window[i]);
+   }
+
+   for (i=0; i<RUDP_STREAMS; i++) {
+      while ((pending = rudp->pending[i])) {
+         rudp->pending[i] = pending->next;
+         free(pending);
+      }
+   }
+
+   pthread_mutex_destroy(&rudp->mutex);
+   pthread_cond_destroy(&rudp->cond);
+
+   free(rudp);
+}
+
+int
+snl_rudp_connect(int fd, int timeout) {
+   long long deadline = now_us() + (long long)timeout * 1000000;
+   unsigned char buf[RUDP_HEADER_SIZE];
+   unsigned int stream, seq, aux;
+   int rto = RUDP_RTO_INIT / 1000;
+   struct pollfd pfd;
+   int received;
+
+   pfd.fd = fd;
+   pfd.events = POLLIN;
+
+   while (now_us() < deadline) {
+      send_control(fd, RUDP_SYN, 0, 0);
+
+      if (poll(&pfd, 1, rto) > 0) {
+         received = recv(fd, buf, sizeof (buf), MSG_DONTWAIT);
+
+         if (received < 0) {
+            // nobody listens on the other side
+            if (errno == ECONNREFUSED) return (SNL_ERROR_CONNECT);
+            continue;
+         }
+
+         if (get_header(buf, received, &stream, &seq, &aux) == RUDP_SYNACK) {
+            return (SNL_ERROR_OK);
+         }
+      }
+
+      if (rto < RUDP_RTO_MAX / 1000) rto *= 2;
+   }
+
+   return (SNL_ERROR_TIMEOUT);
+}
+
+int
+snl_rudp_accept(snl_socket_t *skt, const unsigned char *buf, unsigned int len, struct sockaddr_in *peer) {
+   socklen_t addrlen = sizeof (struct sockaddr_in);
+   snl_rudp_t *rudp = skt->rudp;
+   unsigned int stream, seq, aux, i;
+   struct sockaddr_in local;
+   int new_fd, flg = 1;
+   long long now = now_us();
+
+   if (get_header(buf, len, &stream, &seq, &aux) != RUDP_SYN) {
+      return (-1);
+   }
+
+   // retransmitted SYNs that queued up before the peer got its own socket
+   for (i=0; i<RUDP_ACCEPTED; i++) {
+      if ((rudp->peer[i].sin_addr.s_addr == peer->sin_addr.s_addr) &&
+          (rudp->peer[i].sin_port == peer->sin_port) &&
+          (now - rudp->accepted[i] < RUDP_RTO_MAX)) {
+         return (-1);
+      }
+   }
+
+   if (getsockname(skt->file_descriptor, (SA *)&local, &addrlen)) {
+      return (-1);
+   }
+
+   // a socket connected to the peer gets all its datagrams from now on,
+   // the listening socket keeps getting those of everybody else
+   if ((new_fd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+      return (-1);
+   }
+
+   setsockopt(new_fd, SOL_SOCKET, SO_REUSEADDR, &flg, sizeof (flg));
+
+   if (bind(new_fd, (SA *)&local, sizeof (local)) ||
+       connect(new_fd, (SA *)peer, sizeof (struct sockaddr_in))) {
+      close(new_fd);
+      return (-1);
+   }
+
+   send_control(new_fd, RUDP_SYNACK, 0, 0);
+
+   i = rudp->peers++ % RUDP_ACCEPTED;
+   rudp->peer[i] = *peer;
+   rudp->accepted[i] = now;
+
+   return (new_fd);
+}
+
+static void
+rtt_sample(snl_rudp_t *rudp, long long rtt) {
+   long long delta;
+
+   if (!rudp->srtt) {
+      rudp->srtt   = rtt;
+      rudp->rttvar = rtt / 2;
+   } else {
+      delta = (rudp->srtt > rtt) ? rudp->srtt - rtt : rtt - rudp->srtt;
+
+      rudp->rttvar = (3 * rudp->rttvar + delta) / 4;
+      rudp->srtt   = (7 * rudp->srtt + rtt) / 8;
+   }
+
+   rudp->rto = rudp->srtt + 4 * rudp->rttvar;
+
+   if (rudp->rto < RUDP_RTO_MIN) rudp->rto = RUDP_RTO_MIN;
+   if (rudp->rto > RUDP_RTO_MAX) rudp->rto = RUDP_RTO_MAX;
+}
+
+static void
+retransmit(snl_socket_t *skt, snl_rudp_packet_t *pkt, long long now) {
+   send(skt->file_descriptor, pkt->frame->data, pkt->frame->length, MSG_DONTWAIT);
+
+   pkt->retries++;
+   pkt->sent = now;
+}
+
+int
+snl_rudp_send(snl_socket_t *skt, unsigned int stream, const void *buf, unsigned int len, int timeout) {
+   snl_rudp_t *rudp = skt->rudp;
+   snl_rudp_packet_t *pkt;
+   int error = SNL_ERROR_OK;
+   unsigned int seq, sseq;
+   snl_frame_t *frame;
+   struct timespec ts;
+
+   if (stream >= RUDP_STREAMS) {
+      return (SNL_ERROR_SEND);
+   }
+
+   if (!(frame = snl_sender_frame(SNL_PROTO_RUDP, skt->cipher, buf, len))) {
+      return (skt->cipher ? SNL_ERROR_CIPHER : SNL_ERROR_BUFFER);
+   }
+
+   // check for packet size overflow
+   if (frame->length > RUDP_DATAGRAM) {
+      snl_frame_unref(frame);
+      return (SNL_ERROR_SEND);
+   }
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   ts.tv_sec += timeout;
+
+   pthread_mutex_lock(&rudp->mutex);
+
+   // wait for the peer to acknowledge the oldest packet in flight
+   while (!rudp->closed && (rudp->snd_next - rudp->snd_una >= RUDP_WINDOW)) {
+      if (pthread_cond_timedwait(&rudp->cond, &rudp->mutex, &ts) == ETIMEDOUT) {
+         error = SNL_ERROR_TIMEOUT;
+         goto cleanup;
+      }
+   }
+
+   if (rudp->closed) {
+      error = SNL_ERROR_CLOSED;
+      goto cleanup;
+   }
+
+   seq  = rudp->snd_next++;
+   sseq = rudp->stream_next[stream]++;
+
+   put_header(frame->data, RUDP_DATA, stream, seq, sseq);
+
+   pkt = &rudp->window[seq & RUDP_MASK];
+   pkt->frame   = frame;
+   pkt->retries = 0;
+   pkt->fast    = 0;
+   pkt->sent    = now_us();
+
+   frame = NULL;
+
+   // a lost or refused datagram is just sent again by the timer
+   send(skt->file_descriptor, pkt->frame->data, pkt->frame->length, MSG_DONTWAIT);
+
+   __sync_fetch_and_add(&skt->xfer_sent, pkt->frame->length - RUDP_HEADER_SIZE);
+
+cleanup:
+
+   pthread_mutex_unlock(&rudp->mutex);
+
+   snl_frame_unref(frame);
+
+   return (error);
+}
+
+static void
+handle_ack(snl_socket_t *skt, unsigned int ack, unsigned int sack) {
+   snl_rudp_t *rudp = skt->rudp;
+   snl_rudp_packet_t *pkt;
+   unsigned int seq, i;
+   long long now = now_us();
+
+   pthread_mutex_lock(&rudp->mutex);
+
+   // cumulative part
+   if (((int)(ack - rudp->snd_una) > 0) && ((int)(ack - rudp->snd_next) <= 0)) {
+      pkt = &rudp->window[(ack - 1) & RUDP_MASK];
+
+      // never measure retransmitted packets (karn)
+      if (pkt->frame && !pkt->retries) rtt_sample(rudp, now - pkt->sent);
+
+      for (seq=rudp->snd_una; seq!=ack; seq++) {
+         release(&rudp->window[seq & RUDP_MASK]);
+      }
+
+      rudp->snd_una = ack;
+   }
+
+   // selective part
+   for (i=0; i<RUDP_SACK_BITS; i++) {
+      if (!(sack & (1u << i))) continue;
+
+      seq = ack + 1 + i;
+      if ((int)(seq - rudp->snd_una) < 0 || (int)(seq - rudp->snd_next) >= 0) continue;
+
+      release(&rudp->window[seq & RUDP_MASK]);
+   }
+
+   // resend holes that enough later packets have overtaken
+   for (i=0; sack && (i<RUDP_SACK_BITS); i++) {
+      seq = ack + i;
+      if ((int)(seq - rudp->snd_next) >= 0) break;
+
+      pkt = &rudp->window[seq & RUDP_MASK];
+      if (!pkt->frame || pkt->fast) continue;
+
+      if (__builtin_popcount(sack >> i) >= RUDP_DUPTHRESH) {
+         retransmit(skt, pkt, now);
+         pkt->fast = 1;
+      }
+   }
+
+   pthread_cond_broadcast(&rudp->cond);
+   pthread_mutex_unlock(&rudp->mutex);
+}
+
+static void
+deliver_ordered(snl_socket_t *skt, unsigned int stream, unsigned int sseq, const unsigned char *buf, unsigned int len, snl_rudp_deliver_t deliver) {
+   snl_rudp_t *rudp = skt->rudp;
+   snl_rudp_pending_t *pending, **pp;
+
+   if (sseq != rudp->stream_expect[stream]) {
+      // too early, park it sorted by stream sequence
+      if ((int)(sseq - rudp->stream_expect[stream]) < 0) return;
+
+      for (pp=&rudp->pending[stream]; *pp; pp=&(*pp)->next) {
+         if ((int)((*pp)->sseq - sseq) > 0) break;
+      }
+
+      if (!(pending = malloc(sizeof (snl_rudp_pending_t) + len))) return;
+
+      pending->sseq = sseq;
+      pending->length = len;
+      memcpy(pending->data, buf, len);
+
+      pending->next = *pp;
+      *pp = pending;
+
+      return;
+   }
+
+   rudp->stream_expect[stream]++;
+   deliver(skt, buf, len, stream);
+
+   // release everything that was waiting for this one
+   while ((pending = rudp->pending[stream]) && (pending->sseq == rudp->stream_expect[stream])) {
+      rudp->pending[stream] = pending->next;
+      rudp->stream_expect[stream]++;
+
+      deliver(skt, pending->data, pending->length, stream);
+      free(pending);
+   }
+}
+
+static void
+handle_data(snl_socket_t *skt, unsigned int stream, unsigned int seq, unsigned int sseq, const unsigned char *buf, unsigned int len, snl_rudp_deliver_t deliver) {
+   snl_rudp_t *rudp = skt->rudp;
+   int distance = (int)(seq - rudp->rcv_next);
+
+   rudp->ack_needed = 1;
+
+   // old duplicate or outside of the window
+   if ((distance < 0) || (distance >= RUDP_WINDOW)) return;
+
+   // recent duplicate
+   if (rudp->received[seq & RUDP_MASK]) return;
+
+   rudp->received[seq & RUDP_MASK] = 1;
+
+   while (rudp->received[rudp->rcv_next & RUDP_MASK]) {
+      rudp->received[rudp->rcv_next & RUDP_MASK] = 0;
+      rudp->rcv_next++;
+   }
+
+   if (rudp->ordered && (stream < RUDP_STREAMS)) {
+      deliver_ordered(skt, stream, sseq, buf, len, deliver);
+   } else {
+      deliver(skt, buf, len, stream);
+   }
+}
+
+int
+snl_rudp_input(snl_socket_t *skt, const unsigned char *buf, unsigned int len, snl_rudp_deliver_t deliver) {
+   snl_rudp_t *rudp = skt->rudp;
+   unsigned int stream, seq, aux;
+
+   switch (get_header(buf, len, &stream, &seq, &aux)) {
+      case RUDP_DATA:
+         handle_data(skt, stream, seq, aux, buf + RUDP_HEADER_SIZE, len - RUDP_HEADER_SIZE, deliver);
+      break;
+
+      case RUDP_ACK:
+         handle_ack(skt, seq, aux);
+      break;
+
+      case RUDP_SYN:
+         // our synack got lost
+         send_control(skt->file_descriptor, RUDP_SYNACK, 0, 0);
+      break;
+
+      case RUDP_FIN:
+         pthread_mutex_lock(&rudp->mutex);
+         rudp->closed = 1;
+         pthread_cond_broadcast(&rudp->cond);
+         pthread_mutex_unlock(&rudp->mutex);
+
+         return (SNL_ERROR_CLOSED);
+   }
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_rudp_timer(snl_socket_t *skt, long long *next) {
+   snl_rudp_t *rudp = skt->rudp;
+   int error = SNL_ERROR_OK;
+   unsigned int seq, sack, i;
+   snl_rudp_packet_t *pkt;
+   long long now, due, rto;
+
+   // acknowledge everything received since the last call at once
+   if (rudp->ack_needed) {
+      for (sack=0, i=0; i<RUDP_SACK_BITS; i++) {
+         if (rudp->received[(rudp->rcv_next + 1 + i) & RUDP_MASK]) sack |= 1u << i;
+      }
+
+      send_control(skt->file_descriptor, RUDP_ACK, rudp->rcv_next, sack);
+      rudp->ack_needed = 0;
+   }
+
+   pthread_mutex_lock(&rudp->mutex);
+
+   now = now_us();
+   *next = now + RUDP_POLL;
+
+   for (seq=rudp->snd_una; seq!=rudp->snd_next; seq++) {
+      pkt = &rudp->window[seq & RUDP_MASK];
+      if (!pkt->frame) continue;
+
+      // exponential backoff
+      rto = rudp->rto << (pkt->retries < 6 ? pkt->retries : 6);
+      if (rto > RUDP_RTO_MAX) rto = RUDP_RTO_MAX;
+
+      due = pkt->sent + rto;
+
+      if (due <= now) {
+         if (pkt->retries >= RUDP_RETRIES) {
+            rudp->closed = 1;
+            pthread_cond_broadcast(&rudp->cond);
+            error = SNL_ERROR_TIMEOUT;
+            break;
+         }
+
+         retransmit(skt, pkt, now);
+         due = now + rto;
+      }
+
+      if (due < *next) *next = due;
+   }
+
+   pthread_mutex_unlock(&rudp->mutex);
+
+   return (error);
+}
+
+int
+snl_rudp_close(snl_socket_t *skt, int timeout) {
+   snl_rudp_t *rudp = skt->rudp;
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   ts.tv_sec += timeout;
+
+   pthread_mutex_lock(&rudp->mutex);
+
+   // give the worker a chance to get everything acknowledged
+   while (!rudp->closed && (rudp->snd_una != rudp->snd_next)) {
+      if (pthread_cond_timedwait(&rudp->cond, &rudp->mutex, &ts) == ETIMEDOUT) break;
+   }
+
+   if (!rudp->closed) {
+      send_control(skt->file_descriptor, RUDP_FIN, rudp->snd_next, 0);
+      send_control(skt->file_descriptor, RUDP_FIN, rudp->snd_next, 0);
+   }
+
+   rudp->closed = 1;
+   pthread_cond_broadcast(&rudp->cond);
+
+   pthread_mutex_unlock(&rudp->mutex);
+
+   return (SNL_ERROR_OK);
+}
+
+#undef SA
@@ -0,0 +1,96 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef _SNL_RUDP_H_
+#define _SNL_RUDP_H_
+
+#include <pthread.h>
+#include <netinet/in.h>
+
+#include "queue.h"
+#include "snl.h"
+
+#define RUDP_HEADER_SIZE 12
+#define RUDP_WINDOW      256    // max packets in flight, power of 2
+#define RUDP_STREAMS     16     // streams with independent ordering
+#define RUDP_SACK_BITS   32
+#define RUDP_ACCEPTED    16     // peers remembered to drop duplicate SYNs
+
+enum {
+   RUDP_DATA = 1,
+   RUDP_ACK,
+   RUDP_SYN,
+   RUDP_SYNACK,
+   RUDP_FIN
+};
+
+typedef struct snl_rudp_packet_t {
+   snl_frame_t *frame;            // header + encrypted payload
+   long long sent;                // us, monotonic
+   int retries;
+   int fast;                      // already fast retransmitted
+} snl_rudp_packet_t;
+
+typedef struct snl_rudp_pending_t {
+   struct snl_rudp_pending_t *next;
+   unsigned int sseq;
+   unsigned int length;
+   unsigned char data[];
+} snl_rudp_pending_t;
+
+typedef struct snl_rudp_t {
+   pthread_mutex_t mutex;
+   pthread_cond_t cond;
+   int ordered;
+   int closed;
+
+   // sender, protected by mutex
+   unsigned int snd_una;          // oldest unacknowledged sequence
+   unsigned int snd_next;         // next sequence to send
+   unsigned int stream_next[RUDP_STREAMS];
+   snl_rudp_packet_t window[RUDP_WINDOW];
+   long long srtt, rttvar, rto;   // us
+
+   // receiver, only touched by the worker thread
+   unsigned int rcv_next;         // next expected sequence
+   unsigned char received[RUDP_WINDOW];
+   unsigned int stream_expect[RUDP_STREAMS];
+   snl_rudp_pending_t *pending[RUDP_STREAMS];
+   int ack_needed;
+
+   // listener, recently accepted peers
+   struct sockaddr_in peer[RUDP_ACCEPTED];
+   long long accepted[RUDP_ACCEPTED];
+   unsigned int peers;
+} snl_rudp_t;
+
+typedef void (*snl_rudp_deliver_t)(snl_socket_t *skt, const unsigned char *buf, unsigned int len, unsigned int stream);
+
+snl_rudp_t *snl_rudp_new(void);
+void snl_rudp_delete(snl_rudp_t *rudp);
+
+int snl_rudp_connect(int fd, int timeout);
+int snl_rudp_accept(snl_socket_t *skt, const unsigned char *buf, unsigned int len, struct sockaddr_in *peer);
+int snl_rudp_close(snl_socket_t *skt, int timeout);
+
+int snl_rudp_send(snl_socket_t *skt, unsigned int stream, const void *buf, unsigned int len, int timeout);
+int snl_rudp_input(snl_socket_t *skt, const unsigned char *buf, unsigned int len, snl_rudp_deliver_t deliver);
+int snl_rudp_timer(snl_socket_t *skt, long long *next);
+
+#endif // _SNL_RUDP_H_
@@ -0,0 +1,510 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <errno.h>       // errno, EINTR, EAGAIN
+#include <string.h>      // memset(), memcpy(), memmove()
+#include <stdlib.h>      // malloc(), free()
+#include <unistd.h>      // write(), close()
+#include <time.h>        // clock_gettime()
+#include <sys/eventfd.h> // eventfd()
+#include <sys/socket.h>  // sendmsg(), send(), MSG_DONTWAIT
+#include <sys/uio.h>     // struct iovec
+#include <arpa/inet.h>   // htonl()
+
+#include "rudp.h"
+#include "sender.h"
+
+static long long
+now(void) {
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   return ((long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+snl_sender_t *
+snl_sender_new(void) {
+   snl_sender_t *snd;
+   unsigned int i;
+
+   if (!(snd = malloc(sizeof (snl_sender_t)))) {
+      return (NULL);
+   }
+
+   memset(snd, 0, sizeof (snl_sender_t));
+   snd->event = -1;
+
+   pthread_mutex_init(&snd->mutex, NULL);
+   pthread_cond_init(&snd->turn, NULL);
+
+   if ((snd->event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+      snl_sender_delete(snd);
+      return (NULL);
+   }
+
+   for (i=0; i<SEND_LANES; i++) {
+      if (!(snd->queue[i] = snl_queue_new())) {
+         snl_sender_delete(snd);
+         return (NULL);
+      }
+   }
+
+   return (snd);
+}
+
+void
+snl_sender_delete(snl_sender_t *snd) {
+   unsigned int i;
+
+   if (!snd) return;
+
+   snl_timer_stop(&snd->timer);
+
+   for (i=0; i<snd->count; i++) {
+      snl_frame_unref(snd->batch[i]);
+   }
+
+   for (i=0; i<SEND_LANES; i++) {
+      snl_queue_delete(snd->queue[i], (void (*)(void *))snl_frame_unref);
+   }
+
+   if (snd->event >= 0) close(snd->event);
+
+   pthread_cond_destroy(&snd->turn);
+   pthread_mutex_destroy(&snd->mutex);
+   free(snd);
+}
+
+// once this returns, the wheel does not write to the socket anymore
+void
+snl_sender_close(snl_sender_t *snd) {
+   if (snd) snl_timer_stop(&snd->timer);
+}
+
+snl_frame_t *
+snl_sender_frame(int proto, blowfish_t *bf, const void *buf, unsigned int len) {
+   unsigned int length, pad = 0, header = 0;
+   snl_frame_t *frame;
+
+   // reliable UDP fills in its own header when the frame gets a sequence
+   if (proto == SNL_PROTO_MSG)  header = 4;
+   if (proto == SNL_PROTO_RUDP) header = RUDP_HEADER_SIZE;
+
+   // padding is added in place, no extra cipher buffer needed
+   if (bf) pad = 8 - (len % 8);
+
+   length = len + pad;
+
+   if (!(frame = snl_frame_new(header + length))) {
+      return (NULL);
+   }
+
+   frame->header = header;
+   memcpy(frame->data + header, buf, len);
+
+   if (bf) {
+      memset(frame->data + header + len, pad, pad);
+
+      if (bf_encrypt(bf, frame->data + header, length)) {
+         snl_frame_unref(frame);
+         return (NULL);
+      }
+   }
+
+   if (proto == SNL_PROTO_MSG) {
+      length = htonl(length);
+      memcpy(frame->data, &length, sizeof (length));
+   }
+
+   return (frame);
+}
+
+static void
+expire_frame(snl_sender_t *snd, snl_frame_t *frame) {
+   __sync_fetch_and_sub(&snd->pending, frame->length);
+   __sync_fetch_and_add(&snd->done, frame->length);
+   __sync_fetch_and_add(&snd->expired, 1);
+   snl_frame_unref(frame);
+}
+
+static int
+waiting(snl_sender_t *snd, int lanes) {
+   int i;
+
+   for (i=0; i<lanes; i++) {
+      if (snl_queue_length(snd->queue[i]) > 0) return (1);
+   }
+
+   return (0);
+}
+
+// next frame still worth sending, of the highest priority below lanes
+static snl_frame_t *
+next_frame(snl_sender_t *snd, int lanes, long long *time) {
+   snl_frame_t *frame;
+   int i;
+
+   for (i=0; i<lanes; i++) {
+      while ((frame = snl_queue_pop(snd->queue[i]))) {
+         if (frame->deadline) {
+            if (!*time) *time = now();
+
+            if (frame->deadline <= *time) {
+               expire_frame(snd, frame);
+               continue;
+            }
+         }
+
+         return (frame);
+      }
+   }
+
+   return (NULL);
+}
+
+// drops unsent frames past their deadline and lets frames of a higher
+// priority overtake the unsent rest of the batch
+static void
+update_batch(snl_sender_t *snd) {
+   unsigned int i, first = snd->offset ? 1 : 0, count = first;
+   snl_frame_t *frame;
+   long long time = 0;
+   int lowest = 0;
+
+   for (i=first; i<snd->count; i++) {
+      frame = snd->batch[i];
+
+      if (frame->deadline) {
+         if (!time) time = now();
+
+         if (frame->deadline <= time) {
+            expire_frame(snd, frame);
+            continue;
+         }
+      }
+
+      if (frame->lane > lowest) lowest = frame->lane;
+      snd->batch[count++] = frame;
+   }
+
+   snd->count = count;
+
+   while ((snd->count < SEND_BATCH_SIZE) && waiting(snd, lowest)) {
+      if (!(frame = next_frame(snd, lowest, &time))) break;
+
+      // behind the frames of the same or a higher priority
+      for (i=snd->count; (i > first) && (snd->batch[i-1]->lane > frame->lane); i--) {
+         snd->batch[i] = snd->batch[i-1];
+      }
+
+      snd->batch[i] = frame;
+      snd->count++;
+   }
+}
+
+// write as much of the current batch as the socket takes, returns
+// 1 if the socket would block, 0 if the batch went out completely
+static int
+write_batch(snl_socket_t *skt, snl_sender_t *snd, int nonblock) {
+   struct iovec iov[SEND_BATCH_SIZE];
+   unsigned int i, done;
+   struct msghdr msg;
+   ssize_t written;
+
+   while (snd->count) {
+      update_batch(snd);
+
+      // everything left expired
+      if (!snd->count) break;
+
+      for (i=0; i<snd->count; i++) {
+         iov[i].iov_base = snd->batch[i]->data;
+         iov[i].iov_len  = snd->batch[i]->length;
+      }
+
+      iov[0].iov_base = (char *)iov[0].iov_base + snd->offset;
+      iov[0].iov_len -= snd->offset;
+
+      memset(&msg, 0, sizeof (msg));
+      msg.msg_iov = iov;
+      msg.msg_iovlen = snd->count;
+
+      written = sendmsg(skt->file_descriptor, &msg, nonblock ? MSG_DONTWAIT : 0);
+
+      if (written < 0) {
+         if (errno == EINTR) continue;
+         if (nonblock && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+            return (1);
+         }
+
+         snd->error = SNL_ERROR_CLOSED;
+         return (0);
+      }
+
+      // release everything that went out completely
+      written += snd->offset;
+      for (done=0; done<snd->count; done++) {
+         if (written < (ssize_t)snd->batch[done]->length) break;
+
+         written -= snd->batch[done]->length;
+
+         __sync_fetch_and_add(&skt->xfer_sent, snd->batch[done]->length - snd->batch[done]->header);
+         __sync_fetch_and_sub(&snd->pending, snd->batch[done]->length);
+         __sync_fetch_and_add(&snd->done, snd->batch[done]->length);
+         snl_frame_unref(snd->batch[done]);
+      }
+
+      snd->count -= done;
+      snd->offset = written;
+      memmove(snd->batch, snd->batch + done, snd->count * sizeof (snl_frame_t *));
+
+      // short write, the socket buffer is full
+      if (snd->count && nonblock) return (1);
+   }
+
+   return (0);
+}
+
+// lets the waiting senders check if it is their turn
+static void
+release(snl_sender_t *snd) {
+   __sync_lock_release(&snd->draining);
+   __sync_synchronize();
+
+   if (snd->waiters) {
+      pthread_mutex_lock(&snd->mutex);
+      pthread_cond_broadcast(&snd->turn);
+      pthread_mutex_unlock(&snd->mutex);
+   }
+}
+
+// a waiting sender takes over the rest, returns 0 if nobody waits
+static int
+hand_over(snl_sender_t *snd) {
+   int waiters;
+
+   pthread_mutex_lock(&snd->mutex);
+
+   if ((waiters = snd->waiters)) {
+      __sync_lock_release(&snd->draining);
+      pthread_cond_broadcast(&snd->turn);
+   }
+
+   pthread_mutex_unlock(&snd->mutex);
+
+   return (waiters);
+}
+
+int
+snl_sender_drain(snl_socket_t *skt, int nonblock) {
+   snl_sender_t *snd = skt->sender;
+   unsigned long long share, one = 1;
+   snl_frame_t *frame;
+   long long time;
+   int blocked = 0;
+   unsigned int i;
+
+   while (!blocked && (snd->count || waiting(snd, SEND_LANES))) {
+      // only one thread at a time may write to the socket, everyone
+      // else just leaves its frame in the queue and returns
+      if (!__sync_bool_compare_and_swap(&snd->draining, 0, 1)) break;
+
+      // what was queued before we came, later frames are not our job
+      share = snd->done + snd->pending;
+
+      for (;;) {
+         time = 0;
+
+         while (snd->count < SEND_BATCH_SIZE) {
+            if (!(frame = next_frame(snd, SEND_LANES, &time))) break;
+            snd->batch[snd->count++] = frame;
+         }
+
+         if (!snd->count) break;
+
+         if (!snd->error) {
+            if ((blocked = write_batch(skt, snd, nonblock))) break;
+         }
+
+         // connection is broken, throw away what's left
+         if (snd->error) {
+            for (i=0; i<snd->count; i++) {
+               __sync_fetch_and_sub(&snd->pending, snd->batch[i]->length);
+               __sync_fetch_and_add(&snd->done, snd->batch[i]->length);
+               snl_frame_unref(snd->batch[i]);
+            }
+            snd->count = snd->offset = 0;
+         }
+
+         // producers faster than the peer would keep us here forever
+         if (!nonblock && (snd->done >= share) && hand_over(snd)) {
+            return (snd->error);
+         }
+      }
+
+      // frames queued after our last pop are picked up by the loop
+      release(snd);
+   }
+
+   // the socket is full, the worker writes the rest once it drains
+   if (blocked && !pthread_equal(pthread_self(), skt->worker_tid)) {
+      if (write(snd->event, &one, sizeof (one))) {}
+   }
+
+   return (snd->error);
+}
+
+// with a backlog a blocking sender waits while somebody else drains,
+// until that one has written our frame or hands the rest over
+static int
+send_blocking(snl_socket_t *skt) {
+   snl_sender_t *snd = skt->sender;
+   unsigned long long mine = snd->done + snd->pending;
+   int waited = 0, again;
+
+   for (;;) {
+      snl_sender_drain(skt, 0);
+
+      pthread_mutex_lock(&snd->mutex);
+      snd->waiters++;
+      __sync_synchronize();
+
+      while (snd->draining && (snd->done < mine) && !snd->error) {
+         pthread_cond_wait(&snd->turn, &snd->mutex);
+         waited = 1;
+      }
+
+      snd->waiters--;
+
+      // released with our frame or a hand over still queued
+      again = !snd->draining && !snd->error &&
+         ((snd->done < mine) || (waited && (snd->count || waiting(snd, SEND_LANES))));
+
+      pthread_mutex_unlock(&snd->mutex);
+
+      if (!again) return (snd->error);
+   }
+}
+
+// the worker serves the budget while it waits for data, a worker stuck
+// in a callback or in the middle of a message leaves it to the wheel
+static unsigned int
+budget_expired(void *arg) {
+   snl_socket_t *skt = arg;
+   snl_sender_t *snd = skt->sender;
+   long long oldest = snd->oldest, left;
+
+   // flushed in the meantime
+   if (!oldest) return (0);
+
+   // the wheel ticks in ms, the budget may not be used up yet
+   if ((left = oldest + snd->budget - now()) > 0) {
+      return ((left + 999) / 1000);
+   }
+
+   // the socket takes what it can, a blocked rest is left to the worker
+   if (__sync_bool_compare_and_swap(&snd->oldest, oldest, 0)) {
+      snl_sender_drain(skt, 1);
+   }
+
+   return (0);
+}
+
+int
+snl_sender_send(snl_socket_t *skt, snl_frame_t *frame, int lane, int nonblock) {
+   snl_sender_t *snd = skt->sender;
+   unsigned long long one = 1;
+   int error = SNL_ERROR_OK;
+
+   if (snd->error) {
+      snl_frame_unref(frame);
+      return (snd->error);
+   }
+
+   // datagrams are atomic anyway, no need to queue them
+   if (SNL_DATAGRAMS(skt)) {
+      if (send(skt->file_descriptor, frame->data, frame->length, nonblock ? MSG_DONTWAIT : 0) != (int)frame->length) {
+         error = SNL_ERROR_SEND;
+      } else {
+         __sync_fetch_and_add(&skt->xfer_sent, frame->length);
+      }
+
+      snl_frame_unref(frame);
+
+      return (error);
+   }
+
+   __sync_fetch_and_add(&snd->pending, frame->length);
+
+   frame->lane = lane;
+
+   if (snl_queue_push(snd->queue[lane], frame)) {
+      __sync_fetch_and_sub(&snd->pending, frame->length);
+      snl_frame_unref(frame);
+
+      return (SNL_ERROR_BUFFER);
+   }
+
+   // let it wait for more, the first frame arms the worker
+   if (snd->budget && (snd->pending < snd->threshold)) {
+      if (__sync_bool_compare_and_swap(&snd->oldest, 0, now())) {
+         if (write(snd->event, &one, sizeof (one))) {}
+
+         snd->timer.expire = budget_expired;
+         snd->timer.arg = skt;
+         snl_timer_start(&snd->timer, (snd->budget + 999) / 1000);
+      }
+
+      return (snd->error);
+   }
+
+   // the worker must not wait, the peer may wait for it to read
+   if (nonblock || (snd->pending < SEND_BACKLOG) || pthread_equal(pthread_self(), skt->worker_tid)) {
+      return (snl_sender_drain(skt, nonblock));
+   }
+
+   return (send_blocking(skt));
+}
+
+int
+snl_sender_coalesce(snl_sender_t *snd, unsigned int budget, unsigned int threshold) {
+   snd->threshold = threshold;
+   snd->budget = budget;
+
+   return (SNL_ERROR_OK);
+}
+
+long long
+snl_sender_deadline(snl_sender_t *snd) {
+   long long oldest = snd->oldest;
+
+   return (oldest ? oldest + snd->budget : 0);
+}
+
+int
+snl_sender_flush(snl_socket_t *skt) {
+   snl_sender_t *snd = skt->sender;
+
+   // frames queued from now on arm a new deadline
+   snd->oldest = 0;
+   __sync_synchronize();
+
+   return (snl_sender_drain(skt, 0));
+}
@@ -0,0 +1,76 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef _SNL_SENDER_H_
+#define _SNL_SENDER_H_
+
+#include <pthread.h>
+
+#include "blowfish.h"
+#include "queue.h"
+#include "timer.h"
+#include "snl.h"
+
+#define UDP_PAYLOAD_SIZE 1<<16 // 64KB
+#define SEND_BATCH_SIZE  64    // max frames coalesced into one writev()
+#define COALESCE_BYTES   1<<16 // 64KB, default threshold of snl_coalesce()
+#define SEND_LANES       3     // one queue per SNL_PRIORITY_*
+#define SEND_LOWAT       1<<16 // 64KB, max unsent bytes in the kernel for lanes
+#define SEND_BACKLOG     1<<20 // 1MB queued, then blocking senders take turns
+
+// the kernel keeps message boundaries, so frames go out one by one and
+// without length header
+#define SNL_DATAGRAMS(skt) (((skt)->protocol == SNL_PROTO_UDP) || \
+                            ((skt)->local && ((skt)->protocol == SNL_PROTO_MSG)))
+
+typedef struct snl_sender_t {
+   snl_queue_t *queue[SEND_LANES];      // drained highest priority first
+   snl_frame_t *batch[SEND_BATCH_SIZE]; // taken from queue, not yet written
+   unsigned int count;                  // number of frames in batch
+   unsigned int offset;                 // bytes of batch[0] already written
+   volatile unsigned int pending;       // bytes queued but not yet written
+   volatile unsigned long long done;    // bytes ever written or dropped
+   volatile int draining;
+   volatile int waiters;                // blocking senders waiting for their turn
+   pthread_mutex_t mutex;               // guards waiters, the drainer hands over
+   pthread_cond_t turn;
+   int error;
+   unsigned int budget;                 // us a frame may wait, 0 writes at once
+   unsigned int threshold;              // pending bytes written without waiting
+   volatile long long oldest;           // us, monotonic, first waiting frame
+   int event;                           // eventfd waking the worker
+   snl_timer_t timer;                   // flushes when the worker is busy
+   volatile unsigned int expired;       // frames dropped at their deadline
+   int lowat;                           // TCP_NOTSENT_LOWAT applied
+} snl_sender_t;
+
+snl_sender_t *snl_sender_new(void);
+void snl_sender_delete(snl_sender_t *snd);
+void snl_sender_close(snl_sender_t *snd);
+
+snl_frame_t *snl_sender_frame(int proto, blowfish_t *bf, const void *buf, unsigned int len);
+
+int snl_sender_send(snl_socket_t *skt, snl_frame_t *frame, int lane, int nonblock);
+int snl_sender_drain(snl_socket_t *skt, int nonblock);
+
+int snl_sender_coalesce(snl_sender_t *snd, unsigned int budget, unsigned int threshold);
+long long snl_sender_deadline(snl_sender_t *snd);
+int snl_sender_flush(snl_socket_t *skt);
+
+#endif // _SNL_SENDER_H_
@@ -0,0 +1,247 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <stdlib.h>      // calloc(), free()
+#include <unistd.h>      // usleep()
+#include <pthread.h>     // pthread_mutex_*()
+#include <time.h>        // clock_gettime()
+
+#include "shaper.h"
+
+static long long
+now(void) {
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   return ((long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+// must be called with the mutex held
+static void
+refill(snl_bucket_t *bkt, long long time) {
+   long long full = (long long)bkt->burst * 1000000, elapsed = time - bkt->stamp;
+
+   bkt->stamp = time;
+
+   if ((elapsed <= 0) || (bkt->tokens >= full)) return;
+
+   // idle long enough, the product could overflow
+   if (elapsed > (full - bkt->tokens) / bkt->rate) {
+      bkt->tokens = full;
+   } else {
+      bkt->tokens += elapsed * bkt->rate;
+   }
+}
+
+// us until the bucket is out of debt, 0 if it is not in debt
+long long
+snl_bucket_debt(snl_bucket_t *bkt) {
+   long long wait = 0;
+
+   pthread_mutex_lock(&bkt->mutex);
+
+   refill(bkt, now());
+   if (bkt->tokens < 0) wait = -bkt->tokens / bkt->rate + 1;
+
+   pthread_mutex_unlock(&bkt->mutex);
+
+   return (wait);
+}
+
+void
+snl_bucket_take(snl_bucket_t *bkt, unsigned int len) {
+   pthread_mutex_lock(&bkt->mutex);
+
+   // a message larger than the burst goes into debt
+   bkt->tokens -= (bkt->unit == SNL_RATE_MESSAGES ? 1 : len) * 1000000LL;
+
+   pthread_mutex_unlock(&bkt->mutex);
+}
+
+// us until every bucket of the direction is out of debt
+static long long
+waiting(snl_shaper_t *shp, int direction) {
+   long long wait, most = 0;
+   unsigned int i;
+
+   for (i=0; i<shp->count[direction]; i++) {
+      wait = snl_bucket_debt(shp->bucket[direction][i]);
+      if (wait > most) most = wait;
+   }
+
+   return (most);
+}
+
+snl_bucket_t *
+snl_bucket_ref(snl_bucket_t *bkt) {
+   __sync_fetch_and_add(&bkt->refcount, 1);
+
+   return (bkt);
+}
+
+static void
+bucket_unref(snl_bucket_t *bkt) {
+   if (!bkt || __sync_sub_and_fetch(&bkt->refcount, 1)) return;
+
+   pthread_mutex_destroy(&bkt->mutex);
+   free(bkt);
+}
+
+snl_bucket_t *
+snl_bucket_new(int unit, unsigned int rate, unsigned int burst) {
+   snl_bucket_t *bkt;
+
+   if (((unit != SNL_RATE_BYTES) && (unit != SNL_RATE_MESSAGES)) || !rate) {
+      return (NULL);
+   }
+
+   if (!(bkt = calloc(1, sizeof (snl_bucket_t)))) {
+      return (NULL);
+   }
+
+   bkt->refcount = 1;
+   bkt->unit  = unit;
+   bkt->rate  = rate;
+   bkt->burst = burst ? burst : rate;
+
+   // starts full
+   bkt->tokens = (long long)bkt->burst * 1000000;
+   bkt->stamp  = now();
+
+   pthread_mutex_init(&bkt->mutex, NULL);
+
+   return (bkt);
+}
+
+void
+snl_bucket_delete(snl_bucket_t *bkt) {
+   bucket_unref(bkt);
+}
+
+int
+snl_bucket_rate(snl_bucket_t *bkt, unsigned int rate, unsigned int burst) {
+   if (!rate) {
+      return (SNL_ERROR_OPTION);
+   }
+
+   pthread_mutex_lock(&bkt->mutex);
+
+   // what was saved up so far still counts
+   refill(bkt, now());
+
+   bkt->rate  = rate;
+   bkt->burst = burst ? burst : rate;
+
+   if (bkt->tokens > (long long)bkt->burst * 1000000) {
+      bkt->tokens = (long long)bkt->burst * 1000000;
+   }
+
+   pthread_mutex_unlock(&bkt->mutex);
+
+   return (SNL_ERROR_OK);
+}
+
+long long
+snl_bucket_tokens(snl_bucket_t *bkt) {
+   long long tokens;
+
+   pthread_mutex_lock(&bkt->mutex);
+
+   refill(bkt, now());
+   tokens = bkt->tokens / 1000000;
+
+   pthread_mutex_unlock(&bkt->mutex);
+
+   return (tokens);
+}
+
+snl_shaper_t *
+snl_shaper_new(void) {
+   return (calloc(1, sizeof (snl_shaper_t)));
+}
+
+void
+snl_shaper_delete(snl_shaper_t *shp) {
+   if (!shp) return;
+
+   snl_shaper_clear(shp, SNL_RATE_SEND);
+   snl_shaper_clear(shp, SNL_RATE_RECEIVE);
+
+   free(shp);
+}
+
+int
+snl_shaper_add(snl_shaper_t *shp, int direction, snl_bucket_t *bkt) {
+   if (shp->count[direction] == SHAPER_BUCKETS) {
+      return (SNL_ERROR_OPTION);
+   }
+
+   shp->bucket[direction][shp->count[direction]++] = snl_bucket_ref(bkt);
+
+   return (SNL_ERROR_OK);
+}
+
+void
+snl_shaper_clear(snl_shaper_t *shp, int direction) {
+   while (shp->count[direction]) {
+      bucket_unref(shp->bucket[direction][--shp->count[direction]]);
+   }
+}
+
+int
+snl_shaper_send(snl_socket_t *skt, unsigned int len, int timeout) {
+   long long deadline = now() + timeout * 1000000LL, wait;
+   snl_shaper_t *shp = skt->shaper;
+   unsigned int i;
+
+   while ((wait = waiting(shp, SNL_RATE_SEND))) {
+      // would not be sent within the send timeout anyway
+      if (now() + wait > deadline) return (SNL_ERROR_TIMEOUT);
+
+      usleep(wait);
+   }
+
+   for (i=0; i<shp->count[SNL_RATE_SEND]; i++) {
+      snl_bucket_take(shp->bucket[SNL_RATE_SEND][i], len);
+   }
+
+   return (SNL_ERROR_OK);
+}
+
+void
+snl_shaper_pause(snl_socket_t *skt) {
+   snl_shaper_t *shp = skt->shaper;
+   long long wait;
+
+   // the data waits in the kernel, the peer is slowed down by its window
+   while (!skt->worker_stop && (wait = waiting(shp, SNL_RATE_RECEIVE))) {
+      usleep(wait < SHAPER_SLICE ? wait : SHAPER_SLICE);
+   }
+}
+
+void
+snl_shaper_charge(snl_socket_t *skt, unsigned int len) {
+   snl_shaper_t *shp = skt->shaper;
+   unsigned int i;
+
+   for (i=0; i<shp->count[SNL_RATE_RECEIVE]; i++) {
+      snl_bucket_take(shp->bucket[SNL_RATE_RECEIVE][i], len);
+   }
+}
@@ -0,0 +1,58 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef _SNL_SHAPER_H_
+#define _SNL_SHAPER_H_
+
+#include <pthread.h>
+
+#include "snl.h"
+
+#define SHAPER_BUCKETS 4         // buckets per direction of a socket
+#define SHAPER_SLICE   10000     // us, longest pause of the worker at once
+
+struct snl_bucket_t {
+   pthread_mutex_t mutex;
+   int refcount;                  // owner and every socket using it
+   int unit;                      // SNL_RATE_BYTES or SNL_RATE_MESSAGES
+   unsigned int rate;             // tokens per second
+   unsigned int burst;            // most tokens saved up
+   long long tokens;              // in millionths, below 0 while in debt
+   long long stamp;               // us, monotonic, last refill
+};
+
+typedef struct snl_shaper_t {
+   snl_bucket_t *bucket[2][SHAPER_BUCKETS]; // by SNL_RATE_SEND/_RECEIVE
+   unsigned int count[2];
+} snl_shaper_t;
+
+snl_bucket_t *snl_bucket_ref(snl_bucket_t *bkt);
+long long snl_bucket_debt(snl_bucket_t *bkt);
+void snl_bucket_take(snl_bucket_t *bkt, unsigned int len);
+
+snl_shaper_t *snl_shaper_new(void);
+void snl_shaper_delete(snl_shaper_t *shp);
+int snl_shaper_add(snl_shaper_t *shp, int direction, snl_bucket_t *bkt);
+void snl_shaper_clear(snl_shaper_t *shp, int direction);
+
+int snl_shaper_send(snl_socket_t *skt, unsigned int len, int timeout);
+void snl_shaper_pause(snl_socket_t *skt);
+void snl_shaper_charge(snl_socket_t *skt, unsigned int len);
+
+#endif // _SNL_SHAPER_H_
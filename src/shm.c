@@ -0,0 +1,434 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#define _GNU_SOURCE      // memfd_create()
+
+#include <errno.h>       // errno, EINTR, EAGAIN
+#include <string.h>      // memset(), memcpy()
+#include <stdlib.h>      // malloc(), free()
+#include <limits.h>      // INT_MAX
+#include <unistd.h>      // close(), read(), write(), ftruncate(), syscall()
+#include <time.h>        // clock_gettime()
+#include <poll.h>        // poll()
+#include <sys/mman.h>    // memfd_create(), mmap(), munmap()
+#include <sys/stat.h>    // fstat()
+#include <sys/socket.h>  // sendmsg(), recvmsg(), SCM_RIGHTS
+#include <sys/eventfd.h> // eventfd()
+#include <sys/syscall.h> // SYS_futex
+#include <linux/futex.h> // FUTEX_WAIT, FUTEX_WAKE
+
+#include "shm.h"
+
+#define SHM_WRAP   0xffffffff // record continues at ring start
+#define SHM_FDS    3          // memfd and two eventfds
+#define SHM_ALIGN(x) (((x) + 7) & ~7)
+
+#define RING_BYTES (sizeof (snl_ring_t) + (SHM_RING_SIZE))
+
+// futexes in shared memory must not be process private
+static void
+futex_wait(volatile unsigned int *addr, unsigned int val, int ms) {
+   struct timespec ts;
+
+   ts.tv_sec  = 0;
+   ts.tv_nsec = ms * 1000000;
+
+   syscall(SYS_futex, addr, FUTEX_WAIT, val, &ts, NULL, 0);
+}
+
+static void
+futex_wake(volatile unsigned int *addr) {
+   syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+static void
+wake_consumer(snl_ring_t *ring, int event) {
+   unsigned long long one = 1;
+
+   __sync_synchronize();
+
+   if (ring->sleeping) {
+      ring->sleeping = 0;
+      if (write(event, &one, sizeof (one))) {}
+   }
+}
+
+static void
+wake_producer(snl_ring_t *ring) {
+   __sync_synchronize();
+
+   if (ring->blocked) {
+      ring->blocked = 0;
+      futex_wake(&ring->tail);
+   }
+}
+
+static snl_shm_t *
+shm_map(int memfd, int evt, int evr, int offered) {
+   snl_ring_t *a, *b;
+   snl_shm_t *shm;
+   struct stat st;
+   void *base;
+
+   if (fstat(memfd, &st) || (st.st_size != 2 * RING_BYTES)) {
+      return (NULL);
+   }
+
+   base = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+   if (base == MAP_FAILED) {
+      return (NULL);
+   }
+
+   a = (snl_ring_t *)base;
+   b = (snl_ring_t *)((char *)base + RING_BYTES);
+
+   if (offered) {
+      a->size = b->size = SHM_RING_SIZE;
+   } else if ((a->size != (SHM_RING_SIZE)) || (b->size != (SHM_RING_SIZE))) {
+      munmap(base, st.st_size);
+      return (NULL);
+   }
+
+   if (!(shm = malloc(sizeof (snl_shm_t)))) {
+      munmap(base, st.st_size);
+      return (NULL);
+   }
+
+   memset(shm, 0, sizeof (snl_shm_t));
+   shm->base   = base;
+   shm->length = st.st_size;
+
+   // the connecting side writes to ring a, the accepting side to ring b
+   shm->tx = offered ? a : b;
+   shm->rx = offered ? b : a;
+   shm->tx_event = evt;
+   shm->rx_event = evr;
+
+   pthread_mutex_init(&shm->mutex, NULL);
+
+   return (shm);
+}
+
+snl_shm_t *
+snl_shm_offer(int fd) {
+   int fds[SHM_FDS] = { -1, -1, -1 };
+   char control[CMSG_SPACE(sizeof (fds))];
+   snl_shm_t *shm = NULL;
+   struct cmsghdr *cm;
+   struct msghdr msg;
+   struct iovec iov;
+   char dummy = 0;
+   int i;
+
+   if ((fds[0] = memfd_create("snl", MFD_CLOEXEC)) < 0) goto cleanup;
+   if (ftruncate(fds[0], 2 * RING_BYTES)) goto cleanup;
+
+   // fds[1] wakes the accepting side, fds[2] the connecting side
+   if ((fds[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) goto cleanup;
+   if ((fds[2] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) goto cleanup;
+
+   if (!(shm = shm_map(fds[0], fds[1], fds[2], 1))) goto cleanup;
+
+   iov.iov_base = &dummy;
+   iov.iov_len  = 1;
+
+   memset(&msg, 0, sizeof (msg));
+   msg.msg_iov        = &iov;
+   msg.msg_iovlen     = 1;
+   msg.msg_control    = control;
+   msg.msg_controllen = sizeof (control);
+
+   cm = CMSG_FIRSTHDR(&msg);
+   cm->cmsg_level = SOL_SOCKET;
+   cm->cmsg_type  = SCM_RIGHTS;
+   cm->cmsg_len   = CMSG_LEN(sizeof (fds));
+   memcpy(CMSG_DATA(cm), fds, sizeof (fds));
+
+   if (sendmsg(fd, &msg, MSG_NOSIGNAL) != 1) {
+      snl_shm_delete(shm);
+      shm = NULL;
+      fds[1] = fds[2] = -1;
+   }
+
+cleanup:
+
+   // the mapping keeps the memory alive
+   if (fds[0] >= 0) close(fds[0]);
+
+   if (!shm) {
+      for (i=1; i<SHM_FDS; i++) {
+         if (fds[i] >= 0) close(fds[i]);
+      }
+   }
+
+   return (shm);
+}
+
+snl_shm_t *
+snl_shm_accept(int fd, int timeout) {
+   char control[CMSG_SPACE(SHM_FDS * sizeof (int))];
+   int fds[SHM_FDS] = { -1, -1, -1 };
+   snl_shm_t *shm = NULL;
+   struct cmsghdr *cm;
+   struct pollfd pfd;
+   struct msghdr msg;
+   struct iovec iov;
+   char dummy;
+   int i;
+
+   pfd.fd = fd;
+   pfd.events = POLLIN;
+
+   // the connecting side sends the rings right after connect()
+   if (poll(&pfd, 1, timeout * 1000) <= 0) {
+      return (NULL);
+   }
+
+   iov.iov_base = &dummy;
+   iov.iov_len  = 1;
+
+   memset(&msg, 0, sizeof (msg));
+   msg.msg_iov        = &iov;
+   msg.msg_iovlen     = 1;
+   msg.msg_control    = control;
+   msg.msg_controllen = sizeof (control);
+
+   if (recvmsg(fd, &msg, MSG_CMSG_CLOEXEC) != 1) {
+      return (NULL);
+   }
+
+   for (cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+      if ((cm->cmsg_level == SOL_SOCKET) && (cm->cmsg_type == SCM_RIGHTS) &&
+          (cm->cmsg_len == CMSG_LEN(sizeof (fds)))) {
+         memcpy(fds, CMSG_DATA(cm), sizeof (fds));
+      }
+   }
+
+   if ((fds[0] >= 0) && !(msg.msg_flags & MSG_CTRUNC)) {
+      shm = shm_map(fds[0], fds[2], fds[1], 0);
+   }
+
+   if (fds[0] >= 0) close(fds[0]);
+
+   if (!shm) {
+      for (i=1; i<SHM_FDS; i++) {
+         if (fds[i] >= 0) close(fds[i]);
+      }
+   }
+
+   return (shm);
+}
+
+void
+snl_shm_close(snl_shm_t *shm) {
+   if (!shm) return;
+
+   shm->tx->closed = 1;
+   shm->rx->closed = 1;
+
+   // nobody should wait for us anymore
+   wake_consumer(shm->tx, shm->tx_event);
+   futex_wake(&shm->rx->tail);
+   futex_wake(&shm->tx->tail);
+}
+
+void
+snl_shm_delete(snl_shm_t *shm) {
+   if (!shm) return;
+
+   munmap(shm->base, shm->length);
+
+   close(shm->tx_event);
+   close(shm->rx_event);
+
+   pthread_mutex_destroy(&shm->mutex);
+
+   free(shm);
+}
+
+int
+snl_shm_send(snl_socket_t *skt, const void *buf, unsigned int len, int timeout) {
+   snl_shm_t *shm = skt->shm;
+   snl_ring_t *ring = shm->tx;
+   unsigned int head, tail, pos, skip, need, length, pad = 0;
+   int error = SNL_ERROR_OK;
+   unsigned char *rec;
+   struct timespec ts;
+   time_t deadline;
+
+   if (skt->cipher) pad = 8 - (len % 8);
+
+   length = len + pad;
+   need = SHM_RECORD_SIZE + SHM_ALIGN(length);
+
+   // keep records small enough to never deadlock on wrap around
+   if (need > ring->size / 2) {
+      return (SNL_ERROR_SEND);
+   }
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   deadline = ts.tv_sec + timeout;
+
+   pthread_mutex_lock(&shm->mutex);
+
+   for (;;) {
+      if (ring->closed) {
+         error = SNL_ERROR_CLOSED;
+         goto cleanup;
+      }
+
+      head = ring->head;
+      tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+      pos  = head & (ring->size - 1);
+      skip = (ring->size - pos < need) ? ring->size - pos : 0;
+
+      if (ring->size - (head - tail) >= need + skip) break;
+
+      // ring full, sleep until the consumer moves the tail
+      ring->blocked = 1;
+      __sync_synchronize();
+
+      if (ring->tail == tail) futex_wait(&ring->tail, tail, 10);
+
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      if (ts.tv_sec >= deadline) {
+         error = SNL_ERROR_TIMEOUT;
+         goto cleanup;
+      }
+   }
+
+   if (skip) {
+      memcpy(ring->data + pos, &(unsigned int){ SHM_WRAP }, sizeof (unsigned int));
+      head += skip;
+      pos = 0;
+   }
+
+   rec = ring->data + pos;
+
+   // written exactly once, the consumer reads it in place
+   memcpy(rec + SHM_RECORD_SIZE, buf, len);
+
+   if (skt->cipher) {
+      memset(rec + SHM_RECORD_SIZE + len, pad, pad);
+
+      if (bf_encrypt(skt->cipher, rec + SHM_RECORD_SIZE, length)) {
+         error = SNL_ERROR_CIPHER;
+         goto cleanup;
+      }
+   }
+
+   memcpy(rec, &length, sizeof (length));
+
+   __atomic_store_n(&ring->head, head + need, __ATOMIC_RELEASE);
+
+   wake_consumer(ring, shm->tx_event);
+
+   __sync_fetch_and_add(&skt->xfer_sent, length);
+
+cleanup:
+
+   pthread_mutex_unlock(&shm->mutex);
+
+   return (error);
+}
+
+int
+snl_shm_receive(snl_socket_t *skt, snl_shm_deliver_t deliver) {
+   snl_ring_t *ring = skt->shm->rx;
+   unsigned int head, tail, pos, length;
+
+   while (!skt->worker_stop) {
+      tail = ring->tail;
+      head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+      if (head == tail) break;
+
+      pos = tail & (ring->size - 1);
+      memcpy(&length, ring->data + pos, sizeof (length));
+
+      if (length == SHM_WRAP) {
+         __atomic_store_n(&ring->tail, tail + ring->size - pos, __ATOMIC_RELEASE);
+         continue;
+      }
+
+      // do not trust the other process
+      if (SHM_RECORD_SIZE + SHM_ALIGN(length) > ring->size - pos) {
+         return (SNL_ERROR_RECEIVE);
+      }
+
+      deliver(skt, ring->data + pos + SHM_RECORD_SIZE, length);
+
+      __atomic_store_n(&ring->tail, tail + SHM_RECORD_SIZE + SHM_ALIGN(length), __ATOMIC_RELEASE);
+
+      wake_producer(ring);
+   }
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_shm_wait(snl_socket_t *skt, int timeout) {
+   snl_shm_t *shm = skt->shm;
+   snl_ring_t *ring = shm->rx;
+   unsigned long long count;
+   struct pollfd pfd[2];
+   int received;
+   char dummy;
+
+   ring->sleeping = 1;
+   __sync_synchronize();
+
+   // a record arrived while we were about to sleep
+   if (ring->head != ring->tail) {
+      ring->sleeping = 0;
+      return (SNL_ERROR_OK);
+   }
+
+   pfd[0].fd = shm->rx_event;
+   pfd[0].events = POLLIN;
+   pfd[1].fd = skt->file_descriptor;
+   pfd[1].events = POLLIN;
+
+   if (poll(pfd, 2, timeout) < 0) {
+      ring->sleeping = 0;
+      return ((errno == EINTR) ? SNL_ERROR_OK : SNL_ERROR_RECEIVE);
+   }
+
+   ring->sleeping = 0;
+
+   if (pfd[0].revents & POLLIN) {
+      if (read(shm->rx_event, &count, sizeof (count))) {}
+   }
+
+   // the socket only carries the end of the connection
+   if (pfd[1].revents) {
+      received = recv(skt->file_descriptor, &dummy, 1, MSG_DONTWAIT);
+
+      if (!received || ((received < 0) && (errno != EAGAIN) && (errno != EINTR))) {
+         return (SNL_ERROR_CLOSED);
+      }
+   }
+
+   if (ring->closed && (ring->head == ring->tail)) {
+      return (SNL_ERROR_CLOSED);
+   }
+
+   return (SNL_ERROR_OK);
+}
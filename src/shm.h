@@ -0,0 +1,65 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef _SNL_SHM_H_
+#define _SNL_SHM_H_
+
+#include <pthread.h>
+
+#include "snl.h"
+
+#define SHM_RING_SIZE    1<<22      // 4MB per direction, power of 2
+#define SHM_RECORD_SIZE  8          // length + reserved, keeps payload aligned
+
+// single producer single consumer ring, lives in shared memory
+typedef struct snl_ring_t {
+   volatile unsigned int head;    // bytes ever written, producer only
+   unsigned char pad1[60];
+   volatile unsigned int tail;    // bytes ever read, consumer only
+   unsigned char pad2[60];
+   volatile int sleeping;         // consumer waits for the eventfd
+   volatile int blocked;          // producer waits for the tail futex
+   volatile int closed;
+   unsigned int size;
+   unsigned char pad3[48];
+   unsigned char data[];
+} snl_ring_t;
+
+typedef struct snl_shm_t {
+   void *base;                    // mapping of both rings
+   unsigned int length;
+   snl_ring_t *tx, *rx;
+   int tx_event, rx_event;        // eventfds waking the consumer
+   pthread_mutex_t mutex;         // serializes local producers
+   int lent;                      // data buffer points into the ring
+   void *spare;                   // receive buffer while delivering
+} snl_shm_t;
+
+typedef void (*snl_shm_deliver_t)(snl_socket_t *skt, void *buf, unsigned int len);
+
+snl_shm_t *snl_shm_offer(int fd);
+snl_shm_t *snl_shm_accept(int fd, int timeout);
+void snl_shm_close(snl_shm_t *shm);
+void snl_shm_delete(snl_shm_t *shm);
+
+int snl_shm_send(snl_socket_t *skt, const void *buf, unsigned int len, int timeout);
+int snl_shm_receive(snl_socket_t *skt, snl_shm_deliver_t deliver);
+int snl_shm_wait(snl_socket_t *skt, int timeout);
+
+#endif // _SNL_SHM_H_
@@ -17,31 +17,70 @@
    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 */
 
+#define _GNU_SOURCE      // recvmmsg()
+
 #include <errno.h>       // errno, EINTR
 #include <fcntl.h>       // F_GETFL, F_SETFL, fcntl()
+#include <stdio.h>       // snprintf()
+#include <stddef.h>      // offsetof()
+#include <poll.h>        // poll(), ppoll()
 #include <unistd.h>      // close(), read(), write(), usleep()
 #include <string.h>      // memset(), memcpy(), strlen()
 #include <signal.h>      // signal(), SIG_IGN, SIGPIPE
 #include <stdlib.h>      // malloc(), free()
 #include <pthread.h>     // pthread_*()
 #include <sys/socket.h>  // socket(), bind(), listen(), accept(), shutdown()
+#include <sys/sendfile.h> // sendfile()
+#include <sys/mman.h>    // mmap(), munmap()
+#include <sys/stat.h>    // fstat()
+#include <sys/prctl.h>   // prctl()
+#include <sys/un.h>      // struct sockaddr_un
+#include <net/if.h>      // if_nametoindex()
 #include <netdb.h>       // gethostbyname()
 #include <netinet/tcp.h> // TCP_NODELAY
+#include <netinet/udp.h> // UDP_GRO
 #include <netinet/in.h>  // struct sockaddr_in
 #include <arpa/inet.h>   // htons(), htonl(), ntohl()
 
+#include "admission.h"
 #include "blowfish.h"
+#include "codec.h"
+#include "compress.h"
+#include "crc.h"
+#include "credit.h"
+#include "delimit.h"
+#include "rpc.h"
+#include "mux.h"
+#include "fragment.h"
+#include "framing.h"
+#include "loop.h"
+#include "relay.h"
+#include "rudp.h"
+#include "sender.h"
+#include "shaper.h"
+#include "shm.h"
 #include "snl.h"
+#include "timer.h"
+#include "zerocopy.h"
 
 #define SA struct sockaddr
 
 #define INITIAL_PAYLOAD_SIZE 1<<12 //  4KB
 #define PACKED_PAYLOAD_SIZE  1<<10 //  1KB
-#define UDP_PAYLOAD_SIZE     1<<16 // 64KB
+#define RECV_BATCH_MAX       32    // max datagrams per recvmmsg()
+#define LOCAL_SNDBUF         1<<22 //  4MB, max local message size
+#define FILE_WINDOW_SIZE     1<<20 //  1MB of a file encrypted at once
+#define MULTICAST_GROUPS     20    // groups joined before snl_listen()
+
+// multicast memberships requested before the socket is bound
+struct multicast_groups {
+   unsigned int count;
+   struct ip_mreqn mreq[MULTICAST_GROUPS];
+};
 
 static int send_timeout       = 3; // socket write timeout in seconds
 static int connect_timeout    = 5; // connect timeout in seconds
-static int connection_backlog = 3; // max queue length for pending connections
+static int connection_backlog = SOMAXCONN; // max queue length for pending connections
 
 static pthread_attr_t thread_attr;
 
@@ -50,12 +89,45 @@ static void *worker_thread(void *arg);
 static unsigned char *encrypt(blowfish_t *bf, const void *buffer, unsigned int *len);
 static unsigned char *decrypt(blowfish_t *bf, void *buffer, unsigned int *len);
 
+static int send_payload(snl_socket_t *skt, const void *buf, unsigned int len);
+static int write_header(snl_socket_t *skt, unsigned int len);
+static int send_queued(snl_socket_t *skt, const void *buf, unsigned int len);
+static snl_frame_t *queued_frame(snl_socket_t *skt, const void *buf, unsigned int len);
+static int send_zerocopy(snl_socket_t *skt, const void *buf, unsigned int len);
+static void sent_zerocopy(snl_socket_t *skt, const void *buf, unsigned int len);
+static int wait_readable(snl_socket_t *skt);
+static int send_heartbeat(snl_socket_t *skt);
+static void write_timeout(snl_socket_t *skt, struct timeval *sto);
+static int send_file_plain(int sock, int fd, off_t offset, unsigned int len);
+static int send_file_encrypted(snl_socket_t *skt, int fd, off_t offset, unsigned int len);
+static void receive_datagram(snl_socket_t *skt, unsigned int length);
+static void receive_fragments(snl_socket_t *skt, struct msghdr *msg, unsigned int length);
+static void receive_reliable(snl_socket_t *skt, const unsigned char *buf, unsigned int len, unsigned int stream);
+static int reliable_state(snl_socket_t *skt);
+static void receive_shared(snl_socket_t *skt, void *buf, unsigned int len);
+static void receive_loop(snl_socket_t *skt, snl_frame_t *frame);
+static void receive_packed(snl_socket_t *skt, unsigned int length);
+static void decode_message(snl_socket_t *skt);
+static void receive_records(snl_socket_t *skt);
+static unsigned int codec_tail(snl_socket_t *skt);
+static void restore_message(snl_socket_t *skt);
+static int send_message(snl_socket_t *skt, const void *buf, unsigned int len);
+static int transmit(snl_socket_t *skt, const void *buf, unsigned int len);
+static int send_rpc(snl_socket_t *skt, int type, unsigned int id, const void *buf, unsigned int len);
+static int connect_local(snl_socket_t *skt, unsigned short port);
+static socklen_t local_address(struct sockaddr_un *addr, int proto, unsigned short port);
+static int local_type(int proto);
+static void socket_free(snl_socket_t *skt);
+
 enum {
    WORKER_THREAD_UNKNOWN,
    WORKER_THREAD_IDLE,
    WORKER_THREAD_READ,
    WORKER_THREAD_RECEIVE,
-   WORKER_THREAD_LISTEN
+   WORKER_THREAD_LISTEN,
+   WORKER_THREAD_RELIABLE,
+   WORKER_THREAD_SHARED,
+   WORKER_THREAD_LOOP
 };
 
 snl_socket_t *
@@ -97,10 +169,11 @@ snl_socket_delete(snl_socket_t *skt) {
       // calling socket destructor from within worker,
       // detaching thread and committing suicide
 
-      free(skt->data_buffer);
-      free(skt);
+      // the socket is gone after socket_free()
+      pthread_detach(pthread_self());
+
+      socket_free(skt);
 
-      pthread_detach(skt->worker_tid);
       pthread_exit(NULL); // WILL NOT RETURN
    } else {
       // destructor was not called from thread callback,
@@ -110,8 +183,7 @@ snl_socket_delete(snl_socket_t *skt) {
          usleep(5000); // 5 ms
       }
 
-      free(skt->data_buffer);
-      free(skt);
+      socket_free(skt);
    }
 
    return (SNL_ERROR_OK);
@@ -119,22 +191,43 @@ snl_socket_delete(snl_socket_t *skt) {
 
 int
 snl_accept(snl_socket_t *skt) {
-   int fd, flg = 1, cnt = 1, ivl = 3, lng = 10;
+   int error, fd, flg = 1, cnt = 1, ivl = 3, lng = 10, buf = LOCAL_SNDBUF, low = MUX_LOWAT;
+   socklen_t len = sizeof (struct sockaddr_un);
+   struct sockaddr_un name;
    struct timeval sto;
 
-   // hardcode send timeout
-   sto.tv_sec  = send_timeout;
-   sto.tv_usec = 0;
+   // set send timeout
+   write_timeout(skt, &sto);
 
    // socket already in use
    if (skt->worker_type != WORKER_THREAD_UNKNOWN) {
       return (SNL_ERROR_BUSY);
    }
 
+   // counts against the limit of its listener from now on
+   snl_admission_claim(skt);
+
+   // claims the link behind client_fd
+   if (skt->protocol == SNL_PROTO_LOOP) {
+      if ((error = snl_loop_attach(skt))) return (error);
+
+      skt->worker_type = WORKER_THREAD_LOOP;
+
+      return (SNL_ERROR_OK);
+   }
+
    fd = skt->file_descriptor;
 
-   // set all kinds of fancy socket options
-   if ((skt->protocol == SNL_PROTO_MSG) || (skt->protocol == SNL_PROTO_TCP)) {
+   // accepted from a local listener
+   if (!getsockname(fd, (SA *)&name, &len) && (name.sun_family == AF_UNIX)) {
+      skt->local = (skt->protocol != SNL_PROTO_SHM);
+   }
+
+   if (skt->local) {
+      setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &sto, sizeof (sto));
+      setsockopt(fd, SOL_SOCKET, SO_SNDBUF,   &buf, sizeof (buf));
+   } else if ((skt->protocol == SNL_PROTO_MSG) || (skt->protocol == SNL_PROTO_TCP)) {
+      // set all kinds of fancy socket options
       setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO,   &sto, sizeof (sto));
       setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE,  &flg, sizeof (flg));
       setsockopt(fd, SOL_TCP,    TCP_KEEPCNT,   &cnt, sizeof (cnt));
@@ -144,6 +237,37 @@ snl_accept(snl_socket_t *skt) {
       setsockopt(fd, SOL_TCP,    TCP_LINGER2,   &lng, sizeof (lng));
    }
 
+   // unsent bytes in the kernel would queue up ahead of the scheduler
+   if (skt->mux) setsockopt(fd, SOL_TCP, TCP_NOTSENT_LOWAT, &low, sizeof (low));
+
+   if (skt->sender) skt->sender->error = SNL_ERROR_OK;
+
+   if (skt->protocol == SNL_PROTO_RUDP) {
+      if (reliable_state(skt)) return (SNL_ERROR_BUFFER);
+
+      skt->worker_type = WORKER_THREAD_RELIABLE;
+
+      return (SNL_ERROR_OK);
+   }
+
+   if (skt->protocol == SNL_PROTO_SHM) {
+      // the connecting side passes its rings over the new connection
+      snl_shm_delete(skt->shm);
+
+      if (!(skt->shm = snl_shm_accept(fd, connect_timeout))) {
+         return (SNL_ERROR_ACCEPT);
+      }
+
+      skt->worker_type = WORKER_THREAD_SHARED;
+
+      return (SNL_ERROR_OK);
+   }
+
+   // agree on the frame header before the first message
+   if (skt->framing && !skt->local) {
+      if ((error = snl_framing_hello(skt->framing, fd, connect_timeout, 1))) return (error);
+   }
+
    skt->worker_type = WORKER_THREAD_READ;
 
    return (SNL_ERROR_OK);
@@ -151,268 +275,1479 @@ snl_accept(snl_socket_t *skt) {
 
 int
 snl_send(snl_socket_t *skt, const void *buf, unsigned int len) {
+   // the receiver expects the correlation header on every message
+   if (skt->rpc) {
+      return (send_rpc(skt, RPC_MESSAGE, 0, buf, len));
+   }
+
+   // or a chunk header, the default channel
+   if (skt->mux) {
+      return (snl_mux_send(skt, 0, buf, len, send_message));
+   }
+
+   return (send_message(skt, buf, len));
+}
+
+static int
+send_message(snl_socket_t *skt, const void *buf, unsigned int len) {
+   int error;
+
+   // no faster than its buckets allow
+   if (skt->shaper && (error = snl_shaper_send(skt, len, send_timeout))) {
+      return (error);
+   }
+
+   // waits until the receiver has room for it
+   if (skt->credit) {
+      return (snl_credit_send(skt, buf, len, send_timeout, transmit));
+   }
+
+   return (transmit(skt, buf, len));
+}
+
+static int
+transmit(snl_socket_t *skt, const void *buf, unsigned int len) {
+   int error;
+   void *packed;
+
+   // sequenced, acknowledged and retransmitted by the worker
+   if (skt->protocol == SNL_PROTO_RUDP) {
+      if (!skt->rudp) return (SNL_ERROR_SEND);
+
+      return (snl_rudp_send(skt, 0, buf, len, send_timeout));
+   }
+
+   // written straight into the peer's ring
+   if (skt->protocol == SNL_PROTO_SHM) {
+      if (!skt->shm) return (SNL_ERROR_SEND);
+
+      return (snl_shm_send(skt, buf, len, send_timeout));
+   }
+
+   // handed over to the peer socket of this process
+   if (skt->protocol == SNL_PROTO_LOOP) {
+      return (snl_loop_send(skt, buf, len, send_timeout));
+   }
+
+   // compression and custom stages, the cipher sees their result
+   if (skt->codecs) {
+      if ((error = snl_codecs_encode(skt->codecs, buf, &len, &packed))) {
+         return (error);
+      }
+
+      error = send_payload(skt, packed, len);
+
+      free(packed);
+
+      return (error);
+   }
+
+   return (send_payload(skt, buf, len));
+}
+
+int
+snl_send_file(snl_socket_t *skt, int fd, off_t offset, unsigned int len) {
+   unsigned int pad = 0;
    int error = SNL_ERROR_OK;
-   unsigned int length;
    int on = 1, off = 0;
+   struct stat st;
+   size_t delta;
+   char *map;
 
-   // add padding bytes and encrypt
-   if (skt->cipher && !(buf = encrypt(skt->cipher, buf, &len))) {
-      return (SNL_ERROR_CIPHER);
+   // the length goes out first, the file must hold all of it
+   if (fstat(fd, &st) || (offset < 0) || (offset + len > st.st_size)) {
+      return (SNL_ERROR_FILE);
    }
 
-   if (skt->protocol == SNL_PROTO_UDP) {
-      // check for packet size overflow
-      if (len > UDP_PAYLOAD_SIZE) {
-         return (SNL_ERROR_SEND);
-      }
+   // everything but a plain stream needs the whole message in memory
+   if (((skt->protocol != SNL_PROTO_MSG) && (skt->protocol != SNL_PROTO_TCP)) ||
+       SNL_DATAGRAMS(skt) || skt->sender || skt->codecs || skt->shaper || skt->credit || skt->rpc ||
+       skt->mux) {
+      if (!len) return (snl_send(skt, "", 0));
 
-      if (send(skt->file_descriptor, buf, len, 0) != (int)len) {
-         error = SNL_ERROR_SEND;
-      } else {
-         // update stats
-         skt->xfer_sent += len;
+      delta = offset % sysconf(_SC_PAGESIZE);
+
+      map = mmap(NULL, len + delta, PROT_READ, MAP_PRIVATE, fd, offset - delta);
+      if (map == MAP_FAILED) {
+         return (SNL_ERROR_FILE);
       }
 
-      // free the blowfish buffer
-      if (skt->cipher) free((void *)buf);
+      error = snl_send(skt, map + delta, len);
+
+      munmap(map, len + delta);
 
       return (error);
    }
 
-   // save real packet length
-   length = len;
+   if (skt->cipher) pad = 8 - (len % 8);
 
-   // convert packet length to network byte order
-   len = htonl(len);
+   // the frame length has to fit the header
+   if (len + pad < len) {
+      return (SNL_ERROR_SEND);
+   }
 
    // disable sending of partial frames
    setsockopt(skt->file_descriptor, SOL_TCP, TCP_CORK, &on, sizeof (on));
 
-   if (skt->protocol != SNL_PROTO_TCP) {
-      // send packet header
-      if (snl_write(skt->file_descriptor, &len, sizeof (len))) {
-         error = SNL_ERROR_CLOSED;
-         goto cleanup;
-      }
+   // send packet header
+   if ((error = write_header(skt, len + pad))) {
+      goto cleanup;
    }
 
-   // send packet payload
-   if (snl_write(skt->file_descriptor, buf, length)) {
-      error = SNL_ERROR_CLOSED;
-      goto cleanup;
+   if (skt->cipher) {
+      error = send_file_encrypted(skt, fd, offset, len);
+   } else {
+      error = send_file_plain(skt->file_descriptor, fd, offset, len);
    }
 
    // update stats
-   skt->xfer_sent += length;
+   if (!error) __sync_fetch_and_add(&skt->xfer_sent, len + pad);
 
 cleanup:
 
    // flush send buffer
    setsockopt(skt->file_descriptor, SOL_TCP, TCP_CORK, &off, sizeof (off));
 
-   // free the blowfish buffer
-   if (skt->cipher) free((void *)buf);
-
    return (error);
 }
 
 int
-snl_write(int fd, const void *buf, unsigned int len) {
-   unsigned int remaining = len;
-   char *ptr = (char *)buf;
-	int written;
-
-   while (remaining) {
-      if ((written = write(fd, ptr, remaining)) == -1) {
-         if (errno == EINTR) continue;
-         return (SNL_ERROR_SEND);
-      }
-
-      ptr += written;
-      remaining -= written;
+snl_send_priority(snl_socket_t *skt, const void *buf, unsigned int len, int priority, unsigned int ttl) {
+   void *packed = NULL;
+   snl_frame_t *frame;
+   int error, lowat = SEND_LOWAT;
+   struct timespec ts;
+
+   if ((priority < SNL_PRIORITY_HIGH) || (priority > SNL_PRIORITY_LOW)) {
+      return (SNL_ERROR_OPTION);
    }
 
-   return (SNL_ERROR_OK);
-}
-
-int
-snl_passphrase(snl_socket_t *skt, char *key) {
-   // destroy old blowfish context
-   free(skt->cipher);
-   skt->cipher = NULL;
-
-   if (key) {
-      // create new blowfish context
-      skt->cipher = malloc(sizeof (blowfish_t));
-      bf_init(skt->cipher, key, strlen(key));
+   // only the queue of the thread safe mode holds messages back
+   if (!skt->sender) {
+      return (SNL_ERROR_OPTION);
    }
 
-   return (SNL_ERROR_OK);
-}
-
-int
-snl_listen(snl_socket_t *skt, unsigned short port) {
-   int type = (skt->protocol == SNL_PROTO_UDP) ? SOCK_DGRAM : SOCK_STREAM;
-   int error = SNL_ERROR_OK, flg = 1, fd = -1;
-   struct sockaddr_in addr;
+   // those have send paths or message headers of their own
+   if ((skt->protocol == SNL_PROTO_RUDP) || (skt->protocol == SNL_PROTO_SHM) ||
+       (skt->protocol == SNL_PROTO_LOOP) || skt->fragment || skt->credit || skt->rpc || skt->mux) {
+      return (SNL_ERROR_PROTOCOL);
+   }
 
-   // socket already in use
-   if (skt->worker_type != WORKER_THREAD_UNKNOWN) {
-      return (SNL_ERROR_BUSY);
+   if ((skt->protocol == SNL_PROTO_UDP) && (len > UDP_PAYLOAD_SIZE)) {
+      return (SNL_ERROR_SEND);
    }
 
-   // sanity check
-   if (!port) {
-      return (SNL_ERROR_LISTEN);
+   // unsent bytes in the kernel would queue up ahead of the lanes
+   if (!skt->sender->lowat && !skt->local && (skt->protocol != SNL_PROTO_UDP)) {
+      setsockopt(skt->file_descriptor, SOL_TCP, TCP_NOTSENT_LOWAT, &lowat, sizeof (lowat));
+      skt->sender->lowat = 1;
    }
 
-   // open socket
-   if ((fd = socket(AF_INET, type, 0)) < 0) {
-      error = SNL_ERROR_OPEN;
-      goto cleanup;
+   if (skt->shaper && (error = snl_shaper_send(skt, len, send_timeout))) {
+      return (error);
    }
 
-   // set reuse address flag
-   if ((skt->protocol == SNL_PROTO_MSG) || (skt->protocol == SNL_PROTO_TCP)) {
-      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &flg, sizeof (flg));
+   if (skt->codecs && (error = snl_codecs_encode(skt->codecs, buf, &len, &packed))) {
+      return (error);
    }
 
-   // set non blocking
-   fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+   frame = queued_frame(skt, packed ? packed : buf, len);
 
-   // prepare socket address
-   memset(&addr, 0, sizeof (addr));
-   addr.sin_family = AF_INET;
-   addr.sin_port = htons((int)port);
-   addr.sin_addr.s_addr = htonl(INADDR_ANY);
+   free(packed);
 
-   // bind the socket
-   if (bind(fd, (SA *)&addr, sizeof (addr))) {
-      error = SNL_ERROR_BIND;
-      goto cleanup;
+   if (!frame) {
+      return (skt->cipher ? SNL_ERROR_CIPHER : SNL_ERROR_BUFFER);
    }
 
-   if ((skt->protocol == SNL_PROTO_MSG) || (skt->protocol == SNL_PROTO_TCP)) {
-      if (listen(fd, connection_backlog)) {
-         error = SNL_ERROR_LISTEN;
-         goto cleanup;
-      }
+   if (ttl) {
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      frame->deadline = (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000 + ttl * 1000LL;
    }
 
-cleanup:
+   return (snl_sender_send(skt, frame, priority, 0));
+}
 
-   if (error && (fd >= 0)) {
-      close(fd);
+unsigned int
+snl_send_expired(snl_socket_t *skt) {
+   return (skt->sender ? skt->sender->expired : 0);
+}
 
-      return (error);
+void *
+snl_message_new(unsigned int len) {
+   snl_frame_t *frame;
+
+   if (!(frame = snl_frame_new(len))) {
+      return (NULL);
    }
 
-   if (fd < 0) return (SNL_ERROR_LISTEN);
+   return (frame->data);
+}
 
-   skt->file_descriptor = fd;
+static snl_frame_t *
+message_frame(void *msg) {
+   return ((snl_frame_t *)((unsigned char *)msg - offsetof(snl_frame_t, data)));
+}
 
-   switch (skt->protocol) {
-      case SNL_PROTO_TCP:
-      case SNL_PROTO_MSG:
-         skt->worker_type = WORKER_THREAD_LISTEN;
-      break;
+void
+snl_message_free(void *msg) {
+   if (msg) snl_frame_unref(message_frame(msg));
+}
 
-      case SNL_PROTO_UDP:
-         skt->worker_type = WORKER_THREAD_RECEIVE;
-      break;
+int
+snl_send_message(snl_socket_t *skt, void *msg, unsigned int len) {
+   snl_frame_t *frame = message_frame(msg);
+   int error;
+
+   if (len > frame->length) {
+      snl_frame_unref(frame);
+      return (SNL_ERROR_LENGTH);
    }
 
-   return (SNL_ERROR_OK);
-}
+   // the peer in this process gets the buffer itself
+   if (skt->protocol == SNL_PROTO_LOOP) {
+      if (skt->shaper && (error = snl_shaper_send(skt, len, send_timeout))) {
+         snl_frame_unref(frame);
+         return (error);
+      }
 
-const char *
-snl_error_string(int error) {
-   switch (error) {
-      case SNL_ERROR_OK:         return ("no error");
-      case SNL_ERROR_OPEN:       return ("couldn't open socket");
-      case SNL_ERROR_CONNECT:    return ("connecting to remote socket failed");
-      case SNL_ERROR_LISTEN:     return ("error while listening on socket");
-      case SNL_ERROR_BIND:       return ("couldn't bind to socket");
-      case SNL_ERROR_ACCEPT:     return ("error while accepting connection");
-      case SNL_ERROR_RECEIVE:    return ("couldn't read from socket");
-      case SNL_ERROR_SEND:       return ("failed to send datagram");
-      case SNL_ERROR_CLOSED:     return ("peer closed connection");
-      case SNL_ERROR_BUFFER:     return ("out of memory");
-      case SNL_ERROR_ADDRESS:    return ("hostname resolution failed");
-      case SNL_ERROR_DISCONNECT: return ("error while closing socket");
-      case SNL_ERROR_PROTOCOL:   return ("protocol mismatch");
-      case SNL_ERROR_THREAD:     return ("could not start worker thread");
-      case SNL_ERROR_TIMEOUT:    return ("timeout error");
-      case SNL_ERROR_BUSY:       return ("socket already in use");
-      case SNL_ERROR_CIPHER:     return ("could not (de)cipher payload");
+      frame->length = len;
+
+      return (snl_loop_hand_over(skt, frame, send_timeout));
    }
 
-   return ("unknown error");
+   error = snl_send(skt, msg, len);
+   snl_frame_unref(frame);
+
+   return (error);
 }
 
 int
-snl_connect(snl_socket_t *skt, const char *host, unsigned short port) {
-   int type = (skt->protocol == SNL_PROTO_UDP) ? SOCK_DGRAM : SOCK_STREAM;
-   int fd, error = SNL_ERROR_OK, flg = 1, cnt = 1, ivl = 3;
-   socklen_t len = sizeof (struct timeval);
-   char addrstr[INET_ADDRSTRLEN];
-   struct hostent *hent = NULL;
-   struct timeval to, cto, sto;
-   struct sockaddr_in addr;
-   int broadcast = 0;
+snl_send_batch(snl_socket_t *skt, const void **bufs, const unsigned int *lens, unsigned int count) {
+   unsigned int *sizes = NULL, i;
+   int error = SNL_ERROR_OK;
+   void **packed = NULL;
+   snl_frame_t *frame;
 
-   // set connect timeout
-   cto.tv_sec  = connect_timeout;
-   cto.tv_usec = 0;
+   if (!count) {
+      return (SNL_ERROR_OK);
+   }
 
-   // set send timeout
-   sto.tv_sec  = send_timeout;
-   sto.tv_usec = 0;
+   // one frame per message without the compact header
+   if (!SNL_FRAMING_V2(skt) || skt->shaper || skt->credit || skt->rpc || skt->mux) {
+      for (i=0; i<count; i++) {
+         if ((error = snl_send(skt, bufs[i], lens[i]))) break;
+      }
 
-   // socket already in use
-   if (skt->worker_type != WORKER_THREAD_UNKNOWN) {
-      return (SNL_ERROR_BUSY);
+      return (error);
    }
 
-   // sanity check
-   if (!port) {
-      return (SNL_ERROR_CONNECT);
-   }
+   // every message on its own, the receiver decodes them one by one
+   if (skt->codecs) {
+      if (!(packed = calloc(count, sizeof (void *))) || !(sizes = malloc(count * sizeof (unsigned int)))) {
+         error = SNL_ERROR_BUFFER;
+         goto cleanup;
+      }
 
-   // check, if we should broadcast
-   if (!host) {
-      if (skt->protocol == SNL_PROTO_UDP) broadcast = 1;
-      if ((skt->protocol == SNL_PROTO_MSG) || (skt->protocol == SNL_PROTO_TCP)) {
-         return (SNL_ERROR_CONNECT);
+      for (i=0; i<count; i++) {
+         sizes[i] = lens[i];
+
+         if ((error = snl_codecs_encode(skt->codecs, bufs[i], &sizes[i], &packed[i]))) {
+            goto cleanup;
+         }
       }
+
+      bufs = (const void **)packed;
+      lens = sizes;
    }
 
-   // open socket
-   if ((fd = socket(AF_INET, type, 0)) < 0) {
-      error = SNL_ERROR_OPEN;
+   if (!(frame = snl_framing_pack(skt->cipher, bufs, lens, count))) {
+      error = skt->cipher ? SNL_ERROR_CIPHER : SNL_ERROR_BUFFER;
       goto cleanup;
    }
 
-   // set all kinds of fancy socket options
-   if ((skt->protocol == SNL_PROTO_MSG) || (skt->protocol == SNL_PROTO_TCP)) {
-      setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO,   &sto, sizeof (sto));
-      setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE,  &flg, sizeof (flg));
-      setsockopt(fd, SOL_TCP,    TCP_KEEPCNT,   &cnt, sizeof (cnt));
-      setsockopt(fd, SOL_TCP,    TCP_KEEPIDLE,  &ivl, sizeof (ivl));
-      setsockopt(fd, SOL_TCP,    TCP_KEEPINTVL, &ivl, sizeof (ivl));
-      setsockopt(fd, SOL_TCP,    TCP_NODELAY,   &flg, sizeof (flg));
+   if (skt->sender) {
+      error = snl_sender_send(skt, frame, SNL_PRIORITY_NORMAL, 0);
+      goto cleanup;
    }
 
-   if (broadcast) {
-      setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &flg, sizeof (flg));
+   if (snl_write(skt->file_descriptor, frame->data, frame->length)) {
+      error = SNL_ERROR_CLOSED;
+   } else {
+      // update stats
+      __sync_fetch_and_add(&skt->xfer_sent, frame->length - frame->header);
    }
 
-   // prepare socket address
-   memset(&addr, 0, sizeof (addr));
-   addr.sin_family = AF_INET;
-   addr.sin_port = htons((int)port);
+   snl_frame_unref(frame);
 
-   if (broadcast) {
+cleanup:
+
+   if (packed) {
+      for (i=0; i<count; i++) free(packed[i]);
+   }
+
+   free(packed);
+   free(sizes);
+
+   return (error);
+}
+
+int
+snl_send_stream(snl_socket_t *skt, unsigned int stream, const void *buf, unsigned int len) {
+   if (skt->protocol != SNL_PROTO_RUDP) {
+      return (snl_send(skt, buf, len));
+   }
+
+   if (!skt->rudp) return (SNL_ERROR_SEND);
+
+   return (snl_rudp_send(skt, stream, buf, len, send_timeout));
+}
+
+int
+snl_ordered(snl_socket_t *skt, int enable) {
+   if (skt->protocol != SNL_PROTO_RUDP) {
+      return (SNL_ERROR_PROTOCOL);
+   }
+
+   // socket already in use
+   if (skt->worker_type != WORKER_THREAD_UNKNOWN) {
+      return (SNL_ERROR_BUSY);
+   }
+
+   if (!skt->rudp && !(skt->rudp = snl_rudp_new())) {
+      return (SNL_ERROR_BUFFER);
+   }
+
+   skt->rudp->ordered = enable;
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_coalesce(snl_socket_t *skt, unsigned int budget, unsigned int threshold) {
+   int error;
+
+   // datagrams can not be merged
+   if (((skt->protocol != SNL_PROTO_MSG) && (skt->protocol != SNL_PROTO_TCP)) || skt->local) {
+      return (SNL_ERROR_PROTOCOL);
+   }
+
+   if (budget && !(skt->sender && skt->sender->budget)) {
+      // the worker must watch the deadline from the start
+      if (skt->worker_type != WORKER_THREAD_UNKNOWN) {
+         return (SNL_ERROR_BUSY);
+      }
+
+      // frames wait in the queue of the thread safe mode
+      if ((error = snl_threadsafe(skt, 1))) {
+         return (error);
+      }
+   }
+
+   if (!skt->sender) return (SNL_ERROR_OK);
+
+   if ((error = snl_sender_coalesce(skt->sender, budget, threshold ? threshold : COALESCE_BYTES))) {
+      return (error);
+   }
+
+   // nothing must be left behind without a deadline
+   if (!budget) return (snl_flush(skt));
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_flush(snl_socket_t *skt) {
+   if (!skt->sender) return (SNL_ERROR_OK);
+
+   return (snl_sender_flush(skt));
+}
+
+int
+snl_zerocopy(snl_socket_t *skt, unsigned int threshold) {
+   if ((skt->protocol != SNL_PROTO_MSG) && (skt->protocol != SNL_PROTO_TCP)) {
+      return (SNL_ERROR_PROTOCOL);
+   }
+
+   // unix domain sockets always copy
+   if (skt->local) {
+      return (SNL_ERROR_PROTOCOL);
+   }
+
+   if (!skt->zerocopy) {
+      if (!threshold) return (SNL_ERROR_OK);
+
+      // the worker must watch the error queue from the start
+      if (skt->worker_type != WORKER_THREAD_UNKNOWN) {
+         return (SNL_ERROR_BUSY);
+      }
+
+      if (!(skt->zerocopy = snl_zerocopy_new())) {
+         return (SNL_ERROR_BUFFER);
+      }
+   }
+
+   // kept after disabling, buffers in flight still get their event
+   skt->zerocopy->threshold = threshold;
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_framing(snl_socket_t *skt, unsigned int version) {
+   if (skt->protocol != SNL_PROTO_MSG) {
+      return (SNL_ERROR_PROTOCOL);
+   }
+
+   // unix domain sockets keep message boundaries, no header at all
+   if (skt->local) {
+      return (SNL_ERROR_PROTOCOL);
+   }
+
+   if ((version < 1) || (version > FRAMING_VERSION)) {
+      return (SNL_ERROR_OPTION);
+   }
+
+   // agreed on with the peer while connecting
+   if (skt->worker_type != WORKER_THREAD_UNKNOWN) {
+      return (SNL_ERROR_BUSY);
+   }
+
+   if (version == 1) {
+      free(skt->framing);
+      skt->framing = NULL;
+
+      return (SNL_ERROR_OK);
+   }
+
+   if (!skt->framing && !(skt->framing = calloc(1, sizeof (snl_framing_t)))) {
+      return (SNL_ERROR_BUFFER);
+   }
+
+   skt->framing->wanted = version;
+   skt->framing->version = 1;
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_compress(snl_socket_t *skt, unsigned int threshold) {
+   snl_codec_t codec;
+   int error;
+
+   if ((skt->protocol != SNL_PROTO_MSG) && (skt->protocol != SNL_PROTO_UDP)) {
+      return (SNL_ERROR_PROTOCOL);
+   }
+
+   if (!skt->compress == !threshold) {
+      // only the threshold changes, the peer does not notice
+      if (threshold) skt->compress->threshold = threshold;
+
+      return (SNL_ERROR_OK);
+   }
+
+   // every message carries a marker byte from the start
+   if (skt->worker_type != WORKER_THREAD_UNKNOWN) {
+      return (SNL_ERROR_BUSY);
+   }
+
+   if (!threshold) {
+      snl_codecs_remove(&skt->codecs, skt->compress);
+      snl_compress_delete(skt->compress);
+      skt->compress = NULL;
+
+      return (SNL_ERROR_OK);
+   }
+
+   if (!(skt->compress = snl_compress_new(threshold))) {
+      return (SNL_ERROR_BUFFER);
+   }
+
+   memset(&codec, 0, sizeof (codec));
+
+   codec.overhead = COMPRESS_OVERHEAD;
+   codec.encode   = snl_compress_encode;
+   codec.decode   = snl_compress_decode;
+   codec.state    = skt->compress;
+
+   // always the first stage, nothing compresses after encryption
+   if ((error = snl_codecs_insert(&skt->codecs, 0, &codec))) {
+      snl_compress_delete(skt->compress);
+      skt->compress = NULL;
+   }
+
+   return (error);
+}
+
+int
+snl_codec_add(snl_socket_t *skt, const snl_codec_t *codec) {
+   // the stream of raw TCP has no messages to transform
+   if ((skt->protocol != SNL_PROTO_MSG) && (skt->protocol != SNL_PROTO_UDP)) {
+      return (SNL_ERROR_PROTOCOL);
+   }
+
+   // the peer has to decode with the same stages from the start
+   if (skt->worker_type != WORKER_THREAD_UNKNOWN) {
+      return (SNL_ERROR_BUSY);
+   }
+
+   return (snl_codecs_insert(&skt->codecs, codec_tail(skt), codec));
+}
+
+int
+snl_delimiter(snl_socket_t *skt, const void *delim, unsigned int len, unsigned int max) {
+   if (skt->protocol != SNL_PROTO_TCP) {
+      return (SNL_ERROR_PROTOCOL);
+   }
+
+   // the worker scans with the delimiter, only it may change it once running
+   if ((skt->worker_type != WORKER_THREAD_UNKNOWN) && !pthread_equal(pthread_self(), skt->worker_tid)) {
+      return (SNL_ERROR_BUSY);
+   }
+
+   if (!len) {
+      // the worker hands out what is left, then drops the buffer
+      if (skt->delimit) skt->delimit->len = 0;
+
+      return (SNL_ERROR_OK);
+   }
+
+   if (!skt->delimit && !(skt->delimit = snl_delimit_new())) {
+      return (SNL_ERROR_BUFFER);
+   }
+
+   return (snl_delimit_set(skt->delimit, delim, len, max));
+}
+
+int
+snl_rpc(snl_socket_t *skt, int enable) {
+   if (skt->protocol != SNL_PROTO_MSG) {
+      return (SNL_ERROR_PROTOCOL);
+   }
+
+   // both peers have to agree on the header from the first message
+   if (skt->worker_type != WORKER_THREAD_UNKNOWN) {
+      return (SNL_ERROR_BUSY);
+   }
+
+   if (!enable) {
+      snl_rpc_delete(skt->rpc);
+      skt->rpc = NULL;
+
+      return (SNL_ERROR_OK);
+   }
+
+   // both would claim the first bytes of a message
+   if (skt->mux) {
+      return (SNL_ERROR_OPTION);
+   }
+
+   if (!skt->rpc && !(skt->rpc = snl_rpc_new())) {
+      return (SNL_ERROR_BUFFER);
+   }
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_rpc_call(snl_socket_t *skt, const void *buf, unsigned int len, unsigned int timeout, snl_rpc_callback_t cb, void *data) {
+   unsigned int id;
+   int error;
+
+   if (!skt->rpc || !cb) {
+      return (SNL_ERROR_OPTION);
+   }
+
+   // registered first, the reply may beat snl_send() returning
+   if (!(id = snl_rpc_register(skt->rpc, timeout, cb, data))) {
+      return (SNL_ERROR_BUFFER);
+   }
+
+   if ((error = send_rpc(skt, RPC_REQUEST, id, buf, len))) {
+      // unless the worker failed it already
+      if (!snl_rpc_forget(skt->rpc, id)) error = SNL_ERROR_OK;
+   }
+
+   return (error);
+}
+
+int
+snl_admission(snl_socket_t *skt, int backlog, unsigned int connections, snl_bucket_t *bkt) {
+   // only stream listeners queue up connections in the kernel
+   if ((skt->protocol == SNL_PROTO_UDP) || (skt->protocol == SNL_PROTO_RUDP) ||
+       (skt->protocol == SNL_PROTO_LOOP)) {
+      return (SNL_ERROR_PROTOCOL);
+   }
+
+   if (skt->worker_type != WORKER_THREAD_UNKNOWN) {
+      return (SNL_ERROR_BUSY);
+   }
+
+   if (backlog < 0) {
+      return (SNL_ERROR_OPTION);
+   }
+
+   snl_admission_unref(skt->admission);
+
+   if (!(skt->admission = snl_admission_new(backlog, connections, bkt))) {
+      return (SNL_ERROR_BUFFER);
+   }
+
+   return (SNL_ERROR_OK);
+}
+
+unsigned int
+snl_connections(snl_socket_t *skt) {
+   return (skt->admission ? skt->admission->live : 0);
+}
+
+unsigned int
+snl_refused(snl_socket_t *skt) {
+   return (skt->admission ? skt->admission->refused : 0);
+}
+
+int
+snl_rate_limit(snl_socket_t *skt, int direction, snl_bucket_t *bkt) {
+   int error;
+
+   if ((direction != SNL_RATE_SEND) && (direction != SNL_RATE_RECEIVE)) {
+      return (SNL_ERROR_OPTION);
+   }
+
+   // the other workers do not read in a loop that could pause
+   if ((direction == SNL_RATE_RECEIVE) && (skt->protocol != SNL_PROTO_MSG) &&
+       (skt->protocol != SNL_PROTO_TCP)) {
+      return (SNL_ERROR_PROTOCOL);
+   }
+
+   if (skt->worker_type != WORKER_THREAD_UNKNOWN) {
+      return (SNL_ERROR_BUSY);
+   }
+
+   if (!bkt) {
+      if (skt->shaper) snl_shaper_clear(skt->shaper, direction);
+
+      return (SNL_ERROR_OK);
+   }
+
+   if (!skt->shaper && !(skt->shaper = snl_shaper_new())) {
+      return (SNL_ERROR_BUFFER);
+   }
+
+   if ((error = snl_shaper_add(skt->shaper, direction, bkt))) {
+      return (error);
+   }
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_credit(snl_socket_t *skt, unsigned int messages, unsigned int bytes) {
+   int error;
+
+   if (skt->protocol != SNL_PROTO_MSG) {
+      return (SNL_ERROR_PROTOCOL);
+   }
+
+   // both peers have to agree on the header from the first message
+   if (skt->worker_type != WORKER_THREAD_UNKNOWN) {
+      return (SNL_ERROR_BUSY);
+   }
+
+   snl_credit_delete(skt->credit);
+   skt->credit = NULL;
+
+   if (!messages && !bytes) {
+      return (SNL_ERROR_OK);
+   }
+
+   // the worker writes grants while the application sends
+   if ((error = snl_threadsafe(skt, 1))) {
+      return (error);
+   }
+
+   if (!(skt->credit = snl_credit_new(messages, bytes))) {
+      return (SNL_ERROR_BUFFER);
+   }
+
+   return (SNL_ERROR_OK);
+}
+
+// the settings of both calls share one object, gone with the last of them
+static int
+timeout_settings(snl_socket_t *skt, unsigned int idle, unsigned int heartbeat, unsigned int read, unsigned int write) {
+   if (!idle && !heartbeat && !read && !write) {
+      snl_timeout_delete(skt->timeout);
+      skt->timeout = NULL;
+
+      return (SNL_ERROR_OK);
+   }
+
+   if (!skt->timeout && !(skt->timeout = snl_timeout_new(skt))) {
+      return (SNL_ERROR_BUFFER);
+   }
+
+   skt->timeout->idle      = idle;
+   skt->timeout->heartbeat = heartbeat;
+   skt->timeout->read      = read;
+   skt->timeout->write     = write;
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_timeout(snl_socket_t *skt, unsigned int idle, unsigned int heartbeat) {
+   snl_timeout_t *tmo = skt->timeout;
+   int error;
+
+   // only the stream worker waits for data with the timer wheel in mind
+   if ((skt->protocol != SNL_PROTO_MSG) && (skt->protocol != SNL_PROTO_TCP)) {
+      return (SNL_ERROR_PROTOCOL);
+   }
+
+   // an empty message needs message boundaries
+   if (heartbeat && (skt->protocol != SNL_PROTO_MSG)) {
+      return (SNL_ERROR_PROTOCOL);
+   }
+
+   if (skt->worker_type != WORKER_THREAD_UNKNOWN) {
+      return (SNL_ERROR_BUSY);
+   }
+
+   // the worker sends heartbeats while the application sends
+   if (heartbeat && (error = snl_threadsafe(skt, 1))) {
+      return (error);
+   }
+
+   return (timeout_settings(skt, idle, heartbeat, tmo ? tmo->read : 0, tmo ? tmo->write : 0));
+}
+
+int
+snl_deadline(snl_socket_t *skt, unsigned int read, unsigned int write) {
+   snl_timeout_t *tmo = skt->timeout;
+
+   if ((skt->protocol != SNL_PROTO_MSG) && (skt->protocol != SNL_PROTO_TCP)) {
+      return (SNL_ERROR_PROTOCOL);
+   }
+
+   // every read of raw streams is a message of its own
+   if (read && (skt->protocol != SNL_PROTO_MSG)) {
+      return (SNL_ERROR_PROTOCOL);
+   }
+
+   if (skt->worker_type != WORKER_THREAD_UNKNOWN) {
+      return (SNL_ERROR_BUSY);
+   }
+
+   return (timeout_settings(skt, tmo ? tmo->idle : 0, tmo ? tmo->heartbeat : 0, read, write));
+}
+
+int
+snl_multiplex(snl_socket_t *skt, int enable) {
+   if (skt->protocol != SNL_PROTO_MSG) {
+      return (SNL_ERROR_PROTOCOL);
+   }
+
+   if (skt->worker_type != WORKER_THREAD_UNKNOWN) {
+      return (SNL_ERROR_BUSY);
+   }
+
+   if (!enable) {
+      snl_mux_delete(skt->mux);
+      skt->mux = NULL;
+
+      return (SNL_ERROR_OK);
+   }
+
+   if (skt->rpc) {
+      return (SNL_ERROR_OPTION);
+   }
+
+   if (!skt->mux && !(skt->mux = snl_mux_new())) {
+      return (SNL_ERROR_BUFFER);
+   }
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_channel_weight(snl_socket_t *skt, unsigned int channel, unsigned int weight) {
+   if (!skt->mux) {
+      return (SNL_ERROR_OPTION);
+   }
+
+   return (snl_mux_weight(skt->mux, channel, weight));
+}
+
+int
+snl_channel_limit(snl_socket_t *skt, unsigned int max) {
+   if (!skt->mux) {
+      return (SNL_ERROR_OPTION);
+   }
+
+   return (snl_mux_limit(skt->mux, max));
+}
+
+int
+snl_channel_send(snl_socket_t *skt, unsigned int channel, const void *buf, unsigned int len) {
+   if (!skt->mux) {
+      return (SNL_ERROR_OPTION);
+   }
+
+   return (snl_mux_send(skt, channel, buf, len, send_message));
+}
+
+unsigned int
+snl_channel_id(snl_socket_t *skt) {
+   return (skt->mux ? skt->mux->current : 0);
+}
+
+unsigned int
+snl_rpc_id(snl_socket_t *skt) {
+   return (skt->rpc ? skt->rpc->current : 0);
+}
+
+int
+snl_rpc_reply(snl_socket_t *skt, unsigned int id, const void *buf, unsigned int len) {
+   if (!skt->rpc || !id) {
+      return (SNL_ERROR_OPTION);
+   }
+
+   return (send_rpc(skt, RPC_REPLY, id, buf, len));
+}
+
+int
+snl_checksum(snl_socket_t *skt, int enable) {
+   snl_codec_t codec;
+
+   if ((skt->protocol != SNL_PROTO_MSG) && (skt->protocol != SNL_PROTO_UDP)) {
+      return (SNL_ERROR_PROTOCOL);
+   }
+
+   if (skt->worker_type != WORKER_THREAD_UNKNOWN) {
+      return (SNL_ERROR_BUSY);
+   }
+
+   snl_crc_codec(&codec);
+
+   if (!enable) {
+      snl_codecs_remove(&skt->codecs, codec.state);
+      return (SNL_ERROR_OK);
+   }
+
+   if (skt->codecs && (codec_tail(skt) < skt->codecs->count)) {
+      return (SNL_ERROR_OK);
+   }
+
+   // covers what all other stages produced
+   return (snl_codecs_insert(&skt->codecs, CODEC_STAGES_MAX, &codec));
+}
+
+int
+snl_codec_clear(snl_socket_t *skt) {
+   if (skt->worker_type != WORKER_THREAD_UNKNOWN) {
+      return (SNL_ERROR_BUSY);
+   }
+
+   // compression is a stage too
+   snl_codecs_delete(skt->codecs);
+   snl_compress_delete(skt->compress);
+
+   skt->codecs = NULL;
+   skt->compress = NULL;
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_compress_dictionary(snl_socket_t *skt, const void *dict, unsigned int len) {
+   if (!skt->compress) {
+      return (SNL_ERROR_OPTION);
+   }
+
+   // senders read it without locking
+   if (skt->worker_type != WORKER_THREAD_UNKNOWN) {
+      return (SNL_ERROR_BUSY);
+   }
+
+   return (snl_compress_load(skt->compress, dict, len));
+}
+
+int
+snl_name(snl_socket_t *skt, const char *name) {
+   if (skt->protocol != SNL_PROTO_LOOP) {
+      return (SNL_ERROR_PROTOCOL);
+   }
+
+   // socket already in use
+   if (skt->worker_type != WORKER_THREAD_UNKNOWN) {
+      return (SNL_ERROR_BUSY);
+   }
+
+   return (snl_loop_name(skt, name));
+}
+
+int
+snl_local(snl_socket_t *skt, int enable) {
+   if ((skt->protocol != SNL_PROTO_MSG) && (skt->protocol != SNL_PROTO_TCP) && (skt->protocol != SNL_PROTO_UDP)) {
+      return (SNL_ERROR_PROTOCOL);
+   }
+
+   // socket already in use
+   if (skt->worker_type != WORKER_THREAD_UNKNOWN) {
+      return (SNL_ERROR_BUSY);
+   }
+
+   skt->local = enable;
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_relay(snl_socket_t *skt, snl_socket_t *peer) {
+   if ((skt->protocol != SNL_PROTO_MSG) && (skt->protocol != SNL_PROTO_TCP)) {
+      return (SNL_ERROR_PROTOCOL);
+   }
+
+   if (peer == skt) {
+      return (SNL_ERROR_OPTION);
+   }
+
+   if (!skt->relay) {
+      if (!peer) return (SNL_ERROR_OK);
+
+      if (!(skt->relay = snl_relay_new())) {
+         return (SNL_ERROR_BUFFER);
+      }
+   }
+
+   // waits for a frame currently in transit
+   pthread_mutex_lock(&skt->relay->mutex);
+   skt->relay->peer = peer;
+   pthread_mutex_unlock(&skt->relay->mutex);
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_write(int fd, const void *buf, unsigned int len) {
+   unsigned int remaining = len;
+   char *ptr = (char *)buf;
+	int written;
+
+   while (remaining) {
+      if ((written = write(fd, ptr, remaining)) == -1) {
+         if (errno == EINTR) continue;
+         return (SNL_ERROR_SEND);
+      }
+
+      ptr += written;
+      remaining -= written;
+   }
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_threadsafe(snl_socket_t *skt, int enable) {
+   if (enable && !skt->sender) {
+      if (!(skt->sender = snl_sender_new())) {
+         return (SNL_ERROR_BUFFER);
+      }
+   }
+
+   if (!enable && skt->sender) {
+      snl_sender_drain(skt, 0);
+      snl_sender_delete(skt->sender);
+      skt->sender = NULL;
+   }
+
+   return (SNL_ERROR_OK);
+}
+
+static int
+multicast_interface(const char *iface, struct ip_mreqn *mreq) {
+   if (!iface) return (SNL_ERROR_OK);
+
+   // either an interface address or an interface name
+   if (inet_pton(AF_INET, iface, &mreq->imr_address) == 1) {
+      return (SNL_ERROR_OK);
+   }
+
+   if ((mreq->imr_ifindex = if_nametoindex(iface))) {
+      return (SNL_ERROR_OK);
+   }
+
+   return (SNL_ERROR_ADDRESS);
+}
+
+static int
+multicast_pending(snl_socket_t *skt, struct ip_mreqn *mreq, int opt) {
+   struct multicast_groups *mg = skt->multicast;
+   unsigned int n;
+
+   for (n=0; mg && (n<mg->count); n++) {
+      if (!memcmp(&mg->mreq[n], mreq, sizeof (*mreq))) break;
+   }
+
+   if (opt == IP_DROP_MEMBERSHIP) {
+      // cancel a pending join
+      if (!mg || (n == mg->count)) return (SNL_ERROR_OPTION);
+
+      mg->mreq[n] = mg->mreq[--mg->count];
+
+      if (!mg->count) {
+         free(skt->multicast);
+         skt->multicast = NULL;
+      }
+
+      return (SNL_ERROR_OK);
+   }
+
+   // joined twice, as the kernel would refuse it
+   if (mg && (n < mg->count)) return (SNL_ERROR_OPTION);
+
+   if (!mg && !(mg = skt->multicast = calloc(1, sizeof (*mg)))) {
+      return (SNL_ERROR_BUFFER);
+   }
+
+   if (mg->count == MULTICAST_GROUPS) return (SNL_ERROR_BUSY);
+
+   mg->mreq[mg->count++] = *mreq;
+
+   return (SNL_ERROR_OK);
+}
+
+static int
+multicast_membership(snl_socket_t *skt, const char *group, const char *iface, int opt) {
+   struct ip_mreqn mreq;
+   int error;
+
+   if (skt->protocol != SNL_PROTO_UDP) {
+      return (SNL_ERROR_PROTOCOL);
+   }
+
+   memset(&mreq, 0, sizeof (mreq));
+
+   if (!group || (inet_pton(AF_INET, group, &mreq.imr_multiaddr) != 1)) {
+      return (SNL_ERROR_ADDRESS);
+   }
+
+   if (!IN_MULTICAST(ntohl(mreq.imr_multiaddr.s_addr))) {
+      return (SNL_ERROR_ADDRESS);
+   }
+
+   if ((error = multicast_interface(iface, &mreq))) {
+      return (error);
+   }
+
+   // not bound yet, snl_listen() will join
+   if (skt->file_descriptor < 0) {
+      return (multicast_pending(skt, &mreq, opt));
+   }
+
+   if (setsockopt(skt->file_descriptor, IPPROTO_IP, opt, &mreq, sizeof (mreq))) {
+      return (SNL_ERROR_OPTION);
+   }
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_multicast_join(snl_socket_t *skt, const char *group, const char *iface) {
+   return (multicast_membership(skt, group, iface, IP_ADD_MEMBERSHIP));
+}
+
+int
+snl_multicast_leave(snl_socket_t *skt, const char *group, const char *iface) {
+   return (multicast_membership(skt, group, iface, IP_DROP_MEMBERSHIP));
+}
+
+int
+snl_multicast_ttl(snl_socket_t *skt, int ttl) {
+   if (skt->protocol != SNL_PROTO_UDP) {
+      return (SNL_ERROR_PROTOCOL);
+   }
+
+   if (setsockopt(skt->file_descriptor, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof (ttl))) {
+      return (SNL_ERROR_OPTION);
+   }
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_multicast_loop(snl_socket_t *skt, int enable) {
+   if (skt->protocol != SNL_PROTO_UDP) {
+      return (SNL_ERROR_PROTOCOL);
+   }
+
+   if (setsockopt(skt->file_descriptor, IPPROTO_IP, IP_MULTICAST_LOOP, &enable, sizeof (enable))) {
+      return (SNL_ERROR_OPTION);
+   }
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_multicast_interface(snl_socket_t *skt, const char *iface) {
+   struct ip_mreqn mreq;
+   int error;
+
+   if (skt->protocol != SNL_PROTO_UDP) {
+      return (SNL_ERROR_PROTOCOL);
+   }
+
+   memset(&mreq, 0, sizeof (mreq));
+
+   if ((error = multicast_interface(iface, &mreq))) {
+      return (error);
+   }
+
+   if (setsockopt(skt->file_descriptor, IPPROTO_IP, IP_MULTICAST_IF, &mreq, sizeof (mreq))) {
+      return (SNL_ERROR_OPTION);
+   }
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_receive_batch(snl_socket_t *skt, unsigned int count) {
+   unsigned int i;
+
+   // socket already in use
+   if (skt->worker_type != WORKER_THREAD_UNKNOWN) {
+      return (SNL_ERROR_BUSY);
+   }
+
+   if (skt->protocol != SNL_PROTO_UDP) {
+      return (SNL_ERROR_PROTOCOL);
+   }
+
+   if (count < 1) count = 1;
+   if (count > RECV_BATCH_MAX) count = RECV_BATCH_MAX;
+
+   // drop slots of a previous listen, the worker allocates new ones
+   if (skt->recv_slots) {
+      for (i=1; i<skt->recv_batch; i++) {
+         free(skt->recv_slots[i]);
+      }
+
+      free(skt->recv_slots);
+      skt->recv_slots = NULL;
+   }
+
+   skt->recv_batch = count;
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_fragment(snl_socket_t *skt, unsigned int mtu) {
+   if (skt->protocol != SNL_PROTO_UDP) {
+      return (SNL_ERROR_PROTOCOL);
+   }
+
+   // socket already in use
+   if (skt->worker_type != WORKER_THREAD_UNKNOWN) {
+      return (SNL_ERROR_BUSY);
+   }
+
+   snl_fragment_delete(skt->fragment);
+   skt->fragment = NULL;
+
+   if (!mtu) return (SNL_ERROR_OK);
+
+   if (mtu <= FRAGMENT_HEADER_SIZE || mtu > UDP_PAYLOAD_SIZE) {
+      return (SNL_ERROR_OPTION);
+   }
+
+   if (!(skt->fragment = snl_fragment_new(mtu))) {
+      return (SNL_ERROR_BUFFER);
+   }
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_fragment_limit(snl_socket_t *skt, unsigned int memory, unsigned int timeout) {
+   if (!skt->fragment) {
+      return (SNL_ERROR_PROTOCOL);
+   }
+
+   if (memory)  skt->fragment->limit   = memory;
+   if (timeout) skt->fragment->timeout = timeout;
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_passphrase(snl_socket_t *skt, char *key) {
+   // destroy old blowfish context
+   free(skt->cipher);
+   skt->cipher = NULL;
+
+   if (key) {
+      // create new blowfish context
+      skt->cipher = malloc(sizeof (blowfish_t));
+      bf_init(skt->cipher, key, strlen(key));
+   }
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_listen(snl_socket_t *skt, unsigned short port) {
+   int type = ((skt->protocol == SNL_PROTO_UDP) || (skt->protocol == SNL_PROTO_RUDP)) ? SOCK_DGRAM : SOCK_STREAM;
+   int error = SNL_ERROR_OK, flg = 1, fd = -1, backlog = connection_backlog;
+   struct sockaddr_in addr;
+   struct sockaddr_un local;
+   socklen_t len;
+
+   if (skt->admission && skt->admission->backlog) backlog = skt->admission->backlog;
+
+   // socket already in use
+   if (skt->worker_type != WORKER_THREAD_UNKNOWN) {
+      return (SNL_ERROR_BUSY);
+   }
+
+   // sanity check, a name stands in for the port
+   if (!port && !((skt->protocol == SNL_PROTO_LOOP) && skt->loop && skt->loop->name[0])) {
+      return (SNL_ERROR_LISTEN);
+   }
+
+   // registered by port or name, nothing is bound
+   if (skt->protocol == SNL_PROTO_LOOP) {
+      if ((error = snl_loop_listen(skt, port))) return (error);
+
+      skt->worker_type = WORKER_THREAD_LISTEN;
+
+      return (SNL_ERROR_OK);
+   }
+
+   if (skt->local || (skt->protocol == SNL_PROTO_SHM)) {
+      // unix domain socket named after protocol and port
+      if ((fd = socket(AF_UNIX, local_type(skt->protocol), 0)) < 0) {
+         error = SNL_ERROR_OPEN;
+         goto cleanup;
+      }
+
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+      len = local_address(&local, skt->protocol, port);
+
+      if (bind(fd, (SA *)&local, len)) {
+         error = SNL_ERROR_BIND;
+         goto cleanup;
+      }
+
+      if ((skt->protocol != SNL_PROTO_UDP) && listen(fd, backlog)) {
+         error = SNL_ERROR_LISTEN;
+      }
+
+      goto cleanup;
+   }
+
+   // open socket
+   if ((fd = socket(AF_INET, type, 0)) < 0) {
+      error = SNL_ERROR_OPEN;
+      goto cleanup;
+   }
+
+   // set reuse address flag
+   if ((skt->protocol == SNL_PROTO_MSG) || (skt->protocol == SNL_PROTO_TCP)) {
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &flg, sizeof (flg));
+   }
+
+   // multicast subscribers on the same host share the port, and so
+   // do the connected sockets of reliable UDP peers
+   if (skt->multicast || (skt->protocol == SNL_PROTO_RUDP)) {
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &flg, sizeof (flg));
+   }
+
+   // set non blocking
+   fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+   // prepare socket address
+   memset(&addr, 0, sizeof (addr));
+   addr.sin_family = AF_INET;
+   addr.sin_port = htons((int)port);
+   addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+   // bind the socket
+   if (bind(fd, (SA *)&addr, sizeof (addr))) {
+      error = SNL_ERROR_BIND;
+      goto cleanup;
+   }
+
+   if ((skt->protocol == SNL_PROTO_MSG) || (skt->protocol == SNL_PROTO_TCP)) {
+      if (listen(fd, backlog)) {
+         error = SNL_ERROR_LISTEN;
+         goto cleanup;
+      }
+   }
+
+   // establish group membership requested before binding
+   if (skt->multicast) {
+      struct multicast_groups *mg = skt->multicast;
+      unsigned int n;
+
+      for (n=0; n<mg->count; n++) {
+         if (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mg->mreq[n], sizeof (struct ip_mreqn))) {
+            error = SNL_ERROR_OPTION;
+            goto cleanup;
+         }
+      }
+
+      free(skt->multicast);
+      skt->multicast = NULL;
+   }
+
+cleanup:
+
+   if (error && (fd >= 0)) {
+      close(fd);
+
+      return (error);
+   }
+
+   if (fd < 0) return (SNL_ERROR_LISTEN);
+
+   skt->file_descriptor = fd;
+
+   switch (skt->protocol) {
+      case SNL_PROTO_RUDP:
+         // remembers recently accepted peers
+         if (reliable_state(skt)) {
+            close(fd);
+            skt->file_descriptor = -1;
+            return (SNL_ERROR_BUFFER);
+         }
+      // fall through
+      case SNL_PROTO_SHM:
+      case SNL_PROTO_TCP:
+      case SNL_PROTO_MSG:
+         skt->worker_type = WORKER_THREAD_LISTEN;
+      break;
+
+      case SNL_PROTO_UDP:
+         skt->worker_type = WORKER_THREAD_RECEIVE;
+      break;
+   }
+
+   return (SNL_ERROR_OK);
+}
+
+const char *
+snl_error_string(int error) {
+   switch (error) {
+      case SNL_ERROR_OK:         return ("no error");
+      case SNL_ERROR_OPEN:       return ("couldn't open socket");
+      case SNL_ERROR_CONNECT:    return ("connecting to remote socket failed");
+      case SNL_ERROR_LISTEN:     return ("error while listening on socket");
+      case SNL_ERROR_BIND:       return ("couldn't bind to socket");
+      case SNL_ERROR_ACCEPT:     return ("error while accepting connection");
+      case SNL_ERROR_RECEIVE:    return ("couldn't read from socket");
+      case SNL_ERROR_SEND:       return ("failed to send datagram");
+      case SNL_ERROR_CLOSED:     return ("peer closed connection");
+      case SNL_ERROR_BUFFER:     return ("out of memory");
+      case SNL_ERROR_ADDRESS:    return ("hostname resolution failed");
+      case SNL_ERROR_DISCONNECT: return ("error while closing socket");
+      case SNL_ERROR_PROTOCOL:   return ("protocol mismatch");
+      case SNL_ERROR_THREAD:     return ("could not start worker thread");
+      case SNL_ERROR_TIMEOUT:    return ("timeout error");
+      case SNL_ERROR_BUSY:       return ("socket already in use");
+      case SNL_ERROR_CIPHER:     return ("could not (de)cipher payload");
+      case SNL_ERROR_OPTION:     return ("could not set socket option");
+      case SNL_ERROR_FILE:       return ("could not read file");
+      case SNL_ERROR_COMPRESS:   return ("could not (de)compress payload");
+      case SNL_ERROR_CHECKSUM:   return ("checksum mismatch");
+      case SNL_ERROR_LENGTH:     return ("record too long");
+   }
+
+   return ("unknown error");
+}
+
+int
+snl_connect(snl_socket_t *skt, const char *host, unsigned short port) {
+   int type = ((skt->protocol == SNL_PROTO_UDP) || (skt->protocol == SNL_PROTO_RUDP)) ? SOCK_DGRAM : SOCK_STREAM;
+   int fd, error = SNL_ERROR_OK, flg = 1, cnt = 1, ivl = 3, low = MUX_LOWAT;
+   socklen_t len = sizeof (struct timeval);
+   char addrstr[INET_ADDRSTRLEN];
+   struct hostent *hent = NULL;
+   struct timeval to, cto, sto;
+   struct sockaddr_in addr;
+   int broadcast = 0;
+
+   // set connect timeout
+   cto.tv_sec  = connect_timeout;
+   cto.tv_usec = 0;
+
+   // set send timeout
+   write_timeout(skt, &sto);
+
+   // socket already in use
+   if (skt->worker_type != WORKER_THREAD_UNKNOWN) {
+      return (SNL_ERROR_BUSY);
+   }
+
+   // sanity check, a name stands in for the port
+   if (!port && !((skt->protocol == SNL_PROTO_LOOP) && skt->loop && skt->loop->name[0])) {
+      return (SNL_ERROR_CONNECT);
+   }
+
+   // only ever on this host
+   if (skt->local || (skt->protocol == SNL_PROTO_SHM)) {
+      return (connect_local(skt, port));
+   }
+
+   // only ever in this process
+   if (skt->protocol == SNL_PROTO_LOOP) {
+      if ((error = snl_loop_connect(skt, port))) return (error);
+
+      if (skt->sender) skt->sender->error = SNL_ERROR_OK;
+
+      skt->worker_type = WORKER_THREAD_LOOP;
+
+      return (SNL_ERROR_OK);
+   }
+
+   // check, if we should broadcast
+   if (!host) {
+      if (skt->protocol == SNL_PROTO_UDP) broadcast = 1;
+      if (skt->protocol != SNL_PROTO_UDP) {
+         return (SNL_ERROR_CONNECT);
+      }
+   }
+
+   // open socket
+   if ((fd = socket(AF_INET, type, 0)) < 0) {
+      error = SNL_ERROR_OPEN;
+      goto cleanup;
+   }
+
+   // set all kinds of fancy socket options
+   if ((skt->protocol == SNL_PROTO_MSG) || (skt->protocol == SNL_PROTO_TCP)) {
+      setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO,   &sto, sizeof (sto));
+      setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE,  &flg, sizeof (flg));
+      setsockopt(fd, SOL_TCP,    TCP_KEEPCNT,   &cnt, sizeof (cnt));
+      setsockopt(fd, SOL_TCP,    TCP_KEEPIDLE,  &ivl, sizeof (ivl));
+      setsockopt(fd, SOL_TCP,    TCP_KEEPINTVL, &ivl, sizeof (ivl));
+      setsockopt(fd, SOL_TCP,    TCP_NODELAY,   &flg, sizeof (flg));
+   }
+
+   // unsent bytes in the kernel would queue up ahead of the scheduler
+   if (skt->mux) setsockopt(fd, SOL_TCP, TCP_NOTSENT_LOWAT, &low, sizeof (low));
+
+   if (broadcast) {
+      setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &flg, sizeof (flg));
+   }
+
+   // prepare socket address
+   memset(&addr, 0, sizeof (addr));
+   addr.sin_family = AF_INET;
+   addr.sin_port = htons((int)port);
+
+   if (broadcast) {
       // set destination address directly to the broadcast address
       addr.sin_addr.s_addr = htonl(INADDR_BROADCAST);
    } else {
@@ -421,132 +1756,1061 @@ snl_connect(snl_socket_t *skt, const char *host, unsigned short port) {
          error = SNL_ERROR_ADDRESS;
          goto cleanup;
       }
-      if (!inet_ntop(AF_INET, hent->h_addr, addrstr, sizeof (addrstr))) {
-         error = SNL_ERROR_CONNECT;
-         goto cleanup;
+      if (!inet_ntop(AF_INET, hent->h_addr, addrstr, sizeof (addrstr))) {
+         error = SNL_ERROR_CONNECT;
+         goto cleanup;
+      }
+      if (!inet_pton(AF_INET, addrstr, &addr.sin_addr)) {
+         error = SNL_ERROR_CONNECT;
+         goto cleanup;
+      }
+   }
+
+   if ((skt->protocol == SNL_PROTO_MSG) || (skt->protocol == SNL_PROTO_TCP)) {
+      // save default connect timeout
+      getsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &to, &len);
+      // set new (shorter) connect timeout
+      setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &cto, sizeof (cto));
+   }
+
+   // connect socket
+   while ((connect(fd, (SA *)&addr, sizeof (addr)) == -1) && (errno != EISCONN)) {
+      if (errno != EINTR ) {
+         error = SNL_ERROR_CONNECT;
+         goto cleanup;
+      }
+   }
+
+   // reset socket connect timeout
+   if ((skt->protocol == SNL_PROTO_MSG) || (skt->protocol == SNL_PROTO_TCP)) {
+      setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &to, sizeof (to));
+   }
+
+   if (skt->protocol == SNL_PROTO_RUDP) {
+      // handshake, so snl_send() does not talk into the void
+      if ((error = snl_rudp_connect(fd, connect_timeout))) goto cleanup;
+
+      if (reliable_state(skt)) {
+         error = SNL_ERROR_BUFFER;
+         goto cleanup;
+      }
+   }
+
+   // agree on the frame header before the first message
+   if (skt->framing) {
+      if ((error = snl_framing_hello(skt->framing, fd, connect_timeout, 0))) goto cleanup;
+   }
+
+   if (skt->sender) skt->sender->error = SNL_ERROR_OK;
+
+   // trigger worker thread
+   switch (skt->protocol) {
+      case SNL_PROTO_TCP:
+      case SNL_PROTO_MSG:
+         skt->worker_type = WORKER_THREAD_READ;
+      break;
+      case SNL_PROTO_UDP:
+         skt->worker_type = WORKER_THREAD_IDLE;
+      break;
+      case SNL_PROTO_RUDP:
+         skt->worker_type = WORKER_THREAD_RELIABLE;
+      break;
+   }
+
+cleanup:
+
+   if (error && (fd >= 0)) close(fd);
+
+   skt->file_descriptor = fd;
+
+   return (error);
+}
+
+int
+snl_disconnect(snl_socket_t *skt) {
+   // wait for outstanding acks and tell the peer
+   if (skt->rudp && (skt->worker_type == WORKER_THREAD_RELIABLE)) {
+      snl_rudp_close(skt, skt->worker_stop ? 0 : send_timeout);
+   }
+
+   // release senders blocked on a full ring
+   snl_shm_close(skt->shm);
+
+   // wake up the peer in this process
+   snl_loop_close(skt->loop);
+
+   // a late read deadline must not shut down the next owner of the fd,
+   // nor a late coalescing budget write to it
+   snl_timeout_close(skt->timeout);
+   snl_sender_close(skt->sender);
+
+   shutdown(skt->file_descriptor, SHUT_RDWR);
+
+   if (close(skt->file_descriptor)) return (SNL_ERROR_DISCONNECT);
+
+   return (SNL_ERROR_OK);
+}
+
+int
+snl_init(void) {
+   // catch SIGPIPE to avoid aborting on broken pipes.
+   signal(SIGPIPE, SIG_IGN);
+
+   // set per thread stack size
+   pthread_attr_init(&thread_attr);
+   pthread_attr_setstacksize(&thread_attr, 4 * 65536); // 256 KB
+
+   // pick the fastest CRC32C the CPU offers
+   snl_crc_init();
+
+   return (0);
+}
+
+static unsigned char *
+encrypt(blowfish_t *bf, const void *buffer, unsigned int *len) {
+   unsigned char *buf = NULL;
+   int pad;
+
+   if (!bf) return (NULL);
+
+   pad = 8 - (*len % 8);
+
+   if (!(buf = malloc(*len + pad))) {
+      return (NULL);
+   }
+
+   memcpy(buf, buffer, *len);
+   memset(buf + *len, pad, pad);
+   *len += pad;
+
+   if (bf_encrypt(bf, buf, *len)) {
+      free(buf);
+      return (NULL);
+   }
+
+   return (buf);
+}
+
+static unsigned char *
+decrypt(blowfish_t *bf, void *buffer, unsigned int *len) {
+   unsigned char *buf = (unsigned char *)buffer;
+   int pad;
+
+   if (!bf) return (NULL);
+
+   // whole blocks with at least one padding byte
+   if (!*len || (*len % 8)) return (NULL);
+
+   if (bf_decrypt(bf, buf, *len)) {
+      return (NULL);
+   } else {
+      pad = buf[*len - 1];
+
+      if (pad < 1 || pad > 8) {
+         return (NULL);
+      } else {
+         *len -= pad;
+         memset(&buf[*len], 0, pad);
+      }
+   }
+
+   return (buf);
+}
+
+static int
+send_payload(snl_socket_t *skt, const void *buf, unsigned int len) {
+   int error = SNL_ERROR_OK;
+   unsigned int length;
+   int on = 1, off = 0;
+
+   // large datagrams are split up into mtu sized fragments
+   if (skt->fragment) {
+      return (snl_fragment_send(skt, buf, len));
+   }
+
+   // frames from concurrent senders must not interleave
+   if (skt->sender) {
+      return (send_queued(skt, buf, len));
+   }
+
+   // large payloads are sent from the buffer of the caller
+   if (skt->zerocopy && !skt->cipher && !skt->codecs && snl_zerocopy_ready(skt, len)) {
+      return (send_zerocopy(skt, buf, len));
+   }
+
+   // add padding bytes and encrypt
+   if (skt->cipher && !(buf = encrypt(skt->cipher, buf, &len))) {
+      return (SNL_ERROR_CIPHER);
+   }
+
+   if (SNL_DATAGRAMS(skt)) {
+      // check for packet size overflow
+      if ((skt->protocol == SNL_PROTO_UDP) && (len > UDP_PAYLOAD_SIZE)) {
+         return (SNL_ERROR_SEND);
+      }
+
+      if (send(skt->file_descriptor, buf, len, 0) != (int)len) {
+         error = SNL_ERROR_SEND;
+      } else {
+         // update stats
+         __sync_fetch_and_add(&skt->xfer_sent, len);
+      }
+
+      // free the blowfish buffer
+      if (skt->cipher) free((void *)buf);
+
+      return (error);
+   }
+
+   // save real packet length
+   length = len;
+
+   // disable sending of partial frames
+   setsockopt(skt->file_descriptor, SOL_TCP, TCP_CORK, &on, sizeof (on));
+
+   // send packet header
+   if ((error = write_header(skt, length))) {
+      goto cleanup;
+   }
+
+   // send packet payload
+   if (snl_write(skt->file_descriptor, buf, length)) {
+      error = SNL_ERROR_CLOSED;
+      goto cleanup;
+   }
+
+   // update stats
+   __sync_fetch_and_add(&skt->xfer_sent, length);
+
+cleanup:
+
+   // flush send buffer
+   setsockopt(skt->file_descriptor, SOL_TCP, TCP_CORK, &off, sizeof (off));
+
+   // free the blowfish buffer
+   if (skt->cipher) free((void *)buf);
+
+   return (error);
+}
+
+static int
+write_header(snl_socket_t *skt, unsigned int len) {
+   unsigned char header[FRAME_HEADER_MAX];
+   unsigned int size;
+
+   // raw streams have no message boundaries
+   if (skt->protocol == SNL_PROTO_TCP) {
+      return (SNL_ERROR_OK);
+   }
+
+   if (SNL_FRAMING_V2(skt)) {
+      // the receiver would refuse it
+      if (len > FRAME_LENGTH_MAX) return (SNL_ERROR_SEND);
+
+      size = snl_framing_header(header, 0, len);
+   } else {
+      len = htonl(len);
+      memcpy(header, &len, sizeof (len));
+      size = sizeof (len);
+   }
+
+   if (snl_write(skt->file_descriptor, header, size)) {
+      return (SNL_ERROR_CLOSED);
+   }
+
+   return (SNL_ERROR_OK);
+}
+
+static int
+send_queued(snl_socket_t *skt, const void *buf, unsigned int len) {
+   snl_frame_t *frame;
+
+   if (skt->protocol == SNL_PROTO_UDP) {
+      // check for packet size overflow
+      if (len > UDP_PAYLOAD_SIZE) {
+         return (SNL_ERROR_SEND);
+      }
+   }
+
+   if (!(frame = queued_frame(skt, buf, len))) {
+      return (skt->cipher ? SNL_ERROR_CIPHER : SNL_ERROR_BUFFER);
+   }
+
+   return (snl_sender_send(skt, frame, SNL_PRIORITY_NORMAL, 0));
+}
+
+static snl_frame_t *
+queued_frame(snl_socket_t *skt, const void *buf, unsigned int len) {
+   if (SNL_FRAMING_V2(skt)) {
+      return (snl_framing_pack(skt->cipher, &buf, &len, 1));
+   }
+
+   // datagram framing leaves out the length header
+   return (snl_sender_frame(SNL_DATAGRAMS(skt) ? SNL_PROTO_UDP : skt->protocol, skt->cipher, buf, len));
+}
+
+static int
+send_file_plain(int sock, int fd, off_t offset, unsigned int len) {
+   ssize_t sent;
+
+   // straight from the page cache into the socket
+   while (len) {
+      if ((sent = sendfile(sock, fd, &offset, len)) <= 0) {
+         if ((sent < 0) && (errno == EINTR)) continue;
+
+         // a file truncated meanwhile leaves the frame incomplete
+         return (sent ? SNL_ERROR_CLOSED : SNL_ERROR_FILE);
       }
-      if (!inet_pton(AF_INET, addrstr, &addr.sin_addr)) {
-         error = SNL_ERROR_CONNECT;
-         goto cleanup;
+
+      len -= sent;
+   }
+
+   return (SNL_ERROR_OK);
+}
+
+static int
+send_file_encrypted(snl_socket_t *skt, int fd, off_t offset, unsigned int len) {
+   unsigned char tail[8];
+   unsigned int size;
+   size_t delta;
+   char *map;
+   int pad;
+
+   // whole blocks are encrypted in a private mapping, which copies the
+   // pages on write, but never the file as a whole
+   while (len >= 8) {
+      size = (len < FILE_WINDOW_SIZE) ? len : FILE_WINDOW_SIZE;
+      size -= size % 8;
+
+      delta = offset % sysconf(_SC_PAGESIZE);
+
+      map = mmap(NULL, size + delta, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, offset - delta);
+      if (map == MAP_FAILED) {
+         return (SNL_ERROR_FILE);
+      }
+
+      madvise(map, size + delta, MADV_SEQUENTIAL);
+
+      bf_encrypt(skt->cipher, map + delta, size);
+
+      if (snl_write(skt->file_descriptor, map + delta, size)) {
+         munmap(map, size + delta);
+         return (SNL_ERROR_CLOSED);
       }
+
+      munmap(map, size + delta);
+
+      offset += size;
+      len -= size;
    }
 
-   if ((skt->protocol == SNL_PROTO_MSG) || (skt->protocol == SNL_PROTO_TCP)) {
-      // save default connect timeout
-      getsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &to, &len);
-      // set new (shorter) connect timeout
-      setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &cto, sizeof (cto));
+   // the last block carries the padding bytes, like encrypt() adds them
+   if (len && (pread(fd, tail, len, offset) != (ssize_t)len)) {
+      return (SNL_ERROR_FILE);
    }
 
-   // connect socket
-   while ((connect(fd, (SA *)&addr, sizeof (addr)) == -1) && (errno != EISCONN)) {
-      if (errno != EINTR ) {
-         error = SNL_ERROR_CONNECT;
-         goto cleanup;
+   pad = 8 - len;
+   memset(tail + len, pad, pad);
+
+   bf_encrypt(skt->cipher, tail, sizeof (tail));
+
+   if (snl_write(skt->file_descriptor, tail, sizeof (tail))) {
+      return (SNL_ERROR_CLOSED);
+   }
+
+   return (SNL_ERROR_OK);
+}
+
+static int
+send_zerocopy(snl_socket_t *skt, const void *buf, unsigned int len) {
+   int error = SNL_ERROR_OK;
+   int on = 1, off = 0;
+
+   // disable sending of partial frames
+   setsockopt(skt->file_descriptor, SOL_TCP, TCP_CORK, &on, sizeof (on));
+
+   // send packet header
+   if ((error = write_header(skt, len))) {
+      goto cleanup;
+   }
+
+   // payload pages are pinned, not copied
+   if (!(error = snl_zerocopy_send(skt, buf, len))) {
+      __sync_fetch_and_add(&skt->xfer_sent, len);
+   }
+
+cleanup:
+
+   // flush send buffer
+   setsockopt(skt->file_descriptor, SOL_TCP, TCP_CORK, &off, sizeof (off));
+
+   return (error);
+}
+
+static void
+sent_zerocopy(snl_socket_t *skt, const void *buf, unsigned int len) {
+   snl_zerocopy_t *zc = skt->zerocopy;
+
+   // lend the buffer the kernel is done with to the callback
+   zc->spare = skt->data_buffer;
+   zc->lent = 1;
+   skt->data_buffer = (void *)buf;
+
+   skt->error_code = SNL_ERROR_OK;
+   skt->event_code = SNL_EVENT_SENT;
+   skt->data_length = len;
+
+   skt->event_callback(skt);
+
+   skt->data_buffer = zc->spare;
+   zc->spare = NULL;
+   zc->lent = 0;
+}
+
+static int
+wait_readable(snl_socket_t *skt) {
+   snl_timeout_t *tmo = skt->timeout;
+   snl_sender_t *snd = skt->sender;
+   long long deadline, expiry, now;
+   unsigned long long count;
+   struct pollfd pfd[4];
+   struct timespec ts;
+   int reaped, forever;
+
+   pfd[0].fd = skt->file_descriptor;
+
+   // the first coalesced frame wakes us up to arm the deadline, a sender
+   // the socket did not take everything from leaves the rest to us
+   pfd[1].fd = snd ? snd->event : -1;
+   pfd[1].events = POLLIN;
+
+   // and the timer wheel for timeouts and heartbeats
+   pfd[2].fd = tmo ? tmo->event : -1;
+   pfd[2].events = POLLIN;
+
+   // a call with an earlier deadline than we sleep toward
+   pfd[3].fd = skt->rpc ? skt->rpc->event : -1;
+   pfd[3].events = POLLIN;
+
+   // no message is on its way while we wait
+   if (tmo) tmo->reading = 0;
+
+   while (!skt->worker_stop) {
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      now = (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+
+      // frames waited long enough for company
+      deadline = snd ? snl_sender_deadline(snd) : 0;
+      if (deadline && (deadline <= now)) {
+         snl_sender_flush(skt);
+         deadline = 0;
+      }
+
+      // write what a non-blocking sender left behind, unless it waits
+      // for company or somebody else is at it
+      pfd[0].events = POLLIN;
+      if (snd && snd->pending && !snd->draining && !snd->oldest) pfd[0].events |= POLLOUT;
+
+      // calls without reply in time fail
+      expiry = skt->rpc ? snl_rpc_expire(skt, now) : 0;
+      if (expiry && (!deadline || (expiry < deadline))) deadline = expiry;
+
+      // a disconnect, the sender, the timer wheel and new calls wake us up
+      forever = !deadline;
+
+      if (!forever) {
+         deadline -= now;
+         ts.tv_sec  = deadline / 1000000;
+         ts.tv_nsec = deadline % 1000000 * 1000;
+      }
+
+      if (ppoll(pfd, 4, forever ? NULL : &ts, NULL) < 0) {
+         if (errno == EINTR) continue;
+         return (SNL_ERROR_RECEIVE);
+      }
+
+      if (pfd[0].revents & POLLNVAL) {
+         return (SNL_ERROR_RECEIVE);
+      }
+
+      if (pfd[1].revents & POLLIN) {
+         if (read(pfd[1].fd, &count, sizeof (count))) {}
+      }
+
+      if (pfd[3].revents & POLLIN) {
+         if (read(pfd[3].fd, &count, sizeof (count))) {}
+      }
+
+      if (pfd[2].revents & POLLIN) {
+         snl_timeout_raise(skt, send_heartbeat);
+         continue;
+      }
+
+      if (pfd[0].revents & POLLOUT) {
+         snl_sender_drain(skt, 1);
       }
+
+      // completions raise POLLERR, incoming data POLLIN
+      reaped = skt->zerocopy ? snl_zerocopy_reap(skt, sent_zerocopy) : 0;
+
+      if (pfd[0].revents & (POLLIN | POLLHUP)) break;
+
+      // a socket error, left to read()
+      if ((pfd[0].revents & POLLERR) && !reaped) break;
    }
 
-   // reset socket connect timeout
-   if ((skt->protocol == SNL_PROTO_MSG) || (skt->protocol == SNL_PROTO_TCP)) {
-      setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &to, sizeof (to));
+   // the read deadline starts with the first byte of a message
+   if (tmo) tmo->received = tmo->reading = snl_timer_now();
+
+   return (SNL_ERROR_OK);
+}
+
+static int
+send_heartbeat(snl_socket_t *skt) {
+   snl_frame_t *frame;
+
+   // only the version 2 header has room to mark it, a local peer is
+   // reported by the kernel right away
+   if (!SNL_FRAMING_V2(skt)) {
+      return (SNL_ERROR_OK);
    }
 
-   // trigger worker thread
-   switch (skt->protocol) {
-      case SNL_PROTO_TCP:
-      case SNL_PROTO_MSG:
-         skt->worker_type = WORKER_THREAD_READ;
-      break;
-      case SNL_PROTO_UDP:
-         skt->worker_type = WORKER_THREAD_IDLE;
-      break;
+   if (!(frame = snl_frame_new(FRAME_HEADER_MAX))) {
+      return (SNL_ERROR_BUFFER);
+   }
+
+   // the peer drops it without an event
+   frame->header = snl_framing_header(frame->data, FRAME_HEARTBEAT, 0);
+   frame->length = frame->header;
+
+   return (snl_sender_send(skt, frame, SNL_PRIORITY_HIGH, 0));
+}
+
+static void
+write_timeout(snl_socket_t *skt, struct timeval *sto) {
+   unsigned int ms = skt->timeout ? skt->timeout->write : 0;
+
+   if (ms) {
+      sto->tv_sec  = ms / 1000;
+      sto->tv_usec = ms % 1000 * 1000;
+   } else {
+      sto->tv_sec  = send_timeout;
+      sto->tv_usec = 0;
+   }
+}
+
+static void
+socket_free(snl_socket_t *skt) {
+   unsigned int i;
+
+   // deleted from within the callback, the data buffer is the payload
+   // behind the correlation header or a decoded message, given back first
+   // as their spare may be lent from further below
+   if (skt->rpc && skt->rpc->lent) {
+      skt->data_buffer = skt->rpc->spare;
+   }
+
+   if (skt->mux && skt->mux->lent) {
+      skt->data_buffer = skt->mux->spare;
+   }
+
+   if (skt->credit && skt->credit->lent) {
+      skt->data_buffer = skt->credit->spare;
+   }
+
+   if (skt->codecs && skt->codecs->lent) {
+      skt->data_buffer = skt->codecs->spare;
+   }
+
+   // or a record in the delimiter buffer
+   if (skt->delimit && skt->delimit->lent) {
+      skt->data_buffer = skt->delimit->spare;
+   }
+
+   // the data buffer is in the ring
+   if (skt->shm && skt->shm->lent) {
+      skt->data_buffer = skt->shm->spare;
+   }
+
+   // same for a message of the peer socket in this process
+   if (skt->loop && skt->loop->lent) {
+      skt->data_buffer = skt->loop->spare;
+   }
+
+   // and for a buffer sent with zero copy
+   if (skt->zerocopy && skt->zerocopy->lent) {
+      skt->data_buffer = skt->zerocopy->spare;
+   }
+
+   // and for a message of a packed container
+   if (skt->framing && skt->framing->lent) {
+      skt->data_buffer = skt->framing->spare;
+   }
+
+   if (skt->recv_slots) {
+      for (i=1; i<skt->recv_batch; i++) {
+         free(skt->recv_slots[i]);
+      }
+   }
+
+   snl_sender_delete(skt->sender);
+   snl_fragment_delete(skt->fragment);
+   snl_rudp_delete(skt->rudp);
+   snl_shm_delete(skt->shm);
+   snl_loop_delete(skt->loop);
+   snl_relay_delete(skt->relay);
+   snl_zerocopy_delete(skt->zerocopy);
+   free(skt->framing);
+   snl_codecs_delete(skt->codecs);
+   snl_compress_delete(skt->compress);
+   snl_delimit_delete(skt->delimit);
+   snl_rpc_delete(skt->rpc);
+   snl_mux_delete(skt->mux);
+   snl_credit_delete(skt->credit);
+   snl_shaper_delete(skt->shaper);
+   snl_timeout_delete(skt->timeout);
+   snl_admission_release(skt);
+   snl_admission_unref(skt->admission);
+   free(skt->recv_slots);
+   free(skt->multicast);
+   free(skt->data_buffer);
+   free(skt);
+}
+
+static void
+receive_datagram(snl_socket_t *skt, unsigned int length) {
+   // update counter
+   skt->xfer_rcvd += length;
+
+   // decrypt and strip padding bytes
+   if (skt->cipher && !decrypt(skt->cipher, skt->data_buffer, &length)) {
+      skt->error_code = SNL_ERROR_CIPHER;
+      skt->event_code = SNL_EVENT_ERROR;
+   } else {
+      skt->error_code = SNL_ERROR_OK;
+      skt->event_code = SNL_EVENT_RECEIVE;
+
+      skt->data_length = length;
+
+      decode_message(skt);
+   }
+
+   // a reply, consumed while decoding
+   if (skt->event_code != SNL_EVENT_UNKNOWN) skt->event_callback(skt);
+
+   restore_message(skt);
+}
+
+static void
+receive_fragments(snl_socket_t *skt, struct msghdr *msg, unsigned int length) {
+   unsigned char *buf = skt->data_buffer;
+   unsigned int offset, segment = length, size;
+   snl_fragment_t *frg = skt->fragment;
+   struct cmsghdr *cm;
+   void *data;
+
+   // with GRO one buffer holds several equally sized datagrams
+   for (cm = CMSG_FIRSTHDR(msg); cm; cm = CMSG_NXTHDR(msg, cm)) {
+      if ((cm->cmsg_level == IPPROTO_UDP) && (cm->cmsg_type == UDP_GRO)) {
+         memcpy(&size, CMSG_DATA(cm), sizeof (size));
+         if (size) segment = size;
+      }
+   }
+
+   for (offset=0; offset<length; offset+=segment) {
+      size = (length - offset < segment) ? length - offset : segment;
+
+      data = snl_fragment_input(frg, buf + offset, size, skt->client_ip, skt->client_port, &size);
+      if (!data) continue;
+
+      // lend the completed message to the callback as data buffer
+      frg->spare = skt->data_buffer;
+      skt->data_buffer = data;
+
+      receive_datagram(skt, size);
+
+      skt->data_buffer = frg->spare;
+      frg->spare = NULL;
+      free(data);
+   }
+}
+
+static void
+receive_reliable(snl_socket_t *skt, const unsigned char *buf, unsigned int len, unsigned int stream) {
+   // the payload follows the protocol header in the data buffer,
+   // or was parked in order mode
+   memmove(skt->data_buffer, buf, len);
+
+   skt->data_stream = stream;
+
+   receive_datagram(skt, len);
+}
+
+static int
+reliable_state(snl_socket_t *skt) {
+   int ordered = skt->rudp ? skt->rudp->ordered : 0;
+
+   // fresh sequence numbers for every connection
+   snl_rudp_delete(skt->rudp);
+
+   if (!(skt->rudp = snl_rudp_new())) {
+      return (SNL_ERROR_BUFFER);
+   }
+
+   skt->rudp->ordered = ordered;
+
+   return (SNL_ERROR_OK);
+}
+
+static void
+receive_shared(snl_socket_t *skt, void *buf, unsigned int len) {
+   snl_shm_t *shm = skt->shm;
+
+   // lend the record in the ring to the callback as data buffer
+   shm->spare = skt->data_buffer;
+   shm->lent = 1;
+   skt->data_buffer = buf;
+
+   receive_datagram(skt, len);
+
+   skt->data_buffer = shm->spare;
+   shm->spare = NULL;
+   shm->lent = 0;
+}
+
+static void
+receive_loop(snl_socket_t *skt, snl_frame_t *frame) {
+   snl_loop_t *loop = skt->loop;
+
+   // lend the message of the sender to the callback as data buffer
+   loop->spare = skt->data_buffer;
+   loop->lent = frame;
+   skt->data_buffer = frame->data;
+
+   skt->xfer_rcvd += frame->length;
+
+   skt->error_code = SNL_ERROR_OK;
+   skt->event_code = SNL_EVENT_RECEIVE;
+   skt->data_length = frame->length;
+
+   skt->event_callback(skt);
+
+   skt->data_buffer = loop->spare;
+   loop->spare = NULL;
+   loop->lent = NULL;
+
+   snl_frame_unref(frame);
+}
+
+static void
+receive_packed(snl_socket_t *skt, unsigned int length) {
+   snl_framing_t *frm = skt->framing;
+   unsigned char *container = skt->data_buffer;
+   unsigned long long size;
+   unsigned int offset = 0, used;
+
+   frm->spare = container;
+   frm->lent = 1;
+
+   while ((offset < length) && !skt->worker_stop) {
+      used = snl_varint_get(container + offset, length - offset, &size);
+
+      if (!used || (size > length - offset - used)) {
+         skt->data_buffer = frm->spare;
+         skt->error_code = SNL_ERROR_RECEIVE;
+         skt->event_code = SNL_EVENT_ERROR;
+         skt->event_callback(skt);
+         break;
+      }
+
+      offset += used;
+
+      // each message is lent to the callback in place
+      skt->data_buffer = container + offset;
+      skt->data_length = size;
+
+      offset += size;
+
+      skt->error_code = SNL_ERROR_OK;
+      skt->event_code = SNL_EVENT_RECEIVE;
+
+      decode_message(skt);
+
+      if (skt->event_code == SNL_EVENT_UNKNOWN) {
+         // consumed while decoding
+      } else if (!skt->relay || (skt->event_code != SNL_EVENT_RECEIVE) ||
+          snl_relay_send(skt, skt->data_buffer, skt->data_length)) {
+         skt->event_callback(skt);
+      }
+
+      restore_message(skt);
+   }
+
+   skt->data_buffer = frm->spare;
+   frm->spare = NULL;
+   frm->lent = 0;
+}
+
+static void
+receive_records(snl_socket_t *skt) {
+   snl_delimit_t *dl = skt->delimit;
+   unsigned int length, head;
+   unsigned char *record;
+   int error;
+
+   while (!skt->worker_stop && dl->len) {
+      head = dl->head;
+      record = snl_delimit_next(dl, &length, &error);
+
+      if (error) {
+         skt->error_code = error;
+         skt->event_code = SNL_EVENT_ERROR;
+         skt->event_callback(skt);
+         continue;
+      }
+
+      if (!record) break;
+
+      // with the delimiter, if there was one
+      skt->xfer_rcvd += dl->head - head;
+
+      if (skt->shaper) snl_shaper_charge(skt, length);
+
+      // lend the record to the callback as data buffer
+      dl->spare = skt->data_buffer;
+      dl->lent = 1;
+      skt->data_buffer = record;
+
+      skt->error_code = SNL_ERROR_OK;
+      skt->event_code = SNL_EVENT_RECEIVE;
+      skt->data_length = length;
+
+      skt->event_callback(skt);
+
+      skt->data_buffer = dl->spare;
+      dl->spare = NULL;
+      dl->lent = 0;
+   }
+
+   if (dl->len) return;
+
+   // switched back to raw mode, the rest is handed out as it is
+   skt->delimit = NULL;
+   length = dl->tail - dl->head;
+
+   if (length > skt->buffer_length && (record = realloc(skt->data_buffer, length * 2))) {
+      skt->data_buffer = record;
+      skt->buffer_length = length * 2;
+   }
+
+   if (length > skt->buffer_length) {
+      skt->error_code = SNL_ERROR_BUFFER;
+      skt->event_code = SNL_EVENT_ERROR;
+   } else {
+      memcpy(skt->data_buffer, dl->buf + dl->head, length);
+      skt->xfer_rcvd += length;
+
+      skt->error_code = SNL_ERROR_OK;
+      skt->event_code = SNL_EVENT_RECEIVE;
+      skt->data_length = length;
+   }
+
+   snl_delimit_delete(dl);
+
+   if (length) skt->event_callback(skt);
+}
+
+static int
+send_rpc(snl_socket_t *skt, int type, unsigned int id, const void *buf, unsigned int len) {
+   unsigned char stack[RPC_STACK], *msg = stack;
+   int error;
+
+   // header and payload go out as one message
+   if ((len > sizeof (stack) - RPC_HEADER) && !(msg = malloc(len + RPC_HEADER))) {
+      return (SNL_ERROR_BUFFER);
+   }
+
+   snl_rpc_header(msg, type, id);
+   memcpy(msg + RPC_HEADER, buf, len);
+
+   error = send_message(skt, msg, len + RPC_HEADER);
+
+   if (msg != stack) free(msg);
+
+   return (error);
+}
+
+static unsigned int
+codec_tail(snl_socket_t *skt) {
+   snl_codecs_t *codecs = skt->codecs;
+   snl_codec_t crc;
+
+   if (!codecs) return (0);
+
+   snl_crc_codec(&crc);
+
+   // custom stages go in front of the checksum
+   if (codecs->count && (codecs->stage[codecs->count - 1].state == crc.state)) {
+      return (codecs->count - 1);
+   }
+
+   return (codecs->count);
+}
+
+static void
+decode_message(snl_socket_t *skt) {
+   snl_codecs_t *codecs = skt->codecs;
+   unsigned int size;
+   void *data;
+   int error;
+
+   if (skt->event_code != SNL_EVENT_RECEIVE) return;
+
+   // pays for it before the next read
+   if (skt->shaper) snl_shaper_charge(skt, skt->data_length);
+
+   if (codecs) {
+      if ((error = snl_codecs_decode(codecs, skt->data_buffer, skt->data_length, &data, &size))) {
+         skt->error_code = error;
+         skt->event_code = SNL_EVENT_ERROR;
+         return;
+      }
+
+      // lend the message to the callback, until restore_message()
+      codecs->spare = skt->data_buffer;
+      codecs->lent = 1;
+      skt->data_buffer = data;
+      skt->data_length = size;
    }
 
-cleanup:
+   // grants add to our credit and raise no event
+   if (skt->credit) {
+      snl_credit_receive(skt, transmit);
+      if (skt->event_code != SNL_EVENT_RECEIVE) return;
+   }
+
+   // replies complete their call and raise no event
+   if (skt->rpc) snl_rpc_receive(skt);
+
+   // and neither do chunks of a message still incomplete
+   if (skt->mux) snl_mux_receive(skt);
+}
+
+static void
+restore_message(snl_socket_t *skt) {
+   snl_codecs_t *codecs = skt->codecs;
 
-   if (error && (fd >= 0)) close(fd);
+   // lent last, given back first
+   if (skt->rpc) snl_rpc_restore(skt);
+   if (skt->mux) snl_mux_restore(skt);
 
-   skt->file_descriptor = fd;
+   // the callback is done, the peer may send more
+   if (skt->credit) snl_credit_restore(skt, transmit);
 
-   return (error);
-}
+   if (!codecs || !codecs->lent) return;
 
-int
-snl_disconnect(snl_socket_t *skt) {
-   shutdown(skt->file_descriptor, SHUT_RDWR);
+   skt->data_buffer = codecs->spare;
+   codecs->spare = NULL;
+   codecs->lent = 0;
+}
 
-   if (close(skt->file_descriptor)) return (SNL_ERROR_DISCONNECT);
+static int
+local_type(int proto) {
+   switch (proto) {
+      case SNL_PROTO_MSG: return (SOCK_SEQPACKET);
+      case SNL_PROTO_UDP: return (SOCK_DGRAM);
+   }
 
-   return (SNL_ERROR_OK);
+   return (SOCK_STREAM);
 }
 
-int
-snl_init(void) {
-   // catch SIGPIPE to avoid aborting on broken pipes.
-   signal(SIGPIPE, SIG_IGN);
+static socklen_t
+local_address(struct sockaddr_un *addr, int proto, unsigned short port) {
+   const char *name = "msg";
 
-   // set per thread stack size
-   pthread_attr_init(&thread_attr);
-   pthread_attr_setstacksize(&thread_attr, 4 * 65536); // 256 KB
+   switch (proto) {
+      case SNL_PROTO_TCP: name = "tcp"; break;
+      case SNL_PROTO_UDP: name = "udp"; break;
+      case SNL_PROTO_SHM: name = "shm"; break;
+   }
 
-   return (0);
-}
+   memset(addr, 0, sizeof (struct sockaddr_un));
+   addr->sun_family = AF_UNIX;
 
-static unsigned char *
-encrypt(blowfish_t *bf, const void *buffer, unsigned int *len) {
-   unsigned char *buf = NULL;
-   int pad;
+   // abstract namespace, vanishes with the listener
+   snprintf(addr->sun_path + 1, sizeof (addr->sun_path) - 1, "snl-%s-%u", name, port);
 
-   if (!bf) return (NULL);
+   return (offsetof(struct sockaddr_un, sun_path) + 1 + strlen(addr->sun_path + 1));
+}
 
-   pad = 8 - (*len % 8);
+static int
+connect_local(snl_socket_t *skt, unsigned short port) {
+   int fd, buf = LOCAL_SNDBUF;
+   struct sockaddr_un addr;
+   struct timeval sto;
+   snl_shm_t *shm;
+   socklen_t len;
 
-   if (!(buf = malloc(*len + pad))) {
-      return (NULL);
+   // set send timeout
+   write_timeout(skt, &sto);
+
+   if ((fd = socket(AF_UNIX, local_type(skt->protocol), 0)) < 0) {
+      return (SNL_ERROR_OPEN);
    }
 
-   memcpy(buf, buffer, *len);
-   memset(buf + *len, pad, pad);
-   *len += pad;
+   len = local_address(&addr, skt->protocol, port);
 
-   if (bf_encrypt(bf, buf, *len)) {
-      free(buf);
-      return (NULL);
+   setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &sto, sizeof (sto));
+   setsockopt(fd, SOL_SOCKET, SO_SNDBUF,   &buf, sizeof (buf));
+
+   while (connect(fd, (SA *)&addr, len) == -1) {
+      if (errno != EINTR) {
+         close(fd);
+         return (SNL_ERROR_CONNECT);
+      }
    }
 
-   return (buf);
-}
+   if (skt->protocol == SNL_PROTO_SHM) {
+      // the connection stays open to detect the end of the peer
+      if (!(shm = snl_shm_offer(fd))) {
+         close(fd);
+         return (SNL_ERROR_BUFFER);
+      }
 
-static unsigned char *
-decrypt(blowfish_t *bf, void *buffer, unsigned int *len) {
-   unsigned char *buf = (unsigned char *)buffer;
-   int pad;
+      snl_shm_delete(skt->shm);
+      skt->shm = shm;
+   }
 
-   if (!bf) return (NULL);
+   if (skt->sender) skt->sender->error = SNL_ERROR_OK;
 
-   if (bf_decrypt(bf, buf, *len)) {
-      return (NULL);
-   } else {
-      pad = buf[*len - 1];
+   skt->file_descriptor = fd;
 
-      if (pad < 1 || pad > 8) {
-         return (NULL);
-      } else {
-         *len -= pad;
-         memset(&buf[*len], 0, pad);
-      }
+   switch (skt->protocol) {
+      case SNL_PROTO_SHM: skt->worker_type = WORKER_THREAD_SHARED; break;
+      case SNL_PROTO_UDP: skt->worker_type = WORKER_THREAD_IDLE;   break;
+      default:            skt->worker_type = WORKER_THREAD_READ;   break;
    }
 
-   return (buf);
+   return (SNL_ERROR_OK);
 }
 
 static void *
 worker_thread(void *arg) {
    int remaining, received, new_fd, max_fd, fd, error;
+   struct mmsghdr msgs[RECV_BATCH_MAX];
+   struct sockaddr_in peer[RECV_BATCH_MAX];
+   struct iovec iov[RECV_BATCH_MAX];
+   char control[RECV_BATCH_MAX][CMSG_SPACE(sizeof (int))];
+   unsigned char syn[RUDP_HEADER_SIZE];
    snl_socket_t *skt = (snl_socket_t *)arg;
    struct sockaddr_in addr;
-   unsigned int length;
+   unsigned int length, batch, flags, i;
+   unsigned long long size;
+   int on = 1;
    struct sockaddr *sa;
+   struct pollfd pfd;
+   struct timespec ts;
+   long long next, now, delay;
    struct timeval tv;
    socklen_t len;
    fd_set fds;
@@ -589,9 +2853,44 @@ worker_start:
 
          fd = skt->file_descriptor;
 
+         // nothing arrives before the peer got its first credit
+         if (skt->credit && (error = snl_credit_open(skt, transmit))) {
+            goto worker_stop;
+         }
+
+         if (skt->timeout && (error = snl_timeout_open(skt))) {
+            goto worker_stop;
+         }
+
+         // the default 50us timer slack would double a small budget
+         if (skt->sender && skt->sender->budget) {
+            prctl(PR_SET_TIMERSLACK, 1000); // 1 us
+         }
+
          // we repeat until the connection has been closed
          while (!skt->worker_stop) {
-            if (skt->protocol == SNL_PROTO_TCP) {
+            // collect completions, write what senders left behind and
+            // watch the timers while idle
+            if (skt->zerocopy || skt->sender || skt->rpc || skt->timeout) {
+               if ((error = wait_readable(skt))) goto worker_stop;
+               if (skt->worker_stop) goto worker_stop;
+            }
+
+            // over the receive rate, the data waits in the kernel
+            if (skt->shaper) {
+               snl_shaper_pause(skt);
+               if (skt->worker_stop) goto worker_stop;
+            }
+
+            flags = 0;
+
+            if (skt->delimit) {
+               // records are raised as soon as they are complete
+               if ((error = snl_delimit_fill(skt->delimit, fd))) goto worker_stop;
+
+               receive_records(skt);
+               continue;
+            } else if (skt->protocol == SNL_PROTO_TCP) {
                // read one line
                length = 0;
                ptr = skt->data_buffer;
@@ -607,29 +2906,116 @@ worker_start:
                } else {
                   length = received;
                }
-            } else {
-               // read length of next datagram
-               ptr = (char *)&length;
-               remaining = sizeof (length);
-               while (remaining) {
-                  received = read(fd, ptr, remaining);
+            } else if (skt->local) {
+               // the kernel keeps message boundaries, peek at the size
+               received = recv(fd, NULL, 0, MSG_PEEK | MSG_TRUNC);
 
-                  if (received == 0) {
+               if (received < 0) {
+                  if (errno == EINTR) continue;
+
+                  error = SNL_ERROR_RECEIVE;
+                  goto worker_stop;
+               }
+
+               // increase buffer size if necessary
+               if ((unsigned int)received > skt->buffer_length) {
+                  skt->buffer_length = received * 2;
+                  if (!(skt->data_buffer = realloc(skt->data_buffer, skt->buffer_length))) {
+                     error = SNL_ERROR_BUFFER;
+                     goto worker_stop;
+                  }
+               }
+
+               received = recv(fd, skt->data_buffer, skt->buffer_length, 0);
+
+               if (received < 0) {
+                  if (errno == EINTR) continue;
+
+                  error = SNL_ERROR_RECEIVE;
+                  goto worker_stop;
+               }
+
+               // an empty message or the end of the connection
+               if (!received) {
+                  pfd.fd = fd;
+                  pfd.events = POLLRDHUP;
+
+                  if ((poll(&pfd, 1, 0) > 0) && (pfd.revents & (POLLRDHUP | POLLHUP))) {
                      error = SNL_ERROR_CLOSED;
                      goto worker_stop;
-                  } else if (received < 0) {
-                     if (errno == EINTR) continue;
+                  }
+               }
+
+               length = received;
+            } else {
+               if (SNL_FRAMING_V2(skt)) {
+                  // flags and varint length
+                  if ((error = snl_framing_read(fd, &flags, &size))) {
+                     goto worker_stop;
+                  }
+
+                  // nothing but a sign of life
+                  if (flags & FRAME_HEARTBEAT) {
+                     if (size) {
+                        error = SNL_ERROR_PROTOCOL;
+                        goto worker_stop;
+                     }
+
+                     if (skt->timeout) skt->timeout->reading = 0;
+                     continue;
+                  }
 
+                  // the wire allows 64 bit, data_length does not
+                  if (size > FRAME_LENGTH_MAX) {
                      error = SNL_ERROR_RECEIVE;
                      goto worker_stop;
-                  } else {
-                     ptr += received;
-                     remaining -= received;
                   }
-               }
 
-               // convert back to host byte order
-               length = ntohl(length);
+                  length = size;
+               } else {
+                  // read length of next datagram
+                  ptr = (char *)&length;
+                  remaining = sizeof (length);
+                  while (remaining) {
+                     received = read(fd, ptr, remaining);
+
+                     if (received == 0) {
+                        error = SNL_ERROR_CLOSED;
+                        goto worker_stop;
+                     } else if (received < 0) {
+                        if (errno == EINTR) continue;
+
+                        error = SNL_ERROR_RECEIVE;
+                        goto worker_stop;
+                     } else {
+                        ptr += received;
+                        remaining -= received;
+                     }
+                  }
+
+                  // convert back to host byte order
+                  length = ntohl(length);
+
+                  // payload goes from socket to socket in the kernel
+                  if (skt->relay) {
+                     error = snl_relay_forward(skt, length);
+
+                     if (error == SNL_ERROR_OK) continue;
+
+                     if (error == SNL_ERROR_SEND) {
+                        skt->error_code = error;
+                        skt->event_code = SNL_EVENT_ERROR;
+                        skt->event_callback(skt);
+
+                        error = SNL_ERROR_OK;
+                        continue;
+                     }
+
+                     if (error != SNL_ERROR_PROTOCOL) goto worker_stop;
+
+                     error = SNL_ERROR_OK;
+                  }
+               }
 
                // increase buffer size if necessary
                if (length > skt->buffer_length) {
@@ -661,6 +3047,10 @@ worker_start:
                }
             }
 
+            if (skt->timeout) {
+               skt->timeout->reading = 0;
+            }
+
             if (skt->worker_stop) {
                goto worker_stop;
             }
@@ -678,7 +3068,35 @@ worker_start:
                skt->data_length = length;
             }
 
-            skt->event_callback(skt);
+            // container of several messages
+            if ((flags & FRAME_PACKED) && (skt->event_code == SNL_EVENT_RECEIVE)) {
+               receive_packed(skt, length);
+               continue;
+            }
+
+            decode_message(skt);
+
+            // sent on instead of raising the event
+            if (skt->relay && (skt->event_code == SNL_EVENT_RECEIVE)) {
+               error = snl_relay_send(skt, skt->data_buffer, skt->data_length);
+
+               if (error == SNL_ERROR_OK) {
+                  restore_message(skt);
+                  continue;
+               }
+
+               if (error != SNL_ERROR_PROTOCOL) {
+                  skt->error_code = error;
+                  skt->event_code = SNL_EVENT_ERROR;
+               }
+
+               error = SNL_ERROR_OK;
+            }
+
+            // unless it was a reply to one of our calls
+            if (skt->event_code != SNL_EVENT_UNKNOWN) skt->event_callback(skt);
+
+            restore_message(skt);
          }
       break;
 
@@ -689,6 +3107,12 @@ worker_start:
 
          // wait for connections
          while (!skt->worker_stop) {
+            // over the accept rate, new connections wait in the backlog
+            if (skt->admission && (delay = snl_admission_wait(skt->admission))) {
+               usleep(delay < 5000 ? delay : 5000);
+               continue;
+            }
+
             tv.tv_sec = 0;
             tv.tv_usec = 5000; // 5 ms
 
@@ -705,32 +3129,58 @@ worker_start:
                goto worker_stop;
             }
 
-            sa = (SA *)&addr; len = sizeof (addr);
-            if (fd >= 0 && FD_ISSET(fd, &fds)) {
-               new_fd = accept(fd, sa, &len);
+            if ((fd < 0) || !FD_ISSET(fd, &fds)) continue;
+
+            // all pending connections at once, a datagram at a time
+            do {
+               sa = (SA *)&addr; len = sizeof (addr);
+
+               if (skt->protocol == SNL_PROTO_RUDP) {
+                  // anything but a new peer's SYN is ignored
+                  received = recvfrom(fd, syn, sizeof (syn), 0, sa, &len);
+                  if (received < 0) break;
+
+                  new_fd = snl_rudp_accept(skt, syn, received, &addr);
+                  if (new_fd < 0) break;
+               } else if (skt->protocol == SNL_PROTO_LOOP) {
+                  // the handle of the next waiting link
+                  new_fd = snl_loop_accept(skt);
+                  if (new_fd < 0) break;
+               } else {
+                  new_fd = accept4(fd, sa, &len, SOCK_CLOEXEC);
+               }
 
                if (new_fd < 0) {
-                  if ((errno == EAGAIN) || (errno == EINTR)) continue;
+                  if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)) break;
 
                   skt->error_code = SNL_ERROR_ACCEPT;
                   skt->event_code = SNL_EVENT_ERROR;
-               } else {
-                  skt->error_code = SNL_ERROR_OK;
-                  skt->event_code = SNL_EVENT_ACCEPT;
+                  skt->event_callback(skt);
+                  break;
+               }
 
-                  skt->client_port = addr.sin_port;
-                  skt->client_ip = ntohl(addr.sin_addr.s_addr);
-                  skt->client_fd = new_fd;
+               // over the connection limit, shed it right away
+               if (skt->admission && snl_admission_admit(skt->admission, new_fd)) {
+                  close(new_fd);
+                  continue;
                }
 
+               skt->error_code = SNL_ERROR_OK;
+               skt->event_code = SNL_EVENT_ACCEPT;
+
+               skt->client_port = addr.sin_port;
+               skt->client_ip = ntohl(addr.sin_addr.s_addr);
+               skt->client_fd = new_fd;
+
                skt->event_callback(skt);
-            }
+
+               if (skt->admission) snl_admission_settle(skt->admission, new_fd);
+            } while (!skt->worker_stop && (skt->protocol != SNL_PROTO_RUDP) &&
+                     !(skt->admission && snl_admission_wait(skt->admission)));
          }
       break;
 
       case WORKER_THREAD_RECEIVE:
-         memset(&addr, 0, sizeof (addr));
-
          fd = skt->file_descriptor;
 
          // set buffer size to maximum size of udp datagrams
@@ -742,6 +3192,26 @@ worker_start:
             goto worker_stop;
          }
 
+         // let the kernel coalesce our fragments (generic receive offload)
+         if (skt->fragment) {
+            setsockopt(fd, IPPROTO_UDP, UDP_GRO, &on, sizeof (on));
+         }
+
+         // extra buffers for batched receive, slot 0 is the data buffer
+         batch = skt->recv_batch ? skt->recv_batch : 1;
+         if ((batch > 1) && !skt->recv_slots) {
+            if (!(skt->recv_slots = calloc(batch, sizeof (void *)))) {
+               error = SNL_ERROR_BUFFER;
+               goto worker_stop;
+            }
+            for (i=1; i<batch; i++) {
+               if (!(skt->recv_slots[i] = malloc(UDP_PAYLOAD_SIZE))) {
+                  error = SNL_ERROR_BUFFER;
+                  goto worker_stop;
+               }
+            }
+         }
+
          // wait for messages
          while (!skt->worker_stop) {
             tv.tv_sec = 0;
@@ -760,38 +3230,149 @@ worker_start:
                goto worker_stop;
             }
 
-            sa = (SA *)&addr; len = sizeof (addr);
-            if (fd >= 0 && FD_ISSET(fd, &fds)) {
-               received = recvfrom(fd, skt->data_buffer, skt->buffer_length, 0, sa, &len);
+            if (fd < 0 || !FD_ISSET(fd, &fds)) continue;
 
-               if (received < 0) {
-                  if ((errno == EAGAIN) || (errno == EINTR)) continue;
+            memset(msgs, 0, batch * sizeof (struct mmsghdr));
+            for (i=0; i<batch; i++) {
+               iov[i].iov_base = i ? skt->recv_slots[i] : skt->data_buffer;
+               iov[i].iov_len  = skt->buffer_length;
 
-                  skt->error_code = SNL_ERROR_RECEIVE;
-                  skt->event_code = SNL_EVENT_ERROR;
+               msgs[i].msg_hdr.msg_iov     = &iov[i];
+               msgs[i].msg_hdr.msg_iovlen  = 1;
+               msgs[i].msg_hdr.msg_name    = &peer[i];
+               msgs[i].msg_hdr.msg_namelen = sizeof (peer[i]);
+
+               if (skt->fragment) {
+                  msgs[i].msg_hdr.msg_control    = control[i];
+                  msgs[i].msg_hdr.msg_controllen = sizeof (control[i]);
+               }
+            }
+
+            // fetch as many datagrams as are waiting (up to batch)
+            received = recvmmsg(fd, msgs, batch, MSG_DONTWAIT, NULL);
+
+            if (received < 0) {
+               if ((errno == EAGAIN) || (errno == EINTR)) continue;
+
+               skt->error_code = SNL_ERROR_RECEIVE;
+               skt->event_code = SNL_EVENT_ERROR;
+               skt->event_callback(skt);
+
+               continue;
+            }
+
+            for (i=0; i<(unsigned int)received; i++) {
+               // hand the slot to the callback as data buffer
+               if (i) {
+                  ptr = skt->data_buffer;
+                  skt->data_buffer = skt->recv_slots[i];
+                  skt->recv_slots[i] = ptr;
+               }
+
+               length = msgs[i].msg_len;
+
+               skt->client_port = peer[i].sin_port;
+               skt->client_ip = ntohl(peer[i].sin_addr.s_addr);
+               skt->client_fd = fd;
+
+               if (skt->fragment) {
+                  receive_fragments(skt, &msgs[i].msg_hdr, length);
                } else {
-                  length = received;
+                  receive_datagram(skt, length);
+               }
 
-                  skt->client_port = addr.sin_port;
-                  skt->client_ip = ntohl(addr.sin_addr.s_addr);
-                  skt->client_fd = fd;
+               if (i) {
+                  ptr = skt->data_buffer;
+                  skt->data_buffer = skt->recv_slots[i];
+                  skt->recv_slots[i] = ptr;
+               }
+            }
+         }
+      break;
 
-                  // update counter
-                  skt->xfer_rcvd += length;
+      case WORKER_THREAD_RELIABLE:
+         fd = skt->file_descriptor;
 
-                  // decrypt and strip padding bytes
-                  if (skt->cipher && !decrypt(skt->cipher, skt->data_buffer, &length)) {
-                     skt->error_code = SNL_ERROR_CIPHER;
-                     skt->event_code = SNL_EVENT_ERROR;
-                  } else {
-                     skt->error_code = SNL_ERROR_OK;
-                     skt->event_code = SNL_EVENT_RECEIVE;
+         // set buffer size to maximum size of udp datagrams
+         skt->buffer_length = UDP_PAYLOAD_SIZE;
 
-                     skt->data_length = length;
-                  }
+         // allocate buffer for received data
+         if (!(skt->data_buffer = realloc(skt->data_buffer, skt->buffer_length))) {
+            error = SNL_ERROR_BUFFER;
+            goto worker_stop;
+         }
+
+         pfd.fd = fd;
+         pfd.events = POLLIN;
+
+         while (!skt->worker_stop) {
+            // send acks and retransmit overdue packets
+            if ((error = snl_rudp_timer(skt, &next))) goto worker_stop;
+
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            now = (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+            if (next < now) next = now;
+
+            ts.tv_sec  = (next - now) / 1000000;
+            ts.tv_nsec = (next - now) % 1000000 * 1000;
+
+            if (ppoll(&pfd, 1, &ts, NULL) <= 0) continue;
+
+            if (skt->worker_stop) {
+               goto worker_stop;
+            }
+
+            // process everything waiting, then ack it at once
+            for (i=0; i<RECV_BATCH_MAX; i++) {
+               received = recv(fd, skt->data_buffer, skt->buffer_length, MSG_DONTWAIT);
+
+               if (received < 0) {
+                  if (errno == EINTR) continue;
+                  if (errno == EAGAIN) break;
+
+                  // the peer port is gone
+                  error = (errno == ECONNREFUSED) ? SNL_ERROR_CLOSED : SNL_ERROR_RECEIVE;
+                  goto worker_stop;
                }
- 
-               skt->event_callback(skt);
+
+               skt->client_fd = fd;
+
+               if ((error = snl_rudp_input(skt, skt->data_buffer, received, receive_reliable))) {
+                  goto worker_stop;
+               }
+
+               if (skt->worker_stop) {
+                  goto worker_stop;
+               }
+            }
+         }
+      break;
+
+      case WORKER_THREAD_SHARED:
+         // records are delivered in place, no receive buffer needed
+         while (!skt->worker_stop) {
+            if ((error = snl_shm_receive(skt, receive_shared))) {
+               goto worker_stop;
+            }
+
+            if ((error = snl_shm_wait(skt, 5))) {
+               // deliver what the peer wrote before leaving
+               if (error == SNL_ERROR_CLOSED) snl_shm_receive(skt, receive_shared);
+               goto worker_stop;
+            }
+         }
+      break;
+
+      case WORKER_THREAD_LOOP:
+         // messages are delivered in the buffer of the sender
+         while (!skt->worker_stop) {
+            if ((error = snl_loop_receive(skt, receive_loop))) {
+               goto worker_stop;
+            }
+
+            if ((error = snl_loop_wait(skt, 5))) {
+               if (error == SNL_ERROR_CLOSED) snl_loop_receive(skt, receive_loop);
+               goto worker_stop;
             }
          }
       break;
@@ -802,6 +3383,23 @@ worker_stop:
 
    skt->worker_type = WORKER_THREAD_UNKNOWN;
 
+   // the timers are done with this connection, a missed read deadline
+   // is what made the read fail
+   if (skt->timeout) {
+      snl_timeout_close(skt->timeout);
+
+      if (skt->timeout->fired & TIMEOUT_READ) error = SNL_ERROR_TIMEOUT;
+   }
+
+   // nobody is going to answer them on this connection
+   if (skt->rpc) snl_rpc_cancel(skt, error ? error : SNL_ERROR_CLOSED);
+
+   // release senders waiting for credit
+   if (skt->credit) snl_credit_cancel(skt, error ? error : SNL_ERROR_CLOSED);
+
+   // room for another one at the listener
+   if (skt->admitted) snl_admission_release(skt);
+
    if (error && !skt->worker_stop) {
       skt->error_code = error;
       skt->event_code = SNL_EVENT_ERROR;
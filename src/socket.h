@@ -36,6 +36,7 @@
 #define _SNL_H_
 
 #include <pthread.h>
+#include <sys/types.h>
 
 #include <snl/blowfish.h>
 
@@ -67,6 +68,29 @@ typedef struct snl_socket_t {
    int worker_stop;
    pthread_t worker_tid;
    blowfish_t *cipher;
+   struct snl_sender_t *sender;
+   unsigned int recv_batch;
+   void **recv_slots;
+   void *multicast;
+   struct snl_fragment_t *fragment;
+   struct snl_rudp_t *rudp;
+   struct snl_shm_t *shm;
+   struct snl_loop_t *loop;
+   struct snl_relay_t *relay;
+   struct snl_zerocopy_t *zerocopy;
+   struct snl_framing_t *framing;
+   struct snl_compress_t *compress;
+   struct snl_codecs_t *codecs;
+   struct snl_delimit_t *delimit;
+   struct snl_credit_t *credit;
+   struct snl_shaper_t *shaper;
+   struct snl_admission_t *admission;
+   struct snl_admission_t *admitted;
+   struct snl_rpc_t *rpc;
+   struct snl_mux_t *mux;
+   struct snl_timeout_t *timeout;
+   int local;
+   unsigned int data_stream;
    void *user_data;
    void (*event_callback)();
 } snl_socket_t;
@@ -79,9 +103,142 @@ typedef struct snl_socket_t {
 enum {
    SNL_PROTO_MSG,       ///< stream socket
    SNL_PROTO_UDP,       ///< datagram socket
-   SNL_PROTO_TCP        ///< stream socket without packet header
+   SNL_PROTO_TCP,       ///< stream socket without packet header
+   SNL_PROTO_RUDP,      ///< reliable datagram socket
+   SNL_PROTO_SHM,       ///< shared memory rings between local processes
+   SNL_PROTO_LOOP       ///< in-process connection between two threads
 };
 
+/**
+   \brief Slow group member policy enumeration.
+
+   What snl_group_send() does with a member whose pending data exceeds
+   the group limit.
+*/
+enum {
+   SNL_POLICY_DROP,        ///< skip the message for this member
+   SNL_POLICY_QUEUE,       ///< queue the message anyway
+   SNL_POLICY_DISCONNECT   ///< shut down the connection of this member
+};
+
+/**
+   \brief Send priority enumeration.
+
+   Lanes of the send queue of a thread safe socket, see snl_send_priority().
+*/
+enum {
+   SNL_PRIORITY_HIGH,      ///< overtakes everything still unsent
+   SNL_PRIORITY_NORMAL,    ///< lane of snl_send()
+   SNL_PRIORITY_LOW        ///< sent when nothing else is waiting
+};
+
+/**
+   \brief Rate limit enumeration.
+
+   Direction a token bucket limits and unit it counts, see snl_rate_limit().
+*/
+enum {
+   SNL_RATE_SEND,          ///< outgoing messages
+   SNL_RATE_RECEIVE,       ///< incoming messages
+   SNL_RATE_BYTES = 0,     ///< one token per payload byte
+   SNL_RATE_MESSAGES       ///< one token per message
+};
+
+/**
+   \brief   Opaque token bucket object
+
+   May be shared by any number of sockets to limit their aggregate rate.
+   See snl_bucket_new().
+*/
+typedef struct snl_bucket_t snl_bucket_t;
+
+/**
+   \brief   Opaque broadcast group object
+
+   A group holds a set of sockets that all receive the same messages.
+   See snl_group_new().
+*/
+typedef struct snl_group_t snl_group_t;
+
+/**
+   \brief   Completion of a remote procedure call
+
+   Called from the worker thread of the socket with the reply, which is
+   only valid until the callback returns, or with SNL_ERROR_TIMEOUT when
+   the deadline passed, or the error that ended the connection.
+*/
+typedef void (*snl_rpc_callback_t)(snl_socket_t *skt, int error, const void *buf, unsigned int len, void *data);
+
+/**
+   \brief   Opaque pending call object, see snl_rpc_submit()
+*/
+typedef struct snl_rpc_future_t snl_rpc_future_t;
+
+/**
+   \brief   Opaque HTTP/1.1 server object
+
+   Serves persistent and pipelined connections on SNL_PROTO_TCP.
+   See snl_http_new().
+*/
+typedef struct snl_http_t snl_http_t;
+
+#define SNL_HTTP_HEADERS 32 ///< max number of header fields of a request
+
+/**
+   \brief   One header field of a HTTP request, not \0 terminated
+*/
+typedef struct snl_http_header_t {
+   const char *name;
+   unsigned int name_length;
+   const char *value;               ///< without surrounding whitespace
+   unsigned int value_length;
+} snl_http_header_t;
+
+/**
+   \brief   A parsed HTTP request
+
+   All strings point into the receive buffer of the connection, are not
+   \0 terminated and only valid until the handler returns.
+*/
+typedef struct snl_http_request_t {
+   const char *method;
+   unsigned int method_length;
+   const char *target;              ///< path and query, as sent
+   unsigned int target_length;
+   int version;                     ///< 10 for HTTP/1.0, 11 for HTTP/1.1
+   int keep_alive;                  ///< connection stays open after this
+   snl_http_header_t header[SNL_HTTP_HEADERS];
+   unsigned int headers;
+   const char *body;                ///< Content-Length bytes or NULL
+   unsigned int body_length;
+} snl_http_request_t;
+
+/**
+   \brief   Request handler of a HTTP server
+
+   Called from the worker thread of the connection, which answers with
+   snl_http_respond() before returning.
+*/
+typedef void (*snl_http_handler_t)(snl_socket_t *skt, const snl_http_request_t *req, void *data);
+
+/**
+   \brief   One stage of the codec pipeline of a socket
+
+   encode() transforms len bytes at buf into out, which has room for len
+   plus overhead bytes, and stores the new length in size. If inplace is
+   set, out may be the same as buf. decode() reverses it, in place or into
+   a buffer of its own, and points out to the result. Both return 0 or an
+   error code. release() frees the state, if not NULL.
+*/
+typedef struct snl_codec_t {
+   unsigned int overhead;  ///< max number of bytes encode() adds
+   int inplace;            ///< encode() can work with out == buf
+   int (*encode)(void *state, const void *buf, unsigned int len, void *out, unsigned int *size);
+   int (*decode)(void *state, void *buf, unsigned int len, void **out, unsigned int *size);
+   void (*release)(void *state);
+   void *state;
+} snl_codec_t;
+
 /**
    \brief Event type enumeration.
 
@@ -92,7 +249,8 @@ enum {
    SNL_EVENT_ERROR,
    SNL_EVENT_ACCEPT,
    SNL_EVENT_RECEIVE,
-   SNL_EVENT_READ
+   SNL_EVENT_READ,
+   SNL_EVENT_SENT
 };
 
 /**
@@ -115,7 +273,12 @@ enum {
    SNL_ERROR_THREAD,       ///< 13: could not start worker thread
    SNL_ERROR_TIMEOUT,      ///< 14: timeout error
    SNL_ERROR_BUSY,         ///< 15: socket is already connected or listening
-   SNL_ERROR_CIPHER        ///< 16: could not (de)cipher payload
+   SNL_ERROR_CIPHER,       ///< 16: could not (de)cipher payload
+   SNL_ERROR_OPTION,       ///< 17: could not set socket option
+   SNL_ERROR_FILE,         ///< 18: could not read file
+   SNL_ERROR_COMPRESS,     ///< 19: could not (de)compress payload
+   SNL_ERROR_CHECKSUM,     ///< 20: payload got corrupted on the way
+   SNL_ERROR_LENGTH        ///< 21: record exceeds the max length
 };
 
 /**
@@ -165,6 +328,414 @@ int snl_socket_delete(snl_socket_t *skt);
 */
 int snl_send(snl_socket_t *skt, const void *buf, unsigned int len);
 
+/**
+   \brief   Send a datagram on a stream of a reliable UDP connection
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   stream <unsigned int> stream number (0 - 15)
+   \param   buf <const void *> pointer to the data to send
+   \param   len <unsigned int> length of that data
+   \return  0 on success or a negative error code
+
+   SNL_PROTO_RUDP connections carry 16 independent streams, snl_send()
+   uses stream 0. In ordered mode a lost datagram only holds back later
+   datagrams of the same stream. The receiver finds the stream number in
+   the data_stream member of the socket. For all other protocols the
+   stream is ignored.
+
+   \note
+   snl_send() blocks while 256 datagrams wait for their acknowledgement
+   and fails with SNL_ERROR_TIMEOUT, if the peer does not catch up within
+   the send timeout.
+*/
+int snl_send_stream(snl_socket_t *skt, unsigned int stream, const void *buf, unsigned int len);
+
+/**
+   \brief   Send a part of a file as one datagram
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   fd <int> file descriptor of a regular file, opened for reading
+   \param   offset <off_t> position of the first byte in the file
+   \param   len <unsigned int> number of bytes to send
+   \return  0 on success or a negative error code
+
+   The receiver gets the same SNL_EVENT_RECEIVE as for snl_send(). On a
+   TCP connection without cipher the header is written and the payload is
+   passed to sendfile(), so the file content is never copied to user
+   space. With a cipher, the file is mapped in 1MB windows and encrypted
+   window by window. All other sockets map the file and send it with
+   snl_send().
+
+   Fails with SNL_ERROR_FILE, if the file is shorter than offset + len.
+*/
+int snl_send_file(snl_socket_t *skt, int fd, off_t offset, unsigned int len);
+
+/**
+   \brief   Send several messages with a single write
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   bufs <const void **> array of count payload pointers
+   \param   lens <const unsigned int *> array of count payload lengths
+   \param   count <unsigned int> number of messages
+   \return  0 on success or a negative error code
+
+   With framing version 2 in effect (see snl_framing()), the messages are
+   packed into one frame, which is padded and encrypted only once. The
+   receiver raises a SNL_EVENT_RECEIVE for each of them, in order. On all
+   other sockets this is the same as calling snl_send() for every message.
+*/
+int snl_send_batch(snl_socket_t *skt, const void **bufs, const unsigned int *lens, unsigned int count);
+
+/**
+   \brief   Allocate a message buffer for snl_send_message()
+   \param   len <unsigned int> size of the buffer
+   \return  pointer to the buffer or NULL on error
+*/
+void *snl_message_new(unsigned int len);
+
+/**
+   \brief   Release a message buffer that was not sent
+   \param   msg <void *> buffer of snl_message_new()
+*/
+void snl_message_free(void *msg);
+
+/**
+   \brief   Send a message buffer and hand it over to the library
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   msg <void *> buffer of snl_message_new(), filled in by the caller
+   \param   len <unsigned int> bytes used of that buffer
+   \return  0 on success or a negative error code
+
+   The buffer belongs to the library from now on, also on error. On an
+   SNL_PROTO_LOOP connection it is queued to the peer as it is and lent
+   to its callback, nothing is copied. All other sockets send it with
+   snl_send() and release it. SNL_ERROR_LENGTH is returned if len is
+   larger than the buffer.
+*/
+int snl_send_message(snl_socket_t *skt, void *msg, unsigned int len);
+
+/**
+   \brief   Deliver reliable UDP datagrams in order
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   enable <int> 1 for ordered, 0 for unordered delivery (default)
+   \return  0 on success or a negative error code
+
+   An SNL_PROTO_RUDP socket delivers every datagram exactly once, but by
+   default in the order they arrive. In ordered mode datagrams that
+   overtook a lost one are held back until the retransmission arrives.
+   Must be called on the receiving socket before snl_connect() or
+   snl_accept().
+*/
+int snl_ordered(snl_socket_t *skt, int enable);
+
+/**
+   \brief   Allow concurrent sending from multiple threads
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   enable <int> 1 to enable, 0 to disable thread safe sending
+   \return  0 on success or a negative error code
+
+   In thread safe mode snl_send() builds the complete frame (header and
+   encrypted payload) in one buffer and pushes it onto a lock free queue.
+   The first thread that finds the socket idle becomes the drainer and
+   writes all queued frames with as few writev() calls as possible, while
+   all other threads return immediately after queueing their frame. Once
+   more than 1MB is queued, they wait for their turn instead, and the
+   drainer hands over after writing what was queued before it, so that
+   no thread writes for faster producers forever.
+
+   \note
+   A write error is reported to the draining thread and to every later
+   call of snl_send(). Do not toggle this mode while other threads are
+   still sending.
+*/
+int snl_threadsafe(snl_socket_t *skt, int enable);
+
+/**
+   \brief   Queue a message with a priority and a time to live
+   \param   skt <snl_socket_t *> pointer to thread safe socket
+   \param   buf <const void *> pointer to the data to send
+   \param   len <unsigned int> length of that data
+   \param   priority <int> SNL_PRIORITY_HIGH, _NORMAL or _LOW
+   \param   ttl <unsigned int> ms the message stays worth sending, 0 forever
+   \return  0 on success or a negative error code
+
+   The send queue of snl_threadsafe() has one lane per priority. Whenever
+   the socket takes more data, the drainer picks from the highest lane,
+   and a message of a higher priority also overtakes those of a lower one
+   that are batched already but not yet written. Messages still unsent
+   when their ttl runs out are dropped and counted, see snl_send_expired().
+   Datagrams are never queued, they go out at once and ignore both.
+*/
+int snl_send_priority(snl_socket_t *skt, const void *buf, unsigned int len, int priority, unsigned int ttl);
+
+/**
+   \brief   Number of messages dropped at the end of their ttl
+   \param   skt <snl_socket_t *> pointer to socket
+   \return  messages dropped since snl_threadsafe() was enabled
+*/
+unsigned int snl_send_expired(snl_socket_t *skt);
+
+/**
+   \brief   Merge small messages into fewer writes
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   budget <unsigned int> max us a message may wait, 0 to disable
+   \param   threshold <unsigned int> bytes written without waiting, 0 for 64KB
+   \return  0 on success or a negative error code
+
+   With TCP_NODELAY every snl_send() becomes a TCP segment of its own. In
+   coalescing mode, SNL_PROTO_MSG and SNL_PROTO_TCP network sockets queue
+   messages like in thread safe mode (which gets enabled), and write all
+   of them with a single writev() once the oldest one waited for budget
+   microseconds, or threshold bytes are pending. snl_flush() writes them
+   right away.
+
+   Must be enabled before snl_connect() or snl_accept(), both values can
+   be changed later. Disabling flushes what is still waiting.
+
+   \note
+   The deadline is served by the worker thread of the socket while it
+   waits for data. A worker busy in a callback or in the middle of a
+   message leaves it to the timer thread, which writes up to a millisecond
+   late and only what the socket takes without blocking.
+*/
+int snl_coalesce(snl_socket_t *skt, unsigned int budget, unsigned int threshold);
+
+/**
+   \brief   Write all messages waiting in the send queue
+   \param   skt <snl_socket_t *> pointer to socket
+   \return  0 on success or a negative error code
+
+   Writes the messages queued in coalescing or thread safe mode right
+   away, unless another thread is already writing them.
+*/
+int snl_flush(snl_socket_t *skt);
+
+/**
+   \brief   Use unix domain sockets for connections on this host
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   enable <int> 1 for local, 0 for network sockets (default)
+   \return  0 on success or a negative error code
+
+   A local socket listens and connects on an abstract unix address named
+   after protocol and port, instead of TCP/IP loopback. SNL_PROTO_MSG
+   uses SOCK_SEQPACKET, so the kernel keeps the message boundaries and no
+   length header is sent. SNL_PROTO_TCP uses SOCK_STREAM and SNL_PROTO_UDP
+   SOCK_DGRAM. Must be called before snl_connect() or snl_listen(),
+   accepted connections become local automatically.
+
+   \note
+   The size of a local SNL_PROTO_MSG message is limited by the socket
+   send buffer, which is raised to 4MB as far as net.core.wmem_max allows.
+*/
+int snl_local(snl_socket_t *skt, int enable);
+
+/**
+   \brief   Address an in-process socket by name
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   name <const char *> up to 63 characters
+   \return  0 on success or a negative error code
+
+   An SNL_PROTO_LOOP listener given a name is found by sockets given the
+   same name, the port passed to snl_listen() and snl_connect() is ignored
+   then and may be 0. Sockets without a name are matched by port. Must be
+   called before snl_listen() or snl_connect().
+*/
+int snl_name(snl_socket_t *skt, const char *name);
+
+/**
+   \brief   Forward all received messages to another socket
+   \param   skt <snl_socket_t *> pointer to receiving socket
+   \param   peer <snl_socket_t *> pointer to sending socket, NULL to stop
+   \return  0 on success or a negative error code
+
+   Instead of raising SNL_EVENT_RECEIVE, every message arriving on skt is
+   sent on with the peer socket. Call it for both sockets to bridge two
+   connections. Between two SNL_PROTO_MSG TCP connections without cipher
+   (or an SNL_PROTO_TCP peer, which gets the messages without header) only
+   the 4 byte header is read, the payload is moved from one socket to the
+   other with splice() and never copied to user space. In all other cases
+   messages are received, decrypted and sent again with snl_send().
+
+   A failed write to the peer is reported as SNL_ERROR_SEND on skt, the
+   message is dropped.
+
+   \note
+   Other threads sending on the peer at the same time must use
+   snl_threadsafe(), which disables the splice() path. Stop the relay
+   before the peer gets deleted.
+*/
+int snl_relay(snl_socket_t *skt, snl_socket_t *peer);
+
+/**
+   \brief   Send large payloads without copying them
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   threshold <unsigned int> min payload size in bytes, 0 to disable
+   \return  0 on success or a negative error code
+
+   On SNL_PROTO_MSG and SNL_PROTO_TCP network connections without cipher,
+   snl_send() passes payloads of at least threshold bytes with
+   MSG_ZEROCOPY. The kernel then sends straight from the buffer of the
+   caller, which must not be modified or freed until the socket raises
+   SNL_EVENT_SENT for it, with the buffer in data_buffer and its length
+   in data_length. These events come in the order of the snl_send()
+   calls, also for failed ones. Smaller payloads are copied as usual and
+   raise no event.
+
+   Must be enabled before snl_connect() or snl_accept(), the threshold
+   can be changed at any time.
+
+   \note
+   Pinning pages costs more than copying small buffers, a threshold in
+   the range of 256KB is a good start. On loopback the kernel copies
+   anyway, but the events are raised all the same.
+*/
+int snl_zerocopy(snl_socket_t *skt, unsigned int threshold);
+
+/**
+   \brief   Choose the frame header of a connection
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   version <unsigned int> 1 for the classic, 2 for the compact header
+   \return  0 on success or a negative error code
+
+   Version 1 prefixes every SNL_PROTO_MSG datagram with a 4 byte length.
+   Version 2 uses a flags byte and a varint length instead, so messages
+   below 128 bytes cost 2 bytes of header, and allows to pack several
+   messages into one frame with snl_send_batch().
+
+   Must be called before snl_connect() or snl_accept() on both sides of a
+   network connection. Right after connecting, both sides exchange the
+   version they want and use the lower one. A peer that does not ask for
+   version 2 fails the connection with SNL_ERROR_TIMEOUT or
+   SNL_ERROR_PROTOCOL, instead of misreading the stream.
+
+   \note
+   The varint can carry 64 bit lengths, but data_length is 32 bit and
+   frames larger than 2GB are refused. Group members and splice relays
+   need version 1.
+*/
+int snl_framing(snl_socket_t *skt, unsigned int version);
+
+/**
+   \brief   Compress messages before they are sent
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   threshold <unsigned int> min message size in bytes, 0 to disable
+   \return  0 on success or a negative error code
+
+   SNL_PROTO_MSG and SNL_PROTO_UDP sockets run every message of at least
+   threshold bytes through a fast LZ77 codec before encryption, and the
+   receiver inflates it again before SNL_EVENT_RECEIVE. Smaller messages,
+   and those that would not get shorter, are sent as they are. Either way
+   a marker byte precedes each message.
+
+   Must be enabled before snl_connect() or snl_accept() on both sides, the
+   threshold can be changed at any time.
+
+   \note
+   A short message has little to match against by itself, see
+   snl_compress_dictionary(). Group members and splice relays do not
+   support compression.
+*/
+int snl_compress(snl_socket_t *skt, unsigned int threshold);
+
+/**
+   \brief   Share a dictionary of typical content between both sides
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   dict <const void *> sample data, only the last 64KB are used
+   \param   len <unsigned int> size of dict, 0 to drop the dictionary
+   \return  0 on success or a negative error code
+
+   Matches may reach back into the dictionary, which lets even short
+   messages compress well if they look like the sample. Both sides must
+   use the very same dictionary, or messages arrive garbled or fail with
+   SNL_ERROR_COMPRESS.
+
+   Must be set after snl_compress() and before snl_connect() or
+   snl_accept().
+*/
+int snl_compress_dictionary(snl_socket_t *skt, const void *dict, unsigned int len);
+
+/**
+   \brief   Append a stage to the codec pipeline
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   codec <const snl_codec_t *> stage description, copied
+   \return  0 on success or a negative error code
+
+   Messages of SNL_PROTO_MSG and SNL_PROTO_UDP sockets pass all stages in
+   the order they were added when sent, and backwards when received. The
+   compression of snl_compress() always runs first, the checksum of
+   snl_checksum() last and the cipher of snl_passphrase() after that. All buffers of a message are
+   allocated once, sized by the sum of the overheads. Sockets without any
+   stage skip the pipeline altogether.
+
+   Must be called before snl_connect() or snl_accept(), the peer needs the
+   same stages. Up to 8 stages are supported, the socket releases them.
+
+   \note
+   encode() is called from every thread that sends, decode() only from
+   the worker thread.
+*/
+int snl_codec_add(snl_socket_t *skt, const snl_codec_t *codec);
+
+/**
+   \brief   Remove all stages of the codec pipeline, compression included
+   \param   skt <snl_socket_t *> pointer to socket
+   \return  0 on success or a negative error code
+*/
+int snl_codec_clear(snl_socket_t *skt);
+
+/**
+   \brief   Describe the built-in blowfish cipher as a codec stage
+   \param   codec <snl_codec_t *> stage to fill in
+   \param   key <const char *> passphrase, must not be NULL
+   \return  0 on success or a negative error code
+
+   Useful to encrypt between custom stages, e.g. before an integrity
+   check. The stage pads to full 8 byte blocks and encrypts in place.
+   Pass it to snl_codec_add(), which takes over the key schedule.
+*/
+int snl_codec_blowfish(snl_codec_t *codec, const char *key);
+
+/**
+   \brief   Append a CRC32C to every message
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   enable <int> 1 to enable, 0 to disable
+   \return  0 on success or a negative error code
+
+   TCP checksums miss a lot of corruption, and the blowfish padding only
+   covers the last block. With this enabled, SNL_PROTO_MSG and
+   SNL_PROTO_UDP sockets send a 4 byte CRC32C after each message, as the
+   last stage of the codec pipeline and before encryption. A message that
+   does not match raises SNL_EVENT_ERROR with SNL_ERROR_CHECKSUM instead
+   of SNL_EVENT_RECEIVE.
+
+   Must be enabled before snl_connect() or snl_accept() on both sides.
+
+   \note
+   The CRC uses the SSE4.2 or ARMv8 instructions if the CPU has them, and
+   is computed while the message is copied anyway.
+*/
+int snl_checksum(snl_socket_t *skt, int enable);
+
+/**
+   \brief   Split a TCP stream into delimited records
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   delim <const void *> delimiter, e.g. "\n" or "\r\n"
+   \param   len <unsigned int> length of delim (up to 16), 0 for raw mode
+   \param   max <unsigned int> max record length, 0 for 64KB
+   \return  0 on success or a negative error code
+
+   Without a delimiter, SNL_PROTO_TCP raises SNL_EVENT_RECEIVE for
+   whatever a single read() returned. In delimiter mode the worker keeps
+   the bytes of the connection in a buffer, searches it with SSE2 and
+   raises one event per complete record. data_buffer points to the record
+   without its delimiter, which is replaced with a terminating '\0'.
+   A record longer than max raises SNL_EVENT_ERROR with SNL_ERROR_LENGTH
+   and is skipped up to its delimiter.
+
+   Can be set before snl_connect() or snl_accept(). After that it can only
+   be changed from within the callback, e.g. to read a header by lines,
+   other threads get SNL_ERROR_BUSY. Switching back to raw mode delivers
+   what is still buffered as one event.
+*/
+int snl_delimiter(snl_socket_t *skt, const void *delim, unsigned int len, unsigned int max);
+
 /**
    \brief   Start a seperate thread to handle exact one socket connection
    \param   skt <snl_socket_t *> pointer to socket
@@ -200,9 +771,62 @@ int snl_write(int fd, const void *buf, unsigned int len);
    means either waiting for incoming connections for SNL_PROTO_TCP or
    SNL_PROTO_MSG sockets, or waiting for incoming datagrams if the
    socket protocol is set to SNL_PROTO_UDP.
+
+   A listening SNL_PROTO_RUDP socket raises SNL_EVENT_ACCEPT for every
+   new peer, with a connected datagram socket in client_fd, that shares
+   the listening port.
+
+   SNL_PROTO_SHM sockets listen on a local (abstract unix) address named
+   after the port. The connecting process creates a pair of 4MB shared
+   memory rings and passes them on connect, snl_accept() maps them. After
+   that messages are written once into the ring of the peer and handed to
+   its callback in place, without any system call as long as the receiver
+   is busy. Messages must not exceed 2MB.
+
+   SNL_PROTO_LOOP sockets listen inside the process only, on the port or
+   the name of snl_name(). Messages are copied once and the buffer is
+   handed over to the receiving socket, snl_send_message() skips the copy.
+   No system call is involved while both sides are busy, a sender blocks
+   while 65536 messages wait for the receiver. The cipher is never
+   applied, data does not leave the process.
 */
 int snl_listen(snl_socket_t *skt, unsigned short port);
 
+/**
+   \brief   Protect a listener from connection storms
+   \param   skt <snl_socket_t *> pointer to listening socket
+   \param   backlog <int> pending connections queued by the kernel, 0 default
+   \param   connections <unsigned int> most live connections, 0 any
+   \param   bkt <snl_bucket_t *> accept rate, one token each, NULL any
+   \return  0 on success or a negative error code
+
+   Every wakeup of the listener accepts all pending connections, unless
+   the bucket (see snl_bucket_new()) runs dry. Then the rest waits in the
+   backlog until the accept rate allows more, and connections beyond the
+   backlog are retried by the kernel of the client. With the given number
+   of connections alive, new ones are closed right away instead of raising
+   SNL_EVENT_ACCEPT, see snl_refused(). A connection is alive from its
+   accept event until its socket got disconnected or deleted, provided
+   snl_accept() is called from within the event. The default backlog is
+   SOMAXCONN. Not for SNL_PROTO_UDP, SNL_PROTO_RUDP and SNL_PROTO_LOOP.
+   Must be called before snl_listen().
+*/
+int snl_admission(snl_socket_t *skt, int backlog, unsigned int connections, snl_bucket_t *bkt);
+
+/**
+   \brief   Number of live connections of a listener
+   \param   skt <snl_socket_t *> pointer to listening socket
+   \return  connections accepted and not yet ended, see snl_admission()
+*/
+unsigned int snl_connections(snl_socket_t *skt);
+
+/**
+   \brief   Number of connections closed over the limit
+   \param   skt <snl_socket_t *> pointer to listening socket
+   \return  connections refused since snl_admission()
+*/
+unsigned int snl_refused(snl_socket_t *skt);
+
 /**
    \brief   Connect to a listening socket
    \param   skt <snl_socket_t *> pointer to socket
@@ -211,7 +835,9 @@ int snl_listen(snl_socket_t *skt, unsigned short port);
    \return  0 on success or a negative error code
 
    For connecting to a snl server, one has to call this fuction. The first
-   paramter can be a hostname or an ipaddress.
+   paramter can be a hostname or an ipaddress. SNL_PROTO_SHM sockets can
+   only connect to the same host, the hostname is ignored. SNL_PROTO_LOOP
+   sockets connect to a listener of the same process.
 */
 int snl_connect(snl_socket_t *skt, const char *host, unsigned short port);
 
@@ -225,6 +851,107 @@ int snl_connect(snl_socket_t *skt, const char *host, unsigned short port);
 */
 int snl_disconnect(snl_socket_t *skt);
 
+/**
+   \brief   Join a multicast group
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   group <const char *> multicast group address (i.e. 239.0.0.1)
+   \param   iface <const char *> interface name or address, NULL for any
+   \return  0 on success or a negative error code
+
+   Subscribes an SNL_PROTO_UDP socket to a multicast group, so the group
+   datagrams arrive as usual SNL_EVENT_RECEIVE events. If called before
+   snl_listen(), the membership is established when the socket is bound
+   and the port may be shared with other listeners on the same host.
+   Up to 20 groups can be joined before snl_listen(), SNL_ERROR_BUSY is
+   returned beyond that. Further groups can be joined after snl_listen().
+*/
+int snl_multicast_join(snl_socket_t *skt, const char *group, const char *iface);
+
+/**
+   \brief   Leave a multicast group
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   group <const char *> multicast group address
+   \param   iface <const char *> interface name or address, NULL for any
+   \return  0 on success or a negative error code
+
+   Before snl_listen() this cancels a pending snl_multicast_join() with the
+   same group and interface.
+*/
+int snl_multicast_leave(snl_socket_t *skt, const char *group, const char *iface);
+
+/**
+   \brief   Set time to live of outgoing multicast datagrams
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   ttl <int> number of router hops (default 1, 0 = this host)
+   \return  0 on success or a negative error code
+
+   To send multicast datagrams, snl_connect() an SNL_PROTO_UDP socket to
+   the group address. This and the following functions must be called
+   after snl_connect().
+*/
+int snl_multicast_ttl(snl_socket_t *skt, int ttl);
+
+/**
+   \brief   Loop back outgoing multicast datagrams to the local host
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   enable <int> 1 to enable (default), 0 to disable
+   \return  0 on success or a negative error code
+*/
+int snl_multicast_loop(snl_socket_t *skt, int enable);
+
+/**
+   \brief   Select the interface for outgoing multicast datagrams
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   iface <const char *> interface name or address, NULL for default
+   \return  0 on success or a negative error code
+*/
+int snl_multicast_interface(snl_socket_t *skt, const char *iface);
+
+/**
+   \brief   Receive several datagrams per system call
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   count <unsigned int> max datagrams per recvmmsg() (1 - 32)
+   \return  0 on success or a negative error code
+
+   A listening SNL_PROTO_UDP socket fetches up to count datagrams with a
+   single recvmmsg() call and raises one SNL_EVENT_RECEIVE for each of
+   them. Every extra slot costs a 64KB buffer. Must be called before
+   snl_listen().
+*/
+int snl_receive_batch(snl_socket_t *skt, unsigned int count);
+
+/**
+   \brief   Split large datagrams into fragments
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   mtu <unsigned int> max size of a single datagram, 0 to disable
+   \return  0 on success or a negative error code
+
+   In fragment mode an SNL_PROTO_UDP socket sends messages of any size
+   by splitting them into datagrams of at most mtu bytes, each carrying a
+   16 byte header with message id and fragment index. The receiving side
+   reassembles them and raises a single SNL_EVENT_RECEIVE per complete
+   message. If the kernel supports UDP segmentation offload (GSO/GRO), the
+   fragments are cut and merged in the kernel. Both sides must enable
+   fragment mode before snl_connect() or snl_listen().
+
+   \note
+   An mtu of 1472 fits a single ethernet frame. Lost fragments are not
+   retransmitted, the whole message is dropped after a timeout.
+*/
+int snl_fragment(snl_socket_t *skt, unsigned int mtu);
+
+/**
+   \brief   Limit reassembly resources
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   memory <unsigned int> max bytes of incomplete messages (default 16MB)
+   \param   timeout <unsigned int> ms until incomplete messages expire (default 1000)
+   \return  0 on success or a negative error code
+
+   When the memory limit is exceeded, the oldest incomplete messages are
+   discarded first. A value of 0 keeps the current setting.
+*/
+int snl_fragment_limit(snl_socket_t *skt, unsigned int memory, unsigned int timeout);
+
 /**
    \brief   Use Blowfish encryption for packet load
    \param   skt <snl_socket_t *> pointer to socket
@@ -237,6 +964,431 @@ int snl_disconnect(snl_socket_t *skt);
 */
 int snl_passphrase(snl_socket_t *skt, char *key);
 
+/**
+   \brief   Create new broadcast group
+   \param   proto <int> protocol of all member sockets
+   \return  pointer to new group object
+
+   A message sent to a group is framed and encrypted only once into a
+   reference counted buffer, which then gets queued to every member
+   socket without blocking on slow receivers.
+*/
+snl_group_t *snl_group_new(int proto);
+
+/**
+   \brief   Destroy the group object
+   \param   grp <snl_group_t *> pointer to group
+   \return  0 on success or a negative error code
+
+   The member sockets are not touched and have to be deleted seperately.
+*/
+int snl_group_delete(snl_group_t *grp);
+
+/**
+   \brief   Add a socket to a group
+   \param   grp <snl_group_t *> pointer to group
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   policy <int> one of SNL_POLICY_DROP, _QUEUE or _DISCONNECT
+   \return  0 on success or a negative error code
+
+   The socket is switched to thread safe sending (see snl_threadsafe()),
+   so it may still be used with snl_send() directly. Its passphrase must
+   be the one of the group, else SNL_ERROR_OPTION is returned, as it is
+   for an unknown policy or a socket already in the group. Sockets with
+   framing, codecs, credit, RPC, channels, fragments or a send rate get
+   SNL_ERROR_PROTOCOL, the shared frames would bypass them.
+
+   \note
+   A socket must be removed from all groups before it gets deleted.
+*/
+int snl_group_add(snl_group_t *grp, snl_socket_t *skt, int policy);
+
+/**
+   \brief   Remove a socket from a group
+   \param   grp <snl_group_t *> pointer to group
+   \param   skt <snl_socket_t *> pointer to socket
+   \return  0 on success or a negative error code
+*/
+int snl_group_remove(snl_group_t *grp, snl_socket_t *skt);
+
+/**
+   \brief   Send a datagram to all members of a group
+   \param   grp <snl_group_t *> pointer to group
+   \param   buf <const void *> pointer to the data to send
+   \param   len <unsigned int> length of that data
+   \return  0 on success or a negative error code
+
+   Whatever a member socket does not accept right away stays queued and
+   is written by its worker as soon as the socket drains.
+*/
+int snl_group_send(snl_group_t *grp, const void *buf, unsigned int len);
+
+/**
+   \brief   Write out data still queued for group members
+   \param   grp <snl_group_t *> pointer to group
+   \return  0 on success or a negative error code
+*/
+int snl_group_flush(snl_group_t *grp);
+
+/**
+   \brief   Set the slow member threshold
+   \param   grp <snl_group_t *> pointer to group
+   \param   bytes <unsigned int> max pending bytes per member (default 1MB)
+   \return  0 on success or a negative error code
+*/
+int snl_group_limit(snl_group_t *grp, unsigned int bytes);
+
+/**
+   \brief   Use Blowfish encryption for group messages
+   \param   grp <snl_group_t *> pointer to group
+   \param   key <char *> \0 terminated passphrase string
+   \return  0 on success or a negative error code
+
+   The group encrypts with its own key, which must be the passphrase of
+   every member socket. Returns SNL_ERROR_BUSY while the group has
+   members.
+*/
+int snl_group_passphrase(snl_group_t *grp, char *key);
+
+/**
+   \brief   Let the receiver pace the sender with credits
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   messages <unsigned int> messages the peer may send ahead, 0 any
+   \param   bytes <unsigned int> bytes the peer may send ahead, 0 any
+   \return  0 on success or a negative error code
+
+   Every message of a SNL_PROTO_MSG connection gets a 4 byte header. Each
+   side grants its peer a window of messages and bytes, and grants them
+   again as soon as its callback returned from half of them. Without
+   credit left snl_send() waits, for at most the send timeout, so neither
+   the kernel buffers nor the receiver ever hold more than one window. A
+   message is sent as long as any credit is left, even if it is larger.
+   Messages sent from the callback of the same socket never wait, they
+   are queued until the next grant arrives. Beyond 1MB queued that way,
+   snl_send() fails with SNL_ERROR_BUFFER. Both peers must enable it
+   before snl_connect() or snl_accept(), but may choose different windows.
+   Both 0 disable it. Implies snl_threadsafe().
+*/
+int snl_credit(snl_socket_t *skt, unsigned int messages, unsigned int bytes);
+
+/**
+   \brief   Create a token bucket
+   \param   unit <int> SNL_RATE_BYTES or SNL_RATE_MESSAGES
+   \param   rate <unsigned int> tokens per second, must not be 0
+   \param   burst <unsigned int> most tokens saved up, 0 for one second worth
+   \return  pointer to a new bucket or NULL on error
+
+   The bucket starts full. Every message takes its tokens as soon as the
+   bucket is not in debt, so one larger than the burst passes as well and
+   the next one waits until the debt is paid off.
+*/
+snl_bucket_t *snl_bucket_new(int unit, unsigned int rate, unsigned int burst);
+
+/**
+   \brief   Release a token bucket
+   \param   bkt <snl_bucket_t *> pointer to bucket
+
+   Sockets still limited by it keep using it until they are deleted.
+*/
+void snl_bucket_delete(snl_bucket_t *bkt);
+
+/**
+   \brief   Change the rate of a token bucket
+   \param   bkt <snl_bucket_t *> pointer to bucket
+   \param   rate <unsigned int> tokens per second, must not be 0
+   \param   burst <unsigned int> most tokens saved up, 0 for one second worth
+   \return  0 on success or a negative error code
+
+   Takes effect at once, also for the sockets already using it.
+*/
+int snl_bucket_rate(snl_bucket_t *bkt, unsigned int rate, unsigned int burst);
+
+/**
+   \brief   Current fill level of a token bucket
+   \param   bkt <snl_bucket_t *> pointer to bucket
+   \return  tokens available, negative while in debt
+*/
+long long snl_bucket_tokens(snl_bucket_t *bkt);
+
+/**
+   \brief   Limit the rate of a socket with a token bucket
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   direction <int> SNL_RATE_SEND or SNL_RATE_RECEIVE
+   \param   bkt <snl_bucket_t *> pointer to bucket, NULL removes all
+   \return  0 on success or a negative error code
+
+   Up to 4 buckets per direction, typically one of the socket itself and
+   one shared by all sockets of an uplink. A message has to wait until all
+   of them are out of debt. snl_send() sleeps for that, but fails with
+   SNL_ERROR_TIMEOUT if the wait would exceed the send timeout. With
+   snl_multiplex() every chunk counts as a message. snl_group_send()
+   bypasses the limit.
+
+   Over the receive rate the worker stops reading, so nothing is dropped
+   and the peer is slowed down by the flow control of the transport. Only
+   for connections of SNL_PROTO_MSG and SNL_PROTO_TCP. Must be called
+   before snl_connect() or snl_accept().
+*/
+int snl_rate_limit(snl_socket_t *skt, int direction, snl_bucket_t *bkt);
+
+/**
+   \brief   Detect dead peers and keep quiet connections alive
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   idle <unsigned int> ms without receiving anything, 0 never
+   \param   heartbeat <unsigned int> ms without sending anything, 0 never
+   \return  0 on success or a negative error code
+
+   After idle ms without any incoming data, SNL_EVENT_ERROR is raised with
+   SNL_ERROR_TIMEOUT, and again after every further idle ms of silence.
+   The connection stays up, the callback decides what to do about it.
+
+   With a heartbeat, a frame without payload is sent whenever nothing else
+   was sent during a whole interval, so the idle timeout of the peer should
+   span three of them at least. Its header is marked, the peer drops it
+   without an event whether it has timeouts or not, and empty messages
+   still arrive. Only the version 2 header has a flag for it, so both
+   sides need snl_framing(skt, 2), connections with version 1 framing
+   send no heartbeats. Neither do local connections, the kernel reports a
+   vanished peer right away. A heartbeat needs SNL_PROTO_MSG and implies
+   snl_threadsafe(), idle timeouts work with SNL_PROTO_TCP as well. The
+   timers of all sockets share one thread of the library. Both 0 disable
+   it. Must be called before snl_connect() or snl_accept().
+*/
+int snl_timeout(snl_socket_t *skt, unsigned int idle, unsigned int heartbeat);
+
+/**
+   \brief   Limit the time a single message may take on the wire
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   read <unsigned int> ms from the first to the last byte of an incoming message, 0 any
+   \param   write <unsigned int> ms a write to the kernel may block, 0 for the send timeout
+   \return  0 on success or a negative error code
+
+   An incoming message that is still incomplete after read ms ends the
+   connection with SNL_EVENT_ERROR and SNL_ERROR_TIMEOUT, so a peer that
+   trickles in a few bytes at a time cannot hold the worker forever. The
+   time until a message starts is up to snl_timeout(). The read deadline
+   needs SNL_PROTO_MSG. The write deadline replaces the send timeout of 3
+   seconds for SNL_PROTO_MSG and SNL_PROTO_TCP. Must be called before
+   snl_connect() or snl_accept().
+*/
+int snl_deadline(snl_socket_t *skt, unsigned int read, unsigned int write);
+
+/**
+   \brief   Enable request/response calls on a connection
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   enable <int> 1 to enable, 0 to disable
+   \return  0 on success or a negative error code
+
+   Every message of a SNL_PROTO_MSG connection gets an 8 byte header with
+   a correlation id, so any number of calls may be in flight at once and
+   replies may come in any order. Both peers must enable it before
+   snl_connect() or snl_accept(). Plain snl_send() still works and raises
+   SNL_EVENT_RECEIVE on the other side, as do requests. Not together with
+   snl_multiplex().
+*/
+int snl_rpc(snl_socket_t *skt, int enable);
+
+/**
+   \brief   Send a request and complete it by callback
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   buf <const void *> pointer to the request
+   \param   len <unsigned int> length of the request
+   \param   timeout <unsigned int> deadline in ms, 0 for none
+   \param   cb <snl_rpc_callback_t> called once with the reply or an error
+   \param   data <void *> passed on to the callback
+   \return  0 on success or a negative error code
+
+   The callback is not called if the request could not be sent. Calls from
+   several threads need snl_threadsafe().
+*/
+int snl_rpc_call(snl_socket_t *skt, const void *buf, unsigned int len, unsigned int timeout, snl_rpc_callback_t cb, void *data);
+
+/**
+   \brief   Send a request and complete it by future
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   buf <const void *> pointer to the request
+   \param   len <unsigned int> length of the request
+   \param   timeout <unsigned int> deadline in ms, 0 for none
+   \param   future <snl_rpc_future_t **> receives the pending call
+   \return  0 on success or a negative error code
+
+   The future has to be released with snl_rpc_release(), whether it has
+   been waited for or not.
+*/
+int snl_rpc_submit(snl_socket_t *skt, const void *buf, unsigned int len, unsigned int timeout, snl_rpc_future_t **future);
+
+/**
+   \brief   Wait for a call to complete
+   \param   future <snl_rpc_future_t *> pending call
+   \param   buf <const void **> receives the reply, owned by the future
+   \param   len <unsigned int *> receives the length of the reply
+   \return  0 on success or a negative error code
+
+   Must not be called from within the socket callback, which would block
+   the worker delivering the reply.
+*/
+int snl_rpc_wait(snl_rpc_future_t *future, const void **buf, unsigned int *len);
+
+/**
+   \brief   Release a future and its reply
+   \param   future <snl_rpc_future_t *> pending or completed call
+*/
+void snl_rpc_release(snl_rpc_future_t *future);
+
+/**
+   \brief   Correlation id of the request being delivered
+   \param   skt <snl_socket_t *> pointer to socket
+   \return  id for snl_rpc_reply(), 0 for plain messages
+
+   Only valid within SNL_EVENT_RECEIVE. The id may be kept to reply later
+   from another thread.
+*/
+unsigned int snl_rpc_id(snl_socket_t *skt);
+
+/**
+   \brief   Answer a request
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   id <unsigned int> correlation id of the request
+   \param   buf <const void *> pointer to the reply
+   \param   len <unsigned int> length of the reply
+   \return  0 on success or a negative error code
+*/
+int snl_rpc_reply(snl_socket_t *skt, unsigned int id, const void *buf, unsigned int len);
+
+/**
+   \brief   Multiplex logical channels over one connection
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   enable <int> 1 to enable, 0 to disable
+   \return  0 on success or a negative error code
+
+   Messages of SNL_PROTO_MSG are split into chunks of up to 16KB, each
+   tagged with one of 16 channels. Chunks of different channels interleave
+   on the wire, so a small message does not wait for a large one sent on
+   another channel to finish. Which chunk goes next is decided by weighted
+   fair queueing, see snl_channel_weight(). Both peers must enable it
+   before snl_connect() or snl_accept(). Not together with snl_rpc().
+*/
+int snl_multiplex(snl_socket_t *skt, int enable);
+
+/**
+   \brief   Set the share of a channel
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   channel <unsigned int> channel number, 0 to 15
+   \param   weight <unsigned int> relative share of the bandwidth (default 1)
+   \return  0 on success or a negative error code
+
+   While several channels have messages waiting, each gets bandwidth in
+   proportion to its weight. A channel that has been idle starts without
+   credit, but its first chunk still goes out right after the chunk that
+   is being written.
+*/
+int snl_channel_weight(snl_socket_t *skt, unsigned int channel, unsigned int weight);
+
+/**
+   \brief   Limit the length of a received message
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   max <unsigned int> max length in bytes, at least 16KB, 0 for 64MB
+   \return  0 on success or a negative error code
+
+   Chunks of a message are reassembled until the last one arrives. A
+   message growing beyond max raises SNL_EVENT_ERROR with SNL_ERROR_LENGTH
+   on its channel and the rest of its chunks are dropped.
+*/
+int snl_channel_limit(snl_socket_t *skt, unsigned int max);
+
+/**
+   \brief   Send a message on a channel
+   \param   skt <snl_socket_t *> pointer to socket
+   \param   channel <unsigned int> channel number, 0 to 15
+   \param   buf <const void *> pointer to the data to send
+   \param   len <unsigned int> length of that data
+   \return  0 on success or a negative error code
+
+   Blocks until the message is written, like snl_send(), which sends on
+   channel 0. Threads sending at the same time take turns writing chunks
+   in the order of the scheduler, so this may be called from several
+   threads without snl_threadsafe().
+*/
+int snl_channel_send(snl_socket_t *skt, unsigned int channel, const void *buf, unsigned int len);
+
+/**
+   \brief   Channel of the message being delivered
+   \param   skt <snl_socket_t *> pointer to socket
+   \return  channel number, only valid within SNL_EVENT_RECEIVE
+*/
+unsigned int snl_channel_id(snl_socket_t *skt);
+
+/**
+   \brief   Create new HTTP/1.1 server
+   \param   handler <snl_http_handler_t> called for requests without a static response, may be NULL
+   \param   data <void *> passed on to the handler
+   \return  pointer to new server object
+
+   Connections are kept open and may pipeline requests, HTTP/1.0 ones only
+   if the client asked with "Connection: keep-alive", which the response
+   then confirms. The header block is parsed in place, without allocating
+   memory per request. Responses for pipelined requests are collected and
+   written with a single write(), once no further complete request is
+   waiting.
+*/
+snl_http_t *snl_http_new(snl_http_handler_t handler, void *data);
+
+/**
+   \brief   Destroy the server object
+   \param   http <snl_http_t *> pointer to server
+   \return  0 on success or a negative error code
+
+   Stops listening, shuts down all connections and waits for them.
+   Must not be called from within the handler.
+*/
+int snl_http_delete(snl_http_t *http);
+
+/**
+   \brief   Accept HTTP connections
+   \param   http <snl_http_t *> pointer to server
+   \param   port <unsigned short> TCP port to listen on
+   \return  0 on success or a negative error code
+*/
+int snl_http_listen(snl_http_t *http, unsigned short port);
+
+/**
+   \brief   Add a static response
+   \param   http <snl_http_t *> pointer to server
+   \param   path <const char *> \0 terminated path, e.g. "/index.html"
+   \param   type <const char *> \0 terminated Content-Type
+   \param   body <const void *> pointer to the content
+   \param   len <unsigned int> length of the content
+   \return  0 on success or a negative error code
+
+   The complete response, status line and headers included, is formatted
+   once and then copied out for every GET or HEAD of this path. The query
+   string of a request is ignored. Must be called before snl_http_listen().
+*/
+int snl_http_static(snl_http_t *http, const char *path, const char *type, const void *body, unsigned int len);
+
+/**
+   \brief   Answer the request passed to the handler
+   \param   skt <snl_socket_t *> the socket passed to the handler
+   \param   status <int> HTTP status code, e.g. 200
+   \param   type <const char *> \0 terminated Content-Type, or NULL
+   \param   body <const void *> pointer to the content
+   \param   len <unsigned int> length of the content
+   \return  0 on success or a negative error code
+
+   A request left without an answer gets 404 Not Found. HEAD requests get
+   the headers only.
+*/
+int snl_http_respond(snl_socket_t *skt, int status, const char *type, const void *body, unsigned int len);
+
+/**
+   \brief   Find a header field of a request
+   \param   req <const snl_http_request_t *> pointer to request
+   \param   name <const char *> \0 terminated field name, case insensitive
+   \param   len <unsigned int *> receives the length of the value
+   \return  pointer to the value, not \0 terminated, or NULL
+*/
+const char *snl_http_header(const snl_http_request_t *req, const char *name, unsigned int *len);
+
 /**
    \brief   Convert error code to string
    \param   error <int> snl error code
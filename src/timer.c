@@ -0,0 +1,400 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#include <stdlib.h>      // calloc(), free()
+#include <unistd.h>      // read(), write(), close()
+#include <pthread.h>     // pthread_*()
+#include <time.h>        // clock_gettime()
+#include <sys/socket.h>  // shutdown()
+#include <sys/eventfd.h> // eventfd()
+
+#include "framing.h"
+#include "timer.h"
+
+// one wheel for the timers of all sockets, driven by a thread of its own
+static struct {
+   pthread_mutex_t mutex;
+   pthread_cond_t cond;                          // monotonic
+   snl_timer_t *slot[TIMER_LEVELS][TIMER_SLOTS];
+   long long tick;                               // ms, the next one to expire
+   long long wakeup;                             // ms, the thread sleeps until, 0 forever
+   unsigned int count;                           // armed timers
+   int running;
+} wheel = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+long long
+snl_timer_now(void) {
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   return ((long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+static void
+wheel_init(void) {
+   pthread_condattr_t attr;
+
+   pthread_condattr_init(&attr);
+   pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+   pthread_cond_init(&wheel.cond, &attr);
+   pthread_condattr_destroy(&attr);
+}
+
+// must be called with the mutex held
+static void
+place(snl_timer_t *timer) {
+   long long expires = timer->expires, delta;
+   snl_timer_t **head;
+   int level;
+
+   // overdue ones expire with the next tick, the far future is looked at
+   // again when the last level comes around
+   if (expires < wheel.tick) expires = wheel.tick;
+   if (expires - wheel.tick >= TIMER_SPAN) expires = wheel.tick + TIMER_SPAN - 1;
+
+   delta = expires - wheel.tick;
+
+   for (level=0; level<TIMER_LEVELS-1; level++) {
+      if (delta < (1LL << (TIMER_BITS * (level + 1)))) break;
+   }
+
+   head = &wheel.slot[level][(expires >> (TIMER_BITS * level)) & (TIMER_SLOTS - 1)];
+
+   if ((timer->next = *head)) timer->next->pprev = &timer->next;
+   timer->pprev = head;
+   *head = timer;
+
+   timer->armed = 1;
+   wheel.count++;
+}
+
+// must be called with the mutex held
+static void
+unlink_timer(snl_timer_t *timer) {
+   if ((*timer->pprev = timer->next)) timer->next->pprev = timer->pprev;
+
+   timer->armed = 0;
+   wheel.count--;
+}
+
+// must be called with the mutex held
+static snl_timer_t *
+take(int level, long long tick) {
+   snl_timer_t **head = &wheel.slot[level][(tick >> (TIMER_BITS * level)) & (TIMER_SLOTS - 1)];
+   snl_timer_t *list = *head, *timer;
+
+   *head = NULL;
+
+   for (timer=list; timer; timer=timer->next) {
+      timer->armed = 0;
+      wheel.count--;
+   }
+
+   return (list);
+}
+
+// must be called with the mutex held
+static void
+advance(void) {
+   long long tick = wheel.tick;
+   snl_timer_t *timer, *list;
+   unsigned int ms;
+   int level;
+
+   // a slot of the next level comes up every time this one wraps around,
+   // its timers move down
+   for (level=1; level<TIMER_LEVELS; level++) {
+      if (tick & ((1LL << (TIMER_BITS * level)) - 1)) break;
+
+      for (list=take(level, tick); (timer = list); ) {
+         list = timer->next;
+         place(timer);
+      }
+   }
+
+   list = take(0, tick);
+
+   wheel.tick = tick + 1;
+
+   while ((timer = list)) {
+      list = timer->next;
+
+      if ((ms = timer->expire(timer->arg))) {
+         timer->expires = tick + ms;
+         place(timer);
+      }
+   }
+}
+
+// must be called with the mutex held
+static long long
+next_tick(void) {
+   long long tick = wheel.tick;
+
+   // the first slot of this level with timers or the next cascade
+   if (tick & (TIMER_SLOTS - 1)) {
+      while ((tick & (TIMER_SLOTS - 1)) && !wheel.slot[0][tick & (TIMER_SLOTS - 1)]) {
+         tick++;
+      }
+   }
+
+   return (tick);
+}
+
+static void *
+wheel_thread(void *arg) {
+   struct timespec ts;
+   long long now;
+
+   (void)arg;
+
+   pthread_mutex_lock(&wheel.mutex);
+
+   while (1) {
+      now = snl_timer_now();
+
+      // nothing armed, nothing to catch up with
+      if (!wheel.count && (wheel.tick <= now)) wheel.tick = now + 1;
+
+      while (wheel.tick <= now) {
+         advance();
+      }
+
+      if (!wheel.count) {
+         wheel.wakeup = 0;
+         pthread_cond_wait(&wheel.cond, &wheel.mutex);
+         continue;
+      }
+
+      wheel.wakeup = next_tick();
+
+      ts.tv_sec  = wheel.wakeup / 1000;
+      ts.tv_nsec = wheel.wakeup % 1000 * 1000000;
+
+      pthread_cond_timedwait(&wheel.cond, &wheel.mutex, &ts);
+   }
+
+   return (NULL);
+}
+
+int
+snl_timer_start(snl_timer_t *timer, unsigned int ms) {
+   pthread_attr_t attr;
+   pthread_t tid;
+   long long now;
+
+   pthread_once(&once, wheel_init);
+
+   pthread_mutex_lock(&wheel.mutex);
+
+   // started with the first timer, runs as long as the process
+   if (!wheel.running) {
+      pthread_attr_init(&attr);
+      pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+      pthread_attr_setstacksize(&attr, 65536);
+
+      wheel.running = !pthread_create(&tid, &attr, wheel_thread, NULL);
+
+      pthread_attr_destroy(&attr);
+
+      if (!wheel.running) {
+         pthread_mutex_unlock(&wheel.mutex);
+         return (SNL_ERROR_THREAD);
+      }
+   }
+
+   if (timer->armed) unlink_timer(timer);
+
+   now = snl_timer_now();
+
+   // an empty wheel may skip the time it slept
+   if (!wheel.count && (wheel.tick < now)) wheel.tick = now;
+
+   timer->expires = now + ms;
+   place(timer);
+
+   // earlier than the thread is going to look
+   if (!wheel.wakeup || (timer->expires < wheel.wakeup)) {
+      pthread_cond_signal(&wheel.cond);
+   }
+
+   pthread_mutex_unlock(&wheel.mutex);
+
+   return (SNL_ERROR_OK);
+}
+
+// once this returns, the timer is not going to expire anymore
+void
+snl_timer_stop(snl_timer_t *timer) {
+   pthread_mutex_lock(&wheel.mutex);
+
+   if (timer->armed) unlink_timer(timer);
+
+   pthread_mutex_unlock(&wheel.mutex);
+}
+
+static void
+fire(snl_timeout_t *tmo, int what) {
+   unsigned long long one = 1;
+
+   __sync_fetch_and_or(&tmo->fired, what);
+
+   if (write(tmo->event, &one, sizeof (one))) {}
+}
+
+static unsigned int
+idle_expired(void *arg) {
+   snl_timeout_t *tmo = arg;
+   long long quiet = snl_timer_now() - tmo->received;
+
+   if (quiet < tmo->idle) return (tmo->idle - quiet);
+
+   // and again after every further idle period of silence
+   fire(tmo, TIMEOUT_IDLE);
+
+   return (tmo->idle);
+}
+
+static unsigned int
+heartbeat_expired(void *arg) {
+   snl_timeout_t *tmo = arg;
+   unsigned int sent = tmo->skt->xfer_sent;
+
+   // any message at all keeps the peer from timing out
+   if (sent == tmo->sent) fire(tmo, TIMEOUT_HEARTBEAT);
+
+   tmo->sent = sent;
+
+   return (tmo->heartbeat);
+}
+
+static unsigned int
+read_expired(void *arg) {
+   snl_timeout_t *tmo = arg;
+   long long started = tmo->reading, late;
+
+   if (!started) return (tmo->read);
+
+   late = snl_timer_now() - started;
+
+   if (late < tmo->read) return (tmo->read - late);
+
+   // the worker waits in read(), nothing else gets it out of there
+   fire(tmo, TIMEOUT_READ);
+   shutdown(tmo->fd, SHUT_RD);
+
+   return (0);
+}
+
+snl_timeout_t *
+snl_timeout_new(snl_socket_t *skt) {
+   static const snl_timer_expire_t expire[3] = { idle_expired, heartbeat_expired, read_expired };
+   snl_timeout_t *tmo;
+   int i;
+
+   if (!(tmo = calloc(1, sizeof (snl_timeout_t)))) {
+      return (NULL);
+   }
+
+   if ((tmo->event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+      free(tmo);
+      return (NULL);
+   }
+
+   for (i=0; i<3; i++) {
+      tmo->timer[i].expire = expire[i];
+      tmo->timer[i].arg = tmo;
+   }
+
+   tmo->fd  = -1;
+   tmo->skt = skt;
+
+   return (tmo);
+}
+
+void
+snl_timeout_delete(snl_timeout_t *tmo) {
+   if (!tmo) return;
+
+   snl_timeout_close(tmo);
+
+   close(tmo->event);
+   free(tmo);
+}
+
+int
+snl_timeout_open(snl_socket_t *skt) {
+   snl_timeout_t *tmo = skt->timeout;
+   // a version 1 peer would take a heartbeat for the length of a message
+   unsigned int ms[3] = { tmo->idle, SNL_FRAMING_V2(skt) ? tmo->heartbeat : 0, tmo->read };
+   unsigned long long count;
+   int i, error;
+
+   tmo->fd = skt->file_descriptor;
+   tmo->received = snl_timer_now();
+   tmo->reading = 0;
+   tmo->sent = skt->xfer_sent;
+   tmo->fired = 0;
+
+   // left over from an earlier connection
+   if (read(tmo->event, &count, sizeof (count))) {}
+
+   for (i=0; i<3; i++) {
+      if (ms[i] && (error = snl_timer_start(&tmo->timer[i], ms[i]))) {
+         snl_timeout_close(tmo);
+         return (error);
+      }
+   }
+
+   return (SNL_ERROR_OK);
+}
+
+void
+snl_timeout_close(snl_timeout_t *tmo) {
+   int i;
+
+   if (!tmo) return;
+
+   for (i=0; i<3; i++) {
+      snl_timer_stop(&tmo->timer[i]);
+   }
+}
+
+void
+snl_timeout_raise(snl_socket_t *skt, int (*beat)(snl_socket_t *skt)) {
+   snl_timeout_t *tmo = skt->timeout;
+   unsigned long long count;
+   int fired;
+
+   if (read(tmo->event, &count, sizeof (count))) {}
+
+   // a missed read deadline is left to the worker, it ends the connection
+   fired = __sync_fetch_and_and(&tmo->fired, TIMEOUT_READ);
+
+   // a failed heartbeat shows up as a failed read soon enough
+   if (fired & TIMEOUT_HEARTBEAT) beat(skt);
+
+   if (fired & TIMEOUT_IDLE) {
+      skt->error_code = SNL_ERROR_TIMEOUT;
+      skt->event_code = SNL_EVENT_ERROR;
+      skt->event_callback(skt);
+   }
+}
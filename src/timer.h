@@ -0,0 +1,73 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef _SNL_TIMER_H_
+#define _SNL_TIMER_H_
+
+#include "snl.h"
+
+#define TIMER_BITS    6                          // slots per level, as a power of 2
+#define TIMER_SLOTS   (1 << TIMER_BITS)
+#define TIMER_LEVELS  4                          // each level ticks 64 times slower
+#define TIMER_SPAN    (1LL << (TIMER_BITS * TIMER_LEVELS)) // ms, about 4.6 hours
+
+#define TIMEOUT_IDLE      1                      // nothing received for too long
+#define TIMEOUT_HEARTBEAT 2                      // nothing sent for too long
+#define TIMEOUT_READ      4                      // a message took too long
+
+// called on the wheel thread with the wheel locked, returns ms until it
+// expires again or 0 to stop
+typedef unsigned int (*snl_timer_expire_t)(void *arg);
+
+typedef struct snl_timer_t {
+   struct snl_timer_t *next;
+   struct snl_timer_t **pprev;    // whatever points to this one
+   long long expires;             // ms, monotonic
+   snl_timer_expire_t expire;
+   void *arg;
+   int armed;                     // linked into a slot of the wheel
+} snl_timer_t;
+
+typedef struct snl_timeout_t {
+   snl_timer_t timer[3];          // idle, heartbeat and read deadline
+   unsigned int idle;             // ms, 0 for none
+   unsigned int heartbeat;
+   unsigned int read;
+   unsigned int write;
+   volatile long long received;   // ms, data got readable the last time
+   volatile long long reading;    // ms, a message started, 0 in between
+   unsigned int sent;             // xfer_sent at the last heartbeat
+   volatile int fired;            // TIMEOUT_* not handled by the worker yet
+   int event;                     // eventfd, wakes up the worker
+   int fd;                        // shut down on a missed read deadline
+   snl_socket_t *skt;
+} snl_timeout_t;
+
+long long snl_timer_now(void);
+int snl_timer_start(snl_timer_t *timer, unsigned int ms);
+void snl_timer_stop(snl_timer_t *timer);
+
+snl_timeout_t *snl_timeout_new(snl_socket_t *skt);
+void snl_timeout_delete(snl_timeout_t *tmo);
+
+int snl_timeout_open(snl_socket_t *skt);
+void snl_timeout_close(snl_timeout_t *tmo);
+void snl_timeout_raise(snl_socket_t *skt, int (*beat)(snl_socket_t *skt));
+
+#endif // _SNL_TIMER_H_
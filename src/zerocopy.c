@@ -0,0 +1,234 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <stdlib.h>         // calloc(), free()
+#include <string.h>         // memset()
+#include <errno.h>          // errno
+#include <sys/socket.h>     // send(), recvmsg(), SO_ZEROCOPY, MSG_ZEROCOPY
+#include <netinet/in.h>     // IPPROTO_IP, IPPROTO_IPV6
+#include <linux/errqueue.h> // struct sock_extended_err
+
+#include "zerocopy.h"
+
+#ifndef IP_RECVERR
+#define IP_RECVERR   11
+#endif
+
+#ifndef IPV6_RECVERR
+#define IPV6_RECVERR 25
+#endif
+
+snl_zerocopy_t *
+snl_zerocopy_new(void) {
+   snl_zerocopy_t *zc;
+
+   if (!(zc = calloc(1, sizeof (snl_zerocopy_t)))) {
+      return (NULL);
+   }
+
+   zc->fd = -1;
+
+   pthread_mutex_init(&zc->mutex, NULL);
+
+   return (zc);
+}
+
+void
+snl_zerocopy_delete(snl_zerocopy_t *zc) {
+   snl_zc_buffer_t *zb;
+
+   if (!zc) return;
+
+   // the socket is closed, nobody waits for these anymore
+   while ((zb = zc->head)) {
+      zc->head = zb->next;
+      free(zb);
+   }
+
+   pthread_mutex_destroy(&zc->mutex);
+
+   free(zc);
+}
+
+int
+snl_zerocopy_ready(snl_socket_t *skt, unsigned int len) {
+   snl_zerocopy_t *zc = skt->zerocopy;
+   int on = 1;
+
+   if (!zc->threshold || (len < zc->threshold)) {
+      return (0);
+   }
+
+   // the option belongs to the connection, not to the snl socket
+   if (zc->fd != skt->file_descriptor) {
+      if (setsockopt(skt->file_descriptor, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof (on))) {
+         return (0);
+      }
+
+      pthread_mutex_lock(&zc->mutex);
+      zc->fd = skt->file_descriptor;
+      zc->sequence = 0;
+      zc->ahead = 0;
+      pthread_mutex_unlock(&zc->mutex);
+   }
+
+   return (1);
+}
+
+int
+snl_zerocopy_send(snl_socket_t *skt, const void *buf, unsigned int len) {
+   snl_zerocopy_t *zc = skt->zerocopy;
+   unsigned int remaining = len;
+   const char *ptr = buf;
+   snl_zc_buffer_t *zb;
+   int error = SNL_ERROR_OK;
+   ssize_t sent;
+
+   if (!(zb = calloc(1, sizeof (snl_zc_buffer_t)))) {
+      return (SNL_ERROR_BUFFER);
+   }
+
+   zb->buf = buf;
+   zb->len = len;
+
+   pthread_mutex_lock(&zc->mutex);
+   zb->first = zc->sequence;
+   if (zc->tail) zc->tail->next = zb; else zc->head = zb;
+   zc->tail = zb;
+   pthread_mutex_unlock(&zc->mutex);
+
+   while (remaining) {
+      sent = send(skt->file_descriptor, ptr, remaining, MSG_ZEROCOPY | MSG_NOSIGNAL);
+
+      if (sent < 0) {
+         if (errno == EINTR) continue;
+
+         // out of memory for pinned pages, copy the rest
+         if (errno == ENOBUFS) {
+            if (snl_write(skt->file_descriptor, ptr, remaining)) error = SNL_ERROR_CLOSED;
+         } else {
+            error = SNL_ERROR_CLOSED;
+         }
+
+         break;
+      }
+
+      // every successful call gets the next id, its completion may
+      // already have been reaped by the worker
+      pthread_mutex_lock(&zc->mutex);
+      zb->count++;
+      if (zc->ahead & 1) zb->done++;
+      zc->ahead >>= 1;
+      zc->sequence++;
+      pthread_mutex_unlock(&zc->mutex);
+
+      ptr += sent;
+      remaining -= sent;
+   }
+
+   pthread_mutex_lock(&zc->mutex);
+   zb->sent = 1;
+   pthread_mutex_unlock(&zc->mutex);
+
+   return (error);
+}
+
+static void
+complete(snl_zerocopy_t *zc, unsigned int lo, unsigned int hi) {
+   unsigned int first, last, id;
+   snl_zc_buffer_t *zb;
+
+   pthread_mutex_lock(&zc->mutex);
+
+   for (zb=zc->head; zb; zb=zb->next) {
+      if (!zb->count) continue;
+
+      first = (lo > zb->first) ? lo : zb->first;
+      last  = (hi < zb->first + zb->count - 1) ? hi : zb->first + zb->count - 1;
+
+      if (first <= last) zb->done += last - first + 1;
+   }
+
+   // ids of a send call, that did not return yet
+   for (id=(lo > zc->sequence) ? lo : zc->sequence; (id <= hi) && (id - zc->sequence < 64); id++) {
+      zc->ahead |= 1ULL << (id - zc->sequence);
+   }
+
+   pthread_mutex_unlock(&zc->mutex);
+}
+
+int
+snl_zerocopy_reap(snl_socket_t *skt, snl_zerocopy_deliver_t deliver) {
+   snl_zerocopy_t *zc = skt->zerocopy;
+   struct sock_extended_err *ee;
+   unsigned char control[128];
+   struct cmsghdr *cm;
+   snl_zc_buffer_t *zb;
+   struct msghdr msg;
+   int count = 0;
+
+   // fetch all notifications waiting in the error queue
+   while (1) {
+      memset(&msg, 0, sizeof (msg));
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof (control);
+
+      if (recvmsg(skt->file_descriptor, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+         if (errno == EINTR) continue;
+         break;
+      }
+
+      for (cm=CMSG_FIRSTHDR(&msg); cm; cm=CMSG_NXTHDR(&msg, cm)) {
+         if (!((cm->cmsg_level == IPPROTO_IP)   && (cm->cmsg_type == IP_RECVERR)) &&
+             !((cm->cmsg_level == IPPROTO_IPV6) && (cm->cmsg_type == IPV6_RECVERR))) {
+            continue;
+         }
+
+         ee = (struct sock_extended_err *)CMSG_DATA(cm);
+
+         // a range of ids, even if the kernel had to copy after all
+         if ((ee->ee_origin == SO_EE_ORIGIN_ZEROCOPY) && !ee->ee_errno) {
+            complete(zc, ee->ee_info, ee->ee_data);
+            count++;
+         }
+      }
+   }
+
+   // hand back buffers in the order they were sent
+   while (1) {
+      pthread_mutex_lock(&zc->mutex);
+
+      zb = zc->head;
+
+      if (!zb || !zb->sent || (zb->done < zb->count)) {
+         pthread_mutex_unlock(&zc->mutex);
+         break;
+      }
+
+      if (!(zc->head = zb->next)) zc->tail = NULL;
+
+      pthread_mutex_unlock(&zc->mutex);
+
+      deliver(skt, zb->buf, zb->len);
+
+      free(zb);
+   }
+
+   return (count);
+}
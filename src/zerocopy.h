@@ -0,0 +1,58 @@
+/*
+   The SNL (Simple Network Layer) provides a neat C API for network programming.
+   Copyright (C) 2001, 2002, 2013 Clemens Kirchgatterer <clemens@1541.org>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef _SNL_ZEROCOPY_H_
+#define _SNL_ZEROCOPY_H_
+
+#include <pthread.h>
+
+#include "snl.h"
+
+// buffer of one snl_send(), owned by the kernel until completion
+typedef struct snl_zc_buffer_t {
+   const void *buf;
+   unsigned int len;
+   unsigned int first;            // notification id of the first send call
+   unsigned int count;            // number of send calls
+   unsigned int done;             // send calls completed
+   int sent;                      // snl_send() returned
+   struct snl_zc_buffer_t *next;
+} snl_zc_buffer_t;
+
+typedef struct snl_zerocopy_t {
+   unsigned int threshold;        // min payload size, 0 disabled
+   unsigned int sequence;         // id of the next send call
+   unsigned long long ahead;      // completed ids not yet counted, from sequence
+   int fd;                        // socket with SO_ZEROCOPY enabled
+   pthread_mutex_t mutex;
+   snl_zc_buffer_t *head, *tail;  // in order of snl_send()
+   int lent;                      // data buffer is a sent buffer
+   void *spare;                   // receive buffer while delivering
+} snl_zerocopy_t;
+
+typedef void (*snl_zerocopy_deliver_t)(snl_socket_t *skt, const void *buf, unsigned int len);
+
+snl_zerocopy_t *snl_zerocopy_new(void);
+void snl_zerocopy_delete(snl_zerocopy_t *zc);
+
+int snl_zerocopy_ready(snl_socket_t *skt, unsigned int len);
+int snl_zerocopy_send(snl_socket_t *skt, const void *buf, unsigned int len);
+int snl_zerocopy_reap(snl_socket_t *skt, snl_zerocopy_deliver_t deliver);
+
+#endif // _SNL_ZEROCOPY_H_
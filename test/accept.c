@@ -0,0 +1,185 @@
+//
+// SNL admission benchmark, a storm of connections against a listener, plain
+// and with a connection limit and an accept rate, checks that the limit
+// refuses the rest at once and the rate paces the accepts
+//
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/time.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+
+#include "snl/snl.h"
+
+#define TOLERANCE 0.1 // of the accept rate
+
+static volatile int accepted = 0, closed = 0;
+
+static int made, refused, bad = 0;
+
+static double first, last; // the first and the last accept of a run
+
+static double
+now(void) {
+   struct timeval tv;
+
+   gettimeofday(&tv, NULL);
+
+   return (tv.tv_sec + tv.tv_usec / 1000000.0);
+}
+
+static void
+server_callback(snl_socket_t *skt) {
+   snl_socket_t *peer;
+
+   switch (skt->event_code) {
+      case SNL_EVENT_ACCEPT:
+         peer = snl_socket_new(SNL_PROTO_MSG, server_callback, NULL);
+         peer->file_descriptor = skt->client_fd;
+         snl_accept(peer);
+
+         last = now();
+         if (!accepted++) first = last;
+      break;
+
+      case SNL_EVENT_ERROR:
+         if (skt->error_code == SNL_ERROR_CLOSED) {
+            snl_disconnect(skt);
+            __sync_fetch_and_add(&closed, 1);
+         }
+      break;
+   }
+}
+
+// plain sockets, a few thousand snl clients would measure their threads
+static int
+storm(unsigned short port, int count, int *fds) {
+   struct sockaddr_in sa;
+   int i, made = 0;
+
+   memset(&sa, 0, sizeof (sa));
+   sa.sin_family = AF_INET;
+   sa.sin_port = htons(port);
+   sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+   for (i=0; i<count; i++) {
+      if ((fds[i] = socket(AF_INET, SOCK_STREAM, 0)) < 0) continue;
+
+      if (connect(fds[i], (struct sockaddr *)&sa, sizeof (sa))) {
+         close(fds[i]);
+         fds[i] = -1;
+         continue;
+      }
+
+      made++;
+   }
+
+   return (made);
+}
+
+static void
+run(const char *name, unsigned short port, int count, unsigned int limit, snl_bucket_t *bkt) {
+   double t0, connected, secs;
+   snl_socket_t *server;
+   int i, *fds;
+
+   fds = calloc(count, sizeof (int));
+
+   server = snl_socket_new(SNL_PROTO_MSG, server_callback, NULL);
+   if (limit || bkt) snl_admission(server, 0, limit, bkt);
+
+   if (snl_listen(server, port)) {
+      printf("%-6s could not listen\n", name);
+      bad++;
+      return;
+   }
+
+   accepted = 0; made = 0;
+   t0 = now();
+
+   made = storm(port, count, fds);
+   connected = now() - t0;
+
+   while ((accepted + snl_refused(server) < made) && (now() - t0 < 60)) usleep(1000);
+   secs = now() - t0;
+
+   refused = snl_refused(server);
+
+   printf("%-6s %8i %8i %8u %8u %10.1f %10.1f %10.0f\n", name, made, accepted,
+      refused, snl_connections(server), connected * 1000.0,
+      secs * 1000.0, accepted / secs);
+
+   closed = 0;
+   for (i=0; i<count; i++) {
+      if (fds[i] >= 0) close(fds[i]);
+   }
+
+   while ((closed < accepted) && (now() - t0 < 60)) usleep(1000);
+
+   snl_socket_delete(server);
+
+   free(fds);
+}
+
+int
+main(int argc, char **argv) {
+   int i, port = 3000, count = 500, rate = 500;
+   snl_bucket_t *bucket;
+   double paced;
+
+   for (i=1; i<argc; i++) {
+      if (!strcmp(argv[i], "-p")) port  = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-c")) count = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-r")) rate  = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+         puts("");
+         puts("accept " VERSION " <clemens@1541.org>");
+         puts("");
+         puts("USAGE: accept [-p port] [-c cnt] [-r rate]");
+         puts("\t-p ... use port <port> for connections (default 3000)");
+         puts("\t-c ... open <cnt> connections per test (default 500)");
+         puts("\t-r ... accepts per second when limited (default 500)");
+         puts("");
+         exit(0);
+      }
+   }
+
+   snl_init();
+
+   printf("%i connections at once\n\n", count);
+   printf("%-6s %8s %8s %8s %8s %10s %10s %10s\n", "", "made", "accepted",
+      "refused", "live", "conn ms", "drain ms", "accept/s");
+
+   run("plain", port, count, 0, NULL);
+   if ((made != count) || (accepted != made) || refused) bad++;
+
+   // a quarter is served, the rest shed right away
+   run("limit", port + 1, count, count / 4, NULL);
+   if ((made != count) || (accepted != count / 4) || (refused != made - count / 4)) bad++;
+
+   // all are served, beyond the burst at the given rate
+   bucket = snl_bucket_new(SNL_RATE_MESSAGES, rate, rate / 10);
+   run("rate", port + 2, count, 0, bucket);
+   snl_bucket_delete(bucket);
+
+   // a client retries a dropped SYN only a second later, which stretches
+   // the drain time, so only the pace of the accepts is checked
+   paced = (accepted - 1 - rate / 10) / (last - first);
+   printf("\n%-6s %8.0f accepts/s after the burst of %i\n", "rate", paced, rate / 10);
+
+   if ((accepted != made) || refused) bad++;
+   if (paced > rate * (1 + TOLERANCE)) bad++;
+
+   if (bad) {
+      printf("FAIL\n");
+      return (1);
+   }
+
+   printf("PASS\n");
+
+   return (0);
+}
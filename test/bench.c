@@ -0,0 +1,156 @@
+//
+// SNL transport benchmark, TCP loopback vs. unix domain vs. shared memory
+// vs. in-process, tcp50 coalesces messages for up to 50us
+//
+
+#include <sys/time.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sched.h>
+#include <stdio.h>
+
+#include "snl/snl.h"
+
+static volatile int echoed = 0, counted = 0, echo = 0, closed = 0;
+
+static double
+now(void) {
+   struct timeval tv;
+
+   gettimeofday(&tv, NULL);
+
+   return (tv.tv_sec + tv.tv_usec / 1000000.0);
+}
+
+static void
+server_callback(snl_socket_t *skt) {
+   snl_socket_t *peer;
+
+   switch (skt->event_code) {
+      case SNL_EVENT_ACCEPT:
+         peer = snl_socket_new(skt->protocol, server_callback, NULL);
+         peer->file_descriptor = skt->client_fd;
+         snl_accept(peer);
+      break;
+
+      case SNL_EVENT_ERROR:
+         if (skt->error_code == SNL_ERROR_CLOSED) {
+            snl_disconnect(skt);
+            closed++;
+         }
+      break;
+
+      case SNL_EVENT_RECEIVE:
+         if (echo) {
+            snl_send(skt, skt->data_buffer, skt->data_length);
+         } else {
+            counted++;
+         }
+      break;
+   }
+}
+
+static void
+client_callback(snl_socket_t *skt) {
+   if (skt->event_code == SNL_EVENT_RECEIVE) echoed++;
+}
+
+static void
+wait_for(volatile int *counter, int value) {
+   double timeout = now() + 30;
+
+   while ((*counter < value) && (now() < timeout)) {
+      sched_yield();
+   }
+}
+
+static void
+run(const char *name, int proto, int local, unsigned int budget, unsigned short port, int count, int size) {
+   snl_socket_t *server, *client;
+   double t0, rtt, rate;
+   char *load;
+   int i;
+
+   load = calloc(1, size);
+
+   server = snl_socket_new(proto, server_callback, NULL);
+   snl_local(server, local);
+
+   if (snl_listen(server, port)) {
+      printf("%-6s could not listen\n", name);
+      return;
+   }
+
+   client = snl_socket_new(proto, client_callback, NULL);
+   snl_local(client, local);
+   snl_coalesce(client, budget, 0);
+
+   if (snl_connect(client, "localhost", port)) {
+      printf("%-6s could not connect\n", name);
+      return;
+   }
+
+   // round trip latency, one message in flight
+   echo = 1; echoed = 0;
+   t0 = now();
+   for (i=0; i<count; i++) {
+      snl_send(client, load, size);
+      wait_for(&echoed, i + 1);
+   }
+   rtt = (now() - t0) / count * 1000000.0;
+
+   // throughput, as fast as the sender can go
+   echo = 0; counted = 0;
+   t0 = now();
+   for (i=0; i<count; i++) {
+      snl_send(client, load, size);
+   }
+   wait_for(&counted, count);
+   rate = count / (now() - t0);
+
+   printf("%-6s %10.1f %12.0f %10.1f\n", name, rtt, rate, rate * size / 1048576.0);
+
+   closed = 0;
+   snl_socket_delete(client);
+   wait_for(&closed, 1);
+
+   snl_socket_delete(server);
+
+   free(load);
+}
+
+int
+main(int argc, char **argv) {
+   int i, port = 3000, count = 100000, size = 64;
+
+   for (i=1; i<argc; i++) {
+      if (!strcmp(argv[i], "-p")) port  = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-c")) count = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-s")) size  = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+         puts("");
+         puts("bench " VERSION " <clemens@1541.org>");
+         puts("");
+         puts("USAGE: bench [-p port] [-c cnt] [-s size]");
+         puts("\t-p ... use port <port> for connections (default 3000)");
+         puts("\t-c ... transmit <cnt> messages per test (default 100000)");
+         puts("\t-s ... size of payload (default 64)");
+         puts("");
+         exit(0);
+      }
+   }
+
+   snl_init();
+
+   printf("%i messages of %i bytes\n\n", count, size);
+   printf("%-6s %10s %12s %10s\n", "", "rtt us", "msg/s", "MB/s");
+
+   run("tcp",   SNL_PROTO_MSG,  0, 0,  port, count, size);
+   run("tcp50", SNL_PROTO_MSG,  0, 50, port, count, size);
+   run("unix",  SNL_PROTO_MSG,  1, 0,  port, count, size);
+   run("shm",   SNL_PROTO_SHM,  0, 0,  port, count, size);
+   run("loop",  SNL_PROTO_LOOP, 0, 0,  port, count, size);
+
+   return (0);
+}
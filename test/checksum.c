@@ -0,0 +1,223 @@
+//
+// SNL checksum test, sends hand made messages with a good, a corrupted or
+// no CRC32C to receivers in checksum mode and checks that only the good
+// ones are received, while the others raise SNL_ERROR_CHECKSUM
+//
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+
+#include "snl/snl.h"
+#include "snl/crc.h"
+
+static volatile int received = 0, errors = 0, error_code = 0;
+
+static char last[256];
+
+static int bad = 0;
+
+static void
+server_callback(snl_socket_t *skt) {
+   snl_socket_t *peer;
+
+   switch (skt->event_code) {
+      case SNL_EVENT_ACCEPT:
+         peer = snl_socket_new(SNL_PROTO_MSG, server_callback, NULL);
+         snl_checksum(peer, 1);
+         peer->file_descriptor = skt->client_fd;
+         snl_accept(peer);
+      break;
+
+      case SNL_EVENT_RECEIVE:
+         if (skt->data_length < sizeof (last)) {
+            memcpy(last, skt->data_buffer, skt->data_length);
+            last[skt->data_length] = '\0';
+         }
+         __sync_fetch_and_add(&received, 1);
+      break;
+
+      case SNL_EVENT_ERROR:
+         error_code = skt->error_code;
+         __sync_fetch_and_add(&errors, 1);
+      break;
+   }
+}
+
+// payload and its little endian CRC32C, returns the length
+static unsigned int
+message(unsigned char *buf, const char *text) {
+   unsigned int len = strlen(text), crc;
+
+   memcpy(buf, text, len);
+   crc = snl_crc32c(0, buf, len);
+
+   buf[len + 0] = crc;
+   buf[len + 1] = crc >> 8;
+   buf[len + 2] = crc >> 16;
+   buf[len + 3] = crc >> 24;
+
+   return (len + CRC_SIZE);
+}
+
+// the event a message raised, once the worker got to it
+static void
+check(const char *name, const char *text, int error) {
+   int i, ok;
+
+   for (i=0; (received + errors < 1) && (i<1000); i++) usleep(1000);
+
+   if (text) {
+      ok = (received == 1) && !errors && !strcmp(last, text);
+   } else {
+      ok = !received && (errors == 1) && (error_code == error);
+   }
+
+   printf("%-28s %8s %8i %8i %s\n", name, text ? "receive" : "error", received, errors, ok ? "ok" : "FAIL");
+
+   if (!ok) bad++;
+
+   received = 0;
+   errors = 0;
+   error_code = 0;
+}
+
+static void
+datagrams(int fd, struct sockaddr_in *sa) {
+   unsigned char buf[256];
+   unsigned int len;
+
+   printf("%-28s %8s %8s %8s\n", "udp", "wanted", "received", "errors");
+
+   len = message(buf, "hello");
+   if (sendto(fd, buf, len, 0, (struct sockaddr *)sa, sizeof (*sa))) {}
+   check("good", "hello", 0);
+
+   buf[1] ^= 0x01;
+   if (sendto(fd, buf, len, 0, (struct sockaddr *)sa, sizeof (*sa))) {}
+   check("payload corrupted", NULL, SNL_ERROR_CHECKSUM);
+
+   len = message(buf, "hello");
+   buf[len - 1] ^= 0x80;
+   if (sendto(fd, buf, len, 0, (struct sockaddr *)sa, sizeof (*sa))) {}
+   check("crc corrupted", NULL, SNL_ERROR_CHECKSUM);
+
+   if (sendto(fd, buf, CRC_SIZE - 1, 0, (struct sockaddr *)sa, sizeof (*sa))) {}
+   check("shorter than the crc", NULL, SNL_ERROR_CHECKSUM);
+
+   len = message(buf, "again");
+   if (sendto(fd, buf, len, 0, (struct sockaddr *)sa, sizeof (*sa))) {}
+   check("good afterwards", "again", 0);
+
+   printf("\n");
+}
+
+// a version 1 frame, 4 byte length and the message
+static void
+frame(int fd, const unsigned char *buf, unsigned int len) {
+   unsigned char hdr[4];
+   unsigned int l = htonl(len);
+
+   memcpy(hdr, &l, 4);
+
+   if (write(fd, hdr, 4)) {}
+   if (write(fd, buf, len)) {}
+}
+
+static void
+messages(int fd) {
+   unsigned char buf[256];
+   unsigned int len;
+
+   printf("%-28s %8s %8s %8s\n", "msg", "wanted", "received", "errors");
+
+   len = message(buf, "hello");
+   frame(fd, buf, len);
+   check("good", "hello", 0);
+
+   buf[0] ^= 0x01;
+   frame(fd, buf, len);
+   check("payload corrupted", NULL, SNL_ERROR_CHECKSUM);
+
+   frame(fd, buf, CRC_SIZE - 1);
+   check("shorter than the crc", NULL, SNL_ERROR_CHECKSUM);
+
+   len = message(buf, "again");
+   frame(fd, buf, len);
+   check("still connected", "again", 0);
+
+   printf("\n");
+}
+
+int
+main(int argc, char **argv) {
+   unsigned short port = 3000;
+   snl_socket_t *udp, *msg;
+   struct sockaddr_in sa;
+   unsigned int crc;
+   int i, fd;
+
+   for (i=1; i<argc; i++) {
+      if (!strcmp(argv[i], "-p")) port = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+         puts("");
+         puts("checksum " VERSION " <clemens@1541.org>");
+         puts("");
+         puts("USAGE: checksum [-p port]");
+         puts("\t-p ... use port <port> for datagrams and connections (default 3000)");
+         puts("");
+         exit(0);
+      }
+   }
+
+   snl_init();
+
+   // the check value of the Castagnoli polynomial
+   crc = snl_crc32c(0, "123456789", 9);
+   printf("%-28s %08x %08x %s\n\n", "crc32c", 0xe3069283, crc, (crc == 0xe3069283) ? "ok" : "FAIL");
+   if (crc != 0xe3069283) bad++;
+
+   udp = snl_socket_new(SNL_PROTO_UDP, server_callback, NULL);
+   msg = snl_socket_new(SNL_PROTO_MSG, server_callback, NULL);
+   snl_checksum(udp, 1);
+
+   if (snl_listen(udp, port) || snl_listen(msg, port)) {
+      printf("could not listen\n");
+      return (1);
+   }
+
+   memset(&sa, 0, sizeof (sa));
+   sa.sin_family = AF_INET;
+   sa.sin_port = htons(port);
+   sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+   fd = socket(AF_INET, SOCK_DGRAM, 0);
+   datagrams(fd, &sa);
+   close(fd);
+
+   fd = socket(AF_INET, SOCK_STREAM, 0);
+
+   if (connect(fd, (struct sockaddr *)&sa, sizeof (sa))) {
+      printf("could not connect\n");
+      return (1);
+   }
+
+   messages(fd);
+   close(fd);
+
+   snl_socket_delete(udp);
+   snl_socket_delete(msg);
+
+   if (bad) {
+      printf("FAIL\n");
+      return (1);
+   }
+
+   printf("PASS\n");
+
+   return (0);
+}
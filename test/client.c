@@ -3,6 +3,7 @@
 //
 
 #include <sys/time.h>
+#include <pthread.h>
 #include <signal.h>
 #include <string.h>
 #include <stdlib.h>
@@ -15,6 +16,10 @@
 
 static int shortest = INT_MAX, longest = 0, sum = 0, shutdown = 0;
 
+static int proto = SNL_PROTO_MSG, local = 0;
+
+static int seq = 0, size = 0, count = 10, interval = 1000;
+
 static char *load = "abcdefghijklmnopqrstuvwxyz!@#$%^&*()1234567890";
 
 static struct timeval start;
@@ -45,6 +50,22 @@ quit(int sig) {
    }
 }
 
+static void *
+transmit(void *arg) {
+   snl_socket_t *skt = (snl_socket_t *)arg;
+
+   while ((seq < count) && (!shutdown)) {
+      msleep(interval);
+      gettimeofday(&start, NULL);
+      if (snl_send(skt, load, size)) {
+         printf("error while sending data to server\n");
+      }
+      __sync_fetch_and_add(&seq, 1);
+   }
+
+   return (NULL);
+}
+
 void
 event_callback(snl_socket_t *skt) {
    static int sequence = 1;
@@ -81,8 +102,8 @@ event_callback(snl_socket_t *skt) {
 
 int
 main(int argc, char **argv) {
-   int i, size = 0, seq = 0, count = 10;
-   int port = 3000, interval = 1000;
+   int i, port = 3000, threads = 1;
+   pthread_t tid[64];
    float min, max, avg;
    snl_socket_t *skt;
    char *key = NULL;
@@ -93,16 +114,22 @@ main(int argc, char **argv) {
       if (!strcmp(argv[i], "-c")) count    = atoi(argv[i+1]);
       if (!strcmp(argv[i], "-s")) size     = atoi(argv[i+1]);
       if (!strcmp(argv[i], "-i")) interval = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-t")) threads  = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-m")) proto    = SNL_PROTO_SHM;
+      if (!strcmp(argv[i], "-u")) local    = 1;
       if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
          puts("");
          puts("client " VERSION " <clemens@1541.org>");
          puts("");
-         puts("USAGE: client [-i int] [-p port] [-t text] [-k key] [-c cnt]");
+         puts("USAGE: client [-i int] [-p port] [-s size] [-k key] [-c cnt] [-t num] [-m] [-u]");
          puts("\t-p ... use port <port> for connections (default 3000)");
          puts("\t-k ... set cipher key to <key>");
          puts("\t-s ... size of payload");
          puts("\t-i ... packet interval in ms (default 1000)");
          puts("\t-c ... transmit <cnt> packets then exit (default 10)");
+         puts("\t-t ... send from <num> threads at once (default 1)");
+         puts("\t-m ... connect over shared memory (local server only)");
+         puts("\t-u ... connect over unix domain sockets (local server only)");
          puts("");
          exit(0);
       }
@@ -115,11 +142,16 @@ main(int argc, char **argv) {
    signal(SIGHUP,  quit);
 
    if (count == -1) count = INT_MAX;
+   if (threads < 1) threads = 1;
+   if (threads > 64) threads = 64;
 
-   skt = snl_socket_new(SNL_PROTO_MSG, event_callback, NULL);
+   skt = snl_socket_new(proto, event_callback, NULL);
+   snl_local(skt, local);
 
    snl_passphrase(skt, key);
 
+   if (threads > 1) snl_threadsafe(skt, 1);
+
    if (!(snl_connect(skt, "localhost", port)) > 0) {
       if (size) {
          if (!(load = (char *)malloc(size))) {
@@ -130,13 +162,14 @@ main(int argc, char **argv) {
          size = strlen(load);
       }
 
-      while ((seq < count) && (!shutdown)) {
-         msleep(interval);
-         gettimeofday(&start, NULL);
-         if (snl_send(skt, load, size)) {
-            printf("error while sending data to server\n");
-         }
-         seq++;
+      for (i=1; i<threads; i++) {
+         pthread_create(&tid[i], NULL, transmit, skt);
+      }
+
+      transmit(skt);
+
+      for (i=1; i<threads; i++) {
+         pthread_join(tid[i], NULL);
       }
 
       sleep(1); // wait for answer packets to arrive
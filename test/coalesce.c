@@ -0,0 +1,176 @@
+//
+// SNL coalesce test, checks that a message waits no longer than the
+// budget of snl_coalesce() while the worker of its socket is busy, in
+// a callback or in the middle of a message the peer stalled halfway
+//
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/time.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <poll.h>
+#include <stdio.h>
+
+#include "snl/snl.h"
+
+#define SLACK 10.0 // ms beyond the budget a busy machine may need
+
+static volatile int received = 0, stall = 0;
+
+static int bad = 0;
+
+static double
+now(void) {
+   struct timeval tv;
+
+   gettimeofday(&tv, NULL);
+
+   return (tv.tv_sec + tv.tv_usec / 1000000.0);
+}
+
+static void
+client_callback(snl_socket_t *skt) {
+   if (skt->event_code != SNL_EVENT_RECEIVE) return;
+
+   if (stall) usleep(stall * 1000);
+
+   __sync_fetch_and_add(&received, 1);
+}
+
+// ms until a message of len bytes arrives, -1 if not within a second
+static double
+arrival(int fd, unsigned int len, double t0) {
+   struct pollfd pfd = { fd, POLLIN, 0 };
+   char buf[256];
+   int n, got = 0;
+
+   while (got < (int)(len + 4)) {
+      if (poll(&pfd, 1, 1000 - (int)((now() - t0) * 1000.0)) <= 0) return (-1.0);
+      if ((n = read(fd, buf, sizeof (buf))) <= 0) return (-1.0);
+      got += n;
+   }
+
+   return ((now() - t0) * 1000.0);
+}
+
+static void
+check(const char *name, double ms, unsigned int budget) {
+   int ok = (ms >= 0.0) && (ms < budget / 1000.0 + SLACK);
+
+   printf("%-24s %10.1f %10.1f %s\n", name, budget / 1000.0, ms, ok ? "ok" : "FAIL");
+
+   if (!ok) bad++;
+}
+
+// the start of a message of len bytes
+static void
+header(int fd, unsigned int len, unsigned int part) {
+   char buf[256];
+   unsigned int l = htonl(len);
+
+   memcpy(buf, &l, 4);
+   memset(buf + 4, 'p', part);
+
+   if (write(fd, buf, 4 + part)) {}
+}
+
+int
+main(int argc, char **argv) {
+   unsigned int budget = 2000, i;
+   unsigned short port = 3000;
+   struct sockaddr_in sa;
+   snl_socket_t *client;
+   int lfd, fd, one = 1;
+   char rest[256];
+   double t0;
+
+   for (i=1; i<(unsigned int)argc; i++) {
+      if (!strcmp(argv[i], "-p")) port = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-b")) budget = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+         puts("");
+         puts("coalesce " VERSION " <clemens@1541.org>");
+         puts("");
+         puts("USAGE: coalesce [-p port] [-b us]");
+         puts("\t-p ... use port <port> for connections (default 3000)");
+         puts("\t-b ... coalesce messages for up to <us> (default 2000)");
+         puts("");
+         exit(0);
+      }
+   }
+
+   snl_init();
+
+   memset(&sa, 0, sizeof (sa));
+   sa.sin_family = AF_INET;
+   sa.sin_port = htons(port);
+   sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+   lfd = socket(AF_INET, SOCK_STREAM, 0);
+   setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof (one));
+
+   if (bind(lfd, (struct sockaddr *)&sa, sizeof (sa)) || listen(lfd, 1)) {
+      printf("could not listen\n");
+      return (1);
+   }
+
+   client = snl_socket_new(SNL_PROTO_MSG, client_callback, NULL);
+   snl_coalesce(client, budget, 0);
+
+   if (snl_connect(client, "localhost", port) || ((fd = accept(lfd, NULL, NULL)) < 0)) {
+      printf("could not connect\n");
+      return (1);
+   }
+
+   printf("%-24s %10s %10s\n", "", "budget ms", "waited ms");
+
+   // the worker waits for data and serves the budget itself
+   t0 = now();
+   snl_send(client, "idle", 4);
+   check("idle worker", arrival(fd, 4, t0), budget);
+
+   // the worker sleeps in a callback
+   stall = 500;
+   header(fd, 8, 8);
+   usleep(50000);
+
+   t0 = now();
+   snl_send(client, "callback", 8);
+   check("worker in callback", arrival(fd, 8, t0), budget);
+
+   for (i=0; (received < 1) && (i<3000); i++) usleep(1000);
+   stall = 0;
+
+   // the worker reads a message the peer stopped sending halfway
+   header(fd, 16, 8);
+   usleep(50000);
+
+   t0 = now();
+   snl_send(client, "halfway", 7);
+   check("worker in a message", arrival(fd, 7, t0), budget);
+
+   memset(rest, 'p', 8);
+   if (write(fd, rest, 8)) {}
+   for (i=0; (received < 2) && (i<3000); i++) usleep(1000);
+
+   // and still does after all of that
+   t0 = now();
+   snl_send(client, "afterwards", 10);
+   check("afterwards", arrival(fd, 10, t0), budget);
+
+   snl_socket_delete(client);
+   close(fd);
+   close(lfd);
+
+   if (bad) {
+      printf("FAIL\n");
+      return (1);
+   }
+
+   printf("PASS\n");
+
+   return (0);
+}
@@ -0,0 +1,158 @@
+//
+// SNL compress test, round trips messages through the LZ codec with and
+// without a shared dictionary, and feeds hand made sequences to the
+// decoder that reach back before the start of the output, run past its
+// end or are cut short, all of which must be refused
+//
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "snl/snl.h"
+#include "snl/compress.h"
+
+static int bad = 0;
+
+static void
+check(const char *name, int got, int expected) {
+   printf("%-28s %6i %6i %s\n", name, expected, got, (got == expected) ? "ok" : "FAIL");
+
+   if (got != expected) bad++;
+}
+
+// encoded by one state and decoded by another, 1 if it came back unchanged
+static int
+round_trip(snl_compress_t *enc, snl_compress_t *dec, const char *msg, unsigned int len, unsigned int *packed) {
+   unsigned char *buf = malloc(len + COMPRESS_OVERHEAD);
+   unsigned int size;
+   void *out;
+   int ok;
+
+   snl_compress_encode(enc, msg, len, buf, packed);
+
+   ok = !snl_compress_decode(dec, buf, *packed, &out, &size) && (size == len) && !memcmp(out, msg, len);
+
+   free(buf);
+
+   return (ok);
+}
+
+static int
+decode(snl_compress_t *cmp, const char *buf, unsigned int len) {
+   unsigned int size;
+   void *out;
+
+   return (snl_compress_decode(cmp, (void *)buf, len, &out, &size));
+}
+
+static void
+round_trips(void) {
+   snl_compress_t *enc = snl_compress_new(64), *dec = snl_compress_new(64);
+   char dict[1024], msg[4096];
+   unsigned int i, plain, shared, small, seed;
+
+   printf("%-28s %6s %6s\n", "round trip", "wanted", "got");
+
+   for (i=0; i<sizeof (msg); i++) msg[i] = "the quick brown fox "[i % 20];
+   check("repetitive", round_trip(enc, dec, msg, sizeof (msg), &plain), 1);
+   check("shorter", plain < sizeof (msg) / 8, 1);
+
+   check("below threshold", round_trip(enc, dec, msg, 32, &small), 1);
+   check("sent raw", small, 33);
+
+   // random letters, only the dictionary repeats them
+   for (i=0, seed=1; i<sizeof (dict); i++) {
+      seed = seed * 1103515245 + 12345;
+      dict[i] = 'a' + (seed >> 16) % 26;
+   }
+   memcpy(msg, dict + 100, 512);
+
+   check("unique", round_trip(enc, dec, msg, 512, &plain), 1);
+
+   snl_compress_load(enc, dict, sizeof (dict));
+   snl_compress_load(dec, dict, sizeof (dict));
+
+   check("with dictionary", round_trip(enc, dec, msg, 512, &shared), 1);
+   check("shorter than without", shared < plain / 4, 1);
+
+   printf("\n");
+
+   snl_compress_delete(enc);
+   snl_compress_delete(dec);
+}
+
+static void
+crafted(void) {
+   snl_compress_t *cmp = snl_compress_new(64);
+   char dict[16];
+   unsigned int size;
+   void *out;
+
+   printf("%-28s %6s %6s\n", "crafted", "wanted", "got");
+
+   // 4 literals, then 4 bytes from 10 back, before the start of the output
+   check("before the start", decode(cmp, "\x01\x08\x40" "abcd" "\x0a\x00", 9), SNL_ERROR_COMPRESS);
+
+   check("offset 0", decode(cmp, "\x01\x08\x40" "abcd" "\x00\x00", 9), SNL_ERROR_COMPRESS);
+
+   // 1 literal, then 11 bytes from 1 back, the run of one byte
+   check("overlapping", decode(cmp, "\x01\x0c\x17" "a" "\x01\x00", 6), SNL_ERROR_OK);
+
+   // 4 bytes of a match, but only 2 left of the declared length
+   check("past the end", decode(cmp, "\x01\x06\x40" "abcd" "\x04\x00", 9), SNL_ERROR_COMPRESS);
+
+   check("short of the end", decode(cmp, "\x01\x0a\x40" "abcd", 7), SNL_ERROR_COMPRESS);
+
+   // 8 literals announced, 3 there
+   check("truncated literals", decode(cmp, "\x01\x08\x80" "abc", 6), SNL_ERROR_COMPRESS);
+
+   check("truncated offset", decode(cmp, "\x01\x08\x40" "abcd" "\x04", 8), SNL_ERROR_COMPRESS);
+
+   // 100000 bytes out of 5
+   check("too long to be true", decode(cmp, "\x01\xa0\x8d\x06\x00", 5), SNL_ERROR_COMPRESS);
+
+   check("unknown marker", decode(cmp, "\x02" "abc", 4), SNL_ERROR_COMPRESS);
+   check("empty", decode(cmp, "", 0), SNL_ERROR_COMPRESS);
+
+   // the same reference, now reaching into the dictionary
+   memcpy(dict, "0123456789ABCDEF", 16);
+   snl_compress_load(cmp, dict, sizeof (dict));
+
+   check("into the dictionary", snl_compress_decode(cmp, (void *)"\x01\x08\x40" "abcd" "\x0a\x00", 9, &out, &size), SNL_ERROR_OK);
+   check("from the dictionary", (size == 8) && !memcmp(out, "abcdABCD", 8), 1);
+
+   check("before the dictionary", decode(cmp, "\x01\x08\x40" "abcd" "\x15\x00", 9), SNL_ERROR_COMPRESS);
+
+   printf("\n");
+
+   snl_compress_delete(cmp);
+}
+
+int
+main(int argc, char **argv) {
+   int i;
+
+   for (i=1; i<argc; i++) {
+      if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+         puts("");
+         puts("compress " VERSION " <clemens@1541.org>");
+         puts("");
+         puts("USAGE: compress");
+         puts("");
+         exit(0);
+      }
+   }
+
+   round_trips();
+   crafted();
+
+   if (bad) {
+      printf("FAIL\n");
+      return (1);
+   }
+
+   printf("PASS\n");
+
+   return (0);
+}
@@ -0,0 +1,231 @@
+//
+// SNL credit benchmark, messages sent but not yet processed by a slow
+// receiver, with and without credit based flow control, and the rate
+// with a fast receiver, checks that credit never lets the sender get
+// further ahead than the window, and that a callback sending to a peer
+// that does not read gets SNL_ERROR_BUFFER once its backlog is full
+//
+
+#include <sys/time.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sched.h>
+#include <stdio.h>
+
+#include "snl/snl.h"
+
+static volatile int delivered = 0, closed = 0, stalled = 0, answered = 0;
+
+static volatile int accepted = 0, refused = 0;
+
+static int window = 0, slow = 0, replies = 0, bad = 0;
+
+static double
+now(void) {
+   struct timeval tv;
+
+   gettimeofday(&tv, NULL);
+
+   return (tv.tv_sec + tv.tv_usec / 1000000.0);
+}
+
+static void
+server_callback(snl_socket_t *skt) {
+   static char reply[1024];
+   snl_socket_t *peer;
+   int i, error;
+
+   switch (skt->event_code) {
+      case SNL_EVENT_ACCEPT:
+         peer = snl_socket_new(SNL_PROTO_MSG, server_callback, NULL);
+         snl_credit(peer, window, 0);
+         peer->file_descriptor = skt->client_fd;
+         snl_accept(peer);
+      break;
+
+      case SNL_EVENT_ERROR:
+         if (skt->error_code == SNL_ERROR_CLOSED) {
+            snl_disconnect(skt);
+            closed++;
+         }
+      break;
+
+      case SNL_EVENT_RECEIVE:
+         if (slow) usleep(slow);
+         delivered++;
+
+         // answers from the callback, queued without credit
+         for (i=0; i<replies; i++) {
+            error = snl_send(skt, reply, sizeof (reply));
+
+            if (!error) accepted++;
+            if (error == SNL_ERROR_BUFFER) refused++;
+         }
+      break;
+   }
+}
+
+static void
+client_callback(snl_socket_t *skt) {
+   if (skt->event_code != SNL_EVENT_RECEIVE) return;
+
+   while (stalled) usleep(1000);
+   answered++;
+}
+
+static int
+run(const char *name, unsigned short port, int count, int size) {
+   snl_socket_t *server, *client;
+   int i, ahead, most = 0;
+   double t0, rate;
+   char *load;
+
+   load = calloc(1, size);
+
+   server = snl_socket_new(SNL_PROTO_MSG, server_callback, NULL);
+   client = snl_socket_new(SNL_PROTO_MSG, client_callback, NULL);
+
+   snl_credit(client, window, 0);
+
+   if (snl_listen(server, port) || snl_connect(client, "localhost", port)) {
+      printf("%-8s could not connect\n", name);
+      bad++;
+      return (0);
+   }
+
+   delivered = 0;
+   t0 = now();
+   for (i=0; i<count; i++) {
+      if (snl_send(client, load, size)) {
+         printf("%-8s send failed\n", name);
+         bad++;
+         break;
+      }
+
+      ahead = i + 1 - delivered;
+      if (ahead > most) most = ahead;
+   }
+
+   while ((delivered < count) && (now() - t0 < 60)) sched_yield();
+   rate = count / (now() - t0);
+
+   printf("%-8s %10.0f %10i %10.2f\n", name, rate, most, (double)most * size / 1048576.0);
+
+   // everything arrives, with credit never more than the window ahead
+   if ((delivered != count) || (window && (most > window))) bad++;
+
+   closed = 0;
+   snl_socket_delete(client);
+   while (!closed) usleep(1000);
+
+   snl_socket_delete(server);
+
+   free(load);
+
+   return (most);
+}
+
+// the client stops reading after its first answer, the server callback
+// sends on and on
+static void
+backlog(unsigned short port) {
+   snl_socket_t *server, *client;
+   int i, fits = (1<<20) / (1024 + 4);
+
+   server = snl_socket_new(SNL_PROTO_MSG, server_callback, NULL);
+   client = snl_socket_new(SNL_PROTO_MSG, client_callback, NULL);
+
+   window = 4;
+   replies = 2 * fits;
+   stalled = 1;
+   answered = accepted = refused = 0;
+
+   snl_credit(client, window, 0);
+
+   if (snl_listen(server, port) || snl_connect(client, "localhost", port)) {
+      printf("%-8s could not connect\n", "backlog");
+      bad++;
+      return;
+   }
+
+   snl_send(client, "x", 1);
+
+   for (i=0; (accepted + refused < replies) && (i<5000); i++) usleep(1000);
+
+   // a window on the wire, a backlog full of the rest
+   if ((accepted < fits) || (accepted > fits + window) || (refused != replies - accepted)) bad++;
+
+   // the peer reads again and gets all of what was accepted
+   stalled = 0;
+   for (i=0; (answered < accepted) && (i<5000); i++) usleep(1000);
+
+   if (answered != accepted) bad++;
+
+   printf("\n%-8s %10s %10s %10s %10s\n", "", "sent", "accepted", "refused", "answered");
+   printf("%-8s %10i %10i %10i %10i\n", "backlog", replies, accepted, refused, answered);
+
+   replies = 0;
+   closed = 0;
+   snl_socket_delete(client);
+   for (i=0; !closed && (i<5000); i++) usleep(1000);
+
+   snl_socket_delete(server);
+}
+
+int
+main(int argc, char **argv) {
+   int i, port = 3000, count = 20000, size = 1024, credits = 64;
+
+   for (i=1; i<argc; i++) {
+      if (!strcmp(argv[i], "-p")) port    = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-c")) count   = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-s")) size    = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-w")) credits = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+         puts("");
+         puts("credit " VERSION " <clemens@1541.org>");
+         puts("");
+         puts("USAGE: credit [-p port] [-c cnt] [-s size] [-w window]");
+         puts("\t-p ... use port <port> for connections (default 3000)");
+         puts("\t-c ... transmit <cnt> messages per test (default 20000)");
+         puts("\t-s ... size of payload (default 1024)");
+         puts("\t-w ... messages granted ahead (default 64)");
+         puts("");
+         exit(0);
+      }
+   }
+
+   snl_init();
+
+   printf("%i messages of %i bytes, window of %i messages\n\n", count, size, credits);
+   printf("%-8s %10s %10s %10s\n", "", "msg/s", "max ahead", "MB ahead");
+
+   slow = 50;
+
+   // without credit the sender runs far ahead of a slow receiver
+   window = 0;
+   if (run("slow", port, count, size) <= credits) bad++;
+
+   window = credits;
+   run("+credit", port + 1, count, size);
+
+   slow = 0;
+
+   window = 0;
+   run("fast", port + 2, count * 10, size);
+
+   window = credits;
+   run("+credit", port + 3, count * 10, size);
+
+   backlog(port + 4);
+
+   if (bad) {
+      printf("FAIL\n");
+      return (1);
+   }
+
+   printf("PASS\n");
+
+   return (0);
+}
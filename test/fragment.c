@@ -0,0 +1,190 @@
+//
+// SNL fragment test, feeds hand made fragments to a receiver in fragment
+// mode and checks that messages arriving out of order or with duplicates
+// are reassembled exactly once, and that fragments not fitting the layout
+// of their message or the memory limit are dropped
+//
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+
+#include "snl/snl.h"
+
+#define MTU    1472
+#define HEADER 16
+#define CHUNK  (MTU - HEADER)
+#define LIMIT  1<<20 // 1MB of reassembly memory
+
+static volatile int received = 0, corrupt = 0;
+
+static struct sockaddr_in sa;
+
+static int fd = -1, bad = 0;
+
+// every byte depends on its position and the id in the first one
+static unsigned char
+pattern(unsigned int id, unsigned int i) {
+   return ((i * 31 + id) & 0xff);
+}
+
+static void
+server_callback(snl_socket_t *skt) {
+   unsigned char *data = skt->data_buffer;
+   unsigned int i;
+
+   if (skt->event_code != SNL_EVENT_RECEIVE) return;
+
+   for (i=0; i<skt->data_length; i++) {
+      if (data[i] != pattern(data[0], i)) {
+         __sync_fetch_and_add(&corrupt, 1);
+         break;
+      }
+   }
+
+   __sync_fetch_and_add(&received, 1);
+}
+
+// one datagram of a message, len bytes of payload at index * chunk
+static void
+fragment(unsigned int id, unsigned int index, unsigned int count, unsigned int total, unsigned int len) {
+   unsigned int chunk = (total + count - 1) / count, i, l;
+   unsigned char buf[HEADER + 65507];
+   unsigned short s;
+
+   s = htons(0x534E); memcpy(buf +  0, &s, 2); // "SN"
+   s = htons(index);  memcpy(buf +  2, &s, 2);
+   s = htons(count);  memcpy(buf +  4, &s, 2);
+   s = 0;             memcpy(buf +  6, &s, 2);
+   l = htonl(id);     memcpy(buf +  8, &l, 4);
+   l = htonl(total);  memcpy(buf + 12, &l, 4);
+
+   for (i=0; i<len; i++) {
+      buf[HEADER + i] = pattern(id, index * chunk + i);
+   }
+
+   if (sendto(fd, buf, HEADER + len, 0, (struct sockaddr *)&sa, sizeof (sa))) {}
+}
+
+// payload of fragment index, as the sender cuts it
+static unsigned int
+slice(unsigned int index, unsigned int count, unsigned int total) {
+   unsigned int chunk = (total + count - 1) / count;
+
+   return (((index + 1) * chunk > total) ? total - index * chunk : chunk);
+}
+
+static void
+check(const char *name, int expected) {
+   int ok;
+
+   // loopback delivers at once, give the worker time to reassemble
+   usleep(50000);
+
+   ok = (received == expected) && !corrupt;
+
+   printf("%-14s %10i %10i %10i %s\n", name, expected, received, corrupt, ok ? "ok" : "FAIL");
+
+   if (!ok) bad++;
+
+   received = 0;
+   corrupt = 0;
+}
+
+int
+main(int argc, char **argv) {
+   unsigned int total = 10000, count = (total + CHUNK - 1) / CHUNK, i;
+   unsigned short port = 3000;
+   snl_socket_t *server;
+
+   for (i=1; i<(unsigned int)argc; i++) {
+      if (!strcmp(argv[i], "-p")) port = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+         puts("");
+         puts("fragment " VERSION " <clemens@1541.org>");
+         puts("");
+         puts("USAGE: fragment [-p port]");
+         puts("\t-p ... use port <port> for datagrams (default 3000)");
+         puts("");
+         exit(0);
+      }
+   }
+
+   snl_init();
+
+   server = snl_socket_new(SNL_PROTO_UDP, server_callback, NULL);
+   snl_fragment(server, MTU);
+   snl_fragment_limit(server, LIMIT, 200);
+
+   if (snl_listen(server, port)) {
+      printf("could not listen\n");
+      return (1);
+   }
+
+   memset(&sa, 0, sizeof (sa));
+   sa.sin_family = AF_INET;
+   sa.sin_port = htons(port);
+   sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+   fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+   printf("%i fragments of a %u byte message\n\n", count, total);
+   printf("%-14s %10s %10s %10s\n", "", "expected", "received", "corrupt");
+
+   for (i=0; i<count; i++) fragment(1, i, count, total, slice(i, count, total));
+   check("in order", 1);
+
+   for (i=count; i>0; i--) fragment(2, i - 1, count, total, slice(i - 1, count, total));
+   check("reversed", 1);
+
+   // every fragment twice, the message only once
+   for (i=0; i<count; i++) {
+      fragment(3, i, count, total, slice(i, count, total));
+      fragment(3, i, count, total, slice(i, count, total));
+   }
+   check("duplicates", 1);
+
+   // one missing, the rest expires
+   for (i=1; i<count; i++) fragment(4, i, count, total, slice(i, count, total));
+   check("incomplete", 0);
+
+   // a fragment too short or too long for its place, or out of range
+   fragment(5, 0, count, total, slice(0, count, total) - 1);
+   fragment(5, 1, count, total, slice(1, count, total) + 1);
+   fragment(5, count, count, total, slice(0, count, total));
+   check("bad layout", 0);
+
+   // the same message, still reassembled from the valid fragments
+   for (i=0; i<count; i++) fragment(5, i, count, total, slice(i, count, total));
+   check("after bad", 1);
+
+   // a later fragment claiming another length for the same id
+   fragment(6, 0, count, total, slice(0, count, total));
+   fragment(6, 1, count, total * 2, slice(1, count, total * 2));
+   for (i=1; i<count; i++) fragment(6, i, count, total, slice(i, count, total));
+   check("relayout", 1);
+
+   // more than the reassembly memory, never started
+   for (i=0; i<4; i++) fragment(7, i, 1024, 2 * LIMIT, slice(i, 1024, 2 * LIMIT));
+   check("oversized", 0);
+
+   // still works after all of that
+   for (i=0; i<count; i++) fragment(8, i, count, total, slice(i, count, total));
+   check("afterwards", 1);
+
+   close(fd);
+   snl_socket_delete(server);
+
+   if (bad) {
+      printf("FAIL\n");
+      return (1);
+   }
+
+   printf("PASS\n");
+
+   return (0);
+}
@@ -0,0 +1,238 @@
+//
+// SNL framing test, feeds truncated and overlong varints to the decoder
+// of the version 2 frame header and checks that they are refused, both
+// as frame length and inside a packed container sent by a hand made peer
+//
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+
+#include "snl/snl.h"
+#include "snl/framing.h"
+
+static volatile int received = 0, errors = 0;
+
+static char last[256];
+
+static int bad = 0;
+
+static void
+check(const char *name, long long got, long long expected) {
+   printf("%-28s %6lli %6lli %s\n", name, expected, got, (got == expected) ? "ok" : "FAIL");
+
+   if (got != expected) bad++;
+}
+
+static void
+server_callback(snl_socket_t *skt) {
+   snl_socket_t *peer;
+
+   switch (skt->event_code) {
+      case SNL_EVENT_ACCEPT:
+         peer = snl_socket_new(SNL_PROTO_MSG, server_callback, NULL);
+         snl_framing(peer, 2);
+         peer->file_descriptor = skt->client_fd;
+         snl_accept(peer);
+      break;
+
+      case SNL_EVENT_RECEIVE:
+         if (skt->data_length < sizeof (last)) {
+            memcpy(last, skt->data_buffer, skt->data_length);
+            last[skt->data_length] = '\0';
+         }
+         __sync_fetch_and_add(&received, 1);
+      break;
+
+      case SNL_EVENT_ERROR:
+         __sync_fetch_and_add(&errors, 1);
+      break;
+   }
+}
+
+// bytes used by a varint, 0 if refused
+static long long
+varint(const unsigned char *buf, unsigned int len) {
+   unsigned long long val;
+
+   return (snl_varint_get(buf, len, &val));
+}
+
+static void
+varints(void) {
+   unsigned long long values[] = { 0, 127, 128, 16384, 1ULL << 32, ~0ULL }, val;
+   unsigned char buf[16];
+   unsigned int i, len, ok = 0;
+
+   printf("%-28s %6s %6s\n", "varint", "wanted", "got");
+
+   for (i=0; i<sizeof (values) / sizeof (values[0]); i++) {
+      len = snl_varint_put(buf, values[i]);
+      if ((snl_varint_get(buf, len, &val) == len) && (val == values[i])) ok++;
+   }
+   check("round trip", ok, i);
+
+   // continued, but nothing follows
+   memset(buf, 0x80, sizeof (buf));
+   check("truncated", varint(buf, 3), 0);
+
+   // eleven bytes
+   buf[10] = 0x01;
+   check("overlong", varint(buf, 11), 0);
+
+   // ten bytes, the last one beyond the 64th bit
+   memset(buf, 0xff, 9);
+   buf[9] = 0x02;
+   check("more than 64 bit", varint(buf, 10), 0);
+
+   buf[9] = 0x01;
+   check("64 bit", varint(buf, 10), 10);
+
+   printf("\n");
+}
+
+// what snl_framing_read() makes of a header, the writer closes after it
+static int
+header(const unsigned char *buf, unsigned int len) {
+   unsigned long long size;
+   unsigned int flags;
+   int sv[2], error;
+
+   if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv)) return (-1);
+
+   if (write(sv[1], buf, len)) {}
+   close(sv[1]);
+
+   error = snl_framing_read(sv[0], &flags, &size);
+   close(sv[0]);
+
+   return (error);
+}
+
+static void
+headers(void) {
+   unsigned char buf[16];
+
+   printf("%-28s %6s %6s\n", "frame header", "wanted", "got");
+
+   buf[0] = 0x00; buf[1] = 0x05;
+   check("valid", header(buf, 2), SNL_ERROR_OK);
+
+   buf[0] = 0x04;
+   check("unknown flag", header(buf, 2), SNL_ERROR_PROTOCOL);
+
+   buf[0] = 0x00; buf[1] = 0x80;
+   check("end of stream midway", header(buf, 2), SNL_ERROR_CLOSED);
+
+   memset(buf + 1, 0x80, 11);
+   check("overlong", header(buf, 12), SNL_ERROR_RECEIVE);
+
+   memset(buf + 1, 0xff, 9);
+   buf[10] = 0x02;
+   check("more than 64 bit", header(buf, 11), SNL_ERROR_RECEIVE);
+
+   printf("\n");
+}
+
+static void
+wait_for(volatile int *count, int expected) {
+   int i;
+
+   for (i=0; (*count < expected) && (i<1000); i++) usleep(1000);
+}
+
+// a peer speaking version 2 by hand, sending packed containers
+static void
+containers(unsigned short port) {
+   unsigned char hello[4] = { 'S', 'N', 'L', 2 }, buf[64];
+   struct sockaddr_in sa;
+   int fd;
+
+   memset(&sa, 0, sizeof (sa));
+   sa.sin_family = AF_INET;
+   sa.sin_port = htons(port);
+   sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+   fd = socket(AF_INET, SOCK_STREAM, 0);
+
+   if (connect(fd, (struct sockaddr *)&sa, sizeof (sa)) ||
+      (write(fd, hello, 4) != 4) || (read(fd, buf, 4) != 4) || (buf[3] != 2)) {
+      printf("could not shake hands\n");
+      bad++;
+      close(fd);
+      return;
+   }
+
+   printf("%-28s %6s %6s\n", "packed container", "wanted", "got");
+
+   // "abc", then a length running past the end of the container
+   memcpy(buf, "\x01\x06" "\x03" "abc" "\x64" "x", 8);
+   if (write(fd, buf, 8)) {}
+   wait_for(&errors, 1);
+   check("length past the end", errors, 1);
+   check("messages before it", received, 1);
+
+   // "abc", then a varint the container ends in the middle of
+   memcpy(buf, "\x01\x05" "\x03" "abc" "\x80", 7);
+   if (write(fd, buf, 7)) {}
+   wait_for(&errors, 2);
+   check("truncated length", errors, 2);
+   check("messages before it", received, 2);
+
+   // and still in sync with the stream
+   memcpy(buf, "\x00\x05" "hello", 7);
+   if (write(fd, buf, 7)) {}
+   wait_for(&received, 3);
+   check("next frame", (received == 3) && !strcmp(last, "hello"), 1);
+
+   close(fd);
+}
+
+int
+main(int argc, char **argv) {
+   unsigned short port = 3000;
+   snl_socket_t *server;
+   int i;
+
+   for (i=1; i<argc; i++) {
+      if (!strcmp(argv[i], "-p")) port = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+         puts("");
+         puts("framing " VERSION " <clemens@1541.org>");
+         puts("");
+         puts("USAGE: framing [-p port]");
+         puts("\t-p ... use port <port> for connections (default 3000)");
+         puts("");
+         exit(0);
+      }
+   }
+
+   snl_init();
+
+   varints();
+   headers();
+
+   server = snl_socket_new(SNL_PROTO_MSG, server_callback, NULL);
+
+   if (snl_listen(server, port)) {
+      printf("could not listen\n");
+      return (1);
+   }
+
+   containers(port);
+
+   snl_socket_delete(server);
+
+   if (bad) {
+      printf("FAIL\n");
+      return (1);
+   }
+
+   printf("PASS\n");
+
+   return (0);
+}
@@ -0,0 +1,201 @@
+//
+// SNL group test, checks which sockets a group admits and that members
+// too slow to take a burst get the rest written by their worker, without
+// further calls to snl_group_send() or snl_group_flush()
+//
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/time.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+
+#include "snl/snl.h"
+
+static int bad = 0;
+
+static double
+now(void) {
+   struct timeval tv;
+
+   gettimeofday(&tv, NULL);
+
+   return (tv.tv_sec + tv.tv_usec / 1000000.0);
+}
+
+static void
+client_callback(snl_socket_t *skt) {
+}
+
+static void
+check(const char *name, int error, int expected) {
+   printf("%-24s %6i %6i %s\n", name, expected, error, (error == expected) ? "ok" : "FAIL");
+
+   if (error != expected) bad++;
+}
+
+// what a member must have in common with the group
+static void
+admission(void) {
+   snl_group_t *grp = snl_group_new(SNL_PROTO_MSG);
+   snl_socket_t *skt = snl_socket_new(SNL_PROTO_MSG, client_callback, NULL);
+   snl_socket_t *udp = snl_socket_new(SNL_PROTO_UDP, client_callback, NULL);
+   snl_bucket_t *bkt = snl_bucket_new(SNL_RATE_BYTES, 1000000, 0);
+
+   printf("%-24s %6s %6s\n", "admission", "wanted", "got");
+
+   check("policy out of range", snl_group_add(grp, skt, 42), SNL_ERROR_OPTION);
+   check("other protocol", snl_group_add(grp, udp, SNL_POLICY_QUEUE), SNL_ERROR_PROTOCOL);
+
+   snl_passphrase(skt, "member");
+   check("key without group key", snl_group_add(grp, skt, SNL_POLICY_QUEUE), SNL_ERROR_OPTION);
+
+   snl_group_passphrase(grp, "group");
+   check("other key", snl_group_add(grp, skt, SNL_POLICY_QUEUE), SNL_ERROR_OPTION);
+
+   snl_passphrase(skt, "group");
+   check("same key", snl_group_add(grp, skt, SNL_POLICY_QUEUE), SNL_ERROR_OK);
+   check("added twice", snl_group_add(grp, skt, SNL_POLICY_QUEUE), SNL_ERROR_OPTION);
+   check("key change with members", snl_group_passphrase(grp, "other"), SNL_ERROR_BUSY);
+
+   snl_group_remove(grp, skt);
+
+   snl_rate_limit(skt, SNL_RATE_SEND, bkt);
+   check("shaped", snl_group_add(grp, skt, SNL_POLICY_QUEUE), SNL_ERROR_PROTOCOL);
+
+   printf("\n");
+
+   snl_socket_delete(skt);
+   snl_socket_delete(udp);
+   snl_group_delete(grp);
+   snl_bucket_delete(bkt);
+}
+
+// receivers that take nothing until the whole burst is queued
+static void
+burst(unsigned short port, int members, int count, int size) {
+   int i, n, lfd, *fd, rcvbuf = 4096, one = 1;
+   long long want, *got, total = 0;
+   snl_socket_t **member;
+   struct sockaddr_in sa;
+   snl_group_t *grp;
+   double t0, secs;
+   char *load, buf[65536];
+
+   memset(&sa, 0, sizeof (sa));
+   sa.sin_family = AF_INET;
+   sa.sin_port = htons(port);
+   sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+   lfd = socket(AF_INET, SOCK_STREAM, 0);
+   setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof (one));
+   setsockopt(lfd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof (rcvbuf));
+
+   if (bind(lfd, (struct sockaddr *)&sa, sizeof (sa)) || listen(lfd, members)) {
+      printf("burst could not listen\n");
+      close(lfd);
+      bad++;
+      return;
+   }
+
+   grp = snl_group_new(SNL_PROTO_MSG);
+   member = calloc(members, sizeof (snl_socket_t *));
+   fd = calloc(members, sizeof (int));
+   got = calloc(members, sizeof (long long));
+   load = calloc(1, size);
+
+   for (i=0; i<members; i++) {
+      member[i] = snl_socket_new(SNL_PROTO_MSG, client_callback, NULL);
+
+      if (snl_connect(member[i], "localhost", port) || ((fd[i] = accept(lfd, NULL, NULL)) < 0)) {
+         printf("burst could not connect\n");
+         bad++;
+         return;
+      }
+
+      snl_group_add(grp, member[i], SNL_POLICY_QUEUE);
+   }
+
+   for (i=0; i<count; i++) {
+      snl_group_send(grp, load, size);
+   }
+
+   // nobody sends or flushes from here on
+   want = (long long)count * (size + 4);
+   t0 = now();
+
+   for (i=0; i<members; i++) {
+      while ((got[i] < want) && (now() - t0 < 5.0)) {
+         struct timeval tv = { 0, 100000 };
+
+         setsockopt(fd[i], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof (tv));
+         if ((n = read(fd[i], buf, sizeof (buf))) <= 0) continue;
+         got[i] += n;
+      }
+
+      total += got[i];
+   }
+
+   secs = now() - t0;
+
+   printf("%-10s %10s %10s %10s\n", "burst", "wanted KB", "got KB", "ms");
+   printf("%-10i %10lli %10lli %10.1f %s\n", members, want * members / 1024, total / 1024,
+      secs * 1000.0, (total == want * members) ? "ok" : "FAIL");
+
+   if (total != want * members) bad++;
+
+   for (i=0; i<members; i++) {
+      snl_group_remove(grp, member[i]);
+      snl_socket_delete(member[i]);
+      close(fd[i]);
+   }
+
+   snl_group_delete(grp);
+   close(lfd);
+
+   free(member);
+   free(load);
+   free(got);
+   free(fd);
+}
+
+int
+main(int argc, char **argv) {
+   int i, port = 3000, members = 4, count = 256, size = 16384;
+
+   for (i=1; i<argc; i++) {
+      if (!strcmp(argv[i], "-p")) port    = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-m")) members = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-c")) count   = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-s")) size    = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+         puts("");
+         puts("group " VERSION " <clemens@1541.org>");
+         puts("");
+         puts("USAGE: group [-p port] [-m members] [-c cnt] [-s size]");
+         puts("\t-p ... use port <port> for connections (default 3000)");
+         puts("\t-m ... number of group members (default 4)");
+         puts("\t-c ... messages of the burst (default 256)");
+         puts("\t-s ... size of one message (default 16384)");
+         puts("");
+         exit(0);
+      }
+   }
+
+   snl_init();
+
+   admission();
+   burst(port, members, count, size);
+
+   if (bad) {
+      printf("FAIL\n");
+      return (1);
+   }
+
+   printf("PASS\n");
+
+   return (0);
+}
@@ -0,0 +1,366 @@
+//
+// SNL HTTP benchmark, a new connection per request like demo/webserver
+// vs. persistent connections vs. pipelined requests, and checks that
+// pipelined responses keep their order, oversized headers get a 431 and
+// HTTP/1.0 clients get keep-alive only if they ask for it
+//
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/time.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+
+#include "snl/snl.h"
+
+static const char *page = "<html>hello, world!</html>";
+
+static const char *request = "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n";
+
+static int bad = 0;
+
+static double
+now(void) {
+   struct timeval tv;
+
+   gettimeofday(&tv, NULL);
+
+   return (tv.tv_sec + tv.tv_usec / 1000000.0);
+}
+
+static void
+close_callback(snl_socket_t *skt) {
+   // what demo/webserver does
+   if (skt->event_code == SNL_EVENT_ACCEPT) {
+      snl_write(skt->client_fd, page, strlen(page));
+      close(skt->client_fd);
+   }
+}
+
+static int
+dial(unsigned short port) {
+   struct sockaddr_in addr;
+   int fd, flg = 1;
+
+   memset(&addr, 0, sizeof (addr));
+   addr.sin_family = AF_INET;
+   addr.sin_port = htons(port);
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+   if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) return (-1);
+
+   setsockopt(fd, SOL_TCP, TCP_NODELAY, &flg, sizeof (flg));
+
+   if (connect(fd, (struct sockaddr *)&addr, sizeof (addr))) {
+      close(fd);
+      return (-1);
+   }
+
+   return (fd);
+}
+
+// reads until len bytes arrived or the server closed
+static int
+drain(int fd, char *buf, unsigned int size, unsigned int len) {
+   unsigned int total = 0;
+   int received;
+
+   while (!len || (total < len)) {
+      if ((received = read(fd, buf, size)) <= 0) break;
+      total += received;
+   }
+
+   return (total);
+}
+
+static void
+run_close(unsigned short port, int count) {
+   snl_socket_t *server;
+   char buf[4096];
+   double t0;
+   int i, fd;
+
+   server = snl_socket_new(SNL_PROTO_TCP, close_callback, NULL);
+
+   if (snl_listen(server, port)) {
+      printf("%-10s could not listen\n", "close");
+      return;
+   }
+
+   t0 = now();
+   for (i=0; i<count; i++) {
+      if ((fd = dial(port)) < 0) break;
+      snl_write(fd, request, strlen(request));
+      drain(fd, buf, sizeof (buf), 0);
+      close(fd);
+   }
+
+   printf("%-10s %12.0f\n", "close", i / (now() - t0));
+
+   snl_socket_delete(server);
+}
+
+static void
+run_http(const char *name, unsigned short port, int count, int depth) {
+   unsigned int length, response;
+   snl_http_t *http;
+   char buf[65536];
+   char *batch;
+   double t0;
+   int i, j, fd;
+
+   http = snl_http_new(NULL, NULL);
+   snl_http_static(http, "/", "text/html", page, strlen(page));
+
+   if (snl_http_listen(http, port) || ((fd = dial(port)) < 0)) {
+      printf("%-10s could not connect\n", name);
+      snl_http_delete(http);
+      return;
+   }
+
+   // the length of one response
+   snl_write(fd, request, strlen(request));
+   response = read(fd, buf, sizeof (buf));
+
+   length = strlen(request);
+   batch = malloc(length * depth);
+   for (j=0; j<depth; j++) memcpy(batch + j * length, request, length);
+
+   t0 = now();
+   for (i=0; i<count; i+=depth) {
+      snl_write(fd, batch, length * depth);
+      if (drain(fd, buf, sizeof (buf), response * depth) < response * depth) break;
+   }
+
+   printf("%-10s %12.0f\n", name, i / (now() - t0));
+
+   close(fd);
+   free(batch);
+
+   snl_http_delete(http);
+}
+
+// answers with the target, to tell the responses apart
+static void
+echo_handler(snl_socket_t *skt, const snl_http_request_t *req, void *data) {
+   snl_http_respond(skt, 200, "text/plain", req->target, req->target_length);
+}
+
+// reads until the server stays quiet for a second or closes
+static int
+collect(int fd, char *buf, unsigned int size) {
+   struct timeval tv = { 1, 0 };
+   unsigned int total = 0;
+   int received;
+
+   setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof (tv));
+
+   while (total < size - 1) {
+      if ((received = read(fd, buf + total, size - 1 - total)) <= 0) break;
+      total += received;
+   }
+
+   buf[total] = '\0';
+
+   return (total);
+}
+
+static void
+check_order(unsigned short port, int depth) {
+   char buf[65536], target[32], *batch, *ptr;
+   unsigned int length = 0;
+   snl_http_t *http;
+   int i, fd;
+
+   http = snl_http_new(echo_handler, NULL);
+
+   if (snl_http_listen(http, port) || ((fd = dial(port)) < 0)) {
+      printf("%-10s could not connect\n", "order");
+      snl_http_delete(http);
+      bad++;
+      return;
+   }
+
+   batch = malloc(depth * 64);
+   for (i=0; i<depth; i++) {
+      length += sprintf(batch + length, "GET /r%i HTTP/1.1\r\nHost: localhost\r\n\r\n", i);
+   }
+
+   snl_write(fd, batch, length);
+   collect(fd, buf, sizeof (buf));
+
+   // every response after the one before
+   for (i=0, ptr=buf; i<depth; i++) {
+      sprintf(target, "\r\n\r\n/r%i", i);
+      if (!(ptr = strstr(ptr, target))) break;
+      ptr += strlen(target);
+   }
+
+   printf("%-10s %12i of %i in order\n", "order", i, depth);
+   if (i < depth) bad++;
+
+   close(fd);
+   free(batch);
+
+   snl_http_delete(http);
+}
+
+static void
+check_oversized(unsigned short port) {
+   char buf[4096], *big;
+   unsigned int length;
+   snl_http_t *http;
+   int fd, ok;
+
+   http = snl_http_new(echo_handler, NULL);
+
+   if (snl_http_listen(http, port) || ((fd = dial(port)) < 0)) {
+      printf("%-10s could not connect\n", "oversized");
+      snl_http_delete(http);
+      bad++;
+      return;
+   }
+
+   // a header block far beyond what the server takes
+   big = malloc(20000);
+   length = sprintf(big, "GET / HTTP/1.1\r\nHost: localhost\r\nX-Big: ");
+   memset(big + length, 'x', 16384);
+   strcpy(big + length + 16384, "\r\n\r\n");
+
+   snl_write(fd, big, strlen(big));
+   collect(fd, buf, sizeof (buf));
+
+   ok = !strncmp(buf, "HTTP/1.1 431 ", 13);
+   printf("%-10s %12s\n", "oversized", ok ? "431" : "no 431");
+   if (!ok) bad++;
+
+   close(fd);
+   free(big);
+
+   snl_http_delete(http);
+}
+
+// reads one response with its body, 0 if it did not come within a second
+static int
+response(int fd, char *buf, unsigned int size) {
+   struct timeval tv = { 1, 0 };
+   unsigned int total = 0;
+   char *end, *len;
+   int received;
+
+   setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof (tv));
+
+   while (total < size - 1) {
+      if ((received = read(fd, buf + total, size - 1 - total)) <= 0) return (0);
+      total += received;
+      buf[total] = '\0';
+
+      if (!(end = strstr(buf, "\r\n\r\n")) || !(len = strstr(buf, "Content-Length: "))) continue;
+      if (total >= (end + 4 - buf) + atoi(len + 16)) return (total);
+   }
+
+   return (0);
+}
+
+// HTTP/1.0 clients close unless told that the connection stays open
+static void
+check_keepalive10(unsigned short port) {
+   const char *target[2] = { "/static", "/handler" };
+   char buf[4096], req[256];
+   snl_http_t *http;
+   int i, n, fd, ok;
+   double t0;
+
+   http = snl_http_new(echo_handler, NULL);
+   snl_http_static(http, "/static", "text/html", page, strlen(page));
+
+   if (snl_http_listen(http, port) || ((fd = dial(port)) < 0)) {
+      printf("%-10s could not connect\n", "http/1.0");
+      snl_http_delete(http);
+      bad++;
+      return;
+   }
+
+   // both requests on the same connection
+   for (i=0; i<2; i++) {
+      n = sprintf(req, "GET %s HTTP/1.0\r\nConnection: keep-alive\r\n\r\n", target[i]);
+      snl_write(fd, req, n);
+
+      ok = response(fd, buf, sizeof (buf)) && strstr(buf, "\r\nConnection: keep-alive\r\n");
+      printf("%-10s %12s %s\n", "http/1.0", ok ? "keep-alive" : "no keep-alive", target[i]);
+      if (!ok) bad++;
+   }
+
+   close(fd);
+
+   // without asking, the server closes after the response
+   fd = dial(port);
+   n = sprintf(req, "GET /static HTTP/1.0\r\n\r\n");
+   snl_write(fd, req, n);
+
+   ok = response(fd, buf, sizeof (buf)) && strstr(buf, "\r\nConnection: close\r\n") && !read(fd, buf, 1);
+   printf("%-10s %12s\n", "http/1.0", ok ? "close" : "no close");
+   if (!ok) bad++;
+
+   close(fd);
+
+   // an open connection is shut down and waited for
+   fd = dial(port);
+   usleep(10000);
+
+   t0 = now();
+   snl_http_delete(http);
+   printf("%-10s %9.1f ms to delete with a connection\n", "delete", (now() - t0) * 1000.0);
+
+   close(fd);
+}
+
+int
+main(int argc, char **argv) {
+   int i, port = 3000, count = 20000, depth = 16;
+
+   for (i=1; i<argc; i++) {
+      if (!strcmp(argv[i], "-p")) port  = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-c")) count = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-d")) depth = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+         puts("");
+         puts("http " VERSION " <clemens@1541.org>");
+         puts("");
+         puts("USAGE: http [-p port] [-c cnt] [-d depth]");
+         puts("\t-p ... use port <port> for connections (default 3000)");
+         puts("\t-c ... send <cnt> requests per test (default 20000)");
+         puts("\t-d ... pipeline <depth> requests at once (default 16)");
+         puts("");
+         exit(0);
+      }
+   }
+
+   snl_init();
+
+   printf("%i requests\n\n", count);
+   printf("%-10s %12s\n", "", "req/s");
+
+   run_close(port, count);
+   run_http("keepalive", port + 1, count, 1);
+   run_http("pipeline", port + 2, count, depth);
+
+   printf("\n");
+
+   check_order(port + 3, depth);
+   check_oversized(port + 4);
+   check_keepalive10(port + 5);
+
+   if (bad) {
+      printf("FAIL\n");
+      return (1);
+   }
+
+   printf("PASS\n");
+
+   return (0);
+}
@@ -0,0 +1,241 @@
+//
+// SNL loop test, checks that in-process sockets find each other by name,
+// that snl_send_message() hands the buffer itself to the receiver and
+// that a sender waits for a stalled receiver without spinning
+//
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdio.h>
+
+#include "snl/snl.h"
+
+#define QUEUE_LIMIT 65536 // messages waiting before a sender blocks
+
+static volatile int received = 0, stalled = 0, sent = 0, failed = 0;
+
+static int total = QUEUE_LIMIT + 1000;
+
+static volatile void *last = NULL;
+
+static int bad = 0;
+
+// cpu time of one thread
+static double
+cpu(pthread_t tid) {
+   struct timespec ts;
+   clockid_t clk;
+
+   pthread_getcpuclockid(tid, &clk);
+   clock_gettime(clk, &ts);
+
+   return (ts.tv_sec + ts.tv_nsec / 1000000000.0);
+}
+
+static void
+server_callback(snl_socket_t *skt) {
+   snl_socket_t *peer;
+
+   switch (skt->event_code) {
+      case SNL_EVENT_ACCEPT:
+         peer = snl_socket_new(SNL_PROTO_LOOP, server_callback, NULL);
+         peer->file_descriptor = skt->client_fd;
+         snl_accept(peer);
+      break;
+
+      case SNL_EVENT_RECEIVE:
+         while (stalled) usleep(1000);
+         last = skt->data_buffer;
+         __sync_fetch_and_add(&received, 1);
+      break;
+
+      case SNL_EVENT_ERROR:
+         snl_disconnect(skt);
+      break;
+   }
+}
+
+static void
+client_callback(snl_socket_t *skt) {
+}
+
+static void
+check(const char *name, int ok) {
+   printf("%-24s %s\n", name, ok ? "ok" : "FAIL");
+
+   if (!ok) bad++;
+}
+
+static void
+wait_for(int count) {
+   int i;
+
+   for (i=0; (received < count) && (i<3000); i++) usleep(1000);
+}
+
+static void
+names(void) {
+   snl_socket_t *alpha, *other, *numbered, *client, *udp;
+
+   alpha = snl_socket_new(SNL_PROTO_LOOP, server_callback, NULL);
+   other = snl_socket_new(SNL_PROTO_LOOP, server_callback, NULL);
+   numbered = snl_socket_new(SNL_PROTO_LOOP, server_callback, NULL);
+
+   udp = snl_socket_new(SNL_PROTO_UDP, client_callback, NULL);
+   check("name on udp refused", snl_name(udp, "x") == SNL_ERROR_PROTOCOL);
+   snl_socket_delete(udp);
+
+   snl_name(alpha, "alpha");
+   check("listen by name", !snl_listen(alpha, 0));
+
+   snl_name(other, "alpha");
+   check("same name taken", snl_listen(other, 0) == SNL_ERROR_BIND);
+
+   check("port beside a name", !snl_listen(numbered, 4000));
+
+   client = snl_socket_new(SNL_PROTO_LOOP, client_callback, NULL);
+   snl_name(client, "alpha");
+   received = 0;
+   check("connect by name", !snl_connect(client, NULL, 0) && !snl_send(client, "x", 1));
+   wait_for(1);
+   check("delivered by name", received == 1);
+   snl_socket_delete(client);
+
+   client = snl_socket_new(SNL_PROTO_LOOP, client_callback, NULL);
+   snl_name(client, "beta");
+   check("unknown name refused", snl_connect(client, NULL, 0) == SNL_ERROR_CONNECT);
+   snl_socket_delete(client);
+
+   client = snl_socket_new(SNL_PROTO_LOOP, client_callback, NULL);
+   check("connect by port", !snl_connect(client, NULL, 4000));
+   snl_socket_delete(client);
+
+   snl_socket_delete(numbered);
+   snl_socket_delete(other);
+   snl_socket_delete(alpha);
+}
+
+static void
+handover(void) {
+   snl_socket_t *server, *client;
+   void *msg;
+
+   server = snl_socket_new(SNL_PROTO_LOOP, server_callback, NULL);
+   client = snl_socket_new(SNL_PROTO_LOOP, client_callback, NULL);
+
+   snl_name(server, "handover");
+   snl_name(client, "handover");
+
+   if (snl_listen(server, 0) || snl_connect(client, NULL, 0)) {
+      check("handover connect", 0);
+      return;
+   }
+
+   received = 0;
+   last = NULL;
+
+   msg = snl_message_new(64);
+   strcpy(msg, "by pointer");
+
+   check("message sent", !snl_send_message(client, msg, 11));
+   wait_for(1);
+   check("message not copied", (received == 1) && (last == msg));
+
+   msg = snl_message_new(8);
+   check("message too long", snl_send_message(client, msg, 9) == SNL_ERROR_LENGTH);
+
+   snl_socket_delete(client);
+   snl_socket_delete(server);
+}
+
+static void *
+producer(void *arg) {
+   snl_socket_t *client = arg;
+   int i;
+
+   for (i=0; i<total; i++) {
+      if ((failed = snl_send(client, "x", 1))) break;
+      sent++;
+   }
+
+   return (NULL);
+}
+
+// more than the queue holds while the receiver sleeps
+static void
+backpressure(void) {
+   snl_socket_t *server, *client;
+   pthread_t tid;
+   double used;
+   int i;
+
+   server = snl_socket_new(SNL_PROTO_LOOP, server_callback, NULL);
+   client = snl_socket_new(SNL_PROTO_LOOP, client_callback, NULL);
+
+   if (snl_listen(server, 4001) || snl_connect(client, NULL, 4001)) {
+      check("backpressure connect", 0);
+      return;
+   }
+
+   received = 0;
+   stalled = 1;
+
+   pthread_create(&tid, NULL, producer, client);
+
+   // the callback holds one, the queue the rest
+   for (i=0; (sent <= QUEUE_LIMIT) && (i<3000); i++) usleep(1000);
+   usleep(100000);
+
+   used = cpu(tid);
+   usleep(500000);
+   used = cpu(tid) - used;
+
+   printf("%-24s %i of %i sent, %.1f ms cpu in 500 ms\n", "stalled receiver", sent, total, used * 1000.0);
+
+   check("sender blocked", sent == QUEUE_LIMIT + 1);
+   check("sender sleeps", used < 0.001);
+
+   stalled = 0;
+   pthread_join(tid, NULL);
+   wait_for(total);
+
+   check("all sent", (sent == total) && !failed);
+   check("all received", received == total);
+
+   snl_socket_delete(client);
+   snl_socket_delete(server);
+}
+
+int
+main(int argc, char **argv) {
+   int i;
+
+   for (i=1; i<argc; i++) {
+      if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+         puts("");
+         puts("loop " VERSION " <clemens@1541.org>");
+         puts("");
+         puts("USAGE: loop");
+         puts("");
+         exit(0);
+      }
+   }
+
+   snl_init();
+
+   names();
+   handover();
+   backpressure();
+
+   if (bad) {
+      printf("FAIL\n");
+      return (1);
+   }
+
+   printf("PASS\n");
+
+   return (0);
+}
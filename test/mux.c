@@ -0,0 +1,248 @@
+//
+// SNL channel benchmark, round trip of small control messages while bulk
+// messages are sent on the same connection, with and without channels,
+// and checks that a message beyond the limit of the receiver is dropped
+//
+
+#include <sys/time.h>
+#include <pthread.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sched.h>
+#include <stdio.h>
+
+#include "snl/snl.h"
+
+static volatile int echoed = 0, bulk_done = 0, too_long = 0, stop = 0, closed = 0;
+
+static int multiplex = 0, size = 100 << 20, limit = 0, bad = 0;
+
+static char *bulk;
+
+static double
+now(void) {
+   struct timeval tv;
+
+   gettimeofday(&tv, NULL);
+
+   return (tv.tv_sec + tv.tv_usec / 1000000.0);
+}
+
+static void
+server_callback(snl_socket_t *skt) {
+   snl_socket_t *peer;
+
+   switch (skt->event_code) {
+      case SNL_EVENT_ACCEPT:
+         peer = snl_socket_new(SNL_PROTO_MSG, server_callback, NULL);
+         snl_multiplex(peer, multiplex);
+         if (multiplex) snl_channel_limit(peer, limit);
+         peer->file_descriptor = skt->client_fd;
+         snl_accept(peer);
+      break;
+
+      case SNL_EVENT_ERROR:
+         if (skt->error_code == SNL_ERROR_CLOSED) {
+            snl_disconnect(skt);
+            closed++;
+         } else if (skt->error_code == SNL_ERROR_LENGTH) {
+            too_long++;
+         } else {
+            bad++;
+         }
+      break;
+
+      case SNL_EVENT_RECEIVE:
+         // control messages come back, bulk is counted
+         if (skt->data_length < 1024) {
+            snl_send(skt, skt->data_buffer, skt->data_length);
+         } else if (skt->data_length == (unsigned int)size) {
+            bulk_done++;
+         } else {
+            bad++;
+         }
+      break;
+   }
+}
+
+static void
+client_callback(snl_socket_t *skt) {
+   if (skt->event_code != SNL_EVENT_RECEIVE) return;
+
+   // control messages come back as they went
+   if ((skt->data_length != 50) || (*(char *)skt->data_buffer != 'c')) bad++;
+
+   echoed++;
+}
+
+static void *
+bulk_thread(void *arg) {
+   snl_socket_t *skt = arg;
+
+   while (!stop) {
+      if (multiplex) {
+         snl_channel_send(skt, 1, bulk, size);
+      } else {
+         snl_send(skt, bulk, size);
+      }
+   }
+
+   return (NULL);
+}
+
+static double
+run(const char *name, unsigned short port, int count) {
+   double t0, rtt, sum = 0, max = 0, start;
+   snl_socket_t *server, *client;
+   char control[50];
+   pthread_t tid;
+   int i;
+
+   server = snl_socket_new(SNL_PROTO_MSG, server_callback, NULL);
+   client = snl_socket_new(SNL_PROTO_MSG, client_callback, NULL);
+
+   if (multiplex) {
+      snl_multiplex(client, 1);
+      snl_channel_weight(client, 0, 8);
+   } else {
+      // bulk and control must not interleave within a frame
+      snl_threadsafe(client, 1);
+   }
+
+   if (snl_listen(server, port) || snl_connect(client, "localhost", port)) {
+      printf("%-6s could not connect\n", name);
+      bad++;
+      return (0);
+   }
+
+   memset(control, 'c', sizeof (control));
+
+   stop = 0; bulk_done = 0; echoed = 0;
+   pthread_create(&tid, NULL, bulk_thread, client);
+
+   start = now();
+   for (i=0; i<count; i++) {
+      usleep(10000);
+
+      t0 = now();
+      if (multiplex) {
+         snl_channel_send(client, 0, control, sizeof (control));
+      } else {
+         snl_send(client, control, sizeof (control));
+      }
+
+      while ((echoed <= i) && (now() - t0 < 30)) sched_yield();
+
+      rtt = (now() - t0) * 1000.0;
+      sum += rtt;
+      if (rtt > max) max = rtt;
+   }
+
+   stop = 1;
+   pthread_join(tid, NULL);
+
+   printf("%-6s %10.2f %10.2f %10.0f\n", name, sum / count, max,
+      (double)bulk_done * size / 1048576.0 / (now() - start));
+
+   if ((echoed != count) || !bulk_done) bad++;
+
+   closed = 0;
+   snl_socket_delete(client);
+   while (!closed) usleep(1000);
+
+   snl_socket_delete(server);
+
+   return (sum / count);
+}
+
+// a message beyond the limit is dropped, the next one arrives intact
+static void
+oversized(unsigned short port) {
+   snl_socket_t *server, *client;
+   char control[50];
+   double t0;
+
+   multiplex = 1; limit = 1 << 20;
+   echoed = 0; too_long = 0;
+
+   server = snl_socket_new(SNL_PROTO_MSG, server_callback, NULL);
+   client = snl_socket_new(SNL_PROTO_MSG, client_callback, NULL);
+   snl_multiplex(client, 1);
+
+   if (snl_listen(server, port) || snl_connect(client, "localhost", port)) {
+      printf("%-6s could not connect\n", "limit");
+      bad++;
+      return;
+   }
+
+   memset(control, 'c', sizeof (control));
+
+   snl_channel_send(client, 1, bulk, 2 << 20);
+   snl_channel_send(client, 1, control, sizeof (control));
+
+   t0 = now();
+   while (!echoed && (now() - t0 < 10)) usleep(1000);
+
+   printf("\n%-6s %i of 1 dropped, %i of 1 echoed\n", "limit", too_long, echoed);
+   if ((too_long != 1) || (echoed != 1)) bad++;
+
+   closed = 0;
+   snl_socket_delete(client);
+   while (!closed) usleep(1000);
+
+   snl_socket_delete(server);
+}
+
+int
+main(int argc, char **argv) {
+   int i, port = 3000, count = 100;
+   double plain, mux;
+
+   for (i=1; i<argc; i++) {
+      if (!strcmp(argv[i], "-p")) port  = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-c")) count = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-s")) size  = atoi(argv[i+1]) << 20;
+      if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+         puts("");
+         puts("mux " VERSION " <clemens@1541.org>");
+         puts("");
+         puts("USAGE: mux [-p port] [-c cnt] [-s size]");
+         puts("\t-p ... use port <port> for connections (default 3000)");
+         puts("\t-c ... send <cnt> control messages per test (default 100)");
+         puts("\t-s ... size of bulk messages in MB (default 100)");
+         puts("");
+         exit(0);
+      }
+   }
+
+   snl_init();
+
+   bulk = calloc(1, size > 2 << 20 ? size : 2 << 20);
+
+   printf("%i control messages during %i MB bulk messages\n\n", count, size >> 20);
+   printf("%-6s %10s %10s %10s\n", "", "avg ms", "max ms", "bulk MB/s");
+
+   multiplex = 0;
+   plain = run("plain", port, count);
+
+   // the receiver takes the bulk messages
+   multiplex = 1; limit = size;
+   mux = run("mux", port + 1, count);
+
+   // control messages no longer wait behind the bulk
+   if (mux >= plain) bad++;
+
+   oversized(port + 2);
+
+   free(bulk);
+
+   if (bad) {
+      printf("FAIL\n");
+      return (1);
+   }
+
+   printf("PASS\n");
+
+   return (0);
+}
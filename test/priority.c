@@ -0,0 +1,220 @@
+//
+// SNL priority benchmark, round trip of small control messages while more
+// bulk messages are queued than the receiver takes, with and without
+// priority lanes and a ttl for the bulk messages, and checks that control
+// messages overtake the bulk and bulk messages expire while the receiver
+// stalls
+//
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <pthread.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sched.h>
+#include <stdio.h>
+
+#include "snl/snl.h"
+
+#define PRODUCERS 3
+
+static volatile int echoed = 0, bulk_done = 0, stalled = 0, stop = 0, closed = 0;
+
+static int priority = 0, size = 4 << 10, ttl = 100, stall = 0, bad = 0;
+
+static snl_socket_t *client;
+
+static char *bulk;
+
+static double
+now(void) {
+   struct timeval tv;
+
+   gettimeofday(&tv, NULL);
+
+   return (tv.tv_sec + tv.tv_usec / 1000000.0);
+}
+
+static void
+server_callback(snl_socket_t *skt) {
+   int buf = 1 << 16;
+   snl_socket_t *peer;
+
+   switch (skt->event_code) {
+      case SNL_EVENT_ACCEPT:
+         // a small window, like a congested network would
+         setsockopt(skt->client_fd, SOL_SOCKET, SO_RCVBUF, &buf, sizeof (buf));
+
+         peer = snl_socket_new(SNL_PROTO_MSG, server_callback, NULL);
+         peer->file_descriptor = skt->client_fd;
+         snl_accept(peer);
+      break;
+
+      case SNL_EVENT_ERROR:
+         if (skt->error_code == SNL_ERROR_CLOSED) {
+            snl_disconnect(skt);
+            closed++;
+         }
+      break;
+
+      case SNL_EVENT_RECEIVE:
+         // control messages come back, bulk is slowly consumed
+         if (skt->data_length < 1024) {
+            snl_send(skt, skt->data_buffer, skt->data_length);
+         } else {
+            // the receiver stops reading for a while
+            if (stall && !stalled++) usleep(stall * 1000);
+
+            bulk_done++;
+            usleep(100);
+         }
+      break;
+   }
+}
+
+static void
+client_callback(snl_socket_t *skt) {
+   if (skt->event_code == SNL_EVENT_RECEIVE) echoed++;
+}
+
+static void *
+bulk_thread(void *arg) {
+   (void)arg;
+
+   while (!stop) {
+      if (priority) {
+         snl_send_priority(client, bulk, size, SNL_PRIORITY_LOW, ttl);
+      } else {
+         snl_send(client, bulk, size);
+      }
+
+      usleep(200);
+   }
+
+   return (NULL);
+}
+
+static double
+run(const char *name, unsigned short port, int duration) {
+   double t0, rtt, sum = 0, max = 0, start;
+   pthread_t tid[PRODUCERS];
+   snl_socket_t *server;
+   char control[50];
+   int i, count;
+
+   server = snl_socket_new(SNL_PROTO_MSG, server_callback, NULL);
+   client = snl_socket_new(SNL_PROTO_MSG, client_callback, NULL);
+
+   snl_threadsafe(client, 1);
+
+   if (snl_listen(server, port) || snl_connect(client, "localhost", port)) {
+      printf("%-6s could not connect\n", name);
+      bad++;
+      return (0);
+   }
+
+   memset(control, 'c', sizeof (control));
+
+   stop = 0; bulk_done = 0; stalled = 0; echoed = 0;
+   for (i=0; i<PRODUCERS; i++) {
+      pthread_create(&tid[i], NULL, bulk_thread, NULL);
+   }
+
+   start = now();
+   for (count=0; now() - start < duration; count++) {
+      usleep(10000);
+
+      t0 = now();
+      if (priority) {
+         snl_send_priority(client, control, sizeof (control), SNL_PRIORITY_HIGH, 0);
+      } else {
+         snl_send(client, control, sizeof (control));
+      }
+
+      while ((echoed <= count) && (now() - t0 < 30)) sched_yield();
+
+      rtt = (now() - t0) * 1000.0;
+      sum += rtt;
+      if (rtt > max) max = rtt;
+   }
+
+   stop = 1;
+   for (i=0; i<PRODUCERS; i++) {
+      pthread_join(tid[i], NULL);
+   }
+
+   printf("%-6s %10.2f %10.2f %10.0f %10u\n", name, sum / count, max,
+      (double)bulk_done * size / 1048576.0 / (now() - start), snl_send_expired(client));
+
+   // every control message came back, the bulk kept flowing
+   if ((echoed != count) || !bulk_done) bad++;
+
+   // bulk messages only expire if they waited longer than their ttl
+   if (!priority && snl_send_expired(client)) bad++;
+   if (stall && !snl_send_expired(client)) bad++;
+
+   closed = 0;
+   snl_socket_delete(client);
+   while (!closed) usleep(1000);
+
+   snl_socket_delete(server);
+
+   return (sum / count);
+}
+
+int
+main(int argc, char **argv) {
+   int i, port = 3000, duration = 2;
+   double plain, prio;
+
+   for (i=1; i<argc; i++) {
+      if (!strcmp(argv[i], "-p")) port     = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-d")) duration = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-s")) size     = atoi(argv[i+1]) << 10;
+      if (!strcmp(argv[i], "-t")) ttl      = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+         puts("");
+         puts("priority " VERSION " <clemens@1541.org>");
+         puts("");
+         puts("USAGE: priority [-p port] [-d secs] [-s size] [-t ttl]");
+         puts("\t-p ... use port <port> for connections (default 3000)");
+         puts("\t-d ... run each test for <secs> seconds (default 2)");
+         puts("\t-s ... size of bulk messages in KB (default 4)");
+         puts("\t-t ... ttl of bulk messages in ms (default 100)");
+         puts("");
+         exit(0);
+      }
+   }
+
+   snl_init();
+
+   bulk = calloc(1, size);
+
+   printf("control messages every 10 ms during %i KB bulk messages\n\n", size >> 10);
+   printf("%-6s %10s %10s %10s %10s\n", "", "avg ms", "max ms", "bulk MB/s", "expired");
+
+   priority = 0;
+   plain = run("plain", port, duration);
+
+   priority = 1;
+   prio = run("prio", port + 1, duration);
+
+   // the receiver stops for three times the ttl
+   stall = ttl * 3;
+   run("stall", port + 2, duration);
+
+   // control messages no longer wait behind the bulk
+   if (prio >= plain) bad++;
+
+   free(bulk);
+
+   if (bad) {
+      printf("FAIL\n");
+      return (1);
+   }
+
+   printf("PASS\n");
+
+   return (0);
+}
@@ -0,0 +1,209 @@
+//
+// SNL rate limit benchmark, send and receive rates of token bucket limited
+// connections, alone and sharing one bucket, checks that the rates stay
+// within a tolerance of the limit and nothing held back gets lost
+//
+
+#include <sys/time.h>
+#include <pthread.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sched.h>
+#include <stdio.h>
+
+#include "snl/snl.h"
+
+#define TOLERANCE 0.05 // of the limit
+
+static volatile int received = 0, closed = 0, stop = 0;
+
+static snl_bucket_t *inbound = NULL;
+
+static int size = 1024, bad = 0;
+
+static double sent_rate, rcvd_rate;
+
+static char *load;
+
+static double
+now(void) {
+   struct timeval tv;
+
+   gettimeofday(&tv, NULL);
+
+   return (tv.tv_sec + tv.tv_usec / 1000000.0);
+}
+
+static void
+server_callback(snl_socket_t *skt) {
+   snl_socket_t *peer;
+
+   switch (skt->event_code) {
+      case SNL_EVENT_ACCEPT:
+         peer = snl_socket_new(SNL_PROTO_MSG, server_callback, NULL);
+         if (inbound) snl_rate_limit(peer, SNL_RATE_RECEIVE, inbound);
+         peer->file_descriptor = skt->client_fd;
+         snl_accept(peer);
+      break;
+
+      case SNL_EVENT_ERROR:
+         if (skt->error_code == SNL_ERROR_CLOSED) {
+            snl_disconnect(skt);
+            closed++;
+         }
+      break;
+
+      case SNL_EVENT_RECEIVE:
+         __sync_fetch_and_add(&received, 1);
+      break;
+   }
+}
+
+static void
+client_callback(snl_socket_t *skt) {
+}
+
+static void *
+send_thread(void *arg) {
+   snl_socket_t *skt = arg;
+   long sent = 0;
+
+   while (!stop && !snl_send(skt, load, size)) sent++;
+
+   return ((void *)sent);
+}
+
+// clients send as fast as their buckets allow for the given seconds
+static void
+run(const char *name, unsigned short port, int clients, snl_bucket_t **outbound, int seconds) {
+   snl_socket_t *server, *client[2];
+   pthread_t tid[2];
+   double t0, secs;
+   long sent = 0;
+   void *count;
+   int i;
+
+   server = snl_socket_new(SNL_PROTO_MSG, server_callback, NULL);
+
+   if (snl_listen(server, port)) {
+      printf("%-10s could not listen\n", name);
+      bad++;
+      return;
+   }
+
+   for (i=0; i<clients; i++) {
+      client[i] = snl_socket_new(SNL_PROTO_MSG, client_callback, NULL);
+      if (outbound[i]) snl_rate_limit(client[i], SNL_RATE_SEND, outbound[i]);
+
+      if (snl_connect(client[i], "localhost", port)) {
+         printf("%-10s could not connect\n", name);
+         bad++;
+         return;
+      }
+   }
+
+   stop = 0; received = 0;
+   t0 = now();
+
+   for (i=0; i<clients; i++) {
+      pthread_create(&tid[i], NULL, send_thread, client[i]);
+   }
+
+   sleep(seconds);
+   stop = 1;
+
+   for (i=0; i<clients; i++) {
+      pthread_join(tid[i], &count);
+      sent += (long)count;
+   }
+
+   secs = now() - t0;
+
+   sent_rate = sent * size / secs / 1048576.0;
+   rcvd_rate = received * size / secs / 1048576.0;
+
+   printf("%-10s %10.2f %10.2f %10li %10li\n", name, sent_rate, rcvd_rate, sent, sent - received);
+
+   closed = 0;
+   for (i=0; i<clients; i++) {
+      snl_socket_delete(client[i]);
+   }
+
+   // whatever the receive limit held back is still delivered
+   while (closed < clients) usleep(1000);
+
+   if (received != sent) bad++;
+
+   snl_socket_delete(server);
+}
+
+static void
+check(double rate, int limit) {
+   if ((rate < limit * (1 - TOLERANCE)) || (rate > limit * (1 + TOLERANCE))) bad++;
+}
+
+int
+main(int argc, char **argv) {
+   int i, port = 3000, limit = 10, seconds = 2;
+   snl_bucket_t *bucket[2];
+
+   for (i=1; i<argc; i++) {
+      if (!strcmp(argv[i], "-p")) port    = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-r")) limit   = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-d")) seconds = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-s")) size    = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+         puts("");
+         puts("rate " VERSION " <clemens@1541.org>");
+         puts("");
+         puts("USAGE: rate [-p port] [-r rate] [-d secs] [-s size]");
+         puts("\t-p ... use port <port> for connections (default 3000)");
+         puts("\t-r ... limit in MB/s (default 10)");
+         puts("\t-d ... run each test for <secs> seconds (default 2)");
+         puts("\t-s ... size of payload (default 1024)");
+         puts("");
+         exit(0);
+      }
+   }
+
+   snl_init();
+
+   load = calloc(1, size);
+
+   printf("%i byte messages, limit %i MB/s\n\n", size, limit);
+   printf("%-10s %10s %10s %10s %10s\n", "", "sent MB/s", "rcvd MB/s", "sent", "pending");
+
+   // one bucket per socket
+   bucket[0] = snl_bucket_new(SNL_RATE_BYTES, limit << 20, 64 << 10);
+   bucket[1] = NULL;
+   run("send", port, 1, bucket, seconds);
+   check(sent_rate, limit);
+   printf("%-10s %10lli tokens left\n", "", snl_bucket_tokens(bucket[0]));
+
+   // the same bucket for both
+   bucket[1] = bucket[0];
+   run("shared", port + 1, 2, bucket, seconds);
+   check(sent_rate, limit);
+   snl_bucket_delete(bucket[0]);
+
+   // the receiver holds back, nothing gets lost
+   inbound = snl_bucket_new(SNL_RATE_BYTES, limit << 20, 64 << 10);
+   bucket[0] = snl_bucket_new(SNL_RATE_BYTES, limit << 21, 64 << 10);
+   bucket[1] = NULL;
+   run("receive", port + 2, 1, bucket, seconds);
+   check(rcvd_rate, limit);
+   snl_bucket_delete(bucket[0]);
+   snl_bucket_delete(inbound);
+
+   free(load);
+
+   if (bad) {
+      printf("FAIL\n");
+      return (1);
+   }
+
+   printf("PASS\n");
+
+   return (0);
+}
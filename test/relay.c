@@ -0,0 +1,122 @@
+//
+// SNL test relay, forwards every client to a server
+//
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <stdio.h>
+
+#include "snl/snl.h"
+
+static char *key = NULL, *host = "localhost";
+
+static unsigned short port = 3000;
+
+static int finished = 0;
+
+static void
+quit(int sig) {
+   finished = 1;
+}
+
+static void
+event_callback(snl_socket_t *skt) {
+   snl_socket_t *client, *server, *other = skt->user_data;
+
+   switch (skt->event_code) {
+      case SNL_EVENT_ERROR:
+         if (skt->error_code == SNL_ERROR_CLOSED) {
+            printf("connection closed, %u bytes relayed\n", skt->xfer_rcvd);
+            if (other) {
+               snl_relay(other, NULL);
+               snl_disconnect(other);
+            }
+            snl_disconnect(skt);
+         } else {
+            printf("relay error: %i (%s)\n",
+               skt->error_code,
+               snl_error_string(skt->error_code));
+         }
+      break;
+
+      case SNL_EVENT_RECEIVE:
+         // never raised while relaying
+      break;
+
+      case SNL_EVENT_ACCEPT:
+         client = snl_socket_new(SNL_PROTO_MSG, event_callback, NULL);
+         server = snl_socket_new(SNL_PROTO_MSG, event_callback, client);
+         client->user_data = server;
+
+         snl_passphrase(client, key);
+         snl_passphrase(server, key);
+
+         // hook up both directions before any data can arrive
+         snl_relay(client, server);
+         snl_relay(server, client);
+
+         if (snl_connect(server, host, port)) {
+            printf("could not connect to %s:%i\n", host, port);
+            close(skt->client_fd);
+            break;
+         }
+
+         client->file_descriptor = skt->client_fd;
+         snl_accept(client);
+
+         printf("client relayed to %s:%i\n", host, port);
+      break;
+   }
+}
+
+int
+main(int argc, char **argv) {
+   unsigned short int listen_port = 3001;
+   snl_socket_t *relay = NULL;
+
+   for (int i=1; i<argc; i++) {
+      if (!strcmp(argv[i], "-l")) listen_port = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-s")) host = argv[i+1];
+      if (!strcmp(argv[i], "-p")) port = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-k")) key  = argv[i+1];
+      if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+         puts("");
+         puts("relay " VERSION " <clemens@1541.org>");
+         puts("");
+         puts("USAGE: relay [-l port] [-s host] [-p port] [-k key]");
+         puts("\t-l ... accept clients on port <port> (default 3001)");
+         puts("\t-s ... forward to server <host> (default localhost)");
+         puts("\t-p ... forward to server port <port> (default 3000)");
+         puts("\t-k ... set cipher key to <key>, disables splice (default none)");
+         puts("");
+         exit(0);
+      }
+   }
+
+   snl_init();
+
+   signal(SIGINT,  quit);
+   signal(SIGQUIT, quit);
+   signal(SIGHUP,  quit);
+
+   printf("starting relay on port %i.\n", listen_port);
+
+   relay = snl_socket_new(SNL_PROTO_MSG, event_callback, NULL);
+   if (snl_listen(relay, listen_port)) {
+      printf("could not start relay, exiting.\n");
+      snl_socket_delete(relay);
+      exit(-1);
+   }
+
+   while (!finished) {
+      sleep(1);
+   }
+
+   printf("stopping relay.\n");
+
+   snl_socket_delete(relay);
+
+   return (0);
+}
@@ -0,0 +1,190 @@
+//
+// SNL RPC benchmark, one call per round trip like the ping of test/client
+// vs. many calls in flight on the same connection, and checks that every
+// call is answered and unanswered calls fail at their deadline
+//
+
+#include <sys/time.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sched.h>
+#include <stdio.h>
+
+#include "snl/snl.h"
+
+#define TOLERANCE 25 // ms a deadline may be late
+
+static volatile int completed = 0, failed = 0, closed = 0;
+
+static int budget = 0;
+
+static double
+now(void) {
+   struct timeval tv;
+
+   gettimeofday(&tv, NULL);
+
+   return (tv.tv_sec + tv.tv_usec / 1000000.0);
+}
+
+static void
+server_callback(snl_socket_t *skt) {
+   snl_socket_t *peer;
+
+   switch (skt->event_code) {
+      case SNL_EVENT_ACCEPT:
+         peer = snl_socket_new(SNL_PROTO_MSG, server_callback, NULL);
+         snl_rpc(peer, 1);
+         snl_coalesce(peer, budget, 0);
+         peer->file_descriptor = skt->client_fd;
+         snl_accept(peer);
+      break;
+
+      case SNL_EVENT_ERROR:
+         if (skt->error_code == SNL_ERROR_CLOSED) {
+            snl_disconnect(skt);
+            closed++;
+         }
+      break;
+
+      case SNL_EVENT_RECEIVE:
+         // requests starting with '!' are left unanswered
+         if (skt->data_length && (*(char *)skt->data_buffer == '!')) break;
+
+         snl_rpc_reply(skt, snl_rpc_id(skt), skt->data_buffer, skt->data_length);
+      break;
+   }
+}
+
+static void
+client_callback(snl_socket_t *skt) {
+}
+
+static void
+call_done(snl_socket_t *skt, int error, const void *buf, unsigned int len, void *data) {
+   if (error) {
+      __sync_fetch_and_add(&failed, 1);
+   } else {
+      __sync_fetch_and_add(&completed, 1);
+   }
+}
+
+static void
+wait_for(volatile int *counter, int value) {
+   double timeout = now() + 30;
+
+   while ((*counter < value) && (now() < timeout)) {
+      sched_yield();
+   }
+}
+
+int
+main(int argc, char **argv) {
+   int i, j, port = 3000, count = 100000, size = 64, window = 64, bad = 0;
+   snl_rpc_future_t **futures;
+   snl_socket_t *server, *client;
+   const void *reply;
+   unsigned int len;
+   char *load;
+   double t0, ms;
+
+   for (i=1; i<argc; i++) {
+      if (!strcmp(argv[i], "-p")) port   = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-c")) count  = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-s")) size   = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-w")) window = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-b")) budget = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+         puts("");
+         puts("rpc " VERSION " <clemens@1541.org>");
+         puts("");
+         puts("USAGE: rpc [-p port] [-c cnt] [-s size] [-w window] [-b us]");
+         puts("\t-p ... use port <port> for connections (default 3000)");
+         puts("\t-c ... make <cnt> calls per test (default 100000)");
+         puts("\t-s ... size of request and reply (default 64)");
+         puts("\t-w ... max calls in flight (default 64)");
+         puts("\t-b ... coalesce messages for up to <us> (default 0)");
+         puts("");
+         exit(0);
+      }
+   }
+
+   snl_init();
+
+   load = calloc(1, size + 1);
+   futures = calloc(window, sizeof (snl_rpc_future_t *));
+
+   server = snl_socket_new(SNL_PROTO_MSG, server_callback, NULL);
+   client = snl_socket_new(SNL_PROTO_MSG, client_callback, NULL);
+   snl_rpc(client, 1);
+   snl_coalesce(client, budget, 0);
+
+   if (snl_listen(server, port) || snl_connect(client, "localhost", port)) {
+      printf("could not connect\n");
+      return (1);
+   }
+
+   printf("%i calls of %i bytes\n\n", count, size);
+   printf("%-10s %12s\n", "", "calls/s");
+
+   // one call in flight, a full round trip each
+   t0 = now();
+   for (i=0; i<count; i++) {
+      if (snl_rpc_submit(client, load, size, 1000, &futures[0])) break;
+      if (snl_rpc_wait(futures[0], &reply, &len) || (len != size)) bad++;
+      snl_rpc_release(futures[0]);
+      if (bad) break;
+   }
+   printf("%-10s %12.0f\n", "serial", i / (now() - t0));
+
+   // a window of futures, waited for in order
+   t0 = now();
+   for (i=0; i<count; i+=window) {
+      for (j=0; j<window; j++) snl_rpc_submit(client, load, size, 1000, &futures[j]);
+      for (j=0; j<window; j++) {
+         if (snl_rpc_wait(futures[j], NULL, &len) || (len != size)) bad++;
+         snl_rpc_release(futures[j]);
+      }
+   }
+   printf("%-10s %12.0f\n", "futures", count / (now() - t0));
+
+   // completion callbacks, as many in flight as the window allows
+   completed = 0;
+   t0 = now();
+   for (i=0; i<count; i++) {
+      while (i - completed - failed >= window) sched_yield();
+      snl_rpc_call(client, load, size, 1000, call_done, NULL);
+   }
+   wait_for(&completed, count - failed);
+   printf("%-10s %12.0f\n", "callbacks", count / (now() - t0));
+   if ((completed != count) || failed) bad++;
+
+   // unanswered calls fail at their deadline, even behind a later one
+   load[0] = '!'; failed = 0;
+   snl_rpc_call(client, load, size, 5000, call_done, NULL);
+   t0 = now();
+   for (i=0; i<10; i++) snl_rpc_call(client, load, size, 100, call_done, NULL);
+   wait_for(&failed, 10);
+   ms = (now() - t0) * 1000;
+   printf("\n%i calls timed out after %.0f ms\n", failed, ms);
+   if ((failed != 10) || (ms < 100) || (ms > 100 + TOLERANCE)) bad++;
+
+   closed = 0;
+   snl_socket_delete(client);
+   wait_for(&closed, 1);
+
+   snl_socket_delete(server);
+
+   free(futures);
+   free(load);
+
+   if (bad) {
+      printf("FAIL\n");
+      return (1);
+   }
+
+   printf("PASS\n");
+
+   return (0);
+}
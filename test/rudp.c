@@ -0,0 +1,273 @@
+//
+// SNL reliable UDP test, runs client and server through a lossy proxy
+//
+
+#include <arpa/inet.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <pthread.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <time.h>
+#include <poll.h>
+
+#include "snl/snl.h"
+
+#define STREAMS 16
+
+static int port = 3000, count = 10000, size = 100, loss = 0, reorder = 0;
+static int ordered = 0, streams = 4, finished = 0;
+
+static volatile int received = 0, duplicates = 0, misordered = 0, closed = 0;
+static unsigned char *seen[STREAMS];
+static unsigned int expect[STREAMS];
+
+static int
+dice(int percent) {
+   return ((rand() % 100) < percent);
+}
+
+// forwards datagrams between client and server, drops some of them and
+// swaps others with the next one going the same direction
+static void *
+proxy(void *arg) {
+   static char held[2][1<<16];
+   int fd[2], len[2] = { 0, 0 }, n, i, out;
+   struct sockaddr_in addr, client;
+   socklen_t alen = sizeof (client);
+   struct pollfd pfd[2];
+   char buf[1<<16];
+
+   memset(&addr, 0, sizeof (addr));
+   memset(&client, 0, sizeof (client));
+   addr.sin_family = AF_INET;
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+   // fd[0] faces the client, fd[1] the server
+   fd[0] = socket(AF_INET, SOCK_DGRAM, 0);
+   addr.sin_port = htons(port + 1);
+   bind(fd[0], (struct sockaddr *)&addr, sizeof (addr));
+
+   fd[1] = socket(AF_INET, SOCK_DGRAM, 0);
+   addr.sin_port = htons(port);
+   connect(fd[1], (struct sockaddr *)&addr, sizeof (addr));
+
+   for (i=0; i<2; i++) {
+      pfd[i].fd = fd[i];
+      pfd[i].events = POLLIN;
+   }
+
+   while (!finished) {
+      if (poll(pfd, 2, 10) <= 0) {
+         // nothing overtook the held datagrams
+         if (len[0]) send(fd[1], held[0], len[0], 0);
+         if (len[1]) sendto(fd[0], held[1], len[1], 0, (struct sockaddr *)&client, sizeof (client));
+         len[0] = len[1] = 0;
+         continue;
+      }
+
+      for (i=0; i<2; i++) {
+         if (!(pfd[i].revents & POLLIN)) continue;
+
+         if (i) {
+            n = recv(fd[1], buf, sizeof (buf), 0);
+         } else {
+            n = recvfrom(fd[0], buf, sizeof (buf), 0, (struct sockaddr *)&client, &alen);
+         }
+
+         if (n <= 0 || dice(loss)) continue;
+
+         out = i ? 0 : 1;
+
+         if (!len[i] && dice(reorder)) {
+            memcpy(held[i], buf, n);
+            len[i] = n;
+            continue;
+         }
+
+         if (out) {
+            send(fd[1], buf, n, 0);
+            if (len[i]) send(fd[1], held[i], len[i], 0);
+         } else {
+            sendto(fd[0], buf, n, 0, (struct sockaddr *)&client, sizeof (client));
+            if (len[i]) sendto(fd[0], held[i], len[i], 0, (struct sockaddr *)&client, sizeof (client));
+         }
+
+         len[i] = 0;
+      }
+   }
+
+   close(fd[0]);
+   close(fd[1]);
+
+   return (NULL);
+}
+
+static void
+server_callback(snl_socket_t *skt) {
+   unsigned char *buf = skt->data_buffer;
+   snl_socket_t *peer;
+   unsigned int stream, seq;
+
+   switch (skt->event_code) {
+      case SNL_EVENT_ACCEPT:
+         peer = snl_socket_new(SNL_PROTO_RUDP, server_callback, NULL);
+         snl_passphrase(peer, skt->user_data);
+         snl_ordered(peer, ordered);
+         peer->file_descriptor = skt->client_fd;
+         snl_accept(peer);
+      break;
+
+      case SNL_EVENT_ERROR:
+         if (skt->error_code == SNL_ERROR_CLOSED) {
+            snl_disconnect(skt);
+            closed = 1;
+         } else {
+            printf("socket error: %s\n", snl_error_string(skt->error_code));
+         }
+      break;
+
+      case SNL_EVENT_RECEIVE:
+         stream = buf[0];
+         seq = buf[1] << 24 | buf[2] << 16 | buf[3] << 8 | buf[4];
+
+         if ((stream != skt->data_stream) || (skt->data_length != (unsigned int)size)) {
+            printf("damaged datagram\n");
+            misordered++;
+            break;
+         }
+
+         if (seen[stream][seq]++) duplicates++;
+
+         if (ordered && (seq != expect[stream]++)) misordered++;
+
+         received++;
+      break;
+   }
+}
+
+static void
+client_callback(snl_socket_t *skt) {
+   // the client only gets acks, nothing to do
+}
+
+int
+main(int argc, char **argv) {
+   snl_socket_t *server, *client;
+   unsigned char *load;
+   struct timeval t0, t1;
+   char *key = NULL;
+   pthread_t tid;
+   int i, error;
+   double ms;
+
+   for (i=1; i<argc; i++) {
+      if (!strcmp(argv[i], "-k")) key      = argv[i+1];
+      if (!strcmp(argv[i], "-p")) port     = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-c")) count    = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-s")) size     = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-l")) loss     = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-r")) reorder  = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-n")) streams  = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-o")) ordered  = 1;
+      if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+         puts("");
+         puts("rudp " VERSION " <clemens@1541.org>");
+         puts("");
+         puts("USAGE: rudp [-p port] [-c cnt] [-s size] [-l loss] [-r reorder] [-n num] [-k key] [-o]");
+         puts("\t-p ... server port <port>, proxy uses <port>+1 (default 3000)");
+         puts("\t-c ... transmit <cnt> datagrams (default 10000)");
+         puts("\t-s ... size of payload (default 100)");
+         puts("\t-l ... drop <loss> percent of all datagrams");
+         puts("\t-r ... swap <reorder> percent of all datagrams with the next one");
+         puts("\t-n ... spread datagrams over <num> streams (default 4)");
+         puts("\t-k ... set cipher key to <key>");
+         puts("\t-o ... check in order delivery per stream");
+         puts("");
+         exit(0);
+      }
+   }
+
+   if (size < 5) size = 5;
+   if (streams < 1) streams = 1;
+   if (streams > STREAMS) streams = STREAMS;
+
+   for (i=0; i<streams; i++) {
+      seen[i] = calloc(count, 1);
+   }
+
+   load = malloc(size);
+   memset(load, 'x', size);
+
+   srand(time(NULL));
+   snl_init();
+
+   server = snl_socket_new(SNL_PROTO_RUDP, server_callback, key);
+   if ((error = snl_listen(server, port))) {
+      printf("can't listen: %s\n", snl_error_string(error));
+      return (-1);
+   }
+
+   pthread_create(&tid, NULL, proxy, NULL);
+   usleep(100000); // let the proxy bind its port
+
+   client = snl_socket_new(SNL_PROTO_RUDP, client_callback, NULL);
+   snl_passphrase(client, key);
+
+   if ((error = snl_connect(client, "localhost", port + 1))) {
+      printf("can't connect: %s\n", snl_error_string(error));
+      return (-3);
+   }
+
+   gettimeofday(&t0, NULL);
+
+   for (i=0; i<count; i++) {
+      load[0] = i % streams;
+      load[1] = (i / streams) >> 24;
+      load[2] = (i / streams) >> 16;
+      load[3] = (i / streams) >> 8;
+      load[4] = (i / streams);
+
+      if ((error = snl_send_stream(client, load[0], load, size))) {
+         printf("send error: %s\n", snl_error_string(error));
+         break;
+      }
+   }
+
+   for (i=0; (i<3000) && (received + duplicates < count); i++) {
+      usleep(10000); // 10 ms
+   }
+
+   gettimeofday(&t1, NULL);
+
+   snl_disconnect(client);
+
+   for (i=0; (i<300) && !closed; i++) {
+      usleep(10000); // 10 ms
+   }
+
+   ms = (t1.tv_sec - t0.tv_sec) * 1000.0 + (t1.tv_usec - t0.tv_usec) / 1000.0;
+
+   printf("\n--- statistics ---\n");
+   printf("%i datagrams sent, %i received, %i duplicates, %i out of order\n",
+      count, received, duplicates, misordered);
+   printf("%i bytes sent in %.1f ms, peer close %s\n",
+      client->xfer_sent, ms, closed ? "seen" : "missed");
+
+   finished = 1;
+   pthread_join(tid, NULL);
+
+   snl_socket_delete(client);
+   snl_socket_delete(server);
+
+   if ((received != count) || duplicates || misordered || !closed) {
+      printf("FAIL\n");
+      return (1);
+   }
+
+   printf("PASS\n");
+
+   return (0);
+}
@@ -12,6 +12,10 @@
 
 static char *key = NULL;
 
+static snl_group_t *group = NULL;
+
+static int proto = SNL_PROTO_MSG, local = 0;
+
 static int packets = 0, shutdown = 0, xfer_sent = 0, xfer_rcvd = 0;
 
 static const char *
@@ -40,6 +44,7 @@ event_callback(snl_socket_t *skt) {
       case SNL_EVENT_ERROR:
          if (skt->error_code == SNL_ERROR_CLOSED) {
             printf("client closed connection\n");
+            if (group) snl_group_remove(group, skt);
             snl_disconnect(skt);
          } else {
             printf("client error: %i (%s)\n",
@@ -50,7 +55,11 @@ event_callback(snl_socket_t *skt) {
 
       case SNL_EVENT_RECEIVE:
          xfer_rcvd += skt->data_length;
-         snl_send(skt, skt->data_buffer, skt->data_length);
+         if (group) {
+            snl_group_send(group, skt->data_buffer, skt->data_length);
+         } else {
+            snl_send(skt, skt->data_buffer, skt->data_length);
+         }
          xfer_sent += skt->data_length;
          packets++;
       break;
@@ -59,10 +68,11 @@ event_callback(snl_socket_t *skt) {
          info = ipaddr(skt->client_ip, skt->client_port);
          printf("client connected from: %s\n", info);
 
-         client = snl_socket_new(SNL_PROTO_MSG, event_callback, NULL);
+         client = snl_socket_new(proto, event_callback, NULL);
          snl_passphrase(client, key);
          client->file_descriptor = skt->client_fd;
          snl_accept(client);
+         if (group) snl_group_add(group, client, SNL_POLICY_QUEUE);
       break;
    }
 }
@@ -75,13 +85,19 @@ main(int argc, char **argv) {
    for (int i=1; i<argc; i++) {
       if (!strcmp(argv[i], "-p")) port = atoi(argv[i+1]);
       if (!strcmp(argv[i], "-k")) key  = argv[i+1];
+      if (!strcmp(argv[i], "-g")) group = snl_group_new(SNL_PROTO_MSG);
+      if (!strcmp(argv[i], "-m")) proto = SNL_PROTO_SHM;
+      if (!strcmp(argv[i], "-u")) local = 1;
       if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
          puts("");
          puts("server " VERSION " <clemens@1541.org>");
          puts("");
-         puts("USAGE: server [-p port] [-k key]");
+         puts("USAGE: server [-p port] [-k key] [-g] [-m] [-u]");
          puts("\t-p ... use port <port> for connections (default 3000)");
          puts("\t-k ... set cipher key to <key> (default none)");
+         puts("\t-g ... relay every message to all clients (default off)");
+         puts("\t-m ... accept local clients over shared memory");
+         puts("\t-u ... accept local clients over unix domain sockets");
          puts("");
          exit(0);
       }
@@ -93,9 +109,12 @@ main(int argc, char **argv) {
    signal(SIGQUIT, quit);
    signal(SIGHUP,  quit);
 
+   if (group) snl_group_passphrase(group, key);
+
    printf("starting server on port %i.\n", port);
 
-   server = snl_socket_new(SNL_PROTO_MSG, event_callback, NULL);
+   server = snl_socket_new(proto, event_callback, NULL);
+   snl_local(server, local);
    if (snl_listen(server, port)) {
       printf("could not start server, exiting.\n");
 
@@ -114,6 +133,8 @@ main(int argc, char **argv) {
 
    snl_disconnect(server);
    snl_socket_delete(server);
+
+   if (group) snl_group_delete(group);
    
    return (0);
 }
@@ -0,0 +1,341 @@
+//
+// SNL timeout benchmark, how soon a silent peer and a peer trickling in a
+// message are noticed, if heartbeats keep quiet connections alive and what
+// the timers of many connections cost, checks that every timeout fires once
+// per period and in time, that heartbeats never reach the application and
+// that empty messages still do, and that version 1 framing sends none
+//
+
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/time.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+
+#include "snl/snl.h"
+
+#define TOLERANCE 50 // ms a timeout may be off
+
+static volatile int timeouts = 0, accepted = 0, closed = 0, received = 0, empty = 0;
+
+static unsigned int idle = 0, heartbeat = 0, deadline = 0, framing = 1;
+
+static double t0, first;
+
+static int bad = 0;
+
+static double
+now(void) {
+   struct timeval tv;
+
+   gettimeofday(&tv, NULL);
+
+   return (tv.tv_sec + tv.tv_usec / 1000000.0);
+}
+
+static double
+cpu(void) {
+   struct rusage ru;
+
+   getrusage(RUSAGE_SELF, &ru);
+
+   return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+      (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000000.0);
+}
+
+static void
+server_callback(snl_socket_t *skt) {
+   snl_socket_t *peer;
+
+   switch (skt->event_code) {
+      case SNL_EVENT_ACCEPT:
+         peer = snl_socket_new(SNL_PROTO_MSG, server_callback, NULL);
+         snl_framing(peer, framing);
+         snl_timeout(peer, idle, heartbeat);
+         snl_deadline(peer, deadline, 0);
+         peer->file_descriptor = skt->client_fd;
+         snl_accept(peer);
+         __sync_fetch_and_add(&accepted, 1);
+      break;
+
+      case SNL_EVENT_RECEIVE:
+         __sync_fetch_and_add(&received, 1);
+         if (!skt->data_length) __sync_fetch_and_add(&empty, 1);
+      break;
+
+      case SNL_EVENT_ERROR:
+         if (skt->error_code == SNL_ERROR_TIMEOUT) {
+            if (!__sync_fetch_and_add(&timeouts, 1)) first = now() - t0;
+         } else {
+            snl_disconnect(skt);
+            __sync_fetch_and_add(&closed, 1);
+         }
+      break;
+   }
+}
+
+static void
+client_callback(snl_socket_t *skt) {
+}
+
+static snl_socket_t *
+listener(const char *name, unsigned short port) {
+   snl_socket_t *server = snl_socket_new(SNL_PROTO_MSG, server_callback, NULL);
+
+   if (snl_listen(server, port)) {
+      printf("%-10s could not listen\n", name);
+      snl_socket_delete(server);
+      bad++;
+      return (NULL);
+   }
+
+   timeouts = 0; accepted = 0; closed = 0; received = 0; empty = 0; first = 0;
+
+   return (server);
+}
+
+// the count of timeouts and when the first one fired, 0 not checked
+static void
+report(const char *name, int expected, unsigned int due, double secs) {
+   int ok = (timeouts == expected) && !received;
+
+   if (due && ((first * 1000.0 < due - TOLERANCE) || (first * 1000.0 > due + TOLERANCE))) ok = 0;
+
+   printf("%-10s %10i %10i %10.1f %10.1f %s\n", name, expected, timeouts,
+      first * 1000.0, secs * 1000.0, ok ? "ok" : "FAIL");
+
+   if (!ok) bad++;
+}
+
+// the peer connects and never says a word
+static void
+silent(unsigned short port, int seconds) {
+   snl_socket_t *server, *client;
+
+   idle = 200; heartbeat = 0; deadline = 0; framing = 1;
+
+   if (!(server = listener("silent", port))) return;
+
+   client = snl_socket_new(SNL_PROTO_MSG, client_callback, NULL);
+
+   t0 = now();
+   snl_connect(client, "localhost", port);
+
+   // off the edge of the last period
+   usleep(seconds * 1000000 + idle * 500);
+
+   report("silent", seconds * 1000 / idle, idle, 0);
+
+   snl_socket_delete(client);
+   while (!closed) usleep(1000);
+   snl_socket_delete(server);
+}
+
+// both peers send heartbeats, neither of them times out
+static void
+beating(unsigned short port, int seconds) {
+   snl_socket_t *server, *client;
+
+   idle = 200; heartbeat = 50; deadline = 0; framing = 2;
+
+   if (!(server = listener("heartbeat", port))) return;
+
+   client = snl_socket_new(SNL_PROTO_MSG, client_callback, NULL);
+   snl_framing(client, framing);
+   snl_timeout(client, idle, heartbeat);
+
+   t0 = now();
+   snl_connect(client, "localhost", port);
+
+   sleep(seconds);
+
+   report("heartbeat", 0, 0, 0);
+
+   snl_socket_delete(client);
+   while (!closed) usleep(1000);
+   snl_socket_delete(server);
+}
+
+// a heartbeat asked for on a connection with version 1 framing, which
+// has no room to mark it, so the peer hears nothing and times out
+static void
+classic(unsigned short port, int seconds) {
+   snl_socket_t *server, *client;
+
+   idle = 200; heartbeat = 0; deadline = 0; framing = 1;
+
+   if (!(server = listener("version 1", port))) return;
+
+   client = snl_socket_new(SNL_PROTO_MSG, client_callback, NULL);
+   snl_timeout(client, 0, 50);
+
+   t0 = now();
+   snl_connect(client, "localhost", port);
+
+   usleep(seconds * 1000000 + idle * 500);
+
+   report("version 1", seconds * 1000 / idle, idle, 0);
+
+   snl_socket_delete(client);
+   while (!closed) usleep(1000);
+   snl_socket_delete(server);
+}
+
+// heartbeats to a peer without timeouts, then an empty message
+static void
+quiet(unsigned short port, int seconds) {
+   snl_socket_t *server, *client;
+   int i, beats, ok;
+
+   idle = 0; heartbeat = 0; deadline = 0; framing = 2;
+
+   if (!(server = listener("quiet", port))) return;
+
+   client = snl_socket_new(SNL_PROTO_MSG, client_callback, NULL);
+   snl_framing(client, framing);
+   snl_timeout(client, 0, 50);
+
+   snl_connect(client, "localhost", port);
+
+   sleep(seconds);
+
+   // heartbeats only so far, none of them is a message
+   beats = received;
+
+   snl_send(client, "", 0);
+
+   for (i=0; !received && (i<1000); i++) usleep(1000);
+
+   ok = !beats && (received == 1) && (empty == 1);
+
+   printf("%-10s %10i %10i %10s %10s %s\n", "quiet", 1, received, "-", "-", ok ? "ok" : "FAIL");
+
+   if (!ok) bad++;
+
+   snl_socket_delete(client);
+   while (!closed) usleep(1000);
+   snl_socket_delete(server);
+}
+
+// a byte of a large message every 50 ms
+static void
+trickle(unsigned short port) {
+   unsigned int header = htonl(1000);
+   struct sockaddr_in sa;
+   snl_socket_t *server;
+   int fd, i;
+
+   idle = 0; heartbeat = 0; deadline = 200; framing = 1;
+
+   if (!(server = listener("deadline", port))) return;
+
+   memset(&sa, 0, sizeof (sa));
+   sa.sin_family = AF_INET;
+   sa.sin_port = htons(port);
+   sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+   fd = socket(AF_INET, SOCK_STREAM, 0);
+   connect(fd, (struct sockaddr *)&sa, sizeof (sa));
+
+   while (!accepted) usleep(1000);
+   t0 = now();
+
+   if (write(fd, &header, sizeof (header))) {}
+
+   for (i=0; (i<1000) && !timeouts; i++) {
+      usleep(50000);
+      if (write(fd, "x", 1)) {}
+   }
+
+   report("deadline", 1, deadline, 0);
+
+   close(fd);
+   snl_socket_delete(server);
+}
+
+// many quiet connections with heartbeats, what does it cost
+static void
+crowd(unsigned short port, int count, int seconds) {
+   snl_socket_t *server, **client;
+   double start;
+   int i;
+
+   idle = 1000; heartbeat = 250; deadline = 1000; framing = 2;
+
+   if (!(server = listener("crowd", port))) return;
+
+   client = calloc(count, sizeof (snl_socket_t *));
+
+   for (i=0; i<count; i++) {
+      client[i] = snl_socket_new(SNL_PROTO_MSG, client_callback, NULL);
+      snl_framing(client[i], framing);
+      snl_timeout(client[i], idle, heartbeat);
+      snl_connect(client[i], "localhost", port);
+   }
+
+   while (accepted < count) usleep(1000);
+
+   start = cpu();
+   t0 = now();
+
+   sleep(seconds);
+
+   report("crowd", 0, 0, (cpu() - start) / seconds);
+
+   for (i=0; i<count; i++) {
+      snl_socket_delete(client[i]);
+   }
+
+   while (closed < count) usleep(1000);
+   snl_socket_delete(server);
+
+   free(client);
+}
+
+int
+main(int argc, char **argv) {
+   int i, port = 3000, count = 200, seconds = 1;
+
+   for (i=1; i<argc; i++) {
+      if (!strcmp(argv[i], "-p")) port    = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-c")) count   = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-d")) seconds = atoi(argv[i+1]);
+      if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+         puts("");
+         puts("timeout " VERSION " <clemens@1541.org>");
+         puts("");
+         puts("USAGE: timeout [-p port] [-c cnt] [-d secs]");
+         puts("\t-p ... use port <port> for connections (default 3000)");
+         puts("\t-c ... quiet connections of the crowd test (default 200)");
+         puts("\t-d ... run each test for <secs> seconds (default 1)");
+         puts("");
+         exit(0);
+      }
+   }
+
+   snl_init();
+
+   printf("idle 200 ms, heartbeat 50 ms, read deadline 200 ms\n");
+   printf("crowd of %i, idle 1 s, heartbeat 250 ms, read deadline 1 s\n\n", count);
+   printf("%-10s %10s %10s %10s %10s\n", "", "expected", "timeouts", "first ms", "cpu ms/s");
+
+   silent(port, seconds);
+   beating(port + 1, seconds);
+   quiet(port + 2, seconds);
+   trickle(port + 3);
+   crowd(port + 4, count, seconds);
+   classic(port + 5, seconds);
+
+   if (bad) {
+      printf("FAIL\n");
+      return (1);
+   }
+
+   printf("PASS\n");
+
+   return (0);
+}